@@ -354,9 +354,9 @@ int testInit(const char* name)
 {
 	//BEGIN_FUNC;
     if(name !=NULL){
-        testContext = ldb_context_create(name, 2048, 1024);
+        testContext = ldb_context_create(name, 2048, 1024, 1, LDB_CACHE_CLOCK);
     }else{
-        testContext = ldb_context_create("/tmp/testdb_ldb", 2048, 1024);
+        testContext = ldb_context_create("/tmp/testdb_ldb", 2048, 1024, 1, LDB_CACHE_CLOCK);
     }
     if(testContext==NULL){
       printf("create ldb context failed, exit!\n");
@@ -11,6 +11,7 @@
 #include "leveldb/db.h"
 #include "leveldb/env.h"
 #include "leveldb/iterator.h"
+#include "util/rate_limiter.h"
 
 namespace leveldb {
 
@@ -31,6 +32,7 @@ Status BuildTable(const std::string& dbname,
     if (!s.ok()) {
       return s;
     }
+    file = NewRateLimitedFile(file, options.rate_limiter);
 
     TableBuilder* builder = new TableBuilder(options, file);
     meta->smallest.DecodeFrom(iter->key());
@@ -38,6 +40,7 @@ Status BuildTable(const std::string& dbname,
       Slice key = iter->key();
       meta->largest.DecodeFrom(key);
       builder->Add(key, iter->value());
+      meta->CountEntry(key, iter->value());
     }
 
     // Finish and check for builder errors
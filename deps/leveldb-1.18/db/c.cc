@@ -4,8 +4,12 @@
 
 #include "leveldb/c.h"
 
+#include <algorithm>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
+#include <vector>
+#include "db/write_batch_internal.h"
 #include "leveldb/cache.h"
 #include "leveldb/comparator.h"
 #include "leveldb/db.h"
@@ -13,6 +17,7 @@
 #include "leveldb/filter_policy.h"
 #include "leveldb/iterator.h"
 #include "leveldb/options.h"
+#include "leveldb/rate_limiter.h"
 #include "leveldb/status.h"
 #include "leveldb/write_batch.h"
 #include "util/coding.h"
@@ -25,14 +30,20 @@ using leveldb::Env;
 using leveldb::FileLock;
 using leveldb::FilterPolicy;
 using leveldb::Iterator;
+using leveldb::KeyMeta;
 using leveldb::kMajorVersion;
 using leveldb::kMinorVersion;
 using leveldb::Logger;
 using leveldb::NewBloomFilterPolicy;
+using leveldb::NewClockCache;
+using leveldb::NewAdaptiveRateLimiter;
 using leveldb::NewLRUCache;
+using leveldb::NewRateLimiter;
 using leveldb::Options;
+using leveldb::PinnedValue;
 using leveldb::RandomAccessFile;
 using leveldb::Range;
+using leveldb::RateLimiter;
 using leveldb::ReadOptions;
 using leveldb::SequentialFile;
 using leveldb::Slice;
@@ -40,6 +51,7 @@ using leveldb::Snapshot;
 using leveldb::Status;
 using leveldb::WritableFile;
 using leveldb::WriteBatch;
+using leveldb::WriteBatchInternal;
 using leveldb::WriteOptions;
 using leveldb::port::Mutex;
 
@@ -53,12 +65,14 @@ struct leveldb_readoptions_t  { ReadOptions       rep; };
 struct leveldb_writeoptions_t { WriteOptions      rep; };
 struct leveldb_options_t      { Options           rep; };
 struct leveldb_cache_t        { Cache*            rep; };
+struct leveldb_ratelimiter_t  { RateLimiter*      rep; };
 struct leveldb_seqfile_t      { SequentialFile*   rep; };
 struct leveldb_randomfile_t   { RandomAccessFile* rep; };
 struct leveldb_writablefile_t { WritableFile*     rep; };
 struct leveldb_logger_t       { Logger*           rep; };
 struct leveldb_filelock_t     { FileLock*         rep; };
 struct leveldb_mutex_t        { Mutex*            rep; };
+struct leveldb_pinned_t       { PinnedValue       rep; };
 
 struct leveldb_comparator_t : public Comparator {
   void* state_;
@@ -232,6 +246,31 @@ void leveldb_put(
             db->rep->Put(options->rep, Slice(key, keylen), Slice(val, vallen)));
 }
 
+static KeyMeta MakeKeyMeta(uint32_t versioncare, uint64_t lastversion,
+                          uint64_t nextversion, uint64_t expiration) {
+  KeyMeta meta;
+  meta.versioncare = versioncare;
+  meta.lastversion = lastversion;
+  meta.nextversion = nextversion;
+  meta.expiration = expiration;
+  return meta;
+}
+
+void leveldb_put_with_meta(
+    leveldb_t* db,
+    const leveldb_writeoptions_t* options,
+    uint32_t versioncare, uint64_t lastversion,
+    uint64_t nextversion, uint64_t expiration,
+    const char* key, size_t keylen,
+    const char* val, size_t vallen,
+    char** errptr) {
+  SaveError(errptr,
+            db->rep->PutWithMeta(options->rep,
+                                 MakeKeyMeta(versioncare, lastversion,
+                                             nextversion, expiration),
+                                 Slice(key, keylen), Slice(val, vallen)));
+}
+
 void leveldb_put_meta(
     leveldb_t* db,
     const char* key, size_t keylen,
@@ -240,6 +279,15 @@ void leveldb_put_meta(
             db->rep->PutMeta(Slice(key, keylen)));  
 }
 
+void leveldb_put_meta_version(
+    leveldb_t* db,
+    const char* key, size_t keylen,
+    uint64_t version,
+    char** errptr) {
+  SaveError(errptr,
+            db->rep->PutMetaVersion(Slice(key, keylen), version));
+}
+
 void leveldb_delete(
     leveldb_t* db,
     const leveldb_writeoptions_t* options,
@@ -284,6 +332,86 @@ char* leveldb_get(
   return result;
 }
 
+void leveldb_multi_get(
+    leveldb_t* db,
+    const leveldb_readoptions_t* options,
+    size_t num_keys,
+    const char* const* keys, const size_t* keylens,
+    char** values, size_t* vallens,
+    char** errptr) {
+  std::vector<Slice> key_slices(num_keys);
+  std::vector<std::string> tmp(num_keys);
+  std::vector<Status> statuses(num_keys);
+  for (size_t i = 0; i < num_keys; i++) {
+    key_slices[i] = Slice(keys[i], keylens[i]);
+  }
+  if (num_keys > 0) {
+    db->rep->MultiGet(options->rep, static_cast<int>(num_keys),
+                      &key_slices[0], &tmp[0], &statuses[0]);
+  }
+  bool saved = false;
+  for (size_t i = 0; i < num_keys; i++) {
+    if (statuses[i].ok()) {
+      vallens[i] = tmp[i].size();
+      values[i] = CopyString(tmp[i]);
+    } else {
+      vallens[i] = 0;
+      values[i] = NULL;
+      if (!statuses[i].IsNotFound() && !saved) {
+        SaveError(errptr, statuses[i]);
+        saved = true;
+      }
+    }
+  }
+}
+
+leveldb_pinned_t* leveldb_get_pinned(
+    leveldb_t* db,
+    const leveldb_readoptions_t* options,
+    const char* key, size_t keylen,
+    const char** val, size_t* vallen,
+    char** errptr) {
+  leveldb_pinned_t* result = new leveldb_pinned_t;
+  Status s = db->rep->GetPinned(options->rep, Slice(key, keylen), &result->rep);
+  if (s.ok()) {
+    *val = result->rep.value().data();
+    *vallen = result->rep.value().size();
+    return result;
+  }
+  delete result;
+  *val = NULL;
+  *vallen = 0;
+  if (!s.IsNotFound()) {
+    SaveError(errptr, s);
+  }
+  return NULL;
+}
+
+void leveldb_pinned_release(leveldb_pinned_t* pinned) {
+  delete pinned;
+}
+
+unsigned char leveldb_exists(
+    leveldb_t* db,
+    const leveldb_readoptions_t* options,
+    const char* key, size_t keylen,
+    char* header, size_t* headerlen,
+    char** errptr) {
+  PinnedValue value;
+  Status s = db->rep->GetPinned(options->rep, Slice(key, keylen), &value);
+  if (s.ok()) {
+    const size_t n = std::min(*headerlen, value.value().size());
+    memcpy(header, value.value().data(), n);
+    *headerlen = n;
+    return 1;
+  }
+  *headerlen = 0;
+  if (!s.IsNotFound()) {
+    SaveError(errptr, s);
+  }
+  return 0;
+}
+
 leveldb_iterator_t* leveldb_create_iterator(
     leveldb_t* db,
     const leveldb_readoptions_t* options) {
@@ -315,6 +443,10 @@ void leveldb_release_snapshot(
   delete snapshot;
 }
 
+uint64_t leveldb_latest_sequence(leveldb_t* db) {
+  return db->rep->GetLatestSequenceNumber();
+}
+
 char* leveldb_property_value(
     leveldb_t* db,
     const char* propname) {
@@ -431,12 +563,50 @@ void leveldb_writebatch_put(
   b->rep.Put(Slice(key, klen), Slice(val, vlen));
 }
 
+void leveldb_writebatch_put_with_meta(
+    leveldb_writebatch_t* b,
+    uint32_t versioncare, uint64_t lastversion,
+    uint64_t nextversion, uint64_t expiration,
+    const char* key, size_t klen,
+    const char* val, size_t vlen) {
+  b->rep.PutWithMeta(MakeKeyMeta(versioncare, lastversion,
+                                 nextversion, expiration),
+                     Slice(key, klen), Slice(val, vlen));
+}
+
 void leveldb_writebatch_delete(
     leveldb_writebatch_t* b,
     const char* key, size_t klen) {
   b->rep.Delete(Slice(key, klen));
 }
 
+void leveldb_writebatch_touch(
+    leveldb_writebatch_t* b,
+    const char* key, size_t klen) {
+  b->rep.Touch(Slice(key, klen));
+}
+
+void leveldb_writebatch_merge(
+    leveldb_writebatch_t* b,
+    uint32_t versioncare, uint64_t lastversion,
+    uint64_t nextversion, uint64_t expiration,
+    const char* key, size_t klen,
+    int64_t delta, int64_t initial,
+    unsigned char drop_zero) {
+  b->rep.Merge(MakeKeyMeta(versioncare, lastversion, nextversion, expiration),
+               Slice(key, klen), delta, initial, drop_zero);
+}
+
+void leveldb_writebatch_append(
+    leveldb_writebatch_t* dst,
+    const leveldb_writebatch_t* src) {
+  WriteBatchInternal::Append(&dst->rep, &src->rep);
+}
+
+size_t leveldb_writebatch_size(const leveldb_writebatch_t* b) {
+  return WriteBatchInternal::ByteSize(&b->rep);
+}
+
 void leveldb_writebatch_iterate(
     leveldb_writebatch_t* b,
     void* state,
@@ -528,6 +698,33 @@ void leveldb_options_set_compaction_speed(leveldb_options_t* opt, int speed) {
   opt->rep.compaction_speed = speed;
 }
 
+void leveldb_options_set_rate_limiter(leveldb_options_t* opt,
+                                      leveldb_ratelimiter_t* limiter) {
+  opt->rep.rate_limiter = (limiter != NULL) ? limiter->rep : NULL;
+}
+
+void leveldb_options_set_met_table_capacity(leveldb_options_t* opt, size_t s) {
+  opt->rep.met_table_capacity = s;
+}
+
+void leveldb_options_set_met_table_checkpoint(leveldb_options_t* opt, unsigned char v) {
+  opt->rep.met_table_checkpoint = v;
+}
+
+void leveldb_options_set_row_cache_size(leveldb_options_t* opt, size_t s) {
+  opt->rep.row_cache_size = s;
+}
+
+void leveldb_options_set_row_cache_max_value_size(leveldb_options_t* opt,
+                                                  size_t s) {
+  opt->rep.row_cache_max_value_size = s;
+}
+
+void leveldb_options_set_expired_compaction_ratio(leveldb_options_t* opt,
+                                                  double ratio) {
+  opt->rep.expired_compaction_ratio = ratio;
+}
+
 void leveldb_options_set_compression(leveldb_options_t* opt, int t) {
   opt->rep.compression = static_cast<CompressionType>(t);
 }
@@ -645,11 +842,46 @@ leveldb_cache_t* leveldb_cache_create_lru(size_t capacity) {
   return c;
 }
 
+leveldb_cache_t* leveldb_cache_create_clock(size_t capacity,
+                                            int num_shard_bits) {
+  leveldb_cache_t* c = new leveldb_cache_t;
+  c->rep = NewClockCache(capacity, num_shard_bits);
+  return c;
+}
+
 void leveldb_cache_destroy(leveldb_cache_t* cache) {
   delete cache->rep;
   delete cache;
 }
 
+leveldb_ratelimiter_t* leveldb_ratelimiter_create(uint64_t bytes_per_second) {
+  leveldb_ratelimiter_t* r = new leveldb_ratelimiter_t;
+  r->rep = NewRateLimiter(bytes_per_second);
+  return r;
+}
+
+leveldb_ratelimiter_t* leveldb_ratelimiter_create_adaptive(
+    uint64_t bytes_per_second, uint64_t write_micros_target) {
+  leveldb_ratelimiter_t* r = new leveldb_ratelimiter_t;
+  r->rep = NewAdaptiveRateLimiter(bytes_per_second, write_micros_target);
+  return r;
+}
+
+void leveldb_ratelimiter_set_bytes_per_second(leveldb_ratelimiter_t* limiter,
+                                              uint64_t bytes_per_second) {
+  limiter->rep->SetBytesPerSecond(bytes_per_second);
+}
+
+uint64_t leveldb_ratelimiter_get_bytes_per_second(
+    leveldb_ratelimiter_t* limiter) {
+  return limiter->rep->GetBytesPerSecond();
+}
+
+void leveldb_ratelimiter_destroy(leveldb_ratelimiter_t* limiter) {
+  delete limiter->rep;
+  delete limiter;
+}
+
 leveldb_env_t* leveldb_create_default_env() {
   leveldb_env_t* result = new leveldb_env_t;
   result->rep = Env::Default();
@@ -18,6 +18,7 @@
 #include "db/log_writer.h"
 #include "db/memtable.h"
 #include "db/mettable.h"
+#include "db/row_cache.h"
 #include "db/table_cache.h"
 #include "db/version_set.h"
 #include "db/write_batch_internal.h"
@@ -31,8 +32,10 @@
 #include "table/merger.h"
 #include "table/two_level_iterator.h"
 #include "util/coding.h"
+#include "util/crc32c.h"
 #include "util/logging.h"
 #include "util/mutexlock.h"
+#include "util/rate_limiter.h"
 
 namespace leveldb {
 
@@ -63,6 +66,7 @@ struct DBImpl::CompactionState {
     uint64_t number;
     uint64_t file_size;
     InternalKey smallest, largest;
+    FileMetaData counts;    // Only the entry counts are used
   };
   std::vector<Output> outputs;
 
@@ -111,6 +115,10 @@ Options SanitizeOptions(const std::string& dbname,
   if (result.block_cache == NULL) {
     result.block_cache = NewLRUCache(8 << 20);
   }
+  if (result.rate_limiter == NULL && result.compaction_speed > 0) {
+    result.rate_limiter = NewRateLimiter(
+        static_cast<uint64_t>(result.compaction_speed) << 20);
+  }
   return result;
 }
 
@@ -122,12 +130,17 @@ DBImpl::DBImpl(const Options& raw_options, const std::string& dbname)
                                &internal_filter_policy_, raw_options)),
       owns_info_log_(options_.info_log != raw_options.info_log),
       owns_cache_(options_.block_cache != raw_options.block_cache),
+      owns_rate_limiter_(options_.rate_limiter != raw_options.rate_limiter),
       dbname_(dbname),
+      row_cache_(options_.row_cache_size > 0
+                 ? new RowCache(options_.row_cache_size,
+                                options_.row_cache_max_value_size)
+                 : NULL),
       db_lock_(NULL),
       shutting_down_(NULL),
       bg_cv_(&mutex_),
-      met_(new MetTable),
-      mem_(new MemTable(met_, internal_comparator_)),
+      met_(new MetTable(options_.met_table_capacity, this)),
+      mem_(new MemTable(met_, internal_comparator_, row_cache_)),
       imm_(NULL),
       logfile_(NULL),
       logfile_number_(0),
@@ -135,7 +148,13 @@ DBImpl::DBImpl(const Options& raw_options, const std::string& dbname)
       seed_(0),
       tmp_batch_(new WriteBatch),
       seq_for_recovering_(0),
+      met_checkpoint_loaded_(false),
+      met_checkpoint_enabled_(false),
+      met_snapshot_log_(0),
+      met_checkpoint_writing_(false),
       bg_compaction_scheduled_(false),
+      expire_cv_(&mutex_),
+      expire_timer_running_(false),
       manual_compaction_(NULL) {
   met_->Ref();
   mem_->Ref();
@@ -153,7 +172,8 @@ DBImpl::~DBImpl() {
   // Wait for background work to finish
   mutex_.Lock();
   shutting_down_.Release_Store(this);  // Any non-NULL value is ok
-  while (bg_compaction_scheduled_) {
+  expire_cv_.SignalAll();
+  while (bg_compaction_scheduled_ || expire_timer_running_) {
     bg_cv_.Wait();
   }
   mutex_.Unlock();
@@ -170,6 +190,7 @@ DBImpl::~DBImpl() {
   delete log_;
   delete logfile_;
   delete table_cache_;
+  delete row_cache_;
 
   if (owns_info_log_) {
     delete options_.info_log;
@@ -177,6 +198,9 @@ DBImpl::~DBImpl() {
   if (owns_cache_) {
     delete options_.block_cache;
   }
+  if (owns_rate_limiter_) {
+    delete options_.rate_limiter;
+  }
 }
 
 Status DBImpl::NewDB() {
@@ -259,6 +283,7 @@ void DBImpl::DeleteObsoleteFiles() {
         case kCurrentFile:
         case kDBLockFile:
         case kInfoLogFile:
+        case kMetTableFile:
           keep = true;
           break;
       }
@@ -307,6 +332,13 @@ Status DBImpl::Recover(VersionEdit* edit) {
   }
 
   s = versions_->Recover();
+  if (s.ok() && options_.met_table_checkpoint) {
+    Status ms = LoadMetCheckpoint();
+    if (!ms.ok()) {
+      Log(options_.info_log, "MetTable checkpoint ignored: %s",
+          ms.ToString().c_str());
+    }
+  }
   if (s.ok()) {
     SequenceNumber max_sequence(0);
     SequenceNumber min_sequence(0);
@@ -366,6 +398,9 @@ Status DBImpl::Recover(VersionEdit* edit) {
     //printf("the LastSequence2=%lu, min=%lu\n", versions_->LastSequence(), min_sequence);
     if( min_sequence > 1){
       seq_for_recovering_ = min_sequence - 1;
+    } else if (min_sequence == 0) {
+      // No log records to replay, everything is in the tables
+      seq_for_recovering_ = versions_->LastSequence();
     }
     //printf("the LastSequence2=%lu, min=%lu, recover=%lu\n", versions_->LastSequence(), min_sequence, seq_for_recovering_);
   }
@@ -515,8 +550,7 @@ Status DBImpl::WriteLevel0Table(MemTable* mem, VersionEdit* edit,
     if (base != NULL) {
       level = base->PickLevelForMemTableOutput(min_user_key, max_user_key);
     }
-    edit->AddFile(level, meta.number, meta.file_size,
-                  meta.smallest, meta.largest);
+    edit->AddFile(level, meta);
   }
 
   CompactionStats stats;
@@ -554,12 +588,186 @@ void DBImpl::CompactMemTable() {
     imm_ = NULL;
     has_imm_.Release_Store(NULL);
     DeleteObsoleteFiles();
+    if (met_snapshot_log_ != 0 &&
+        met_snapshot_log_ == versions_->LogNumber()) {
+      // The log the snapshot was started at is now the oldest one needed
+      WriteMetCheckpoint();
+    }
   } else {
     RecordBackgroundError(s);
   }
   
 }
 
+// The checkpoint is a log file of records tagged by their first byte: a
+// header with the log number it was taken at, one record of entries per
+// non empty bucket, and a footer with the number of entry records and
+// whether the table had dropped any key.  A checkpoint without footer
+// is incomplete and never used.
+enum MetCheckpointTag {
+  kMetHeader = 1,
+  kMetEntries = 2,
+  kMetFooter = 3
+};
+
+void DBImpl::SnapshotMetTable() {
+  mutex_.AssertHeld();
+  // Replay checks the versions of the log records against the loaded
+  // table, so the snapshot must not hold versions written by any of
+  // them.  The caller keeps the records of the new log from being
+  // applied; WriteMeta() and PutMetaVersion() do not wait for it, but
+  // they only bring back versions already in the tables, which the
+  // snapshot may hold or not.
+  if (met_checkpoint_writing_) {
+    // The buckets still serve the previous snapshot, skip this log
+    met_snapshot_log_ = 0;
+    return;
+  }
+  met_->BeginSnapshot();
+  met_snapshot_log_ = logfile_number_;
+}
+
+void DBImpl::WriteMetCheckpoint() {
+  mutex_.AssertHeld();
+  const uint64_t log_number = met_snapshot_log_;
+  assert(log_number != 0 && !met_checkpoint_writing_);
+  met_snapshot_log_ = 0;
+  met_checkpoint_writing_ = true;
+  mutex_.Unlock();
+
+  const std::string fname = MetTableFileName(dbname_);
+  const std::string tmp = fname + ".tmp";
+  WritableFile* file;
+  Status s = env_->NewWritableFile(tmp, &file);
+  if (s.ok()) {
+    log::Writer writer(file);
+    std::string record;
+    record.push_back(kMetHeader);
+    PutFixed64(&record, log_number);
+    s = writer.AddRecord(record);
+    bool evicted = false;
+    uint64_t count = 0;
+    for (int b = 0; s.ok() && b < met_->NumBuckets(); b++) {
+      record.assign(1, kMetEntries);
+      if (met_->SnapshotBucket(b, &record)) {
+        evicted = true;
+      }
+      if (record.size() > 1) {
+        s = writer.AddRecord(record);
+        count++;
+      }
+    }
+    if (s.ok()) {
+      record.assign(1, kMetFooter);
+      record.push_back(evicted ? 1 : 0);
+      PutFixed64(&record, count);
+      s = writer.AddRecord(record);
+    }
+    if (s.ok()) {
+      s = file->Sync();
+    }
+    if (s.ok()) {
+      s = file->Close();
+    }
+    delete file;
+    if (s.ok()) {
+      s = env_->RenameFile(tmp, fname);
+    }
+    if (!s.ok()) {
+      env_->DeleteFile(tmp);
+    }
+  }
+  met_->EndSnapshot();
+  if (!s.ok()) {
+    Log(options_.info_log, "MetTable checkpoint failed: %s",
+        s.ToString().c_str());
+  }
+
+  mutex_.Lock();
+  met_checkpoint_writing_ = false;
+}
+
+Status DBImpl::LoadMetCheckpoint() {
+  mutex_.AssertHeld();
+  const std::string fname = MetTableFileName(dbname_);
+  if (!env_->FileExists(fname)) {
+    return Status::OK();
+  }
+  SequentialFile* file;
+  Status s = env_->NewSequentialFile(fname, &file);
+  if (!s.ok()) {
+    return s;
+  }
+
+  // Entries are only applied once the whole file has been verified, a
+  // rejected checkpoint must leave met_ untouched.
+  struct LogReporter : public log::Reader::Reporter {
+    Status* status;
+    virtual void Corruption(size_t bytes, const Status& s) {
+      if (this->status->ok()) *this->status = s;
+    }
+  };
+  LogReporter reporter;
+  reporter.status = &s;
+  log::Reader reader(file, &reporter, true/*checksum*/, 0/*initial_offset*/);
+  Slice record;
+  std::string scratch;
+  std::vector<std::string> entries;
+  bool header = false;
+  bool footer = false;
+  bool evicted = false;
+  while (s.ok() && !footer && reader.ReadRecord(&record, &scratch)) {
+    if (record.empty()) {
+      s = Status::Corruption("empty MetTable checkpoint record");
+      break;
+    }
+    const char tag = record[0];
+    record.remove_prefix(1);
+    if (!header) {
+      if (tag != kMetHeader || record.size() != 8) {
+        s = Status::Corruption("bad MetTable checkpoint header");
+      } else if (DecodeFixed64(record.data()) != versions_->LogNumber()) {
+        // Taken before the latest memtable compaction
+        s = Status::NotFound("stale MetTable checkpoint");
+      }
+      header = true;
+    } else if (tag == kMetEntries) {
+      entries.push_back(record.ToString());
+    } else if (tag == kMetFooter && record.size() == 9) {
+      evicted = (record[0] != 0);
+      if (DecodeFixed64(record.data() + 1) != entries.size()) {
+        s = Status::Corruption("MetTable checkpoint entries missing");
+      }
+      footer = true;
+    } else {
+      s = Status::Corruption("bad MetTable checkpoint record");
+    }
+  }
+  delete file;
+  if (s.ok() && !footer) {
+    s = Status::Corruption("truncated MetTable checkpoint");
+  }
+  if (!s.ok()) {
+    return s;
+  }
+
+  // Records passed their checksums, a malformed one would be a bug in
+  // WriteMetCheckpoint()
+  for (size_t i = 0; i < entries.size(); i++) {
+    if (!met_->DecodeEntries(entries[i])) {
+      return Status::Corruption("bad MetTable checkpoint entries");
+    }
+    std::string().swap(entries[i]);
+  }
+  if (evicted) {
+    met_->MarkEvicted();
+  }
+  met_checkpoint_loaded_ = true;
+  Log(options_.info_log, "MetTable checkpoint loaded, %d records",
+      static_cast<int>(entries.size()));
+  return Status::OK();
+}
+
 void DBImpl::CompactRange(const Slice* begin, const Slice* end) {
   int max_level_with_files = 1;
   {
@@ -677,6 +885,30 @@ void DBImpl::BackgroundCall() {
   // so reschedule another compaction if needed.
   MaybeScheduleCompaction();
   bg_cv_.SignalAll();
+  expire_cv_.SignalAll();
+}
+
+void DBImpl::ExpirationTimer(void* db) {
+  reinterpret_cast<DBImpl*>(db)->ExpirationTimerCall();
+}
+
+void DBImpl::ExpirationTimerCall() {
+  MutexLock l(&mutex_);
+  while (!shutting_down_.Acquire_Load()) {
+    const uint64_t due = versions_->ExpirationMicros();
+    const uint64_t now = env_->NowMicros();
+    if (due == 0) {
+      expire_cv_.Wait();
+    } else if (now < due) {
+      expire_cv_.TimedWait(due - now);
+    } else {
+      // Wait for the compaction to install a version without the table
+      MaybeScheduleCompaction();
+      expire_cv_.Wait();
+    }
+  }
+  expire_timer_running_ = false;
+  bg_cv_.SignalAll();
 }
 
 void DBImpl::BackgroundCompaction() {
@@ -715,8 +947,7 @@ void DBImpl::BackgroundCompaction() {
     assert(c->num_input_files(0) == 1);
     FileMetaData* f = c->input(0, 0);
     c->edit()->DeleteFile(c->level(), f->number);
-    c->edit()->AddFile(c->level() + 1, f->number, f->file_size,
-                       f->smallest, f->largest);
+    c->edit()->AddFile(c->level() + 1, *f);
     status = versions_->LogAndApply(c->edit(), &mutex_);
     if (!status.ok()) {
       RecordBackgroundError(status);
@@ -801,6 +1032,8 @@ Status DBImpl::OpenCompactionOutputFile(CompactionState* compact) {
   std::string fname = TableFileName(dbname_, file_number);
   Status s = env_->NewWritableFile(fname, &compact->outfile);
   if (s.ok()) {
+    compact->outfile = NewRateLimitedFile(compact->outfile,
+                                          options_.rate_limiter);
     compact->builder = new TableBuilder(options_, compact->outfile);
   }
   return s;
@@ -847,27 +1080,11 @@ Status DBImpl::FinishCompactionOutputFile(CompactionState* compact,
     s = iter->status();
     delete iter;
     if (s.ok()) {
-        Log(options_.info_log,
-            "Generated table #%llu: %lld keys, %lld bytes",
-            (unsigned long long) output_number,
-            (unsigned long long) current_entries,
-            (unsigned long long) current_bytes);
-
-        // Writing current_bytes to disk is considered no expense(cost no time),
-        // so we calculate how many IOs will match the compaction speed,
-        // then sleep 1s/IOs
-        // Added by me@ideawu.com
-        int mbs = current_bytes/1024/1024;
-        if(options_.compaction_speed > 0 && mbs > 1){
-            int count = options_.compaction_speed/mbs;
-            if(count < 1){
-                count = 1;
-            }
-            int pause = 1000 * 1000 / count;
-            Log(options_.info_log, "compaction_speed: %d MB, pause: %d us",
-                options_.compaction_speed, pause);
-            env_->SleepForMicroseconds(pause);
-        }
+      Log(options_.info_log,
+          "Generated table #%llu: %lld keys, %lld bytes",
+          (unsigned long long) output_number,
+          (unsigned long long) current_entries,
+          (unsigned long long) current_bytes);
     }
   }
   return s;
@@ -888,13 +1105,42 @@ Status DBImpl::InstallCompactionResults(CompactionState* compact) {
   const int level = compact->compaction->level();
   for (size_t i = 0; i < compact->outputs.size(); i++) {
     const CompactionState::Output& out = compact->outputs[i];
-    compact->compaction->edit()->AddFile(
-        level + 1,
-        out.number, out.file_size, out.smallest, out.largest);
+    FileMetaData f = out.counts;
+    f.number = out.number;
+    f.file_size = out.file_size;
+    f.smallest = out.smallest;
+    f.largest = out.largest;
+    compact->compaction->edit()->AddFile(level + 1, f);
   }
   return versions_->LogAndApply(compact->compaction->edit(), &mutex_);
 }
 
+Status DBImpl::AddToCompactionOutput(CompactionState* compact,
+                                     Iterator* input,
+                                     const Slice& key, const Slice& value) {
+  // Open output file if necessary
+  Status status;
+  if (compact->builder == NULL) {
+    status = OpenCompactionOutputFile(compact);
+    if (!status.ok()) {
+      return status;
+    }
+  }
+  if (compact->builder->NumEntries() == 0) {
+    compact->current_output()->smallest.DecodeFrom(key);
+  }
+  compact->current_output()->largest.DecodeFrom(key);
+  compact->current_output()->counts.CountEntry(key, value);
+  compact->builder->Add(key, value);
+
+  // Close output file if it is big enough
+  if (compact->builder->FileSize() >=
+      compact->compaction->MaxOutputFileSize()) {
+    status = FinishCompactionOutputFile(compact, input);
+  }
+  return status;
+}
+
 Status DBImpl::DoCompactionWork(CompactionState* compact) {
   const uint64_t start_micros = env_->NowMicros();
   const uint64_t start_millis = start_micros/1000;
@@ -925,6 +1171,13 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
   std::string current_user_key;
   bool has_current_user_key = false;
   SequenceNumber last_sequence_for_key = kMaxSequenceNumber;
+  // Touch records and merge operands seen by every snapshot are held
+  // back until the value below them shows up, they are then written
+  // together with it as a single value.
+  std::string pending_key;
+  RecordFolder pending;
+  std::string folded;
+  bool has_pending = false;
   for (; input->Valid() && !shutting_down_.Acquire_Load(); ) {
     // Prioritize immutable compaction work
     if (has_imm_.NoBarrier_Load() != NULL) {
@@ -939,6 +1192,32 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
     }
 
     Slice key = input->key();
+    bool pending_key_matches = false;
+    if (has_pending) {
+      pending_key_matches =
+          ParseInternalKey(key, &ikey) &&
+          user_comparator()->Compare(ikey.user_key,
+                                     ExtractUserKey(pending_key)) == 0;
+      if (!pending_key_matches) {
+        // Nothing below the records here: keep them unless there is
+        // nothing below them anywhere
+        has_pending = false;
+        if (!compact->compaction->IsBaseLevelForKey(
+                ExtractUserKey(pending_key))) {
+          pending.Record(&folded);
+        } else if (!pending.Finish(NULL, start_millis, &folded) ||
+                   IsDroppedZero(folded)) {
+          folded.clear();
+        }
+        if (!folded.empty()) {
+          status = AddToCompactionOutput(compact, input, pending_key, folded);
+          if (!status.ok()) {
+            break;
+          }
+        }
+      }
+    }
+
     if (compact->compaction->ShouldStopBefore(key) &&
         compact->builder != NULL) {
       status = FinishCompactionOutputFile(compact, input);
@@ -997,6 +1276,55 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
             }
           } 
         }
+        if (!drop && ikey.sequence <= compact->smallest_snapshot &&
+            IsDroppedZero(val) &&
+            compact->compaction->IsBaseLevelForKey(ikey.user_key)) {
+          // A counter at 0 with nothing below it, like a deletion
+          drop = true;
+        }
+      }
+
+      if (pending_key_matches) {
+        // Hidden by the pending records, rule (A) dropped it already
+        assert(drop);
+        Slice val = input->value();
+        if (ikey.type == kTypeValue && NeedsFold(val)) {
+          pending.Add(val);
+        } else {
+          const bool has_base = !(ikey.type == kTypeDeletion ||
+                                  val.size() < 9 || (val[0] & kTypeLater));
+          has_pending = false;
+          if (pending.Finish(has_base ? &val : NULL, start_millis, &folded)) {
+            if (!IsDroppedZero(folded) ||
+                !compact->compaction->IsBaseLevelForKey(ikey.user_key)) {
+              status = AddToCompactionOutput(compact, input, pending_key,
+                                             folded);
+              if (!status.ok()) {
+                break;
+              }
+            }
+          } else if (!compact->compaction->IsBaseLevelForKey(ikey.user_key)) {
+            // The deletion still has to hide the values in the levels
+            // below, it takes the place of the records above it
+            ParsedInternalKey tombstone;
+            ParseInternalKey(pending_key, &tombstone);
+            tombstone.type = ikey.type;
+            folded.clear();
+            AppendInternalKey(&folded, tombstone);
+            status = AddToCompactionOutput(compact, input, folded, val);
+            if (!status.ok()) {
+              break;
+            }
+          }
+        }
+      } else if (!drop && ikey.type == kTypeValue &&
+                 ikey.sequence <= compact->smallest_snapshot &&
+                 NeedsFold(input->value())) {
+        pending_key.assign(key.data(), key.size());
+        pending.Clear();
+        pending.Add(input->value());
+        has_pending = true;
+        drop = true;
       }
 
       last_sequence_for_key = ikey.sequence;
@@ -1012,26 +1340,9 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
 #endif
 
     if (!drop) {
-      // Open output file if necessary
-      if (compact->builder == NULL) {
-        status = OpenCompactionOutputFile(compact);
-        if (!status.ok()) {
-          break;
-        }
-      }
-      if (compact->builder->NumEntries() == 0) {
-        compact->current_output()->smallest.DecodeFrom(key);
-      }
-      compact->current_output()->largest.DecodeFrom(key);
-      compact->builder->Add(key, input->value());
-
-      // Close output file if it is big enough
-      if (compact->builder->FileSize() >=
-          compact->compaction->MaxOutputFileSize()) {
-        status = FinishCompactionOutputFile(compact, input);
-        if (!status.ok()) {
-          break;
-        }
+      status = AddToCompactionOutput(compact, input, key, input->value());
+      if (!status.ok()) {
+        break;
       }
     }
 
@@ -1041,6 +1352,17 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
   if (status.ok() && shutting_down_.Acquire_Load()) {
     status = Status::IOError("Deleting DB during compaction");
   }
+  if (status.ok() && has_pending) {
+    if (!compact->compaction->IsBaseLevelForKey(ExtractUserKey(pending_key))) {
+      pending.Record(&folded);
+    } else if (!pending.Finish(NULL, start_millis, &folded) ||
+               IsDroppedZero(folded)) {
+      folded.clear();
+    }
+    if (!folded.empty()) {
+      status = AddToCompactionOutput(compact, input, pending_key, folded);
+    }
+  }
   if (status.ok() && compact->builder != NULL) {
     status = FinishCompactionOutputFile(compact, input);
   }
@@ -1142,6 +1464,16 @@ Status DBImpl::Get(const ReadOptions& options,
                    std::string* value) {
   assert(key.size() >= 28); //sizeof(uint32_t) + sizeof(uint64_t) + sizeof(uint64_t)*2 == vercare + lastver + nextver + exptime == 28 
   Slice raw_key(key.data()+28, key.size()-28);
+  const bool use_row_cache = (row_cache_ != NULL && options.snapshot == NULL);
+  if (use_row_cache) {
+    Cache::Handle* handle = row_cache_->Lookup(raw_key);
+    if (handle != NULL) {
+      Slice row = row_cache_->Value(handle);
+      value->assign(row.data(), row.size());
+      row_cache_->Release(handle);
+      return Status::OK();
+    }
+  }
   Status s;
   MutexLock l(&mutex_);
   SequenceNumber snapshot;
@@ -1174,9 +1506,155 @@ Status DBImpl::Get(const ReadOptions& options,
       s = current->Get(options, lkey, value, &stats);
       have_stat_update = true;
     }
+    if (s.ok() && NeedsFold(*value)) {
+      s = ReadFolded(options, raw_key, snapshot, value);
+    }
+    if (use_row_cache && s.ok()) {
+      row_cache_->Insert(raw_key, snapshot, *value);
+    }
+    mutex_.Lock();
+  }
+
+  if (have_stat_update && current->UpdateStats(stats)) {
+    MaybeScheduleCompaction();
+  }
+  mem->Unref();
+  if (imm != NULL) imm->Unref();
+  current->Unref();
+  return s;
+}
+
+Status DBImpl::ReadFolded(const ReadOptions& options, const Slice& raw_key,
+                          SequenceNumber snapshot, std::string* value) {
+  SequenceNumber ignored;
+  uint32_t ignored_seed;
+  Iterator* iter = NewInternalIterator(options, &ignored, &ignored_seed);
+  LookupKey lkey(raw_key, snapshot);
+  Status s;
+  RecordFolder folder;
+  Slice base;
+  bool has_base = false;
+  for (iter->Seek(lkey.internal_key()); iter->Valid(); iter->Next()) {
+    ParsedInternalKey ikey;
+    if (!ParseInternalKey(iter->key(), &ikey)) {
+      s = Status::Corruption("corrupted key for ", raw_key);
+      break;
+    }
+    if (user_comparator()->Compare(ikey.user_key, raw_key) != 0 ||
+        ikey.type == kTypeDeletion) {
+      break;
+    }
+    Slice v = iter->value();
+    if (v.size() < 9 || (v[0] & kTypeLater)) {
+      break;
+    }
+    if (NeedsFold(v)) {
+      folder.Add(v);
+      continue;
+    }
+    // Already folded by a compaction since the first read if folder is
+    // empty
+    base = v;
+    has_base = true;
+    break;
+  }
+  if (s.ok() && !iter->status().ok()) {
+    s = iter->status();
+  }
+  if (s.ok() && !folder.Finish(has_base ? &base : NULL,
+                               env_->NowMicros() / 1000, value)) {
+    s = Status::NotFound(Slice());
+  }
+  delete iter;
+  return s;
+}
+
+void DBImpl::UnrefPinnedMemTable(void* arg1, void* arg2) {
+  DBImpl* db = reinterpret_cast<DBImpl*>(arg1);
+  MemTable* mem = reinterpret_cast<MemTable*>(arg2);
+  MutexLock l(&db->mutex_);
+  mem->Unref();
+}
+
+void DBImpl::ReleaseRowCacheHandle(void* arg1, void* arg2) {
+  RowCache* row_cache = reinterpret_cast<RowCache*>(arg1);
+  row_cache->Release(reinterpret_cast<Cache::Handle*>(arg2));
+}
+
+Status DBImpl::GetPinned(const ReadOptions& options,
+                         const Slice& key,
+                         PinnedValue* value) {
+  assert(key.size() >= 28);
+  Slice raw_key(key.data()+28, key.size()-28);
+  value->Reset();
+  const bool use_row_cache = (row_cache_ != NULL && options.snapshot == NULL);
+  if (use_row_cache) {
+    Cache::Handle* handle = row_cache_->Lookup(raw_key);
+    if (handle != NULL) {
+      value->Pin(row_cache_->Value(handle));
+      value->RegisterCleanup(&DBImpl::ReleaseRowCacheHandle, row_cache_, handle);
+      return Status::OK();
+    }
+  }
+  Status s;
+  MutexLock l(&mutex_);
+  SequenceNumber snapshot;
+  if (options.snapshot != NULL) {
+    snapshot = reinterpret_cast<const SnapshotImpl*>(options.snapshot)->number_;
+  } else {
+    snapshot = versions_->LastSequence();
+  }
+
+  MemTable* mem = mem_;
+  MemTable* imm = imm_;
+  Version* current = versions_->current();
+  mem->Ref();
+  if (imm != NULL) imm->Ref();
+  current->Ref();
+
+  bool have_stat_update = false;
+  Version::GetStats stats;
+  MemTable* pinned_mem = NULL;
+
+  // Unlock while reading from files and memtables
+  {
+    mutex_.Unlock();
+    LookupKey lkey(raw_key, snapshot);
+    Slice pinned;
+    if (mem->Get(lkey, NULL, &s, &pinned)) {
+      pinned_mem = mem;
+    } else if (imm != NULL && imm->Get(lkey, NULL, &s, &pinned)) {
+      pinned_mem = imm;
+    } else {
+      // Data blocks are pinned by the iterators registered in *value
+      s = current->Get(options, lkey, NULL, &stats, value);
+      have_stat_update = true;
+    }
+    if (pinned_mem != NULL && s.ok()) {
+      value->Pin(pinned);
+    }
+    if (s.ok() && NeedsFold(value->value())) {
+      // The value is put together from several entries, it cannot be
+      // pinned
+      std::string resolved;
+      s = ReadFolded(options, raw_key, snapshot, &resolved);
+      value->Reset();
+      pinned_mem = NULL;
+      if (s.ok()) {
+        value->PinSelf(resolved);
+      }
+    }
+    if (use_row_cache && s.ok()) {
+      row_cache_->Insert(raw_key, snapshot, value->value());
+    }
     mutex_.Lock();
   }
 
+  if (pinned_mem != NULL && s.ok()) {
+    // The arena holding the value must outlive *value
+    pinned_mem->Ref();
+    value->RegisterCleanup(&DBImpl::UnrefPinnedMemTable, this, pinned_mem);
+  }
   if (have_stat_update && current->UpdateStats(stats)) {
     MaybeScheduleCompaction();
   }
@@ -1186,6 +1664,129 @@ Status DBImpl::Get(const ReadOptions& options,
   return s;
 }
 
+namespace {
+struct RequestLess {
+  const Comparator* ucmp;
+  explicit RequestLess(const Comparator* c) : ucmp(c) { }
+  bool operator()(const LookupRequest& a, const LookupRequest& b) const {
+    return ucmp->Compare(a.key->user_key(), b.key->user_key()) < 0;
+  }
+};
+}  // namespace
+
+void DBImpl::MultiGet(const ReadOptions& options, int n,
+                      const Slice* keys, std::string* values,
+                      Status* statuses) {
+  if (n <= 0) return;
+  const bool use_row_cache = (row_cache_ != NULL && options.snapshot == NULL);
+  MutexLock l(&mutex_);
+  SequenceNumber snapshot;
+  if (options.snapshot != NULL) {
+    snapshot = reinterpret_cast<const SnapshotImpl*>(options.snapshot)->number_;
+  } else {
+    snapshot = versions_->LastSequence();
+  }
+
+  MemTable* mem = mem_;
+  MemTable* imm = imm_;
+  Version* current = versions_->current();
+  mem->Ref();
+  if (imm != NULL) imm->Ref();
+  current->Ref();
+
+  // Unlock while reading from files and memtables
+  {
+    mutex_.Unlock();
+    std::vector<LookupKey*> lkeys(n);
+    std::vector<LookupRequest> requests(n);
+    std::vector<bool> cached(n, false);
+    for (int i = 0; i < n; i++) {
+      assert(keys[i].size() >= 28);
+      Slice raw_key(keys[i].data() + 28, keys[i].size() - 28);
+      lkeys[i] = new LookupKey(raw_key, snapshot);
+      requests[i].key = lkeys[i];
+      requests[i].value = &values[i];
+      requests[i].status = &statuses[i];
+      requests[i].done = false;
+      Cache::Handle* handle =
+          use_row_cache ? row_cache_->Lookup(raw_key) : NULL;
+      if (handle != NULL) {
+        Slice row = row_cache_->Value(handle);
+        values[i].assign(row.data(), row.size());
+        statuses[i] = Status::OK();
+        requests[i].done = true;
+        cached[i] = true;
+        row_cache_->Release(handle);
+      }
+    }
+    // Every source is walked forward once over the sorted keys
+    std::stable_sort(requests.begin(), requests.end(),
+                     RequestLess(user_comparator()));
+
+    mem->MultiGet(&requests[0], n);
+    if (imm != NULL) {
+      imm->MultiGet(&requests[0], n);
+    }
+    current->MultiGet(options, &requests[0], n);
+    for (int i = 0; i < n; i++) {
+      if (cached[i]) {
+        delete lkeys[i];
+        continue;
+      }
+      if (statuses[i].ok() && NeedsFold(values[i])) {
+        statuses[i] = ReadFolded(options, lkeys[i]->user_key(), snapshot,
+                                 &values[i]);
+      }
+      if (use_row_cache && statuses[i].ok()) {
+        row_cache_->Insert(lkeys[i]->user_key(), snapshot, values[i]);
+      }
+      delete lkeys[i];
+    }
+    mutex_.Lock();
+  }
+
+  mem->Unref();
+  if (imm != NULL) imm->Unref();
+  current->Unref();
+}
+
+bool DBImpl::ResolveVersion(const Slice& key, uint64_t* version) {
+  mutex_.Lock();
+  MemTable* mem = mem_;
+  MemTable* imm = imm_;
+  Version* current = versions_->current();
+  mem->Ref();
+  if (imm != NULL) imm->Ref();
+  current->Ref();
+  mutex_.Unlock();
+
+  // Records of the write group being applied are not covered by
+  // LastSequence() yet, so look past it.
+  std::string value;
+  Status s;
+  LookupKey lkey(key, kMaxSequenceNumber);
+  if (mem->Get(lkey, &value, &s)) {
+    // Done
+  } else if (imm != NULL && imm->Get(lkey, &value, &s)) {
+    // Done
+  } else {
+    Version::GetStats stats;
+    s = current->Get(ReadOptions(), lkey, &value, &stats);
+  }
+
+  mutex_.Lock();
+  mem->Unref();
+  if (imm != NULL) imm->Unref();
+  current->Unref();
+  mutex_.Unlock();
+
+  if (!s.ok() || value.size() < 1 + sizeof(uint64_t)) {
+    return false;
+  }
+  *version = DecodeFixed64(value.data() + 1);
+  return true;
+}
+
 Iterator* DBImpl::NewIterator(const ReadOptions& options) {
   SequenceNumber latest_snapshot;
   uint32_t seed;
@@ -1221,6 +1822,11 @@ void DBImpl::ReleaseSnapshot(const Snapshot* s) {
   snapshots_.Delete(reinterpret_cast<const SnapshotImpl*>(s));
 }
 
+uint64_t DBImpl::GetLatestSequenceNumber() {
+  MutexLock l(&mutex_);
+  return versions_->LastSequence();
+}
+
 // Convenience methods
 Status DBImpl::Put(const WriteOptions& o, const Slice& key, const Slice& val) {
   return DB::Put(o, key, val);
@@ -1238,12 +1844,40 @@ Status DBImpl::Delete(const WriteOptions& options, const Slice& key) {
 
 
 Status DBImpl::WriteMeta(const Slice& key){
-  MutexLock l(&mutex_);
-  mem_->AddMeta(key);
+  // AddMeta() may call back into ResolveVersion(), so do not hold mutex_
+  mutex_.Lock();
+  MemTable* mem = mem_;
+  mem->Ref();
+  mutex_.Unlock();
+
+  mem->AddMeta(key);
+
+  mutex_.Lock();
+  mem->Unref();
+  mutex_.Unlock();
+  return Status();
+}
+
+Status DBImpl::PutMetaVersion(const Slice& key, uint64_t version){
+  // met_ lives as long as the DB and its buckets do their own locking,
+  // so concurrent callers do not contend on mutex_
+  met_->Insert(crc32c::Value(key.data(), key.size()), key, version);
   return Status();
 }
 
 void DBImpl::WriteRecovering(const WriteOptions& options){
+    // met_ now accounts for every key and the log opened by Open() is
+    // still empty, the replay below logs the records again.  From here on
+    // each log switch snapshots met_ for the checkpoint.
+    if (options_.met_table_checkpoint) {
+      MutexLock l(&mutex_);
+      met_checkpoint_enabled_ = true;
+      SnapshotMetTable();
+      if (met_snapshot_log_ != 0) {
+        WriteMetCheckpoint();
+      }
+    }
+
     const size_t size = batch_for_recovering_.size();
     for( size_t l=0; l<size; ++l){
         MemTable* mem = NULL;
@@ -1256,6 +1890,8 @@ void DBImpl::WriteRecovering(const WriteOptions& options){
 }
 
 Status DBImpl::Write(const WriteOptions& options, WriteBatch* my_batch) {
+  const uint64_t start_micros =
+      options_.rate_limiter != NULL ? env_->NowMicros() : 0;
   Writer w(&mutex_);
   w.batch = my_batch;
   w.sync = options.sync;
@@ -1267,6 +1903,9 @@ Status DBImpl::Write(const WriteOptions& options, WriteBatch* my_batch) {
     w.cv.Wait();
   }
   if (w.done) {
+    if (my_batch != NULL) {
+      ReportWrite(start_micros);
+    }
     return w.status;
   }
 
@@ -1325,9 +1964,21 @@ Status DBImpl::Write(const WriteOptions& options, WriteBatch* my_batch) {
     writers_.front()->cv.Signal();
   }
 
+  if (my_batch != NULL) {
+    ReportWrite(start_micros);
+  }
   return status;
 }
 
+void DBImpl::ReportWrite(uint64_t start_micros) {
+  mutex_.AssertHeld();
+  if (options_.rate_limiter != NULL) {
+    options_.rate_limiter->ReportWrite(
+        env_->NowMicros() - start_micros,
+        versions_->NumLevelFiles(0) > config::kL0_CompactionTrigger);
+  }
+}
+
 // REQUIRES: Writer list must be non-empty
 // REQUIRES: First writer must have a non-NULL batch
 WriteBatch* DBImpl::BuildBatchGroup(Writer** last_writer) {
@@ -1433,8 +2084,11 @@ Status DBImpl::MakeRoomForWrite(bool force) {
       log_ = new log::Writer(lfile);
       imm_ = mem_;
       has_imm_.Release_Store(imm_);
-      mem_ = new MemTable(met_, internal_comparator_);
+      mem_ = new MemTable(met_, internal_comparator_, row_cache_);
       mem_->Ref();
+      if (met_checkpoint_enabled_) {
+        SnapshotMetTable();
+      }
       force = false;   // Do not force another compaction if have room
       MaybeScheduleCompaction();
     }
@@ -1491,6 +2145,9 @@ bool DBImpl::GetProperty(const Slice& property, std::string* value) {
   } else if (in == "sstables") {
     *value = versions_->current()->DebugString();
     return true;
+  } else if (in == "met-checkpoint-loaded") {
+    *value = met_checkpoint_loaded_ ? "1" : "0";
+    return true;
   }
 
   return false;
@@ -1530,10 +2187,35 @@ Status DB::Put(const WriteOptions& opt, const Slice& key, const Slice& value) {
   return Write(opt, &batch);
 }
 
+Status DB::PutWithMeta(const WriteOptions& opt, const KeyMeta& meta,
+                       const Slice& key, const Slice& value) {
+  WriteBatch batch;
+  batch.PutWithMeta(meta, key, value);
+  return Write(opt, &batch);
+}
+
 Status DB::PutMeta(const Slice& key){
   return WriteMeta(key);
 }
 
+void DB::MultiGet(const ReadOptions& options, int n,
+                  const Slice* keys, std::string* values,
+                  Status* statuses) {
+  for (int i = 0; i < n; i++) {
+    statuses[i] = Get(options, keys[i], &values[i]);
+  }
+}
+
+Status DB::GetPinned(const ReadOptions& options,
+                     const Slice& key, PinnedValue* value) {
+  value->Reset();
+  Status s = Get(options, key, value->GetSelf());
+  if (s.ok()) {
+    value->Pin(*value->GetSelf());
+  }
+  return s;
+}
+
 Status DB::Delete(const WriteOptions& opt, const Slice& key) {
   WriteBatch batch;
   batch.Delete(key);
@@ -1566,6 +2248,10 @@ Status DB::Open(const Options& options, const std::string& dbname,
     if (s.ok()) {
       impl->DeleteObsoleteFiles();
       impl->MaybeScheduleCompaction();
+      if (options.expired_compaction_ratio > 0) {
+        impl->expire_timer_running_ = true;
+        options.env->StartThread(&DBImpl::ExpirationTimer, impl);
+      }
     }
   }
   impl->mutex_.Unlock();
@@ -1580,6 +2266,38 @@ Status DB::Open(const Options& options, const std::string& dbname,
 Snapshot::~Snapshot() {
 }
 
+PinnedValue::PinnedValue() : cleanup_(NULL) { }
+
+PinnedValue::~PinnedValue() {
+  Reset();
+}
+
+void PinnedValue::Reset() {
+  while (cleanup_ != NULL) {
+    Cleanup* c = cleanup_;
+    cleanup_ = c->next;
+    (*c->function)(c->arg1, c->arg2);
+    delete c;
+  }
+  value_.clear();
+  buf_.clear();
+}
+
+void PinnedValue::RegisterCleanup(CleanupFunction func, void* arg1, void* arg2) {
+  assert(func != NULL);
+  Cleanup* c = new Cleanup;
+  c->function = func;
+  c->arg1 = arg1;
+  c->arg2 = arg2;
+  c->next = cleanup_;
+  cleanup_ = c;
+}
+
+void PinnedValue::PinSelf(const Slice& value) {
+  buf_.assign(value.data(), value.size());
+  value_ = buf_;
+}
+
 Status DestroyDB(const std::string& dbname, const Options& options) {
   Env* env = options.env;
   std::vector<std::string> filenames;
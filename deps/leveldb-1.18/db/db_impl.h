@@ -9,6 +9,7 @@
 #include <set>
 #include "db/dbformat.h"
 #include "db/log_writer.h"
+#include "db/mettable.h"
 #include "db/snapshot.h"
 #include "leveldb/db.h"
 #include "leveldb/env.h"
@@ -17,14 +18,14 @@
 
 namespace leveldb {
 
-class MetTable;
 class MemTable;
+class RowCache;
 class TableCache;
 class Version;
 class VersionEdit;
 class VersionSet;
 
-class DBImpl : public DB {
+class DBImpl : public DB, public MetTable::Resolver {
  public:
   DBImpl(const Options& options, const std::string& dbname);
   virtual ~DBImpl();
@@ -37,12 +38,19 @@ class DBImpl : public DB {
   virtual Status Get(const ReadOptions& options,
                      const Slice& key,
                      std::string* value);
+  virtual void MultiGet(const ReadOptions& options, int n,
+                        const Slice* keys, std::string* values,
+                        Status* statuses);
+  virtual Status GetPinned(const ReadOptions& options,
+                           const Slice& key, PinnedValue* value);
   virtual Status WriteMeta(const Slice& key);
+  virtual Status PutMetaVersion(const Slice& key, uint64_t version);
   virtual void WriteRecovering(const WriteOptions& options);
   virtual Iterator* NewIterator(const ReadOptions&);
   virtual const Snapshot* GetSnapshot();
   virtual const Snapshot* GetSnapshotForRecovering();
   virtual void ReleaseSnapshot(const Snapshot* snapshot);
+  virtual uint64_t GetLatestSequenceNumber();
   virtual bool GetProperty(const Slice& property, std::string* value);
   virtual void GetApproximateSizes(const Range* range, int n, uint64_t* sizes);
   virtual void CompactRange(const Slice* begin, const Slice* end);
@@ -69,6 +77,11 @@ class DBImpl : public DB {
   // bytes.
   void RecordReadSample(Slice key);
 
+  // Implementation of MetTable::Resolver: reads the version from the
+  // value header of the newest record of the user key "key".
+  // REQUIRES: mutex_ not held
+  virtual bool ResolveVersion(const Slice& key, uint64_t* version);
+
  private:
   friend class DB;
   struct CompactionState;
@@ -104,15 +117,47 @@ class DBImpl : public DB {
   Status WriteLevel0Table(MemTable* mem, VersionEdit* edit, Version* base)
       EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
+  // Start a copy on write snapshot of met_ as of the start of the
+  // current log: it reflects every record of the earlier logs and none
+  // of that log's.  Only visits the buckets of met_.  REQUIRES: no write
+  // is being applied, i.e. the caller is the front writer or there is none.
+  void SnapshotMetTable() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  // Save the snapshot of met_ so that a later Open() only has to replay
+  // the logs from the one it was taken at on.  Releases mutex_ while the
+  // snapshot is encoded and written.
+  void WriteMetCheckpoint() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  // Load the checkpoint if it is still valid for the recovered version.
+  Status LoadMetCheckpoint() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
   Status MakeRoomForWrite(bool force /* compact even if there is room? */)
       EXCLUSIVE_LOCKS_REQUIRED(mutex_);
   WriteBatch* BuildBatchGroup(Writer** last_writer);
 
+  // Tell options_.rate_limiter how long a write begun at start_micros took.
+  void ReportWrite(uint64_t start_micros) EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
   void RecordBackgroundError(const Status& s);
 
   void MaybeScheduleCompaction() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
   static void BGWork(void* db);
+  static void ExpirationTimer(void* db);
+  static void UnrefPinnedMemTable(void* db, void* mem);
+  static void ReleaseRowCacheHandle(void* row_cache, void* handle);
+
+  // Reads the value of raw_key at snapshot when the newest entry for it
+  // is a touch record or a merge operand, by folding the records down to
+  // the value below them, see RecordFolder.
+  // REQUIRES: mutex_ not held
+  Status ReadFolded(const ReadOptions& options, const Slice& raw_key,
+                    SequenceNumber snapshot, std::string* value);
   void BackgroundCall();
+
+  // Schedules a compaction whenever a table of the current version has
+  // enough expired entries, which time alone brings about.  Runs until
+  // shutdown.
+  void ExpirationTimerCall();
   void  BackgroundCompaction() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
   void CleanupCompaction(CompactionState* compact)
       EXCLUSIVE_LOCKS_REQUIRED(mutex_);
@@ -121,6 +166,8 @@ class DBImpl : public DB {
 
   Status OpenCompactionOutputFile(CompactionState* compact);
   Status FinishCompactionOutputFile(CompactionState* compact, Iterator* input);
+  Status AddToCompactionOutput(CompactionState* compact, Iterator* input,
+                               const Slice& key, const Slice& value);
   Status InstallCompactionResults(CompactionState* compact)
       EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
@@ -131,10 +178,12 @@ class DBImpl : public DB {
   const Options options_;  // options_.comparator == &internal_comparator_
   bool owns_info_log_;
   bool owns_cache_;
+  bool owns_rate_limiter_;
   const std::string dbname_;
 
   // table_cache_ provides its own synchronization
   TableCache* table_cache_;
+  RowCache* row_cache_;          // NULL unless options_.row_cache_size > 0
 
   // Lock over the persistent DB state.  Non-NULL iff successfully acquired.
   FileLock* db_lock_;
@@ -162,6 +211,13 @@ class DBImpl : public DB {
 
   std::vector<std::vector<WriteBatch> > batch_for_recovering_;
 
+  bool met_checkpoint_loaded_;   // Open() restored met_ from a checkpoint
+  bool met_checkpoint_enabled_;  // met_ is complete, checkpoints may be taken
+  uint64_t met_snapshot_log_;    // Log the snapshot of met_ was started
+                                 // at, saved once it is the oldest needed
+                                 // one; 0 if there is none
+  bool met_checkpoint_writing_;  // WriteMetCheckpoint() is at work
+
   // Set of table files to protect from deletion because they are
   // part of ongoing compactions.
   std::set<uint64_t> pending_outputs_;
@@ -169,6 +225,10 @@ class DBImpl : public DB {
   // Has a background compaction been scheduled or is running?
   bool bg_compaction_scheduled_;
 
+  // Wakes the expiration timer when the current version changes
+  port::CondVar expire_cv_;
+  bool expire_timer_running_;
+
   // Information for a manual compaction
   struct ManualCompaction {
     int level;
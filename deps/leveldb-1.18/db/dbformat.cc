@@ -15,6 +15,88 @@ static uint64_t PackSequenceAndType(uint64_t seq, ValueType t) {
   return (seq << 8) | t;
 }
 
+void ApplyTouch(const Slice& touch, const Slice& base, std::string* result) {
+  assert(IsTouchValue(touch));
+  const size_t touch_header = ValueHeaderSize(touch);
+  const size_t base_header = ValueHeaderSize(base);
+  assert(touch.size() >= touch_header && base.size() >= base_header);
+  result->clear();
+  result->reserve(touch_header + base.size() - base_header);
+  result->push_back(static_cast<char>((touch[0] & ~kTypeTouch) |
+                                      (base[0] & kTypeDropZero)));
+  result->append(touch.data() + 1, touch_header - 1);
+  result->append(base.data() + base_header, base.size() - base_header);
+}
+
+void RecordFolder::Clear() {
+  header_.clear();
+  touch_.clear();
+  has_merge_ = false;
+  drop_zero_ = false;
+  delta_ = 0;
+  initial_ = 0;
+}
+
+void RecordFolder::Add(const Slice& record) {
+  assert(NeedsFold(record));
+  const size_t header = ValueHeaderSize(record);
+  assert(record.size() >= header);
+  if (header_.empty()) {
+    header_.assign(record.data(), header);
+    if (!IsMergeValue(record)) {
+      touch_.assign(record.data(), record.size());
+    }
+  }
+  if (IsMergeValue(record)) {
+    assert(record.size() >= header + 16);
+    delta_ += DecodeFixed64(record.data() + header);
+    initial_ = DecodeFixed64(record.data() + header + 8);
+    has_merge_ = true;
+    if (record[0] & kTypeDropZero) drop_zero_ = true;
+  }
+}
+
+void RecordFolder::Record(std::string* result) const {
+  assert(!empty());
+  if (!has_merge_) {
+    result->assign(touch_);
+    return;
+  }
+  result->assign(header_);
+  (*result)[0] = static_cast<char>((header_[0] & ~kTypeTouch) | kTypeMerge |
+                                   (drop_zero_ ? kTypeDropZero : 0));
+  PutFixed64(result, delta_);
+  PutFixed64(result, initial_);
+}
+
+bool RecordFolder::Finish(const Slice* base, uint64_t now_millis,
+                          std::string* result) const {
+  if (empty()) {
+    if (base == NULL) return false;
+    result->assign(base->data(), base->size());
+    return true;
+  }
+  if (!has_merge_) {
+    if (base == NULL) return false;
+    ApplyTouch(touch_, *base, result);
+    return true;
+  }
+  uint64_t counter = initial_;
+  if (base != NULL) {
+    const size_t header = ValueHeaderSize(*base);
+    const bool expired = ((*base)[0] & kTypeExpiration) &&
+                         DecodeFixed64(base->data() + 1 + 8) <= now_millis;
+    if (!expired && base->size() == header + 8) {
+      counter = DecodeFixed64(base->data() + header);
+    }
+  }
+  result->assign(header_);
+  (*result)[0] = static_cast<char>((header_[0] & ~(kTypeTouch | kTypeMerge)) |
+                                   (drop_zero_ ? kTypeDropZero : 0));
+  PutFixed64(result, counter + delta_);
+  return true;
+}
+
 void AppendInternalKey(std::string* result, const ParsedInternalKey& key) {
   result->append(key.user_key.data(), key.user_key.size());
   PutFixed64(result, PackSequenceAndType(key.sequence, key.type));
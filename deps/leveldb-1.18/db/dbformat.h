@@ -52,7 +52,18 @@ enum ValueType {
   kTypeDeletion = 0x0,
   kTypeValue = 0x1,
   kTypeExpiration = 0x2,
-  kTypeLater = 0x4
+  kTypeLater = 0x4,
+  // A value header without a value of its own: it replaces the version
+  // and expiration of the value below it, see ApplyTouch().  Only ever
+  // found in the value header, the internal key says kTypeValue.
+  kTypeTouch = 0x8,
+  // A merge operand: the user value is a fixed64 delta and a fixed64
+  // initial value to be added to the counter below it, see RecordFolder.
+  // Like kTypeTouch only ever found in the value header.
+  kTypeMerge = 0x10,
+  // Set along with kTypeMerge, and kept by the counter it folds into:
+  // compactions drop the counter once it is 0 with nothing below it.
+  kTypeDropZero = 0x20
 };
 // kValueTypeForSeek defines the ValueType that should be passed when
 // constructing a ParsedInternalKey object for seeking to a particular
@@ -187,6 +198,86 @@ inline bool ParseInternalKey(const Slice& internal_key,
   return (c <= static_cast<unsigned char>(kTypeValue));
 }
 
+// Size of the value header: type, version and the expiration if any.
+inline size_t ValueHeaderSize(const Slice& value) {
+  if (value.size() > 0 && (value[0] & kTypeExpiration)) return 1 + 8 + 8;
+  return 1 + 8;
+}
+
+// Returns true iff value was stored by WriteBatch::Touch().
+inline bool IsTouchValue(const Slice& value) {
+  return value.size() > 0 && (value[0] & kTypeTouch);
+}
+
+// Stores in *result the value base takes once the touch record touch is
+// applied to it: the header of touch, without kTypeTouch, followed by
+// the user value of base.
+extern void ApplyTouch(const Slice& touch, const Slice& base,
+                       std::string* result);
+
+// Returns true iff value was stored by WriteBatch::Merge().
+inline bool IsMergeValue(const Slice& value) {
+  return value.size() > 0 && (value[0] & kTypeMerge);
+}
+
+// Returns true iff value only means something together with the entries
+// below it, i.e. it is a touch record or a merge operand.
+inline bool NeedsFold(const Slice& value) {
+  return value.size() > 0 && (value[0] & (kTypeTouch | kTypeMerge));
+}
+
+// Returns true iff value is a counter carrying kTypeDropZero that is 0,
+// which compactions drop where nothing is below it.
+inline bool IsDroppedZero(const Slice& value) {
+  if (value.empty() || NeedsFold(value) || !(value[0] & kTypeDropZero)) {
+    return false;
+  }
+  const size_t header = ValueHeaderSize(value);
+  return value.size() == header + 8 &&
+         DecodeFixed64(value.data() + header) == 0;
+}
+
+// Folds the touch records and merge operands of one user key, newest
+// first, into a single record and finally onto the value below them.
+//
+// The newest record gives the header.  Merge operands add up their
+// deltas; the initial value of the oldest one is used if there is no
+// counter below them: nothing, a deletion, an expired value or a value
+// that is not 8 bytes long.  Touch records below a merge operand have
+// nothing left to say and are skipped.  If any operand carries
+// kTypeDropZero, so do the folded record and value.
+class RecordFolder {
+ public:
+  RecordFolder() { Clear(); }
+
+  void Clear();
+  bool empty() const { return header_.empty(); }
+  bool has_merge() const { return has_merge_; }
+
+  // REQUIRES: NeedsFold(record), record older than those added before
+  void Add(const Slice& record);
+
+  // Stores the records added so far as a single record in *result: a
+  // merge operand if there was any, the newest touch record otherwise.
+  // REQUIRES: !empty()
+  void Record(std::string* result) const;
+
+  // Stores in *result the value of the key, base being the value below
+  // the records or NULL if there is none.  Returns false iff the key has
+  // no value, which is the case for touch records with nothing below.
+  // Values expiring at or before now_millis count as none for operands.
+  bool Finish(const Slice* base, uint64_t now_millis,
+              std::string* result) const;
+
+ private:
+  std::string header_;   // of the newest record
+  std::string touch_;    // the newest record, if a touch record
+  bool has_merge_;
+  bool drop_zero_;
+  uint64_t delta_;      // two's complement, wraps around like int64_t
+  uint64_t initial_;
+};
+
 // A helper class useful for DBImpl::Get()
 class LookupKey {
  public:
@@ -227,6 +318,16 @@ inline LookupKey::~LookupKey() {
   if (start_ != space_) delete[] start_;
 }
 
+// One key of a batched lookup.  A source that settles the key, with a
+// value or a deletion, stores the outcome and sets "done" so that older
+// sources skip it.
+struct LookupRequest {
+  const LookupKey* key;
+  std::string* value;
+  Status* status;
+  bool done;
+};
+
 }  // namespace leveldb
 
 #endif  // STORAGE_LEVELDB_DB_DBFORMAT_H_
@@ -14,6 +14,7 @@
 #include "leveldb/status.h"
 #include "leveldb/table.h"
 #include "leveldb/write_batch.h"
+#include "util/coding.h"
 #include "util/logging.h"
 
 namespace leveldb {
@@ -85,6 +86,24 @@ class WriteBatchItemPrinter : public WriteBatch::Handler {
     r += "'\n";
     dst_->Append(r);
   }
+  virtual void Touch(const Slice& key) {
+    std::string r = "  touch '";
+    AppendEscapedStringTo(&r, key);
+    r += "'\n";
+    dst_->Append(r);
+  }
+  virtual void Merge(const KeyMeta& meta, const Slice& key,
+                     const Slice& operand, bool drop_zero) {
+    std::string r = "  merge '";
+    AppendEscapedStringTo(&r, key);
+    char buf[64];
+    snprintf(buf, sizeof(buf), "' %lld from %lld%s\n",
+             static_cast<long long>(DecodeFixed64(operand.data())),
+             static_cast<long long>(DecodeFixed64(operand.data() + 8)),
+             drop_zero ? " drop zero" : "");
+    r += buf;
+    dst_->Append(r);
+  }
 };
 
 
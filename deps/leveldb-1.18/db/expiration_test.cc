@@ -0,0 +1,121 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include <stdio.h>
+#include <string>
+#include "db/db_impl.h"
+#include "db/dbformat.h"
+#include "leveldb/db.h"
+#include "leveldb/env.h"
+#include "util/coding.h"
+#include "util/testharness.h"
+
+namespace leveldb {
+
+// Key as passed to DB::Put(), see db/touch_test.cc
+static std::string MetaKey(uint64_t expiration, const std::string& key) {
+  std::string result;
+  PutFixed32(&result, 2);
+  PutFixed64(&result, 0);
+  PutFixed64(&result, 1);
+  PutFixed64(&result, expiration);
+  result.append(key);
+  return result;
+}
+
+static std::string Key(int i) {
+  char buf[100];
+  snprintf(buf, sizeof(buf), "key%06d", i);
+  return std::string(buf);
+}
+
+class ExpirationTest {
+ public:
+  std::string dbname_;
+  Options options_;
+  DB* db_;
+
+  ExpirationTest() {
+    dbname_ = test::TmpDir() + "/expiration_test";
+    options_.create_if_missing = true;
+    DestroyDB(dbname_, options_);
+    ASSERT_OK(DB::Open(options_, dbname_, &db_));
+  }
+
+  ~ExpirationTest() {
+    delete db_;
+    DestroyDB(dbname_, options_);
+  }
+
+  DBImpl* dbfull() { return reinterpret_cast<DBImpl*>(db_); }
+
+  void Reopen() {
+    delete db_;
+    db_ = NULL;
+    ASSERT_OK(DB::Open(options_, dbname_, &db_));
+    db_->WriteRecovering(WriteOptions());
+  }
+
+  uint64_t NowMillis() { return Env::Default()->NowMicros() / 1000; }
+
+  // Writes "expiring" of "total" keys to expire after "millis" and flushes
+  // them to a table.
+  void Fill(int total, int expiring, uint64_t millis) {
+    const uint64_t expiration = NowMillis() + millis;
+    for (int i = 0; i < total; i++) {
+      ASSERT_OK(db_->Put(WriteOptions(),
+                         MetaKey(i < expiring ? expiration : 0, Key(i)),
+                         "value"));
+    }
+    ASSERT_OK(dbfull()->TEST_CompactMemTable());
+  }
+
+  int CountEntries() {
+    Iterator* iter = dbfull()->TEST_NewInternalIterator();
+    int count = 0;
+    for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+      count++;
+    }
+    delete iter;
+    return count;
+  }
+
+  // Waits for up to a second for the compaction to take entries away,
+  // without any read or write to notice the expired table.
+  int CountEntriesAfterCompaction(int before) {
+    int count = before;
+    for (int i = 0; i < 100 && count == before; i++) {
+      Env::Default()->SleepForMicroseconds(10000);
+      count = CountEntries();
+    }
+    return count;
+  }
+};
+
+TEST(ExpirationTest, CompactsExpiredTable) {
+  Fill(100, 80, 200);
+  ASSERT_EQ(100, CountEntries());
+  Env::Default()->SleepForMicroseconds(300000);
+  ASSERT_EQ(20, CountEntriesAfterCompaction(100));
+}
+
+TEST(ExpirationTest, BelowRatio) {
+  Fill(100, 20, 100);
+  Env::Default()->SleepForMicroseconds(200000);
+  ASSERT_EQ(100, CountEntriesAfterCompaction(100));
+}
+
+TEST(ExpirationTest, CountsSurviveReopen) {
+  Fill(100, 60, 500);
+  Reopen();
+  ASSERT_EQ(100, CountEntries());
+  Env::Default()->SleepForMicroseconds(600000);
+  ASSERT_EQ(40, CountEntriesAfterCompaction(100));
+}
+
+}  // namespace leveldb
+
+int main(int argc, char** argv) {
+  return leveldb::test::RunAllTests();
+}
@@ -69,12 +69,18 @@ std::string OldInfoLogFileName(const std::string& dbname) {
   return dbname + "/LOG.old";
 }
 
+std::string MetTableFileName(const std::string& dbname) {
+  return dbname + "/METTABLE";
+}
+
 
 // Owned filenames have the form:
 //    dbname/CURRENT
 //    dbname/LOCK
 //    dbname/LOG
 //    dbname/LOG.old
+//    dbname/METTABLE
+//    dbname/METTABLE.tmp
 //    dbname/MANIFEST-[0-9]+
 //    dbname/[0-9]+.(log|sst|ldb)
 bool ParseFileName(const std::string& fname,
@@ -90,6 +96,9 @@ bool ParseFileName(const std::string& fname,
   } else if (rest == "LOG" || rest == "LOG.old") {
     *number = 0;
     *type = kInfoLogFile;
+  } else if (rest == "METTABLE" || rest == "METTABLE.tmp") {
+    *number = 0;
+    *type = kMetTableFile;
   } else if (rest.starts_with("MANIFEST-")) {
     rest.remove_prefix(strlen("MANIFEST-"));
     uint64_t num;
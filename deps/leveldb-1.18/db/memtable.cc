@@ -4,6 +4,7 @@
 
 #include "db/memtable.h"
 #include "db/mettable.h"
+#include "db/row_cache.h"
 #include "db/dbformat.h"
 #include "leveldb/comparator.h"
 #include "leveldb/env.h"
@@ -24,8 +25,10 @@ static Slice GetLengthPrefixedSlice(const char* data) {
   return Slice(p, len);
 }
 
-MemTable::MemTable(MetTable* met, const InternalKeyComparator& cmp)
+MemTable::MemTable(MetTable* met, const InternalKeyComparator& cmp,
+                   RowCache* row_cache)
     : met_(met),
+      row_cache_(row_cache),
       comparator_(cmp),
       refs_(0),
       table_(comparator_, &arena_) {
@@ -129,39 +132,55 @@ void MemTable::AddMeta(const Slice& key){
 void MemTable::Add(SequenceNumber s, ValueType type,
                    const Slice& key,
                    const Slice& value) {
+  size_t mat_size = sizeof(uint32_t) + sizeof(uint64_t) + sizeof(uint64_t) + sizeof(uint64_t);
+  assert(key.size() > mat_size);
+
+  //decode meta data
+  KeyMeta meta;
+  meta.versioncare = DecodeFixed32(key.data());
+  meta.lastversion = DecodeFixed64(key.data() + sizeof(uint32_t));
+  meta.nextversion = DecodeFixed64(key.data() + sizeof(uint32_t) + sizeof(uint64_t));
+  meta.expiration = DecodeFixed64(key.data() + sizeof(uint32_t) + sizeof(uint64_t) + sizeof(uint64_t));
+  Add(s, type, meta, Slice(key.data() + mat_size, key.size() - mat_size), value);
+}
+
+void MemTable::Add(SequenceNumber s, ValueType type, const KeyMeta& meta,
+                   const Slice& key, const Slice& value) {
   // Format of an entry is concatenation of:
-  //  key_size     : varint32 of internal_key.size()- sizeof(uint32_t) - 3*sizeof(uint64_t)
-  //  key bytes    : char[internal_key.size() - sizeof(uint32_t) - 3*sizeof(uint64_t)]
+  //  key_size     : varint32 of internal_key.size()
+  //  key bytes    : char[internal_key.size()]
   //  value_size   : varint32 of value.size() + sizeof(uint8_t) + sizeof(uint64_t) (maybe + sizeof(uint64_t) depends on type)
   //  value bytes  : char[value.size()+sizeof(uint8_t)+sizeof(uint64_t) maybe + sizeof(uint64_t)], include fields-- type and currversion
   ValueType val_type = type;
+  if (type & (kTypeTouch | kTypeMerge)) {
+    // Stored as a value with nothing but a header, or the operand
+    type = kTypeValue;
+  }
 
   size_t key_size = key.size();
   size_t val_size = value.size() + 1 + 8;
-  size_t mat_size = sizeof(uint32_t) + sizeof(uint64_t) + sizeof(uint64_t) + sizeof(uint64_t);
-  assert(key_size > mat_size);
+  assert(key_size > 0);
 
-  //decode meta data
-  uint32_t versioncare = DecodeFixed32(key.data());
-  uint64_t lastversion = DecodeFixed64(key.data() + sizeof(uint32_t));
-  uint64_t nextversion = DecodeFixed64(key.data() + sizeof(uint32_t) + sizeof(uint64_t));
+  uint32_t versioncare = meta.versioncare;
+  uint64_t lastversion = meta.lastversion;
+  uint64_t nextversion = meta.nextversion;
   if(type == kTypeValue ){
 
-    uint64_t expiration = DecodeFixed64(key.data() + sizeof(uint32_t) + sizeof(uint64_t) + sizeof(uint64_t));
+    uint64_t expiration = meta.expiration;
     if(expiration > 0){
       val_type = ValueType(val_type | kTypeExpiration);
       val_size += 8;
     }
 
     //encode key
-    size_t internal_key_size = key_size - mat_size + 8;
+    size_t internal_key_size = key_size + 8;
     const size_t encoded_len =
     VarintLength(internal_key_size) + internal_key_size +
     VarintLength(val_size) + val_size;
     char* buf = arena_.Allocate(encoded_len);
     char* p = EncodeVarint32(buf, internal_key_size);
-    memcpy(p, (key.data()+mat_size), (key_size-mat_size));
-    p += (key_size-mat_size);
+    memcpy(p, key.data(), key_size);
+    p += key_size;
     EncodeFixed64(p, (s << 8) | type);
     p += 8;
 
@@ -180,10 +199,13 @@ void MemTable::Add(SequenceNumber s, ValueType type,
 
     uint64_t currversion = 0;
     if(met_!=NULL && nextversion>0){
-      Slice mat_key(key.data()+mat_size, key.size()-mat_size);
+      const Slice& mat_key = key;
       uint32_t crc32value = crc32c::Value(mat_key.data(), mat_key.size());
       //printf("crc32value=%u, type=%d\n", crc32value, type);
       mutexs_[uint32_t(crc32value%kNumKeyMutexs)]->Lock();
+      if(row_cache_ != NULL){
+        row_cache_->Erase(crc32value, mat_key, s);
+      }
       if(versioncare & 0x00000001){
         if(met_->Query(crc32value, mat_key, &currversion)){
           if(currversion == lastversion){
@@ -199,6 +221,9 @@ void MemTable::Add(SequenceNumber s, ValueType type,
       }
       mutexs_[crc32value%kNumKeyMutexs]->Unlock();
     }else{
+      if(row_cache_ != NULL){
+        row_cache_->Erase(RowCache::Hash(key), key, s);
+      }
       table_.Insert(buf);
     }
   }else if(type == kTypeDeletion){
@@ -208,14 +233,14 @@ void MemTable::Add(SequenceNumber s, ValueType type,
     }
 
     //encode key
-    size_t internal_key_size = key_size - mat_size + 8;
+    size_t internal_key_size = key_size + 8;
     const size_t encoded_len =
     VarintLength(internal_key_size) + internal_key_size +
     VarintLength(val_size) + val_size;
     char* buf = arena_.Allocate(encoded_len);
     char* p = EncodeVarint32(buf, internal_key_size);
-    memcpy(p, (key.data()+mat_size), (key_size-mat_size));
-    p += (key_size - mat_size); 
+    memcpy(p, key.data(), key_size);
+    p += key_size;
     EncodeFixed64(p, (s << 8) | type);
     p += 8;
     //encode value
@@ -227,10 +252,13 @@ void MemTable::Add(SequenceNumber s, ValueType type,
     memcpy(p, value.data(), value.size());
     assert((p + value.size()) - buf == encoded_len);
     if(met_ !=NULL && nextversion >0){
-      Slice mat_key(key.data()+mat_size, key.size()-mat_size);
+      const Slice& mat_key = key;
       uint32_t crc32value = crc32c::Value(mat_key.data(), mat_key.size());
       //printf("crc32value=%u, type=%d\n", crc32value, type);
       mutexs_[crc32value%kNumKeyMutexs]->Lock();
+      if(row_cache_ != NULL){
+        row_cache_->Erase(crc32value, mat_key, s);
+      }
       if(type == kTypeValue){
         if(met_->Insert(crc32value, mat_key, nextversion)){
           table_.Insert(buf);
@@ -242,12 +270,16 @@ void MemTable::Add(SequenceNumber s, ValueType type,
       }
       mutexs_[crc32value%kNumKeyMutexs]->Unlock();
     }else {
+      if(row_cache_ != NULL){
+        row_cache_->Erase(RowCache::Hash(key), key, s);
+      }
       table_.Insert(buf);
     }
   }
 }
 
-bool MemTable::Get(const LookupKey& key, std::string* value, Status* s) {
+bool MemTable::Get(const LookupKey& key, std::string* value, Status* s,
+                   Slice* pinned) {
   Slice memkey = key.memtable_key();
   Table::Iterator iter(&table_);
   iter.Seek(memkey.data());
@@ -272,7 +304,11 @@ bool MemTable::Get(const LookupKey& key, std::string* value, Status* s) {
       switch (static_cast<ValueType>(tag & 0xff)) {
         case kTypeValue: {
           Slice v = GetLengthPrefixedSlice(key_ptr + key_length);
-          value->assign(v.data(), v.size());
+          if (pinned != NULL) {
+            *pinned = v;
+          } else {
+            value->assign(v.data(), v.size());
+          }
           return true;
         }
         case kTypeDeletion:
@@ -284,4 +320,48 @@ bool MemTable::Get(const LookupKey& key, std::string* value, Status* s) {
   return false;
 }
 
+void MemTable::MultiGet(LookupRequest* requests, int n) {
+  const Comparator* ucmp = comparator_.comparator.user_comparator();
+  Table::Iterator iter(&table_);
+  for (int i = 0; i < n; i++) {
+    LookupRequest* r = &requests[i];
+    if (r->done) continue;
+    // The lookup keys only ever move forward, so a near target is
+    // cheaper to reach by stepping than by a fresh descent.
+    Slice memkey = r->key->memtable_key();
+    int steps = 0;
+    while (iter.Valid() && steps < 4 &&
+           comparator_(iter.key(), memkey.data()) < 0) {
+      iter.Next();
+      steps++;
+    }
+    if (!iter.Valid() || steps == 4) {
+      iter.Seek(memkey.data());
+    }
+    if (!iter.Valid()) continue;
+    const char* entry = iter.key();
+    uint32_t key_length;
+    const char* key_ptr = GetVarint32Ptr(entry, entry+5, &key_length);
+    if (ucmp->Compare(Slice(key_ptr, key_length - 8),
+                      r->key->user_key()) == 0) {
+      const uint64_t tag = DecodeFixed64(key_ptr + key_length - 8);
+      switch (static_cast<ValueType>(tag & 0xff)) {
+        case kTypeValue: {
+          Slice v = GetLengthPrefixedSlice(key_ptr + key_length);
+          r->value->assign(v.data(), v.size());
+          *r->status = Status::OK();
+          r->done = true;
+          break;
+        }
+        case kTypeDeletion:
+          *r->status = Status::NotFound(Slice());
+          r->done = true;
+          break;
+        default:
+          break;
+      }
+    }
+  }
+}
+
 }  // namespace leveldb
@@ -8,6 +8,7 @@
 #include <string>
 #include <vector>
 #include "leveldb/db.h"
+#include "leveldb/write_batch.h"
 #include "db/dbformat.h"
 #include "db/skiplist.h"
 #include "util/arena.h"
@@ -15,6 +16,7 @@
 namespace leveldb {
 
 class MetTable;
+class RowCache;
 class InternalKeyComparator;
 class Mutex;
 class MemTableIterator;
@@ -23,7 +25,10 @@ class MemTable {
  public:
   // MemTables are reference counted.  The initial reference count
   // is zero and the caller must call Ref() at least once.
-  explicit MemTable(MetTable* met, const InternalKeyComparator& comparator);
+  //
+  // If "row_cache" is non-NULL every key added is erased from it.
+  MemTable(MetTable* met, const InternalKeyComparator& comparator,
+           RowCache* row_cache = NULL);
 
   // Increase reference count.
   void Ref() { ++refs_; }
@@ -57,15 +62,31 @@ class MemTable {
   // Add an entry into memtable that maps key to value at the
   // specified sequence number and with the specified type.
   // Typically value will be empty if type==kTypeDeletion.
+  // type may be kTypeValue|kTypeTouch to add a touch record, see
+  // WriteBatch::Touch(), or kTypeValue|kTypeMerge, possibly with
+  // kTypeDropZero, to add a merge operand, see WriteBatch::Merge().
+  // key starts with the meta prefix described at KeyMeta.
   void Add(SequenceNumber seq, ValueType type,
            const Slice& key,
            const Slice& value);
 
+  // Add() for a user key whose meta is passed apart.
+  void Add(SequenceNumber seq, ValueType type, const KeyMeta& meta,
+           const Slice& key, const Slice& value);
+
   // If memtable contains a value for key, store it in *value and return true.
   // If memtable contains a deletion for key, store a NotFound() error
   // in *status and return true.
   // Else, return false.
-  bool Get(const LookupKey& key, std::string* value, Status* s);
+  // If pinned is non-NULL the value is not copied, *pinned is pointed at
+  // the entry in the arena instead and stays valid while the memtable is
+  // referenced.
+  bool Get(const LookupKey& key, std::string* value, Status* s,
+           Slice* pinned = NULL);
+
+  // Get() for each of the n requests that are not done yet, with a single
+  // skiplist iterator.  REQUIRES: requests are sorted by user key.
+  void MultiGet(LookupRequest* requests, int n);
 
  private:
   ~MemTable();  // Private since only Unref() should be used to delete it
@@ -82,6 +103,7 @@ class MemTable {
   typedef std::vector<port::Mutex*> Mutexs;
 
   MetTable* met_;
+  RowCache* row_cache_;
   KeyComparator comparator_;
   int refs_;
   Arena arena_;
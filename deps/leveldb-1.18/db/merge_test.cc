@@ -0,0 +1,306 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include <string>
+#include "db/db_impl.h"
+#include "db/dbformat.h"
+#include "leveldb/db.h"
+#include "leveldb/write_batch.h"
+#include "util/coding.h"
+#include "util/logging.h"
+#include "util/testharness.h"
+
+namespace leveldb {
+
+// Key as passed to DB::Put(): versioncare, last and next version and
+// expiration time ahead of the user key.
+static std::string MetaKey(uint64_t next, uint64_t expiration,
+                           const std::string& key) {
+  std::string result;
+  PutFixed32(&result, 2);
+  PutFixed64(&result, 0);
+  PutFixed64(&result, next);
+  PutFixed64(&result, expiration);
+  result.append(key);
+  return result;
+}
+
+static std::string Counter(int64_t n) {
+  std::string result;
+  PutFixed64(&result, static_cast<uint64_t>(n));
+  return result;
+}
+
+// Value as read back: type, version, expiration if any and user value.
+static std::string Value(uint64_t version, uint64_t expiration,
+                         const std::string& value) {
+  std::string result;
+  result.push_back(static_cast<char>(
+      expiration > 0 ? (kTypeValue | kTypeExpiration) : kTypeValue));
+  PutFixed64(&result, version);
+  if (expiration > 0) {
+    PutFixed64(&result, expiration);
+  }
+  result.append(value);
+  return result;
+}
+
+// Value as read back for a counter merged with drop_zero.
+static std::string DropZeroValue(uint64_t version, const std::string& value) {
+  std::string result = Value(version, 0, value);
+  result[0] = static_cast<char>(result[0] | kTypeDropZero);
+  return result;
+}
+
+// Far enough ahead for compactions not to drop the values
+static const uint64_t kLater = 4102444800000ull;
+
+class MergeTest {
+ public:
+  std::string dbname_;
+  Options options_;
+  DB* db_;
+
+  MergeTest() {
+    dbname_ = test::TmpDir() + "/merge_test";
+    options_.create_if_missing = true;
+    DestroyDB(dbname_, options_);
+    ASSERT_OK(DB::Open(options_, dbname_, &db_));
+  }
+
+  ~MergeTest() {
+    delete db_;
+    DestroyDB(dbname_, options_);
+  }
+
+  void Reopen() {
+    delete db_;
+    db_ = NULL;
+    ASSERT_OK(DB::Open(options_, dbname_, &db_));
+    db_->WriteRecovering(WriteOptions());
+  }
+
+  DBImpl* dbfull() { return reinterpret_cast<DBImpl*>(db_); }
+
+  void Merge(uint64_t next, uint64_t expiration, const std::string& key,
+             int64_t delta, int64_t initial = 0, bool drop_zero = false) {
+    KeyMeta meta;
+    meta.versioncare = 2;
+    meta.nextversion = next;
+    meta.expiration = expiration;
+    WriteBatch batch;
+    batch.Merge(meta, key, delta, initial, drop_zero);
+    ASSERT_OK(db_->Write(WriteOptions(), &batch));
+  }
+
+  std::string Get(const std::string& key, const Snapshot* snapshot = NULL) {
+    ReadOptions options;
+    options.snapshot = snapshot;
+    std::string lookup = MetaKey(0, 0, key);
+    std::string value;
+    Status s = db_->Get(options, lookup, &value);
+    if (s.IsNotFound()) {
+      value = "NOT_FOUND";
+    } else if (!s.ok()) {
+      value = s.ToString();
+    }
+
+    // Every read path has to agree
+    PinnedValue pinned;
+    Status ps = db_->GetPinned(options, lookup, &pinned);
+    ASSERT_EQ(s.ToString(), ps.ToString());
+    if (s.ok()) {
+      ASSERT_EQ(value, pinned.value().ToString());
+    }
+    Slice keys[1] = { lookup };
+    std::string values[1];
+    Status statuses[1];
+    db_->MultiGet(options, 1, keys, values, statuses);
+    ASSERT_EQ(s.ToString(), statuses[0].ToString());
+    if (s.ok()) {
+      ASSERT_EQ(value, values[0]);
+    }
+    return value;
+  }
+
+  // Number of entries kept for key in the memtables and files
+  int CountEntries(const std::string& key) {
+    Iterator* iter = dbfull()->TEST_NewInternalIterator();
+    int count = 0;
+    for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+      ParsedInternalKey ikey;
+      ASSERT_TRUE(ParseInternalKey(iter->key(), &ikey));
+      if (ikey.user_key == key) count++;
+    }
+    delete iter;
+    return count;
+  }
+};
+
+TEST(MergeTest, FoldsOnRead) {
+  ASSERT_OK(db_->Put(WriteOptions(), MetaKey(10, 0, "a"), Counter(5)));
+  const Snapshot* before = db_->GetSnapshot();
+  Merge(20, 0, "a", 3);
+  Merge(30, kLater, "a", -10);
+  ASSERT_EQ(Value(30, kLater, Counter(-2)), Get("a"));
+  ASSERT_EQ(Value(10, 0, Counter(5)), Get("a", before));
+
+  // Starts from the initial value of the oldest operand
+  Merge(10, 0, "missing", 2, 100);
+  Merge(20, 0, "missing", 1, 7);
+  ASSERT_EQ(Value(20, 0, Counter(103)), Get("missing"));
+
+  // Across the memtable and the files
+  ASSERT_OK(dbfull()->TEST_CompactMemTable());
+  Merge(40, 0, "a", 1);
+  ASSERT_EQ(Value(40, 0, Counter(-1)), Get("a"));
+  ASSERT_EQ(Value(10, 0, Counter(5)), Get("a", before));
+  db_->ReleaseSnapshot(before);
+}
+
+TEST(MergeTest, NothingToAddTo) {
+  ASSERT_OK(db_->Put(WriteOptions(), MetaKey(10, 0, "deleted"), Counter(5)));
+  ASSERT_OK(db_->Delete(WriteOptions(), MetaKey(0, 0, "deleted")));
+  Merge(20, 0, "deleted", 1, 50);
+  ASSERT_EQ(Value(20, 0, Counter(51)), Get("deleted"));
+
+  // Expired long ago
+  ASSERT_OK(db_->Put(WriteOptions(), MetaKey(10, 1, "expired"), Counter(5)));
+  Merge(20, 0, "expired", 1, 50);
+  ASSERT_EQ(Value(20, 0, Counter(51)), Get("expired"));
+
+  ASSERT_OK(db_->Put(WriteOptions(), MetaKey(10, 0, "text"), "abc"));
+  Merge(20, 0, "text", 1, 50);
+  ASSERT_EQ(Value(20, 0, Counter(51)), Get("text"));
+}
+
+TEST(MergeTest, WithTouch) {
+  ASSERT_OK(db_->Put(WriteOptions(), MetaKey(10, 0, "a"), Counter(5)));
+  WriteBatch batch;
+  batch.Touch(MetaKey(20, kLater, "a"));
+  ASSERT_OK(db_->Write(WriteOptions(), &batch));
+  Merge(30, 0, "a", 1);
+  ASSERT_EQ(Value(30, 0, Counter(6)), Get("a"));
+
+  // The newest record gives version and expiration
+  batch.Clear();
+  batch.Touch(MetaKey(40, kLater, "a"));
+  ASSERT_OK(db_->Write(WriteOptions(), &batch));
+  ASSERT_EQ(Value(40, kLater, Counter(6)), Get("a"));
+}
+
+TEST(MergeTest, FoldsInCompaction) {
+  ASSERT_OK(db_->Put(WriteOptions(), MetaKey(10, 0, "a"), Counter(5)));
+  ASSERT_OK(db_->Put(WriteOptions(), MetaKey(10, 0, "z"), Counter(0)));
+  // Overlapping files, so that the compaction below is not a move
+  ASSERT_OK(dbfull()->TEST_CompactMemTable());
+  for (int i = 0; i < 100; i++) {
+    Merge(20 + i, 0, "a", 1);
+    Merge(20 + i, 0, "missing", 1, 1000);
+  }
+  Merge(200, 0, "z", 1);
+  const Snapshot* snapshot = db_->GetSnapshot();
+  Merge(300, 0, "a", 1000);
+  ASSERT_OK(dbfull()->TEST_CompactMemTable());
+  db_->CompactRange(NULL, NULL);
+
+  // The snapshot keeps the operands older than it apart from the newer
+  ASSERT_EQ(Value(119, 0, Counter(105)), Get("a", snapshot));
+  ASSERT_EQ(Value(300, 0, Counter(1105)), Get("a"));
+  db_->ReleaseSnapshot(snapshot);
+
+  Merge(400, 0, "z", 1);
+  ASSERT_OK(dbfull()->TEST_CompactMemTable());
+  db_->CompactRange(NULL, NULL);
+  ASSERT_EQ(1, CountEntries("a"));
+  ASSERT_EQ(1, CountEntries("missing"));
+  ASSERT_EQ(1, CountEntries("z"));
+  ASSERT_EQ(Value(300, 0, Counter(1105)), Get("a"));
+  ASSERT_EQ(Value(119, 0, Counter(1100)), Get("missing"));
+  ASSERT_EQ(Value(400, 0, Counter(2)), Get("z"));
+}
+
+TEST(MergeTest, DropsZeroCounters) {
+  ASSERT_OK(db_->Put(WriteOptions(), MetaKey(10, 0, "a"), "va"));
+  ASSERT_OK(db_->Put(WriteOptions(), MetaKey(10, 0, "z"), "vz"));
+  // Overlapping files, so that the compactions below are not moves
+  ASSERT_OK(dbfull()->TEST_CompactMemTable());
+  Merge(10, 0, "size", 3, 0, true);
+  Merge(20, 0, "size", -3, 0, true);
+  Merge(10, 0, "plain", 1);
+  Merge(20, 0, "plain", -1);
+  Merge(10, 0, "left", 2, 0, true);
+  ASSERT_EQ(DropZeroValue(20, Counter(0)), Get("size"));
+  ASSERT_OK(dbfull()->TEST_CompactMemTable());
+  db_->CompactRange(NULL, NULL);
+  ASSERT_EQ(0, CountEntries("size"));
+  ASSERT_EQ("NOT_FOUND", Get("size"));
+  ASSERT_EQ(1, CountEntries("plain"));
+  ASSERT_EQ(Value(20, 0, Counter(0)), Get("plain"));
+  ASSERT_EQ(DropZeroValue(10, Counter(2)), Get("left"));
+
+  // Folded onto the counter in the files
+  Merge(20, 0, "left", -2, 0, true);
+  ASSERT_OK(db_->Put(WriteOptions(), MetaKey(20, 0, "z"), "vz"));
+  ASSERT_OK(dbfull()->TEST_CompactMemTable());
+  db_->CompactRange(NULL, NULL);
+  ASSERT_EQ(0, CountEntries("left"));
+  ASSERT_EQ("NOT_FOUND", Get("left"));
+}
+
+TEST(MergeTest, ZeroCounterHidesOlderLevels) {
+  ASSERT_OK(db_->Put(WriteOptions(), MetaKey(10, 0, "a"), Counter(7)));
+  ASSERT_OK(dbfull()->TEST_CompactMemTable());
+  dbfull()->TEST_CompactRange(2, NULL, NULL);
+  ASSERT_OK(db_->Delete(WriteOptions(), MetaKey(0, 0, "a")));
+  ASSERT_OK(dbfull()->TEST_CompactMemTable());
+  Merge(20, 0, "a", 2, -2, true);
+  ASSERT_OK(dbfull()->TEST_CompactMemTable());
+  std::string files;
+  for (int level = 1; level <= 3; level++) {
+    std::string n;
+    ASSERT_TRUE(db_->GetProperty(
+        "leveldb.num-files-at-level" + NumberToString(level), &n));
+    files += n;
+  }
+  ASSERT_EQ("111", files);
+  ASSERT_EQ(DropZeroValue(20, Counter(0)), Get("a"));
+
+  // Kept while the value in level 3 is there
+  dbfull()->TEST_CompactRange(1, NULL, NULL);
+  ASSERT_EQ(2, CountEntries("a"));
+  ASSERT_EQ(DropZeroValue(20, Counter(0)), Get("a"));
+  db_->CompactRange(NULL, NULL);
+  ASSERT_EQ(0, CountEntries("a"));
+  ASSERT_EQ("NOT_FOUND", Get("a"));
+}
+
+TEST(MergeTest, Replay) {
+  Merge(10, 0, "a", 1, 10);
+  Merge(20, 0, "a", 2);
+  Reopen();
+  ASSERT_EQ(Value(20, 0, Counter(13)), Get("a"));
+
+  // Handlers that do not know about it skip it
+  class Handler : public WriteBatch::Handler {
+   public:
+    int puts_;
+    Handler() : puts_(0) { }
+    virtual void Put(const Slice& key, const Slice& value) { puts_++; }
+    virtual void Delete(const Slice& key) { }
+  };
+  KeyMeta meta;
+  WriteBatch batch;
+  batch.Merge(meta, "a", 1, 0, false);
+  batch.Put(MetaKey(10, 0, "b"), "vb");
+  Handler handler;
+  ASSERT_OK(batch.Iterate(&handler));
+  ASSERT_EQ(1, handler.puts_);
+}
+
+}  // namespace leveldb
+
+int main(int argc, char** argv) {
+  return leveldb::test::RunAllTests();
+}
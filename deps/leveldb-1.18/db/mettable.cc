@@ -3,10 +3,11 @@
 // found in the LICENSE file. See the AUTHORS file for names of contributors.
 
 #include "db/mettable.h"
-#include "util/mutexlock.h"
+#include "util/coding.h"
 #include "util/crc32c.h"
+#include "util/mutexlock.h"
 #include "leveldb/slice.h"
-#include <utility>
+#include <string.h>
 #include <assert.h>
 
 
@@ -15,11 +16,18 @@ namespace leveldb {
 
 const int kNumKeyBuckets = 1024;
 
+static const size_t kInitialSlots = 16;
+
+MetTable::Resolver::~Resolver() {
+}
 
-MetTable::MetTable()
-    : refs_(0) {
+MetTable::MetTable(size_t capacity, Resolver* resolver)
+    : resolver_(resolver),
+      refs_(0) {
+    const size_t per_bucket = capacity / kNumKeyBuckets;
     for(int i=0; i<kNumKeyBuckets; ++i){
-        buckets_.push_back(new KeyBucket(i));
+        // A bounded table never gets a zero, i.e. unbounded, bucket
+        buckets_.push_back(new KeyBucket(i, (capacity > 0 && per_bucket == 0) ? 1 : per_bucket));
     }
 }
 
@@ -30,17 +38,43 @@ MetTable::~MetTable() {
     }
 }
 
+bool MetTable::Resolve(KeyBucket* bucket, uint32_t hash, const Slice& key,
+                       uint64_t* version){
+    if(resolver_ == NULL || !bucket->Evicted()){
+        return false;
+    }
+    if(!resolver_->ResolveVersion(key, version)){
+        return false;
+    }
+    bucket->Insert(hash, key, *version);
+    return true;
+}
+
 
+// Writes are always applied, the table only keeps the newest version
+// seen for each key.
 bool MetTable::Insert(uint32_t value, const Slice& key, uint64_t version){
-    buckets_[value%kNumKeyBuckets]->Insert(std::string(key.data(), key.size()), version);
+    KeyBucket* bucket = buckets_[value%kNumKeyBuckets];
+    uint64_t current = 0;
+    if(!bucket->Query(value, key, &current)){
+        Resolve(bucket, value, key, &current);
+    }
+    bucket->Insert(value, key, version);
+    return true;
 }
 
 bool MetTable::Remove(uint32_t value, const Slice& key, uint64_t version){
-    return buckets_[value%kNumKeyBuckets]->Remove(std::string(key.data(), key.size()), version);
+    KeyBucket* bucket = buckets_[value%kNumKeyBuckets];
+    uint64_t current = 0;
+    if(!bucket->Query(value, key, &current) && Resolve(bucket, value, key, &current) && current >= version){
+        return false;
+    }
+    return bucket->Remove(value, key, version);
 }
 
 bool MetTable::Query(uint32_t value, const Slice& key, uint64_t* version){
-    return buckets_[value%kNumKeyBuckets]->Query(std::string(key.data(), key.size()), version);
+    KeyBucket* bucket = buckets_[value%kNumKeyBuckets];
+    return bucket->Query(value, key, version) || Resolve(bucket, value, key, version);
 }
 
 
@@ -52,55 +86,365 @@ size_t MetTable::ApproximateMemoryUsage(){
     return ret; 
 }
 
-MetTable::KeyBucket::KeyBucket(const int id)
-    :id_(id),memory_usage_(0) {
+bool MetTable::EncodeBucket(int b, std::string* dst){
+    return buckets_[b]->Encode(dst);
+}
+
+bool MetTable::DecodeEntries(const Slice& input){
+    Slice in = input;
+    Slice key;
+    while(!in.empty()){
+        if(!GetLengthPrefixedSlice(&in, &key) || in.size() < 8){
+            return false;
+        }
+        const uint64_t version = DecodeFixed64(in.data());
+        in.remove_prefix(8);
+        // Same hash as MemTable::AddMeta() uses
+        const uint32_t hash = crc32c::Value(key.data(), key.size());
+        buckets_[hash%kNumKeyBuckets]->Insert(hash, key, version);
+    }
+    return true;
+}
+
+void MetTable::MarkEvicted(){
+    for(int i=0; i<kNumKeyBuckets; ++i){
+        buckets_[i]->MarkEvicted();
+    }
+}
+
+void MetTable::BeginSnapshot(){
+    for(int i=0; i<kNumKeyBuckets; ++i){
+        buckets_[i]->BeginSnapshot();
+    }
+}
+
+bool MetTable::SnapshotBucket(int b, std::string* dst){
+    return buckets_[b]->EncodeSnapshot(dst);
+}
+
+void MetTable::EndSnapshot(){
+    for(int i=0; i<kNumKeyBuckets; ++i){
+        buckets_[i]->EndSnapshot();
+    }
+}
+
+static const int kChunkBits = 12;
+static const size_t kChunkSize = 1 << kChunkBits;
+static const uint32_t kUsed = 1;
+static const uint32_t kReferenced = 2;
+
+// The low bits of the hash picked the bucket, the slot keeps the rest.
+static uint32_t MakeTag(uint32_t hash) {
+    return ((hash >> 10) << 2) | kUsed;
+}
+
+static bool SameTag(uint32_t tag, uint32_t hash) {
+    return (tag >> 2) == (hash >> 10);
+}
+
+MetTable::KeyBucket::KeyBucket(const int id, size_t capacity)
+    :id_(id),
+     slots_(new Slot[kInitialSlots]),
+     num_slots_(kInitialSlots),
+     count_(0),
+     chunk_used_(0),
+     chunk_bytes_(0),
+     live_bytes_(0),
+     dead_bytes_(0),
+     capacity_(capacity),
+     hand_(0),
+     evicted_(false),
+     in_snapshot_(false),
+     saved_(NULL),
+     saved_evicted_(false) {
+    memset(slots_, 0, sizeof(Slot) * num_slots_);
+}
+
+MetTable::KeyBucket::~KeyBucket() {
+    delete saved_;
+    delete[] slots_;
+    for(size_t i=0; i<chunks_.size(); ++i){
+        delete[] chunks_[i];
+    }
+}
+
+size_t MetTable::KeyBucket::Home(uint32_t tag) const {
+    return (tag >> 2) & (num_slots_ - 1);
+}
+
+Slice MetTable::KeyBucket::KeyAt(const Slot& slot) const {
+    const char* p = chunks_[slot.key >> kChunkBits] + (slot.key & (kChunkSize - 1));
+    uint32_t len = 0;
+    p = GetVarint32Ptr(p, p + 5, &len);
+    return Slice(p, len);
+}
+
+// Append a length prefixed copy of "key" to the chunks.  Keys that do not
+// fit in a chunk get one of their own.
+uint32_t MetTable::KeyBucket::StoreKey(const Slice& key){
+    const size_t bytes = VarintLength(key.size()) + key.size();
+    if(chunks_.empty() || chunk_used_ + bytes > kChunkSize){
+        const size_t size = bytes > kChunkSize ? bytes : kChunkSize;
+        chunks_.push_back(new char[size]);
+        assert(chunks_.size() <= (1u << (32 - kChunkBits)));
+        chunk_bytes_ += size;
+        chunk_used_ = 0;
+    }
+    const uint32_t ref = ((chunks_.size() - 1) << kChunkBits) | chunk_used_;
+    char* p = EncodeVarint32(chunks_.back() + chunk_used_, key.size());
+    memcpy(p, key.data(), key.size());
+    chunk_used_ += bytes;
+    if(chunk_used_ > kChunkSize){
+        // An oversized key owns its chunk, never append after it
+        chunk_used_ = kChunkSize;
+    }
+    return ref;
+}
+
+size_t MetTable::KeyBucket::Find(uint32_t hash, const Slice& key) const {
+    size_t i = Home(MakeTag(hash));
+    while(slots_[i].tag != 0){
+        if(SameTag(slots_[i].tag, hash) && KeyAt(slots_[i]) == key){
+            break;
+        }
+        i = (i + 1) & (num_slots_ - 1);
+    }
+    return i;
+}
+
+void MetTable::KeyBucket::Add(size_t i, uint32_t hash, const Slice& key, uint64_t version){
+    slots_[i].version = version;
+    slots_[i].key = StoreKey(key);
+    slots_[i].tag = MakeTag(hash) | kReferenced;
+    live_bytes_ += VarintLength(key.size()) + key.size();
+    ++count_;
 }
 
+// Backward shift deletion, keeps probe sequences intact without
+// tombstones.
+void MetTable::KeyBucket::Erase(size_t i){
+    const Slice key = KeyAt(slots_[i]);
+    const size_t bytes = VarintLength(key.size()) + key.size();
+    live_bytes_ -= bytes;
+    dead_bytes_ += bytes;
+    --count_;
+    slots_[i].tag = 0;
+    size_t j = i;
+    while(true){
+        j = (j + 1) & (num_slots_ - 1);
+        if(slots_[j].tag == 0){
+            break;
+        }
+        const size_t home = Home(slots_[j].tag);
+        // Move the entry back unless its home lies cyclically in (i, j]
+        const bool stays = (i <= j) ? (i < home && home <= j)
+                                    : (i < home || home <= j);
+        if(!stays){
+            slots_[i] = slots_[j];
+            slots_[j].tag = 0;
+            i = j;
+        }
+    }
+}
+
+void MetTable::KeyBucket::Resize(size_t num_slots){
+    Slot* old_slots = slots_;
+    const size_t old_num = num_slots_;
+    slots_ = new Slot[num_slots];
+    num_slots_ = num_slots;
+    memset(slots_, 0, sizeof(Slot) * num_slots_);
+    for(size_t i=0; i<old_num; ++i){
+        if(old_slots[i].tag != 0){
+            size_t j = Home(old_slots[i].tag);
+            while(slots_[j].tag != 0){
+                j = (j + 1) & (num_slots_ - 1);
+            }
+            slots_[j] = old_slots[i];
+        }
+    }
+    delete[] old_slots;
+    hand_ = 0;
+}
 
+size_t MetTable::KeyBucket::LiveUsage() const {
+    return num_slots_ * sizeof(Slot) + live_bytes_;
+}
 
-bool MetTable::KeyBucket::Insert(const std::string& key, uint64_t version){
+bool MetTable::KeyBucket::Insert(uint32_t hash, const Slice& key, uint64_t version){
     MutexLock l(&mutex_);
-    std::tr1::unordered_map<std::string, uint64_t>::iterator key_iter=keys_.find(key);
-    if(key_iter!=keys_.end() && key_iter->second <version){
-        key_iter->second=version;
-        return true;
-    }else if(key_iter==keys_.end()){
-        keys_.insert(std::make_pair(key, version));
-        memory_usage_ += (key.size() + sizeof(uint64_t));
-        return true;
+    size_t i = Find(hash, key);
+    if(slots_[i].tag != 0){
+        if(slots_[i].version < version){
+            SaveForSnapshot();
+            slots_[i].version = version;
+            slots_[i].tag |= kReferenced;
+            return true;
+        }
+        return false;
     }
-    return false;
+    SaveForSnapshot();
+    // Keep the load factor at or below 3/4.  A bounded bucket whose slot
+    // array already takes a good part of its budget makes room instead.
+    if((count_ + 1) * 4 > num_slots_ * 3){
+        if(capacity_ > 0 && num_slots_ * 2 * sizeof(Slot) > capacity_ / 2){
+            Evict(count_ - count_ / 8);
+        }
+        if((count_ + 1) * 4 > num_slots_ * 3){
+            Resize(num_slots_ * 2);
+        }
+        i = Find(hash, key);
+    }
+    Add(i, hash, key, version);
+    if(capacity_ > 0 && LiveUsage() > capacity_){
+        Evict(count_);
+    }
+    return true;
 }
 
-bool MetTable::KeyBucket::Remove(const std::string& key, uint64_t version){
+bool MetTable::KeyBucket::Remove(uint32_t hash, const Slice& key, uint64_t version){
     MutexLock l(&mutex_);
-    std::tr1::unordered_map<std::string, uint64_t>::iterator key_iter=keys_.find(key);
-    if(key_iter!=keys_.end()){
-        //printf("%s old=%lu, new=%lu\n", __func__, key_iter->second, version);
-        if(key_iter->second < version){
-            keys_.erase(key_iter);
-            memory_usage_ -= (key.size() + sizeof(uint64_t));
+    size_t i = Find(hash, key);
+    if(slots_[i].tag != 0){
+        if(slots_[i].version < version){
+            SaveForSnapshot();
+            Erase(i);
+            if(dead_bytes_ > live_bytes_ && dead_bytes_ > kChunkSize){
+                CompactChunks();
+            }
             return true;
         }
-    }else if(key_iter==keys_.end()){
-        return true;
+        return false;
     }
-    return false;
+    return true;
 }
 
-bool MetTable::KeyBucket::Query(const std::string& key, uint64_t* version){
+bool MetTable::KeyBucket::Query(uint32_t hash, const Slice& key, uint64_t* version){
   MutexLock l(&mutex_);
-  std::tr1::unordered_map<std::string, uint64_t>::iterator iter=keys_.find(key);
-  if(iter!=keys_.end()){
-    (*version) = iter->second;
+  size_t i = Find(hash, key);
+  if(slots_[i].tag != 0){
+    (*version) = slots_[i].version;
+    slots_[i].tag |= kReferenced;
     return true;
   }
   return false;
 }
 
+bool MetTable::KeyBucket::Evicted(){
+  MutexLock l(&mutex_);
+  return evicted_;
+}
+
+void MetTable::KeyBucket::MarkEvicted(){
+  MutexLock l(&mutex_);
+  SaveForSnapshot();
+  evicted_ = true;
+}
+
+bool MetTable::KeyBucket::Encode(std::string* dst){
+  MutexLock l(&mutex_);
+  return EncodeEntries(dst);
+}
+
+bool MetTable::KeyBucket::EncodeEntries(std::string* dst) const {
+  for(size_t i=0; i<num_slots_; ++i){
+    if(slots_[i].tag != 0){
+      PutLengthPrefixedSlice(dst, KeyAt(slots_[i]));
+      PutFixed64(dst, slots_[i].version);
+    }
+  }
+  return evicted_;
+}
+
+void MetTable::KeyBucket::BeginSnapshot(){
+  MutexLock l(&mutex_);
+  delete saved_;
+  saved_ = NULL;
+  in_snapshot_ = true;
+}
+
+// Keep the entries as they are for the snapshot, only the first change
+// after BeginSnapshot() pays for the copy.
+void MetTable::KeyBucket::SaveForSnapshot(){
+  mutex_.AssertHeld();
+  if(in_snapshot_ && saved_ == NULL){
+    saved_ = new std::string;
+    saved_evicted_ = EncodeEntries(saved_);
+  }
+}
+
+bool MetTable::KeyBucket::EncodeSnapshot(std::string* dst){
+  MutexLock l(&mutex_);
+  assert(in_snapshot_);
+  in_snapshot_ = false;
+  if(saved_ == NULL){
+    return EncodeEntries(dst);
+  }
+  dst->append(*saved_);
+  delete saved_;
+  saved_ = NULL;
+  return saved_evicted_;
+}
+
+void MetTable::KeyBucket::EndSnapshot(){
+  MutexLock l(&mutex_);
+  delete saved_;
+  saved_ = NULL;
+  in_snapshot_ = false;
+}
+
+// Clock sweep over the slots, entries touched since the last sweep get a
+// second chance.  Frees down to 7/8 of the capacity so that a full
+// bucket does not evict on every insert, and to at most "max_count"
+// entries.
+void MetTable::KeyBucket::Evict(size_t max_count){
+  mutex_.AssertHeld();
+  const size_t low_water = capacity_ - capacity_ / 8;
+  size_t visited = 0;
+  while((LiveUsage() > low_water || count_ > max_count) && count_ > 0 &&
+        visited < 2 * num_slots_ + count_){
+    const size_t i = hand_ & (num_slots_ - 1);
+    ++visited;
+    if(slots_[i].tag == 0){
+      hand_ = i + 1;
+    }else if(slots_[i].tag & kReferenced){
+      slots_[i].tag &= ~kReferenced;
+      hand_ = i + 1;
+    }else{
+      // Erase() may shift the next entry into slot i, look at it again
+      Erase(i);
+      evicted_ = true;
+    }
+  }
+  if(dead_bytes_ > live_bytes_){
+    CompactChunks();
+  }
+}
+
+// Copy the live keys into fresh chunks and drop the old ones.
+void MetTable::KeyBucket::CompactChunks(){
+  std::vector<char*> old_chunks;
+  old_chunks.swap(chunks_);
+  chunk_used_ = 0;
+  chunk_bytes_ = 0;
+  for(size_t i=0; i<num_slots_; ++i){
+    if(slots_[i].tag != 0){
+      const char* p = old_chunks[slots_[i].key >> kChunkBits] +
+                      (slots_[i].key & (kChunkSize - 1));
+      uint32_t len = 0;
+      p = GetVarint32Ptr(p, p + 5, &len);
+      slots_[i].key = StoreKey(Slice(p, len));
+    }
+  }
+  for(size_t i=0; i<old_chunks.size(); ++i){
+    delete[] old_chunks[i];
+  }
+  dead_bytes_ = 0;
+}
+
 size_t MetTable::KeyBucket::ApproximateMemoryUsage(){
   MutexLock l(&mutex_);
-  return memory_usage_;
+  return num_slots_ * sizeof(Slot) + chunk_bytes_ +
+         chunks_.capacity() * sizeof(char*);
 }
 
 
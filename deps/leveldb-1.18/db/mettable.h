@@ -9,7 +9,6 @@
 #include <stdint.h>
 #include <string>
 #include <vector>
-#include <tr1/unordered_map>
 #include "port/port.h"
 
 namespace leveldb {
@@ -19,9 +18,24 @@ class Slice;
 
 class MetTable {
  public:
+  // Looks up versions of keys that are no longer held by the table.
+  class Resolver {
+   public:
+    virtual ~Resolver();
+
+    // If the newest live record of "key" exists, store the version kept
+    // in its value header in *version and return true.  Return false if
+    // the key does not exist.
+    virtual bool ResolveVersion(const Slice& key, uint64_t* version) = 0;
+  };
+
   // MemTables are reference counted.  The initial reference count
   // is zero and the caller must call Ref() at least once.
-  MetTable();
+  //
+  // If "capacity" is non-zero the table keeps at most about "capacity"
+  // bytes of entries and evicts cold ones, misses on evicted keys are
+  // answered by "resolver".  A zero capacity keeps every key in memory.
+  MetTable(size_t capacity = 0, Resolver* resolver = NULL);
 
   // Increase reference count.
   void Ref() { ++refs_; }
@@ -46,24 +60,114 @@ class MetTable {
   // operations on the same MemTable.
   size_t ApproximateMemoryUsage();
 
+  // Checkpoint support.  The table is saved one bucket at a time, so a
+  // checkpoint only needs each bucket to be consistent on its own.
+  int NumBuckets() const { return static_cast<int>(buckets_.size()); }
+
+  // Append the entries of bucket "b" to *dst, each as a length prefixed
+  // key followed by its fixed64 version.  Returns true if the bucket has
+  // dropped entries, i.e. does not hold every key.
+  bool EncodeBucket(int b, std::string* dst);
+
+  // Copy on write snapshot of the table.  Once BeginSnapshot() returns,
+  // a bucket saves its entries before it first changes, so that
+  // SnapshotBucket() encodes each bucket as of BeginSnapshot().  Only
+  // visits the buckets, the entries are encoded later by the caller of
+  // SnapshotBucket().  A new BeginSnapshot() drops the previous one.
+  void BeginSnapshot();
+
+  // Like EncodeBucket(), but for the entries of bucket "b" as of
+  // BeginSnapshot().  The bucket stops saving its entries.
+  // REQUIRES: BeginSnapshot() was called and "b" not encoded since.
+  bool SnapshotBucket(int b, std::string* dst);
+
+  // Drop the entries saved for the snapshot and stop saving them.
+  void EndSnapshot();
+
+  // Insert entries encoded by EncodeBucket().  Does not consult the
+  // resolver.  Returns false if "input" is malformed.
+  bool DecodeEntries(const Slice& input);
+
+  // Treat every miss as possibly evicted, for a table loaded from a
+  // checkpoint of a table that did not hold every key.
+  void MarkEvicted();
 
  private:
   ~MetTable();  // Private since only Unref() should be used to delete it
 
-  struct KeyBucket{
-    KeyBucket(const int id);
-    bool Insert(const std::string& key, uint64_t version);
-    bool Remove(const std::string& key, uint64_t version);
-    bool Query(const std::string& key, uint64_t* version);
+  // Open addressing table with linear probing.  Keys are packed in 4KB
+  // chunks owned by the bucket, a slot only holds the version, the
+  // location of its key and the part of the key's crc32c (as computed by
+  // MemTable::Add) not used to pick the bucket, so lookups never
+  // allocate and an entry costs 16 bytes plus its key.
+  class KeyBucket{
+   public:
+    KeyBucket(const int id, size_t capacity);
+    ~KeyBucket();
+    bool Insert(uint32_t hash, const Slice& key, uint64_t version);
+    bool Remove(uint32_t hash, const Slice& key, uint64_t version);
+    bool Query(uint32_t hash, const Slice& key, uint64_t* version);
+    bool Evicted();
+    void MarkEvicted();
+    bool Encode(std::string* dst);
+    void BeginSnapshot();
+    bool EncodeSnapshot(std::string* dst);
+    void EndSnapshot();
     size_t ApproximateMemoryUsage();
-    std::tr1::unordered_map<std::string, uint64_t> keys_;
+
+   private:
+    struct Slot {
+      uint64_t version;
+      uint32_t key;         // Chunk index << kChunkBits | offset
+      uint32_t tag;         // Hash bits << 2 | kReferenced | kUsed
+    };
+
+    // All of the following REQUIRE: mutex_ held
+
+    // Index of the slot holding "key", or of the free slot that ends its
+    // probe sequence.
+    size_t Find(uint32_t hash, const Slice& key) const;
+    Slice KeyAt(const Slot& slot) const;
+    uint32_t StoreKey(const Slice& key);
+    void Add(size_t i, uint32_t hash, const Slice& key, uint64_t version);
+    void Erase(size_t i);
+    void Resize(size_t num_slots);
+    void Evict(size_t max_count);
+    void CompactChunks();
+    size_t Home(uint32_t tag) const;
+    size_t LiveUsage() const;
+    bool EncodeEntries(std::string* dst) const;
+    // Called before every change of the entries
+    void SaveForSnapshot();
+
     port::Mutex mutex_;
     int id_;
-    size_t memory_usage_;
+    Slot* slots_;
+    size_t num_slots_;      // Power of two
+    size_t count_;
+    std::vector<char*> chunks_;
+    size_t chunk_used_;     // Bytes used in chunks_.back()
+    size_t chunk_bytes_;    // Bytes allocated for all chunks
+    size_t live_bytes_;     // Chunk bytes held by keys in the table
+    size_t dead_bytes_;     // Chunk bytes of erased keys
+    size_t capacity_;       // 0 means unbounded
+    size_t hand_;           // Next slot visited by Evict()
+    bool evicted_;          // Set once an entry has been dropped, after
+                            // which a miss is no longer authoritative
+    bool in_snapshot_;      // BeginSnapshot() was called, not encoded yet
+    std::string* saved_;    // Entries as of BeginSnapshot() if changed since
+    bool saved_evicted_;
   };
   typedef std::vector<KeyBucket*>   Buckets;
+
+  // Look up the persisted version of a key missing from "bucket" and
+  // load it back.  Returns false if the miss is authoritative or the key
+  // does not exist.
+  bool Resolve(KeyBucket* bucket, uint32_t hash, const Slice& key,
+               uint64_t* version);
   
   Buckets buckets_;
+  Resolver* resolver_;
   
   int refs_;
 
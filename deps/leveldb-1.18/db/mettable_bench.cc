@@ -0,0 +1,215 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+// Compares MetTable with the std::string keyed unordered_map buckets it
+// used to be built on.  Keys are hashed with crc32c up front, the same
+// way MemTable::Add does before it calls into the table.
+//
+//   ./mettable_bench [--num=N] [--key_size=N]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits>
+#include <string>
+#include <vector>
+#include <tr1/unordered_map>
+#include "db/mettable.h"
+#include "leveldb/env.h"
+#include "leveldb/slice.h"
+#include "port/port.h"
+#include "util/crc32c.h"
+#include "util/mutexlock.h"
+#include "util/random.h"
+
+namespace leveldb {
+
+namespace {
+
+// Bytes handed out to the baseline table, its memory use is not tracked
+// by the table itself.
+static size_t allocated_bytes = 0;
+
+template <typename T>
+class CountingAllocator : public std::allocator<T> {
+ public:
+  typedef size_t size_type;
+  typedef T* pointer;
+  template <typename U> struct rebind { typedef CountingAllocator<U> other; };
+
+  CountingAllocator() { }
+  CountingAllocator(const CountingAllocator& a) : std::allocator<T>(a) { }
+  template <typename U>
+  CountingAllocator(const CountingAllocator<U>& a) : std::allocator<T>(a) { }
+
+  pointer allocate(size_type n, const void* hint = 0) {
+    allocated_bytes += n * sizeof(T);
+    return std::allocator<T>::allocate(n, hint);
+  }
+  void deallocate(pointer p, size_type n) {
+    allocated_bytes -= n * sizeof(T);
+    std::allocator<T>::deallocate(p, n);
+  }
+};
+
+typedef std::basic_string<char, std::char_traits<char>,
+                          CountingAllocator<char> > CountedString;
+
+struct CountedStringHash {
+  size_t operator()(const CountedString& s) const {
+    return std::tr1::hash<std::string>()(std::string(s.data(), s.size()));
+  }
+};
+
+// The previous MetTable bucket layout: one heap node and one std::string
+// per key, built from the Slice on every call.
+class MapMetTable {
+ public:
+  MapMetTable() : buckets_(1024) { }
+
+  bool Insert(uint32_t value, const Slice& key, uint64_t version) {
+    Bucket* b = &buckets_[value % buckets_.size()];
+    CountedString k(key.data(), key.size());
+    MutexLock l(&b->mutex);
+    Map::iterator iter = b->keys.find(k);
+    if (iter == b->keys.end()) {
+      b->keys.insert(std::make_pair(k, version));
+      return true;
+    } else if (iter->second < version) {
+      iter->second = version;
+      return true;
+    }
+    return false;
+  }
+
+  bool Query(uint32_t value, const Slice& key, uint64_t* version) {
+    Bucket* b = &buckets_[value % buckets_.size()];
+    CountedString k(key.data(), key.size());
+    MutexLock l(&b->mutex);
+    Map::iterator iter = b->keys.find(k);
+    if (iter == b->keys.end()) {
+      return false;
+    }
+    *version = iter->second;
+    return true;
+  }
+
+ private:
+  typedef std::tr1::unordered_map<
+      CountedString, uint64_t, CountedStringHash,
+      std::equal_to<CountedString>,
+      CountingAllocator<std::pair<const CountedString, uint64_t> > > Map;
+  struct Bucket {
+    Map keys;
+    port::Mutex mutex;
+  };
+  std::vector<Bucket> buckets_;
+};
+
+struct Workload {
+  std::vector<std::string> keys;
+  std::vector<uint32_t> hashes;
+};
+
+static void MakeWorkload(int num, int key_size, Workload* w) {
+  Random rnd(301);
+  char buf[100];
+  for (int i = 0; i < num; i++) {
+    snprintf(buf, sizeof(buf), "h%d=%016d", rnd.Uniform(1000), i);
+    std::string key(buf);
+    if (static_cast<int>(key.size()) < key_size) {
+      key.append(key_size - key.size(), 'x');
+    }
+    w->keys.push_back(key);
+    w->hashes.push_back(crc32c::Value(key.data(), key.size()));
+  }
+}
+
+static void Report(const char* name, const char* op, int num,
+                   uint64_t micros) {
+  fprintf(stdout, "%-10s %-8s : %8.3f micros/op; %10.0f ops/sec\n",
+          name, op, static_cast<double>(micros) / num,
+          num * 1e6 / (micros > 0 ? micros : 1));
+}
+
+template <typename Table>
+static void Run(const char* name, Table* table, const Workload& w,
+                size_t (*memory)(Table*)) {
+  Env* env = Env::Default();
+  const int num = w.keys.size();
+
+  uint64_t start = env->NowMicros();
+  for (int i = 0; i < num; i++) {
+    table->Insert(w.hashes[i], w.keys[i], i + 1);
+  }
+  Report(name, "insert", num, env->NowMicros() - start);
+
+  start = env->NowMicros();
+  for (int i = 0; i < num; i++) {
+    table->Insert(w.hashes[i], w.keys[i], num + i + 1);
+  }
+  Report(name, "update", num, env->NowMicros() - start);
+
+  uint64_t version = 0;
+  uint64_t sum = 0;
+  start = env->NowMicros();
+  for (int i = 0; i < num; i++) {
+    if (table->Query(w.hashes[i], w.keys[i], &version)) {
+      sum += version;
+    }
+  }
+  Report(name, "query", num, env->NowMicros() - start);
+
+  const size_t bytes = (*memory)(table);
+  fprintf(stdout, "%-10s %-8s : %8.1f bytes/key (%llu)\n", name, "memory",
+          static_cast<double>(bytes) / num,
+          static_cast<unsigned long long>(sum));
+}
+
+static size_t MapMemory(MapMetTable*) {
+  return allocated_bytes;
+}
+
+static size_t MetMemory(MetTable* table) {
+  return table->ApproximateMemoryUsage();
+}
+
+}  // namespace
+
+}  // namespace leveldb
+
+int main(int argc, char** argv) {
+  int num = 1000000;
+  int key_size = 24;
+  for (int i = 1; i < argc; i++) {
+    int n;
+    char junk;
+    if (sscanf(argv[i], "--num=%d%c", &n, &junk) == 1) {
+      num = n;
+    } else if (sscanf(argv[i], "--key_size=%d%c", &n, &junk) == 1) {
+      key_size = n;
+    } else {
+      fprintf(stderr, "Invalid flag '%s'\n", argv[i]);
+      exit(1);
+    }
+  }
+
+  leveldb::Workload w;
+  leveldb::MakeWorkload(num, key_size, &w);
+  fprintf(stdout, "Keys:       %d\nKey size:   %d bytes\n", num, key_size);
+  fprintf(stdout, "------------------------------------------------\n");
+
+  {
+    leveldb::MapMetTable* table = new leveldb::MapMetTable;
+    leveldb::Run("map", table, w, &leveldb::MapMemory);
+    delete table;
+  }
+  {
+    leveldb::MetTable* table = new leveldb::MetTable;
+    table->Ref();
+    leveldb::Run("mettable", table, w, &leveldb::MetMemory);
+    table->Unref();
+  }
+  return 0;
+}
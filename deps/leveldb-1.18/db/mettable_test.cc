@@ -0,0 +1,285 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "db/mettable.h"
+#include <map>
+#include <string>
+#include "db/db_impl.h"
+#include "leveldb/db.h"
+#include "leveldb/slice.h"
+#include "util/coding.h"
+#include "util/crc32c.h"
+#include "util/testharness.h"
+
+namespace leveldb {
+
+// Stands in for the versions persisted in value headers.
+class MapResolver : public MetTable::Resolver {
+ public:
+  MapResolver() : calls_(0) { }
+
+  virtual bool ResolveVersion(const Slice& key, uint64_t* version) {
+    ++calls_;
+    std::map<std::string, uint64_t>::const_iterator iter =
+        persisted_.find(key.ToString());
+    if (iter == persisted_.end()) {
+      return false;
+    }
+    *version = iter->second;
+    return true;
+  }
+
+  std::map<std::string, uint64_t> persisted_;
+  int calls_;
+};
+
+static std::string Key(int i) {
+  char buf[32];
+  snprintf(buf, sizeof(buf), "key%08d", i);
+  return std::string(buf);
+}
+
+static uint32_t Hash(const std::string& key) {
+  return crc32c::Value(key.data(), key.size());
+}
+
+class MetTableTest { };
+
+TEST(MetTableTest, Unbounded) {
+  MetTable* met = new MetTable;
+  met->Ref();
+  const int N = 10000;
+  for (int i = 0; i < N; i++) {
+    std::string k = Key(i);
+    ASSERT_TRUE(met->Insert(Hash(k), k, i + 1));
+  }
+  for (int i = 0; i < N; i++) {
+    std::string k = Key(i);
+    uint64_t version = 0;
+    ASSERT_TRUE(met->Query(Hash(k), k, &version));
+    ASSERT_EQ(i + 1, version);
+    // An older version does not replace the newest one
+    met->Insert(Hash(k), k, i);
+    ASSERT_TRUE(met->Query(Hash(k), k, &version));
+    ASSERT_EQ(i + 1, version);
+  }
+  std::string k = Key(0);
+  ASSERT_TRUE(met->Remove(Hash(k), k, 2));
+  uint64_t version = 0;
+  ASSERT_TRUE(!met->Query(Hash(k), k, &version));
+  met->Unref();
+}
+
+TEST(MetTableTest, RemoveKeepsOtherKeys) {
+  MetTable* met = new MetTable;
+  met->Ref();
+  const int N = 50000;
+  for (int i = 0; i < N; i++) {
+    std::string k = Key(i);
+    ASSERT_TRUE(met->Insert(Hash(k), k, 10));
+  }
+  for (int i = 0; i < N; i += 3) {
+    std::string k = Key(i);
+    ASSERT_TRUE(!met->Remove(Hash(k), k, 10));
+    ASSERT_TRUE(met->Remove(Hash(k), k, 11));
+  }
+  for (int i = 0; i < N; i++) {
+    std::string k = Key(i);
+    uint64_t version = 0;
+    ASSERT_EQ(i % 3 != 0, met->Query(Hash(k), k, &version));
+  }
+  met->Unref();
+}
+
+TEST(MetTableTest, BoundedEvictsAndResolves) {
+  MapResolver resolver;
+  const size_t capacity = 8 << 20;
+  MetTable* met = new MetTable(capacity, &resolver);
+  met->Ref();
+  const int N = 300000;
+  for (int i = 0; i < N; i++) {
+    std::string k = Key(i);
+    ASSERT_TRUE(met->Insert(Hash(k), k, i + 1));
+    resolver.persisted_[k] = i + 1;
+  }
+  // Erased keys linger in the arenas until they are compacted
+  ASSERT_LE(met->ApproximateMemoryUsage(), 2 * capacity);
+
+  // Every key is still answered, from memory or from the resolver
+  for (int i = 0; i < N; i++) {
+    std::string k = Key(i);
+    uint64_t version = 0;
+    ASSERT_TRUE(met->Query(Hash(k), k, &version));
+    ASSERT_EQ(i + 1, version);
+  }
+  ASSERT_GT(resolver.calls_, 0);
+
+  // Evicted keys still know their newest version
+  for (int i = 0; i < N; i += 100) {
+    std::string k = Key(i);
+    ASSERT_TRUE(!met->Remove(Hash(k), k, i + 1));
+    met->Insert(Hash(k), k, i);
+    uint64_t version = 0;
+    ASSERT_TRUE(met->Query(Hash(k), k, &version));
+    ASSERT_EQ(i + 1, version);
+  }
+  met->Unref();
+}
+
+TEST(MetTableTest, EncodeDecode) {
+  MetTable* met = new MetTable;
+  met->Ref();
+  const int N = 20000;
+  for (int i = 0; i < N; i++) {
+    std::string k = Key(i);
+    met->Insert(Hash(k), k, i + 1);
+  }
+  MetTable* copy = new MetTable;
+  copy->Ref();
+  for (int b = 0; b < met->NumBuckets(); b++) {
+    std::string entries;
+    ASSERT_TRUE(!met->EncodeBucket(b, &entries));
+    ASSERT_TRUE(copy->DecodeEntries(entries));
+  }
+  for (int i = 0; i < N; i++) {
+    std::string k = Key(i);
+    uint64_t version = 0;
+    ASSERT_TRUE(copy->Query(Hash(k), k, &version));
+    ASSERT_EQ(i + 1, version);
+  }
+  ASSERT_TRUE(!copy->DecodeEntries(Slice("\x05" "abc", 4)));
+  copy->Unref();
+  met->Unref();
+}
+
+TEST(MetTableTest, SnapshotIgnoresLaterChanges) {
+  MetTable* met = new MetTable;
+  met->Ref();
+  const int N = 20000;
+  for (int i = 0; i < N; i++) {
+    std::string k = Key(i);
+    met->Insert(Hash(k), k, 10);
+  }
+  met->BeginSnapshot();
+  for (int i = 0; i < N; i += 2) {
+    std::string k = Key(i);
+    met->Insert(Hash(k), k, 20);
+    k = Key(N + i);
+    met->Insert(Hash(k), k, 20);
+  }
+  std::string k = Key(1);
+  ASSERT_TRUE(met->Remove(Hash(k), k, 20));
+
+  MetTable* copy = new MetTable;
+  copy->Ref();
+  for (int b = 0; b < met->NumBuckets(); b++) {
+    std::string entries;
+    ASSERT_TRUE(!met->SnapshotBucket(b, &entries));
+    ASSERT_TRUE(copy->DecodeEntries(entries));
+  }
+  met->EndSnapshot();
+  for (int i = 0; i < 2 * N; i++) {
+    std::string k = Key(i);
+    uint64_t version = 0;
+    ASSERT_EQ(i < N, copy->Query(Hash(k), k, &version));
+    if (i < N) {
+      ASSERT_EQ(10, version);
+    }
+    // The table itself has moved on
+    ASSERT_EQ(i != 1 && (i < N || i % 2 == 0),
+              met->Query(Hash(k), k, &version));
+  }
+  copy->Unref();
+  met->Unref();
+}
+
+// Key as passed to DB::Put(): versioncare, last and next version and
+// expiration time ahead of the user key.
+static std::string MetaKey(uint32_t versioncare, uint64_t last,
+                           uint64_t next, const std::string& key) {
+  std::string result;
+  PutFixed32(&result, versioncare);
+  PutFixed64(&result, last);
+  PutFixed64(&result, next);
+  PutFixed64(&result, 0);
+  result.append(key);
+  return result;
+}
+
+static std::string CheckpointLoaded(DB* db) {
+  std::string value;
+  ASSERT_TRUE(db->GetProperty("leveldb.met-checkpoint-loaded", &value));
+  return value;
+}
+
+TEST(MetTableTest, CheckpointSurvivesReopen) {
+  const std::string dbname = test::TmpDir() + "/mettable_checkpoint_test";
+  Options options;
+  options.create_if_missing = true;
+  options.met_table_checkpoint = true;
+  DestroyDB(dbname, options);
+
+  DB* db;
+  ASSERT_OK(DB::Open(options, dbname, &db));
+  ASSERT_EQ("0", CheckpointLoaded(db));
+  db->WriteRecovering(WriteOptions());
+  for (int i = 0; i < 100; i++) {
+    ASSERT_OK(db->Put(WriteOptions(), MetaKey(0, 0, 5, Key(i)), "v"));
+  }
+  ASSERT_OK(reinterpret_cast<DBImpl*>(db)->TEST_CompactMemTable());
+  delete db;
+
+  ASSERT_OK(DB::Open(options, dbname, &db));
+  ASSERT_EQ("1", CheckpointLoaded(db));
+  // A version checked write is only applied if the index knows the key
+  ASSERT_OK(db->Put(WriteOptions(), MetaKey(1, 5, 6, Key(7)), "w"));
+  std::string value;
+  ASSERT_OK(db->Get(ReadOptions(), MetaKey(0, 0, 0, Key(7)), &value));
+  ASSERT_EQ(6, DecodeFixed64(value.data() + 1));
+  delete db;
+
+  // The log the checkpoint was taken at is gone and the checkpoint was
+  // not refreshed since
+  ASSERT_OK(DB::Open(options, dbname, &db));
+  ASSERT_EQ("0", CheckpointLoaded(db));
+  delete db;
+  DestroyDB(dbname, options);
+}
+
+TEST(MetTableTest, CheckpointReplaysLogTail) {
+  const std::string dbname = test::TmpDir() + "/mettable_checkpoint_test";
+  Options options;
+  options.create_if_missing = true;
+  options.met_table_checkpoint = true;
+  DestroyDB(dbname, options);
+
+  DB* db;
+  ASSERT_OK(DB::Open(options, dbname, &db));
+  db->WriteRecovering(WriteOptions());
+  ASSERT_OK(db->Put(WriteOptions(), MetaKey(0, 0, 1, "k"), "A"));
+  ASSERT_OK(reinterpret_cast<DBImpl*>(db)->TEST_CompactMemTable());
+  // Only in the log, the checkpoint has to be from before it
+  ASSERT_OK(db->Put(WriteOptions(), MetaKey(1, 1, 2, "k"), "B"));
+  ASSERT_OK(db->Put(WriteOptions(), MetaKey(1, 1, 3, "k"), "C"));
+  delete db;
+
+  // Twice, the first replay logs the records again
+  for (int i = 0; i < 2; i++) {
+    ASSERT_OK(DB::Open(options, dbname, &db));
+    ASSERT_EQ("1", CheckpointLoaded(db));
+    db->WriteRecovering(WriteOptions());
+    std::string value;
+    ASSERT_OK(db->Get(ReadOptions(), MetaKey(0, 0, 0, "k"), &value));
+    ASSERT_EQ(2, DecodeFixed64(value.data() + 1));
+    ASSERT_EQ("B", value.substr(9));
+    delete db;
+  }
+  DestroyDB(dbname, options);
+}
+
+}  // namespace leveldb
+
+int main(int argc, char** argv) {
+  return leveldb::test::RunAllTests();
+}
@@ -0,0 +1,177 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include <string>
+#include <vector>
+#include "db/db_impl.h"
+#include "leveldb/db.h"
+#include "leveldb/slice.h"
+#include "util/coding.h"
+#include "util/random.h"
+#include "util/testharness.h"
+
+namespace leveldb {
+
+// Key as passed to DB::Put(): versioncare, last and next version and
+// expiration time ahead of the user key.
+static std::string MetaKey(uint32_t versioncare, uint64_t next,
+                           const std::string& key) {
+  std::string result;
+  PutFixed32(&result, versioncare);
+  PutFixed64(&result, 0);
+  PutFixed64(&result, next);
+  PutFixed64(&result, 0);
+  result.append(key);
+  return result;
+}
+
+// Strips the type and version header the DB stores ahead of each value.
+static std::string UserValue(const Slice& v) {
+  return (v.size() < 9) ? std::string() : std::string(v.data() + 9, v.size() - 9);
+}
+
+static std::string Key(int i) {
+  char buf[100];
+  snprintf(buf, sizeof(buf), "key%06d", i);
+  return std::string(buf);
+}
+
+class MultiGetTest {
+ public:
+  std::string dbname_;
+  Options options_;
+  DB* db_;
+
+  MultiGetTest() {
+    dbname_ = test::TmpDir() + "/multi_get_test";
+    options_.create_if_missing = true;
+    // Small blocks and files so that the keys spread over many of both
+    options_.block_size = 256;
+    options_.write_buffer_size = 64 << 10;
+    DestroyDB(dbname_, options_);
+    ASSERT_OK(DB::Open(options_, dbname_, &db_));
+  }
+
+  ~MultiGetTest() {
+    delete db_;
+    DestroyDB(dbname_, options_);
+  }
+
+  void Put(int i, const std::string& v) {
+    ASSERT_OK(db_->Put(WriteOptions(), MetaKey(2, 0, Key(i)), v));
+  }
+
+  void Delete(int i) {
+    ASSERT_OK(db_->Delete(WriteOptions(), MetaKey(2, 0, Key(i))));
+  }
+
+  // Checks MultiGet() and GetPinned() of the given keys against Get() of
+  // each of them, returns how many were found
+  int Check(const std::vector<int>& ids, const ReadOptions& options) {
+    int found = 0;
+    const int n = ids.size();
+    std::vector<std::string> keys(n);
+    std::vector<Slice> slices(n);
+    for (int i = 0; i < n; i++) {
+      keys[i] = MetaKey(0, 0, Key(ids[i]));
+      slices[i] = keys[i];
+    }
+    std::vector<std::string> values(n);
+    std::vector<Status> statuses(n);
+    db_->MultiGet(options, n, &slices[0], &values[0], &statuses[0]);
+    for (int i = 0; i < n; i++) {
+      std::string value;
+      Status s = db_->Get(options, slices[i], &value);
+      ASSERT_EQ(s.ToString(), statuses[i].ToString());
+      PinnedValue pinned;
+      Status ps = db_->GetPinned(options, slices[i], &pinned);
+      ASSERT_EQ(s.ToString(), ps.ToString());
+      if (s.ok()) {
+        ASSERT_EQ(value, values[i]);
+        ASSERT_EQ(value, pinned.value().ToString());
+        found++;
+      }
+    }
+    return found;
+  }
+};
+
+TEST(MultiGetTest, Empty) {
+  std::vector<int> ids;
+  ids.push_back(3);
+  ids.push_back(1);
+  ASSERT_EQ(0, Check(ids, ReadOptions()));
+}
+
+TEST(MultiGetTest, AcrossMemtableAndFiles) {
+  Random rnd(301);
+  const int kNum = 5000;
+  for (int round = 0; round < 3; round++) {
+    for (int i = 0; i < kNum; i++) {
+      if (rnd.OneIn(3)) {
+        Put(i, std::string(rnd.Uniform(40) + 1, 'a' + round));
+      } else if (rnd.OneIn(5)) {
+        Delete(i);
+      }
+    }
+    if (round == 0) {
+      db_->CompactRange(NULL, NULL);
+    } else if (round == 1) {
+      ASSERT_OK(reinterpret_cast<DBImpl*>(db_)->TEST_CompactMemTable());
+    }
+  }
+
+  const Snapshot* snapshot = db_->GetSnapshot();
+  for (int i = 0; i < kNum; i += 7) {
+    Put(i, "after the snapshot");
+  }
+
+  int found = 0, total = 0;
+  for (int iter = 0; iter < 20; iter++) {
+    // Unsorted, with repeats and keys that were never written
+    std::vector<int> ids;
+    const int n = rnd.Uniform(300) + 1;
+    for (int i = 0; i < n; i++) {
+      ids.push_back(rnd.Uniform(kNum + 100));
+    }
+    found += Check(ids, ReadOptions());
+    ReadOptions options;
+    options.snapshot = snapshot;
+    Check(ids, options);
+    total += n;
+  }
+  ASSERT_GT(found, 0);
+  ASSERT_LT(found, total);
+  db_->ReleaseSnapshot(snapshot);
+}
+
+TEST(MultiGetTest, PinnedOutlivesCompaction) {
+  PinnedValue from_mem, from_file;
+  Put(1, "in the file");
+  ASSERT_OK(reinterpret_cast<DBImpl*>(db_)->TEST_CompactMemTable());
+  Put(2, "in the memtable");
+  ASSERT_OK(db_->GetPinned(ReadOptions(), MetaKey(0, 0, Key(1)), &from_file));
+  ASSERT_OK(db_->GetPinned(ReadOptions(), MetaKey(0, 0, Key(2)), &from_mem));
+
+  // Overwrite both and push the memtable and the file out of the version
+  for (int i = 0; i < 2000; i++) {
+    Put(i % 3, std::string(100, 'x'));
+  }
+  db_->CompactRange(NULL, NULL);
+  ASSERT_EQ("in the file", UserValue(from_file.value()));
+  ASSERT_EQ("in the memtable", UserValue(from_mem.value()));
+
+  from_mem.Reset();
+  ASSERT_OK(db_->GetPinned(ReadOptions(), MetaKey(0, 0, Key(2)), &from_mem));
+  ASSERT_EQ(std::string(100, 'x'), UserValue(from_mem.value()));
+  ASSERT_TRUE(db_->GetPinned(ReadOptions(), MetaKey(0, 0, Key(7)),
+                             &from_mem).IsNotFound());
+  ASSERT_EQ(0, from_mem.value().size());
+}
+
+}  // namespace leveldb
+
+int main(int argc, char** argv) {
+  return leveldb::test::RunAllTests();
+}
@@ -0,0 +1,68 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "db/row_cache.h"
+
+#include <string>
+#include "util/crc32c.h"
+#include "util/mutexlock.h"
+
+namespace leveldb {
+
+static void DeleteRow(const Slice& key, void* value) {
+  delete reinterpret_cast<std::string*>(value);
+}
+
+RowCache::RowCache(size_t capacity, size_t max_value_size)
+    : cache_(NewLRUCache(capacity)),
+      max_value_size_(max_value_size) {
+}
+
+RowCache::~RowCache() {
+  delete cache_;
+}
+
+uint32_t RowCache::Hash(const Slice& key) {
+  return crc32c::Value(key.data(), key.size());
+}
+
+Cache::Handle* RowCache::Lookup(const Slice& key) {
+  return cache_->Lookup(key);
+}
+
+Slice RowCache::Value(Cache::Handle* handle) {
+  return Slice(*reinterpret_cast<std::string*>(cache_->Value(handle)));
+}
+
+void RowCache::Release(Cache::Handle* handle) {
+  cache_->Release(handle);
+}
+
+void RowCache::Insert(const Slice& key, SequenceNumber sequence,
+                      const Slice& value) {
+  if (value.size() > max_value_size_) {
+    return;
+  }
+  Stripe* stripe = &stripes_[Hash(key) % kNumStripes];
+  MutexLock l(&stripe->mu);
+  if (stripe->latest > sequence) {
+    // A write the read did not see may already have erased the key
+    return;
+  }
+  std::string* row = new std::string(value.data(), value.size());
+  cache_->Release(cache_->Insert(key, row, key.size() + value.size(),
+                                 &DeleteRow));
+}
+
+void RowCache::Erase(uint32_t hash, const Slice& key,
+                     SequenceNumber sequence) {
+  Stripe* stripe = &stripes_[hash % kNumStripes];
+  MutexLock l(&stripe->mu);
+  if (sequence > stripe->latest) {
+    stripe->latest = sequence;
+  }
+  cache_->Erase(key);
+}
+
+}  // namespace leveldb
@@ -0,0 +1,67 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#ifndef STORAGE_LEVELDB_DB_ROW_CACHE_H_
+#define STORAGE_LEVELDB_DB_ROW_CACHE_H_
+
+#include <stdint.h>
+#include "db/dbformat.h"
+#include "leveldb/cache.h"
+#include "port/port.h"
+
+namespace leveldb {
+
+// Newest values of small keys, as DB::Get() returns them: the value
+// header followed by the user value.  A read that hits it skips the
+// memtables, the tables and the block cache.
+//
+// MemTable::Add() erases the entry of every key it writes.  A reader may
+// only fill in what it read at "sequence" while no write newer than that
+// went to a key of the same stripe, so a value read before a concurrent
+// write cannot be put back after the write erased it.
+// Compactions only drop values that expired, which readers already treat
+// as missing, so they leave the entries alone.
+class RowCache {
+ public:
+  // "capacity" bytes of keys and values, values longer than
+  // "max_value_size" are never kept.
+  RowCache(size_t capacity, size_t max_value_size);
+  ~RowCache();
+
+  // crc32c of the user key, as MemTable and MetTable hash keys.
+  static uint32_t Hash(const Slice& key);
+
+  // Returns NULL if "key" is not cached.  Else the value stays valid
+  // until the handle is passed to Release().
+  Cache::Handle* Lookup(const Slice& key);
+  Slice Value(Cache::Handle* handle);
+  void Release(Cache::Handle* handle);
+
+  // Keep "value", the newest value of "key" as of "sequence".
+  void Insert(const Slice& key, SequenceNumber sequence, const Slice& value);
+
+  // Drop the entry of "key", written at "sequence".
+  void Erase(uint32_t hash, const Slice& key, SequenceNumber sequence);
+
+ private:
+  enum { kNumStripes = 64 };
+
+  struct Stripe {
+    port::Mutex mu;
+    SequenceNumber latest;   // Newest write erased from the stripe
+    Stripe() : latest(0) { }
+  };
+
+  Cache* cache_;
+  const size_t max_value_size_;
+  Stripe stripes_[kNumStripes];
+
+  // No copying allowed
+  RowCache(const RowCache&);
+  void operator=(const RowCache&);
+};
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_DB_ROW_CACHE_H_
@@ -0,0 +1,169 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "db/row_cache.h"
+
+#include <string>
+#include "db/db_impl.h"
+#include "db/dbformat.h"
+#include "leveldb/db.h"
+#include "leveldb/write_batch.h"
+#include "util/coding.h"
+#include "util/testharness.h"
+
+namespace leveldb {
+
+static std::string MetaKey(uint64_t next, uint64_t expiration,
+                           const std::string& key) {
+  std::string result;
+  PutFixed32(&result, 2);
+  PutFixed64(&result, 0);
+  PutFixed64(&result, next);
+  PutFixed64(&result, expiration);
+  result.append(key);
+  return result;
+}
+
+static std::string Value(uint64_t version, uint64_t expiration,
+                         const std::string& value) {
+  std::string result;
+  result.push_back(static_cast<char>(
+      expiration > 0 ? (kTypeValue | kTypeExpiration) : kTypeValue));
+  PutFixed64(&result, version);
+  if (expiration > 0) {
+    PutFixed64(&result, expiration);
+  }
+  result.append(value);
+  return result;
+}
+
+static const uint64_t kLater = 4102444800000ull;
+
+static std::string Cached(RowCache* cache, const std::string& key) {
+  Cache::Handle* handle = cache->Lookup(key);
+  if (handle == NULL) {
+    return "MISS";
+  }
+  std::string result = cache->Value(handle).ToString();
+  cache->Release(handle);
+  return result;
+}
+
+class RowCacheTest {
+ public:
+  std::string dbname_;
+  Options options_;
+  DB* db_;
+
+  RowCacheTest() {
+    dbname_ = test::TmpDir() + "/row_cache_test";
+    options_.create_if_missing = true;
+    options_.row_cache_size = 1 << 20;
+    options_.row_cache_max_value_size = 64;
+    DestroyDB(dbname_, options_);
+    ASSERT_OK(DB::Open(options_, dbname_, &db_));
+  }
+
+  ~RowCacheTest() {
+    delete db_;
+    DestroyDB(dbname_, options_);
+  }
+
+  DBImpl* dbfull() { return reinterpret_cast<DBImpl*>(db_); }
+
+  // Reads "key" through every read path, which all have to agree
+  std::string Get(const std::string& key, const Snapshot* snapshot = NULL) {
+    ReadOptions options;
+    options.snapshot = snapshot;
+    std::string lookup = MetaKey(0, 0, key);
+    std::string value;
+    Status s = db_->Get(options, lookup, &value);
+    if (s.IsNotFound()) {
+      value = "NOT_FOUND";
+    } else if (!s.ok()) {
+      value = s.ToString();
+    }
+
+    PinnedValue pinned;
+    Status ps = db_->GetPinned(options, lookup, &pinned);
+    ASSERT_EQ(s.ToString(), ps.ToString());
+    if (s.ok()) {
+      ASSERT_EQ(value, pinned.value().ToString());
+    }
+    Slice keys[1] = { lookup };
+    std::string values[1];
+    Status statuses[1];
+    db_->MultiGet(options, 1, keys, values, statuses);
+    ASSERT_EQ(s.ToString(), statuses[0].ToString());
+    if (s.ok()) {
+      ASSERT_EQ(value, values[0]);
+    }
+    return value;
+  }
+};
+
+TEST(RowCacheTest, StaleInsert) {
+  RowCache cache(1 << 20, 16);
+  cache.Insert("a", 10, "va");
+  ASSERT_EQ("va", Cached(&cache, "a"));
+
+  // A read from before the write must not put its value back
+  cache.Erase(RowCache::Hash("a"), "a", 20);
+  ASSERT_EQ("MISS", Cached(&cache, "a"));
+  cache.Insert("a", 15, "va");
+  ASSERT_EQ("MISS", Cached(&cache, "a"));
+  cache.Insert("a", 20, "vb");
+  ASSERT_EQ("vb", Cached(&cache, "a"));
+
+  // Too large to keep
+  cache.Insert("b", 30, std::string(17, 'x'));
+  ASSERT_EQ("MISS", Cached(&cache, "b"));
+}
+
+TEST(RowCacheTest, Invalidation) {
+  ASSERT_OK(db_->Put(WriteOptions(), MetaKey(10, 0, "a"), "va"));
+  ASSERT_OK(db_->Put(WriteOptions(), MetaKey(10, 0, "b"), "vb"));
+  ASSERT_EQ(Value(10, 0, "va"), Get("a"));
+  ASSERT_EQ(Value(10, 0, "vb"), Get("b"));
+
+  // Hits keep answering after the values left the memtable
+  ASSERT_OK(dbfull()->TEST_CompactMemTable());
+  ASSERT_EQ(Value(10, 0, "va"), Get("a"));
+
+  ASSERT_OK(db_->Put(WriteOptions(), MetaKey(20, 0, "a"), "va2"));
+  ASSERT_EQ(Value(20, 0, "va2"), Get("a"));
+
+  WriteBatch batch;
+  batch.Touch(MetaKey(30, kLater, "a"));
+  ASSERT_OK(db_->Write(WriteOptions(), &batch));
+  ASSERT_EQ(Value(30, kLater, "va2"), Get("a"));
+
+  ASSERT_OK(db_->Delete(WriteOptions(), MetaKey(0, 0, "b")));
+  ASSERT_EQ("NOT_FOUND", Get("b"));
+  ASSERT_OK(db_->Put(WriteOptions(), MetaKey(40, 0, "b"), "vb2"));
+  ASSERT_EQ(Value(40, 0, "vb2"), Get("b"));
+}
+
+TEST(RowCacheTest, SnapshotBypassesCache) {
+  ASSERT_OK(db_->Put(WriteOptions(), MetaKey(10, 0, "a"), "va"));
+  const Snapshot* before = db_->GetSnapshot();
+  ASSERT_OK(db_->Put(WriteOptions(), MetaKey(20, 0, "a"), "vb"));
+  ASSERT_EQ(Value(20, 0, "vb"), Get("a"));
+  ASSERT_EQ(Value(10, 0, "va"), Get("a", before));
+  ASSERT_EQ(Value(20, 0, "vb"), Get("a"));
+  db_->ReleaseSnapshot(before);
+
+  // Values over the limit are read from the memtable every time
+  const std::string big(100, 'v');
+  ASSERT_OK(db_->Put(WriteOptions(), MetaKey(30, 0, "a"), big));
+  ASSERT_EQ(Value(30, 0, big), Get("a"));
+  ASSERT_OK(db_->Put(WriteOptions(), MetaKey(40, 0, "a"), "vc"));
+  ASSERT_EQ(Value(40, 0, "vc"), Get("a"));
+}
+
+}  // namespace leveldb
+
+int main(int argc, char** argv) {
+  return leveldb::test::RunAllTests();
+}
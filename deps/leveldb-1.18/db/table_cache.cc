@@ -107,12 +107,37 @@ Status TableCache::Get(const ReadOptions& options,
                        uint64_t file_size,
                        const Slice& k,
                        void* arg,
-                       void (*saver)(void*, const Slice&, const Slice&)) {
+                       void (*saver)(void*, const Slice&, const Slice&),
+                       Iterator** block) {
   Cache::Handle* handle = NULL;
   Status s = FindTable(file_number, file_size, &handle);
   if (s.ok()) {
     Table* t = reinterpret_cast<TableAndFile*>(cache_->Value(handle))->table;
-    s = t->InternalGet(options, k, arg, saver);
+    Iterator* block_iter = NULL;
+    s = t->InternalGet(options, k, arg, saver,
+                       block != NULL ? &block_iter : NULL);
+    if (block_iter != NULL) {
+      block_iter->RegisterCleanup(&UnrefEntry, cache_, handle);
+      *block = block_iter;
+    } else {
+      cache_->Release(handle);
+    }
+  }
+  return s;
+}
+
+Status TableCache::MultiGet(const ReadOptions& options,
+                            uint64_t file_number,
+                            uint64_t file_size,
+                            const Slice* keys,
+                            int n,
+                            void* arg,
+                            void (*saver)(void*, int, const Slice&, const Slice&)) {
+  Cache::Handle* handle = NULL;
+  Status s = FindTable(file_number, file_size, &handle);
+  if (s.ok()) {
+    Table* t = reinterpret_cast<TableAndFile*>(cache_->Value(handle))->table;
+    s = t->InternalMultiGet(options, keys, n, arg, saver);
     cache_->Release(handle);
   }
   return s;
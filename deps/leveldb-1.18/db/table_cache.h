@@ -37,12 +37,25 @@ class TableCache {
 
   // If a seek to internal key "k" in specified file finds an entry,
   // call (*handle_result)(arg, found_key, found_value).
+  // If block is non-NULL the entry is pinned as for Table::InternalGet(),
+  // *block then also holds the table open until it is deleted.
   Status Get(const ReadOptions& options,
              uint64_t file_number,
              uint64_t file_size,
              const Slice& k,
              void* arg,
-             void (*handle_result)(void*, const Slice&, const Slice&));
+             void (*handle_result)(void*, const Slice&, const Slice&),
+             Iterator** block = NULL);
+
+  // Get() for n sorted keys of the same file, calling
+  // (*handle_result)(arg, i, found_key, found_value) for keys[i].
+  Status MultiGet(const ReadOptions& options,
+                  uint64_t file_number,
+                  uint64_t file_size,
+                  const Slice* keys,
+                  int n,
+                  void* arg,
+                  void (*handle_result)(void*, int, const Slice&, const Slice&));
 
   // Evict any entry for the specified file number
   void Evict(uint64_t file_number);
@@ -0,0 +1,256 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include <string>
+#include "db/db_impl.h"
+#include "db/dbformat.h"
+#include "db/write_batch_internal.h"
+#include "leveldb/db.h"
+#include "leveldb/write_batch.h"
+#include "util/coding.h"
+#include "util/logging.h"
+#include "util/testharness.h"
+
+namespace leveldb {
+
+// Key as passed to DB::Put(): versioncare, last and next version and
+// expiration time ahead of the user key.
+static std::string MetaKey(uint64_t next, uint64_t expiration,
+                           const std::string& key) {
+  std::string result;
+  PutFixed32(&result, 2);
+  PutFixed64(&result, 0);
+  PutFixed64(&result, next);
+  PutFixed64(&result, expiration);
+  result.append(key);
+  return result;
+}
+
+// Value as read back: type, version, expiration if any and user value.
+static std::string Value(uint64_t version, uint64_t expiration,
+                         const std::string& value) {
+  std::string result;
+  result.push_back(static_cast<char>(
+      expiration > 0 ? (kTypeValue | kTypeExpiration) : kTypeValue));
+  PutFixed64(&result, version);
+  if (expiration > 0) {
+    PutFixed64(&result, expiration);
+  }
+  result.append(value);
+  return result;
+}
+
+// Far enough ahead for compactions not to drop the values
+static const uint64_t kLater = 4102444800000ull;
+
+class TouchTest {
+ public:
+  std::string dbname_;
+  Options options_;
+  DB* db_;
+
+  TouchTest() {
+    dbname_ = test::TmpDir() + "/touch_test";
+    options_.create_if_missing = true;
+    DestroyDB(dbname_, options_);
+    ASSERT_OK(DB::Open(options_, dbname_, &db_));
+  }
+
+  ~TouchTest() {
+    delete db_;
+    DestroyDB(dbname_, options_);
+  }
+
+  void Reopen() {
+    delete db_;
+    db_ = NULL;
+    ASSERT_OK(DB::Open(options_, dbname_, &db_));
+    db_->WriteRecovering(WriteOptions());
+  }
+
+  DBImpl* dbfull() { return reinterpret_cast<DBImpl*>(db_); }
+
+  void Touch(uint64_t next, uint64_t expiration, const std::string& key) {
+    WriteBatch batch;
+    batch.Touch(MetaKey(next, expiration, key));
+    ASSERT_OK(db_->Write(WriteOptions(), &batch));
+  }
+
+  std::string Get(const std::string& key, const Snapshot* snapshot = NULL) {
+    ReadOptions options;
+    options.snapshot = snapshot;
+    std::string lookup = MetaKey(0, 0, key);
+    std::string value;
+    Status s = db_->Get(options, lookup, &value);
+    if (s.IsNotFound()) {
+      value = "NOT_FOUND";
+    } else if (!s.ok()) {
+      value = s.ToString();
+    }
+
+    // Every read path has to agree
+    PinnedValue pinned;
+    Status ps = db_->GetPinned(options, lookup, &pinned);
+    ASSERT_EQ(s.ToString(), ps.ToString());
+    if (s.ok()) {
+      ASSERT_EQ(value, pinned.value().ToString());
+    }
+    Slice keys[1] = { lookup };
+    std::string values[1];
+    Status statuses[1];
+    db_->MultiGet(options, 1, keys, values, statuses);
+    ASSERT_EQ(s.ToString(), statuses[0].ToString());
+    if (s.ok()) {
+      ASSERT_EQ(value, values[0]);
+    }
+    return value;
+  }
+
+  // Number of entries kept for key in the memtables and files
+  int CountEntries(const std::string& key) {
+    Iterator* iter = dbfull()->TEST_NewInternalIterator();
+    int count = 0;
+    for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+      ParsedInternalKey ikey;
+      ASSERT_TRUE(ParseInternalKey(iter->key(), &ikey));
+      if (ikey.user_key == key) count++;
+    }
+    delete iter;
+    return count;
+  }
+};
+
+TEST(TouchTest, ReplacesVersionAndExpiration) {
+  const std::string big(100000, 'v');
+  ASSERT_OK(db_->Put(WriteOptions(), MetaKey(10, kLater, "a"), big));
+  ASSERT_OK(db_->Put(WriteOptions(), MetaKey(10, 0, "b"), "small"));
+  const Snapshot* before = db_->GetSnapshot();
+
+  Touch(20, kLater + 1, "a");
+  Touch(20, kLater, "b");
+  ASSERT_EQ(Value(20, kLater + 1, big), Get("a"));
+  ASSERT_EQ(Value(20, kLater, "small"), Get("b"));
+
+  // Persist
+  Touch(30, 0, "a");
+  ASSERT_EQ(Value(30, 0, big), Get("a"));
+  ASSERT_EQ(Value(10, kLater, big), Get("a", before));
+
+  ASSERT_OK(dbfull()->TEST_CompactMemTable());
+  ASSERT_EQ(Value(30, 0, big), Get("a"));
+  ASSERT_EQ(Value(20, kLater, "small"), Get("b"));
+  ASSERT_EQ(Value(10, kLater, big), Get("a", before));
+
+  // The snapshot still needs the value the touch records apply to
+  db_->CompactRange(NULL, NULL);
+  ASSERT_EQ(Value(10, kLater, big), Get("a", before));
+  db_->ReleaseSnapshot(before);
+  ASSERT_EQ(Value(30, 0, big), Get("a"));
+
+  // Folded into a single value once no snapshot needs the old one
+  Touch(40, kLater, "b");
+  ASSERT_OK(dbfull()->TEST_CompactMemTable());
+  db_->CompactRange(NULL, NULL);
+  ASSERT_EQ(1, CountEntries("a"));
+  ASSERT_EQ(1, CountEntries("b"));
+  ASSERT_EQ(Value(30, 0, big), Get("a"));
+  ASSERT_EQ(Value(40, kLater, "small"), Get("b"));
+}
+
+TEST(TouchTest, DeletedOrMissing) {
+  ASSERT_OK(db_->Put(WriteOptions(), MetaKey(10, 0, "a"), "va"));
+  ASSERT_OK(db_->Put(WriteOptions(), MetaKey(10, 0, "z"), "vz"));
+  // Overlapping files, so that the compaction below is not a move
+  ASSERT_OK(dbfull()->TEST_CompactMemTable());
+  ASSERT_OK(db_->Delete(WriteOptions(), MetaKey(0, 0, "a")));
+  Touch(20, kLater, "a");
+  Touch(20, kLater, "missing");
+  Touch(20, kLater, "z");
+  ASSERT_EQ("NOT_FOUND", Get("a"));
+  ASSERT_EQ("NOT_FOUND", Get("missing"));
+
+  ASSERT_OK(dbfull()->TEST_CompactMemTable());
+  db_->CompactRange(NULL, NULL);
+  ASSERT_EQ("NOT_FOUND", Get("a"));
+  ASSERT_EQ("NOT_FOUND", Get("missing"));
+  ASSERT_EQ(0, CountEntries("a"));
+  ASSERT_EQ(0, CountEntries("missing"));
+  ASSERT_EQ(1, CountEntries("z"));
+  ASSERT_EQ(Value(20, kLater, "vz"), Get("z"));
+}
+
+TEST(TouchTest, DeletedAboveOlderLevels) {
+  ASSERT_OK(db_->Put(WriteOptions(), MetaKey(10, 0, "a"), "va"));
+  ASSERT_OK(dbfull()->TEST_CompactMemTable());
+  dbfull()->TEST_CompactRange(2, NULL, NULL);
+  ASSERT_OK(db_->Delete(WriteOptions(), MetaKey(0, 0, "a")));
+  ASSERT_OK(dbfull()->TEST_CompactMemTable());
+  Touch(20, kLater, "a");
+  ASSERT_OK(dbfull()->TEST_CompactMemTable());
+  std::string files;
+  for (int level = 1; level <= 3; level++) {
+    std::string n;
+    ASSERT_TRUE(db_->GetProperty(
+        "leveldb.num-files-at-level" + NumberToString(level), &n));
+    files += n;
+  }
+  ASSERT_EQ("111", files);
+  ASSERT_EQ("NOT_FOUND", Get("a"));
+
+  // Leaves the value in level 3 alone, the deletion has to stay
+  dbfull()->TEST_CompactRange(1, NULL, NULL);
+  ASSERT_EQ("NOT_FOUND", Get("a"));
+  db_->CompactRange(NULL, NULL);
+  ASSERT_EQ("NOT_FOUND", Get("a"));
+  ASSERT_EQ(0, CountEntries("a"));
+}
+
+TEST(TouchTest, PutWithMeta) {
+  KeyMeta meta;
+  meta.versioncare = 2;
+  meta.nextversion = 10;
+  meta.expiration = kLater;
+  WriteBatch batch;
+  batch.PutWithMeta(meta, "a", "va");
+  WriteBatch prefixed;
+  prefixed.Put(MetaKey(10, kLater, "a"), "va");
+  ASSERT_LT(WriteBatchInternal::ByteSize(&batch),
+            WriteBatchInternal::ByteSize(&prefixed));
+  ASSERT_OK(db_->Write(WriteOptions(), &batch));
+  ASSERT_EQ(Value(10, kLater, "va"), Get("a"));
+
+  // Version checked like a prefixed key
+  meta.versioncare = 1;
+  meta.lastversion = 9;
+  meta.nextversion = 20;
+  meta.expiration = 0;
+  ASSERT_OK(db_->PutWithMeta(WriteOptions(), meta, "a", "stale"));
+  ASSERT_EQ(Value(10, kLater, "va"), Get("a"));
+  meta.lastversion = 10;
+  ASSERT_OK(db_->PutWithMeta(WriteOptions(), meta, "a", "vb"));
+  ASSERT_EQ(Value(20, 0, "vb"), Get("a"));
+
+  // Handlers that do not know about it see the prefixed key
+  class Handler : public WriteBatch::Handler {
+   public:
+    std::string seen_;
+    virtual void Put(const Slice& key, const Slice& value) {
+      seen_ = key.ToString() + value.ToString();
+    }
+    virtual void Delete(const Slice& key) { }
+  };
+  Handler handler;
+  ASSERT_OK(batch.Iterate(&handler));
+  ASSERT_EQ(MetaKey(10, kLater, "a") + "va", handler.seen_);
+
+  // And the log replays it
+  Reopen();
+  ASSERT_EQ(Value(20, 0, "vb"), Get("a"));
+}
+
+}  // namespace leveldb
+
+int main(int argc, char** argv) {
+  return leveldb::test::RunAllTests();
+}
@@ -20,9 +20,43 @@ enum Tag {
   kDeletedFile          = 6,
   kNewFile              = 7,
   // 8 was used for large value refs
-  kPrevLogNumber        = 9
+  kPrevLogNumber        = 9,
+  kNewFileExpiration    = 10      // kNewFile with the expiration counts
 };
 
+void FileMetaData::CountEntry(const Slice& internal_key, const Slice& value) {
+  num_entries++;
+  ParsedInternalKey ikey;
+  if (!ParseInternalKey(internal_key, &ikey) ||
+      ikey.type != kTypeValue || value.size() < 1 + 8) {
+    return;
+  }
+  // Same tests as the ones DBImpl::DoCompactionWork() drops entries by
+  const unsigned char type = value[0];
+  if (type & kTypeExpiration) {
+    if (value.size() < 1 + 8 + 8) {
+      return;
+    }
+    const uint64_t expiration = DecodeFixed64(value.data() + 1 + 8);
+    if (num_expiring == 0 || expiration < min_expiration) {
+      min_expiration = expiration;
+    }
+    if (num_expiring == 0 || expiration > max_expiration) {
+      max_expiration = expiration;
+    }
+    num_expiring++;
+  } else if (type & kTypeLater) {
+    const uint64_t due = DecodeFixed64(value.data() + 1) & 0xFFFFFFFFFF00ull;
+    if (num_latered == 0 || due < min_latered) {
+      min_latered = due;
+    }
+    if (num_latered == 0 || due > max_latered) {
+      max_latered = due;
+    }
+    num_latered++;
+  }
+}
+
 void VersionEdit::Clear() {
   comparator_.clear();
   log_number_ = 0;
@@ -76,12 +110,23 @@ void VersionEdit::EncodeTo(std::string* dst) const {
 
   for (size_t i = 0; i < new_files_.size(); i++) {
     const FileMetaData& f = new_files_[i].second;
-    PutVarint32(dst, kNewFile);
+    // Files without anything to expire stay readable by older versions
+    const bool expiration = (f.num_expiring > 0 || f.num_latered > 0);
+    PutVarint32(dst, expiration ? kNewFileExpiration : kNewFile);
     PutVarint32(dst, new_files_[i].first);  // level
     PutVarint64(dst, f.number);
     PutVarint64(dst, f.file_size);
     PutLengthPrefixedSlice(dst, f.smallest.Encode());
     PutLengthPrefixedSlice(dst, f.largest.Encode());
+    if (expiration) {
+      PutVarint64(dst, f.num_entries);
+      PutVarint64(dst, f.num_expiring);
+      PutVarint64(dst, f.min_expiration);
+      PutVarint64(dst, f.max_expiration);
+      PutVarint64(dst, f.num_latered);
+      PutVarint64(dst, f.min_latered);
+      PutVarint64(dst, f.max_latered);
+    }
   }
 }
 
@@ -181,6 +226,7 @@ Status VersionEdit::DecodeFrom(const Slice& src) {
         break;
 
       case kNewFile:
+        f = FileMetaData();
         if (GetLevel(&input, &level) &&
             GetVarint64(&input, &f.number) &&
             GetVarint64(&input, &f.file_size) &&
@@ -192,6 +238,26 @@ Status VersionEdit::DecodeFrom(const Slice& src) {
         }
         break;
 
+      case kNewFileExpiration:
+        f = FileMetaData();
+        if (GetLevel(&input, &level) &&
+            GetVarint64(&input, &f.number) &&
+            GetVarint64(&input, &f.file_size) &&
+            GetInternalKey(&input, &f.smallest) &&
+            GetInternalKey(&input, &f.largest) &&
+            GetVarint64(&input, &f.num_entries) &&
+            GetVarint64(&input, &f.num_expiring) &&
+            GetVarint64(&input, &f.min_expiration) &&
+            GetVarint64(&input, &f.max_expiration) &&
+            GetVarint64(&input, &f.num_latered) &&
+            GetVarint64(&input, &f.min_latered) &&
+            GetVarint64(&input, &f.max_latered)) {
+          new_files_.push_back(std::make_pair(level, f));
+        } else {
+          msg = "new-file entry";
+        }
+        break;
+
       default:
         msg = "unknown tag";
         break;
@@ -258,6 +324,14 @@ std::string VersionEdit::DebugString() const {
     r.append(f.smallest.DebugString());
     r.append(" .. ");
     r.append(f.largest.DebugString());
+    if (f.num_expiring > 0 || f.num_latered > 0) {
+      r.append(" expiring ");
+      AppendNumberTo(&r, f.num_expiring);
+      r.append(" latered ");
+      AppendNumberTo(&r, f.num_latered);
+      r.append(" of ");
+      AppendNumberTo(&r, f.num_entries);
+    }
   }
   r.append("\n}\n");
   return r;
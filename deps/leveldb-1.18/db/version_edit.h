@@ -22,7 +22,24 @@ struct FileMetaData {
   InternalKey smallest;       // Smallest internal key served by table
   InternalKey largest;        // Largest internal key served by table
 
-  FileMetaData() : refs(0), allowed_seeks(1 << 30), file_size(0) { }
+  // What a compaction would drop from the table as time goes by, see
+  // VersionSet::Finalize().  Unknown, i.e. all zero, for tables written
+  // before these were recorded.
+  uint64_t num_entries;
+  uint64_t num_expiring;      // Values with an expiration
+  uint64_t min_expiration;    // Of those, in milliseconds
+  uint64_t max_expiration;
+  uint64_t num_latered;       // Deletions delayed to a later time
+  uint64_t min_latered;       // When they are due, in microseconds
+  uint64_t max_latered;
+
+  FileMetaData() : refs(0), allowed_seeks(1 << 30), file_size(0),
+                   num_entries(0), num_expiring(0),
+                   min_expiration(0), max_expiration(0),
+                   num_latered(0), min_latered(0), max_latered(0) { }
+
+  // Account for the entry "internal_key" -> "value" added to the table.
+  void CountEntry(const Slice& internal_key, const Slice& value);
 };
 
 class VersionEdit {
@@ -71,6 +88,11 @@ class VersionEdit {
     new_files_.push_back(std::make_pair(level, f));
   }
 
+  // Like AddFile() above, keeping the entry counts of "f" as well.
+  void AddFile(int level, const FileMetaData& f) {
+    new_files_.push_back(std::make_pair(level, f));
+  }
+
   // Delete the specified "file" from the specified "level".
   void DeleteFile(int level, uint64_t file) {
     deleted_files_.insert(std::make_pair(level, file));
@@ -3,6 +3,7 @@
 // found in the LICENSE file. See the AUTHORS file for names of contributors.
 
 #include "db/version_edit.h"
+#include "util/coding.h"
 #include "util/testharness.h"
 
 namespace leveldb {
@@ -39,6 +40,42 @@ TEST(VersionEditTest, EncodeDecode) {
   TestEncodeDecode(edit);
 }
 
+TEST(VersionEditTest, ExpirationCounts) {
+  std::string expiring(1, static_cast<char>(kTypeValue | kTypeExpiration));
+  PutFixed64(&expiring, 7);
+  PutFixed64(&expiring, 5000);
+  std::string latered(1, static_cast<char>(kTypeValue | kTypeLater));
+  PutFixed64(&latered, 0x123456789A07ull);
+  std::string plain(1, static_cast<char>(kTypeValue));
+  PutFixed64(&plain, 7);
+
+  FileMetaData f;
+  f.number = 10;
+  f.file_size = 100;
+  f.smallest = InternalKey("a", 1, kTypeValue);
+  f.largest = InternalKey("z", 2, kTypeValue);
+  f.CountEntry(InternalKey("a", 1, kTypeValue).Encode(), expiring);
+  f.CountEntry(InternalKey("b", 1, kTypeValue).Encode(), plain);
+  f.CountEntry(InternalKey("c", 1, kTypeValue).Encode(), latered);
+  f.CountEntry(InternalKey("d", 1, kTypeDeletion).Encode(), expiring);
+  ASSERT_EQ(4, f.num_entries);
+  ASSERT_EQ(1, f.num_expiring);
+  ASSERT_EQ(5000, f.min_expiration);
+  ASSERT_EQ(5000, f.max_expiration);
+  ASSERT_EQ(1, f.num_latered);
+  ASSERT_EQ(0x123456789A00ull, f.max_latered);
+
+  VersionEdit edit;
+  edit.AddFile(2, f);
+  TestEncodeDecode(edit);
+  std::string encoded;
+  edit.EncodeTo(&encoded);
+  VersionEdit parsed;
+  ASSERT_OK(parsed.DecodeFrom(encoded));
+  ASSERT_TRUE(parsed.DebugString().find("expiring 1 latered 1 of 4") !=
+              std::string::npos) << parsed.DebugString();
+}
+
 }  // namespace leveldb
 
 int main(int argc, char** argv) {
@@ -11,6 +11,7 @@
 #include "db/log_writer.h"
 #include "db/memtable.h"
 #include "db/table_cache.h"
+#include "leveldb/db.h"
 #include "leveldb/env.h"
 #include "leveldb/table_builder.h"
 #include "table/merger.h"
@@ -254,6 +255,7 @@ struct Saver {
   const Comparator* ucmp;
   Slice user_key;
   std::string* value;
+  Slice* pinned;
 };
 }
 static void SaveValue(void* arg, const Slice& ikey, const Slice& v) {
@@ -265,12 +267,20 @@ static void SaveValue(void* arg, const Slice& ikey, const Slice& v) {
     if (s->ucmp->Compare(parsed_key.user_key, s->user_key) == 0) {
       s->state = (parsed_key.type == kTypeValue) ? kFound : kDeleted;
       if (s->state == kFound) {
-        s->value->assign(v.data(), v.size());
+        if (s->pinned != NULL) {
+          *s->pinned = v;
+        } else {
+          s->value->assign(v.data(), v.size());
+        }
       }
     }
   }
 }
 
+static void DeleteIterator(void* arg1, void* arg2) {
+  delete reinterpret_cast<Iterator*>(arg1);
+}
+
 static bool NewestFirst(FileMetaData* a, FileMetaData* b) {
   return a->number > b->number;
 }
@@ -323,7 +333,8 @@ void Version::ForEachOverlapping(Slice user_key, Slice internal_key,
 Status Version::Get(const ReadOptions& options,
                     const LookupKey& k,
                     std::string* value,
-                    GetStats* stats) {
+                    GetStats* stats,
+                    PinnedValue* pin) {
   Slice ikey = k.internal_key();
   Slice user_key = k.user_key();
   const Comparator* ucmp = vset_->icmp_.user_comparator();
@@ -396,8 +407,20 @@ Status Version::Get(const ReadOptions& options,
       saver.ucmp = ucmp;
       saver.user_key = user_key;
       saver.value = value;
+      Slice pinned;
+      Iterator* block = NULL;
+      saver.pinned = (pin != NULL) ? &pinned : NULL;
       s = vset_->table_cache_->Get(options, f->number, f->file_size,
-                                   ikey, &saver, SaveValue);
+                                   ikey, &saver, SaveValue,
+                                   (pin != NULL) ? &block : NULL);
+      if (block != NULL) {
+        if (s.ok() && saver.state == kFound) {
+          pin->Pin(pinned);
+          pin->RegisterCleanup(&DeleteIterator, block, NULL);
+        } else {
+          delete block;
+        }
+      }
       if (!s.ok()) {
         return s;
       }
@@ -419,6 +442,141 @@ Status Version::Get(const ReadOptions& options,
   return Status::NotFound(Slice());  // Use an empty error message for speed
 }
 
+namespace {
+struct MultiSaver {
+  const Comparator* ucmp;
+  LookupRequest* const* requests;
+  SaverState* states;
+};
+}
+static void SaveMultiValue(void* arg, int i, const Slice& ikey, const Slice& v) {
+  MultiSaver* m = reinterpret_cast<MultiSaver*>(arg);
+  Saver saver;
+  saver.state = kNotFound;
+  saver.ucmp = m->ucmp;
+  saver.user_key = m->requests[i]->key->user_key();
+  saver.value = m->requests[i]->value;
+  saver.pinned = NULL;
+  SaveValue(&saver, ikey, v);
+  m->states[i] = saver.state;
+}
+
+// Looks up the requests in *batch, all overlapping file f, and settles
+// those found in it.
+static void MultiGetFromFile(TableCache* table_cache, const ReadOptions& options,
+                             const Comparator* ucmp, FileMetaData* f,
+                             const std::vector<LookupRequest*>& batch) {
+  const int n = static_cast<int>(batch.size());
+  std::vector<Slice> keys(n);
+  std::vector<SaverState> states(n, kNotFound);
+  for (int i = 0; i < n; i++) {
+    keys[i] = batch[i]->key->internal_key();
+  }
+  MultiSaver saver;
+  saver.ucmp = ucmp;
+  saver.requests = &batch[0];
+  saver.states = &states[0];
+  Status s = table_cache->MultiGet(options, f->number, f->file_size,
+                                   &keys[0], n, &saver, SaveMultiValue);
+  for (int i = 0; i < n; i++) {
+    LookupRequest* r = batch[i];
+    if (!s.ok()) {
+      *r->status = s;
+      r->done = true;
+      continue;
+    }
+    switch (states[i]) {
+      case kNotFound:
+        break;      // Keep searching in other files
+      case kFound:
+        *r->status = Status::OK();
+        r->done = true;
+        break;
+      case kDeleted:
+        *r->status = Status::NotFound(Slice());
+        r->done = true;
+        break;
+      case kCorrupt:
+        *r->status = Status::Corruption("corrupted key for ", r->key->user_key());
+        r->done = true;
+        break;
+    }
+  }
+}
+
+void Version::MultiGet(const ReadOptions& options,
+                       LookupRequest* requests, int n) {
+  const Comparator* ucmp = vset_->icmp_.user_comparator();
+  std::vector<LookupRequest*> batch;
+  batch.reserve(n);
+
+  for (int level = 0; level < config::kNumLevels; level++) {
+    const std::vector<FileMetaData*>& files = files_[level];
+    if (files.empty()) continue;
+
+    if (level == 0) {
+      // Level-0 files may overlap each other, settle the keys file by
+      // file from the newest to the oldest.
+      std::vector<FileMetaData*> tmp(files.begin(), files.end());
+      std::sort(tmp.begin(), tmp.end(), NewestFirst);
+      for (size_t j = 0; j < tmp.size(); j++) {
+        FileMetaData* f = tmp[j];
+        batch.clear();
+        for (int i = 0; i < n; i++) {
+          LookupRequest* r = &requests[i];
+          Slice user_key = r->key->user_key();
+          if (!r->done &&
+              ucmp->Compare(user_key, f->smallest.user_key()) >= 0 &&
+              ucmp->Compare(user_key, f->largest.user_key()) <= 0) {
+            batch.push_back(r);
+          }
+        }
+        if (!batch.empty()) {
+          MultiGetFromFile(vset_->table_cache_, options, ucmp, f, batch);
+        }
+      }
+      continue;
+    }
+
+    // Files of the other levels are disjoint and sorted, so the sorted
+    // keys visit them in one forward pass.
+    size_t index = 0;
+    FileMetaData* batch_file = NULL;
+    batch.clear();
+    for (int i = 0; i < n && index < files.size(); i++) {
+      LookupRequest* r = &requests[i];
+      if (r->done) continue;
+      Slice ikey = r->key->internal_key();
+      while (index < files.size() &&
+             vset_->icmp_.Compare(files[index]->largest.Encode(), ikey) < 0) {
+        index++;
+      }
+      if (index >= files.size()) break;
+      FileMetaData* f = files[index];
+      if (ucmp->Compare(r->key->user_key(), f->smallest.user_key()) < 0) {
+        // All of "f" is past any data for the key
+        continue;
+      }
+      if (f != batch_file && !batch.empty()) {
+        MultiGetFromFile(vset_->table_cache_, options, ucmp, batch_file, batch);
+        batch.clear();
+      }
+      batch_file = f;
+      batch.push_back(r);
+    }
+    if (!batch.empty()) {
+      MultiGetFromFile(vset_->table_cache_, options, ucmp, batch_file, batch);
+    }
+  }
+
+  for (int i = 0; i < n; i++) {
+    if (!requests[i].done) {
+      *requests[i].status = Status::NotFound(Slice());
+      requests[i].done = true;
+    }
+  }
+}
+
 bool Version::UpdateStats(const GetStats& stats) {
   FileMetaData* f = stats.seek_file;
   if (f != NULL) {
@@ -1014,6 +1172,66 @@ void VersionSet::MarkFileNumberUsed(uint64_t number) {
   }
 }
 
+static const uint64_t kNever = ~static_cast<uint64_t>(0);
+
+// Share of "count" entries due between "first" and "last" that are due
+// by "now", taking them as evenly spread.
+static double DueEntries(uint64_t count, uint64_t first, uint64_t last,
+                         uint64_t now) {
+  if (count == 0 || now < first) {
+    return 0;
+  } else if (now >= last) {
+    return count;
+  } else {
+    return count * (static_cast<double>(now - first) / (last - first));
+  }
+}
+
+// Estimated number of entries of "f" that a compaction at "micros"
+// drops as expired or as delayed deletions.
+static double DroppableEntries(const FileMetaData* f, uint64_t micros) {
+  return DueEntries(f->num_expiring, f->min_expiration, f->max_expiration,
+                    micros / 1000) +
+         DueEntries(f->num_latered, f->min_latered, f->max_latered, micros);
+}
+
+// Time, in microseconds, from which a compaction drops at least "ratio"
+// of the entries of "f", or kNever.
+static uint64_t ExpirationDueMicros(const FileMetaData* f, double ratio) {
+  if (f->num_entries == 0 ||
+      (f->num_expiring == 0 && f->num_latered == 0)) {
+    return kNever;
+  }
+  const double wanted = ratio * f->num_entries;
+  uint64_t lo = kNever;
+  uint64_t hi = 0;
+  if (f->num_expiring > 0) {
+    lo = f->min_expiration * 1000;
+    hi = f->max_expiration * 1000;
+  }
+  if (f->num_latered > 0) {
+    lo = std::min(lo, f->min_latered);
+    hi = std::max(hi, f->max_latered);
+  }
+  if (DroppableEntries(f, hi) < wanted) {
+    return kNever;
+  }
+  while (lo < hi) {
+    const uint64_t mid = lo + (hi - lo) / 2;
+    if (DroppableEntries(f, mid) >= wanted) {
+      hi = mid;
+    } else {
+      lo = mid + 1;
+    }
+  }
+  return lo;
+}
+
+bool VersionSet::ExpirationDue(const Version* v) const {
+  return v->file_to_expire_ != NULL &&
+         env_->NowMicros() >= v->expire_micros_;
+}
+
 void VersionSet::Finalize(Version* v) {
   // Precomputed best level for next compaction
   int best_level = -1;
@@ -1049,6 +1267,23 @@ void VersionSet::Finalize(Version* v) {
 
   v->compaction_level_ = best_level;
   v->compaction_score_ = best_score;
+
+  // Files in the last level have no level to be compacted into
+  if (options_->expired_compaction_ratio > 0) {
+    for (int level = 0; level < config::kNumLevels-1; level++) {
+      for (size_t i = 0; i < v->files_[level].size(); i++) {
+        FileMetaData* f = v->files_[level][i];
+        const uint64_t due =
+            ExpirationDueMicros(f, options_->expired_compaction_ratio);
+        if (due != kNever &&
+            (v->file_to_expire_ == NULL || due < v->expire_micros_)) {
+          v->file_to_expire_ = f;
+          v->file_to_expire_level_ = level;
+          v->expire_micros_ = due;
+        }
+      }
+    }
+  }
 }
 
 Status VersionSet::WriteSnapshot(log::Writer* log) {
@@ -1072,7 +1307,7 @@ Status VersionSet::WriteSnapshot(log::Writer* log) {
     const std::vector<FileMetaData*>& files = current_->files_[level];
     for (size_t i = 0; i < files.size(); i++) {
       const FileMetaData* f = files[i];
-      edit.AddFile(level, f->number, f->file_size, f->smallest, f->largest);
+      edit.AddFile(level, *f);
     }
   }
 
@@ -1271,6 +1506,11 @@ Compaction* VersionSet::PickCompaction() {
     level = current_->file_to_compact_level_;
     c = new Compaction(level);
     c->inputs_[0].push_back(current_->file_to_compact_);
+  } else if (ExpirationDue(current_)) {
+    level = current_->file_to_expire_level_;
+    c = new Compaction(level);
+    c->for_expiration_ = true;
+    c->inputs_[0].push_back(current_->file_to_expire_);
   } else {
     return NULL;
   }
@@ -1398,6 +1638,7 @@ Compaction* VersionSet::CompactRange(
 
 Compaction::Compaction(int level)
     : level_(level),
+      for_expiration_(false),
       max_output_file_size_(MaxFileSizeForLevel(level)),
       input_version_(NULL),
       grandparent_index_(0),
@@ -1417,8 +1658,10 @@ Compaction::~Compaction() {
 bool Compaction::IsTrivialMove() const {
   // Avoid a move if there is lots of overlapping grandparent data.
   // Otherwise, the move could create a parent file that will require
-  // a very expensive merge later on.
-  return (num_input_files(0) == 1 &&
+  // a very expensive merge later on.  A file picked for its expired
+  // entries has to be rewritten to drop them.
+  return (!for_expiration_ &&
+          num_input_files(0) == 1 &&
           num_input_files(1) == 0 &&
           TotalFileSize(grandparents_) <= kMaxGrandParentOverlapBytes);
 }
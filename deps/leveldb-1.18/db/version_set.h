@@ -30,6 +30,7 @@ namespace log { class Writer; }
 class Compaction;
 class Iterator;
 class MemTable;
+class PinnedValue;
 class TableBuilder;
 class TableCache;
 class Version;
@@ -70,8 +71,16 @@ class Version {
     FileMetaData* seek_file;
     int seek_file_level;
   };
+  // If pin is non-NULL the value is pinned in *pin instead of being
+  // copied to *val, see PinnedValue.
   Status Get(const ReadOptions&, const LookupKey& key, std::string* val,
-             GetStats* stats);
+             GetStats* stats, PinnedValue* pin = NULL);
+
+  // Get() for each of the n requests that are not done yet.  The keys
+  // falling into one file are looked up together, see
+  // Table::InternalMultiGet().  Seek stats are not charged.
+  // REQUIRES: lock is not held, requests are sorted by user key
+  void MultiGet(const ReadOptions&, LookupRequest* requests, int n);
 
   // Adds "stats" into the current state.  Returns true if a new
   // compaction may need to be triggered, false otherwise.
@@ -147,12 +156,21 @@ class Version {
   double compaction_score_;
   int compaction_level_;
 
+  // File a compaction would drop the most expired entries from soonest
+  // and when enough of them will have expired.  Also set by Finalize().
+  FileMetaData* file_to_expire_;
+  int file_to_expire_level_;
+  uint64_t expire_micros_;
+
   explicit Version(VersionSet* vset)
       : vset_(vset), next_(this), prev_(this), refs_(0),
         file_to_compact_(NULL),
         file_to_compact_level_(-1),
         compaction_score_(-1),
-        compaction_level_(-1) {
+        compaction_level_(-1),
+        file_to_expire_(NULL),
+        file_to_expire_level_(-1),
+        expire_micros_(0) {
   }
 
   ~Version();
@@ -250,7 +268,14 @@ class VersionSet {
   // Returns true iff some level needs a compaction.
   bool NeedsCompaction() const {
     Version* v = current_;
-    return (v->compaction_score_ >= 1) || (v->file_to_compact_ != NULL);
+    return (v->compaction_score_ >= 1) || (v->file_to_compact_ != NULL) ||
+           ExpirationDue(v);
+  }
+
+  // Time at which enough entries of a table of the current version will
+  // have expired for it to be compacted, 0 if there is no such table.
+  uint64_t ExpirationMicros() const {
+    return current_->file_to_expire_ != NULL ? current_->expire_micros_ : 0;
   }
 
   // Add all files listed in any live version to *live.
@@ -276,6 +301,9 @@ class VersionSet {
 
   void Finalize(Version* v);
 
+  // Returns true iff enough of v->file_to_expire_ has expired by now.
+  bool ExpirationDue(const Version* v) const;
+
   void GetRange(const std::vector<FileMetaData*>& inputs,
                 InternalKey* smallest,
                 InternalKey* largest);
@@ -367,6 +395,7 @@ class Compaction {
   explicit Compaction(int level);
 
   int level_;
+  bool for_expiration_;         // Picked to drop expired entries
   uint64_t max_output_file_size_;
   Version* input_version_;
   VersionEdit edit_;
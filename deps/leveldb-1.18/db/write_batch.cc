@@ -8,7 +8,16 @@
 //    data: record[count]
 // record :=
 //    kTypeValue varstring varstring         |
-//    kTypeDeletion varstring
+//    kTagValueWithMeta meta varstring varstring |
+//    kTypeDeletion varstring                |
+//    kTypeTouch varstring                   |
+//    kTagMerge meta varstring operand       |
+//    kTagMergeDropZero meta varstring operand
+// meta :=
+//    versioncare: varint32
+//    lastversion, nextversion, expiration: varint64
+// operand :=
+//    delta, initial: fixed64
 // varstring :=
 //    len: varint32
 //    data: uint8[len]
@@ -26,6 +35,26 @@ namespace leveldb {
 // WriteBatch header has an 8-byte sequence number followed by a 4-byte count.
 static const size_t kHeader = 12;
 
+// Record tag of PutWithMeta(), never stored in an internal key
+static const char kTagValueWithMeta = 0x10;
+
+// Record tag of Merge(), the internal key says kTypeValue
+static const char kTagMerge = 0x11;
+
+// Record tag of Merge() for a counter dropped at 0
+static const char kTagMergeDropZero = 0x31;
+
+static const size_t kMergeOperandSize = 8 + 8;
+
+static const size_t kMetaPrefixSize = 4 + 8 + 8 + 8;
+
+static bool GetKeyMeta(Slice* input, KeyMeta* meta) {
+  return GetVarint32(input, &meta->versioncare) &&
+         GetVarint64(input, &meta->lastversion) &&
+         GetVarint64(input, &meta->nextversion) &&
+         GetVarint64(input, &meta->expiration);
+}
+
 WriteBatch::WriteBatch() {
   Clear();
 }
@@ -34,6 +63,23 @@ WriteBatch::~WriteBatch() { }
 
 WriteBatch::Handler::~Handler() { }
 
+void WriteBatch::Handler::PutWithMeta(const KeyMeta& meta, const Slice& key,
+                                      const Slice& value) {
+  std::string prefixed;
+  prefixed.reserve(kMetaPrefixSize + key.size());
+  PutFixed32(&prefixed, meta.versioncare);
+  PutFixed64(&prefixed, meta.lastversion);
+  PutFixed64(&prefixed, meta.nextversion);
+  PutFixed64(&prefixed, meta.expiration);
+  prefixed.append(key.data(), key.size());
+  Put(prefixed, value);
+}
+
+void WriteBatch::Handler::Touch(const Slice& key) { }
+
+void WriteBatch::Handler::Merge(const KeyMeta& meta, const Slice& key,
+                                const Slice& operand, bool drop_zero) { }
+
 void WriteBatch::Clear() {
   rep_.clear();
   rep_.resize(kHeader);
@@ -47,6 +93,7 @@ Status WriteBatch::Iterate(Handler* handler) const {
 
   input.remove_prefix(kHeader);
   Slice key, value;
+  KeyMeta meta;
   int found = 0;
   while (!input.empty()) {
     found++;
@@ -61,6 +108,15 @@ Status WriteBatch::Iterate(Handler* handler) const {
           return Status::Corruption("bad WriteBatch Put");
         }
         break;
+      case kTagValueWithMeta:
+        if (GetKeyMeta(&input, &meta) &&
+            GetLengthPrefixedSlice(&input, &key) &&
+            GetLengthPrefixedSlice(&input, &value)) {
+          handler->PutWithMeta(meta, key, value);
+        } else {
+          return Status::Corruption("bad WriteBatch PutWithMeta");
+        }
+        break;
       case kTypeDeletion:
         if (GetLengthPrefixedSlice(&input, &key)) {
           handler->Delete(key);
@@ -68,6 +124,25 @@ Status WriteBatch::Iterate(Handler* handler) const {
           return Status::Corruption("bad WriteBatch Delete");
         }
         break;
+      case kTypeTouch:
+        if (GetLengthPrefixedSlice(&input, &key)) {
+          handler->Touch(key);
+        } else {
+          return Status::Corruption("bad WriteBatch Touch");
+        }
+        break;
+      case kTagMerge:
+      case kTagMergeDropZero:
+        if (GetKeyMeta(&input, &meta) &&
+            GetLengthPrefixedSlice(&input, &key) &&
+            input.size() >= kMergeOperandSize) {
+          handler->Merge(meta, key, Slice(input.data(), kMergeOperandSize),
+                         tag == kTagMergeDropZero);
+          input.remove_prefix(kMergeOperandSize);
+        } else {
+          return Status::Corruption("bad WriteBatch Merge");
+        }
+        break;
       default:
         return Status::Corruption("unknown WriteBatch tag");
     }
@@ -102,12 +177,43 @@ void WriteBatch::Put(const Slice& key, const Slice& value) {
   PutLengthPrefixedSlice(&rep_, value);
 }
 
+void WriteBatch::PutWithMeta(const KeyMeta& meta, const Slice& key,
+                             const Slice& value) {
+  WriteBatchInternal::SetCount(this, WriteBatchInternal::Count(this) + 1);
+  rep_.push_back(kTagValueWithMeta);
+  PutVarint32(&rep_, meta.versioncare);
+  PutVarint64(&rep_, meta.lastversion);
+  PutVarint64(&rep_, meta.nextversion);
+  PutVarint64(&rep_, meta.expiration);
+  PutLengthPrefixedSlice(&rep_, key);
+  PutLengthPrefixedSlice(&rep_, value);
+}
+
 void WriteBatch::Delete(const Slice& key) {
   WriteBatchInternal::SetCount(this, WriteBatchInternal::Count(this) + 1);
   rep_.push_back(static_cast<char>(kTypeDeletion));
   PutLengthPrefixedSlice(&rep_, key);
 }
 
+void WriteBatch::Touch(const Slice& key) {
+  WriteBatchInternal::SetCount(this, WriteBatchInternal::Count(this) + 1);
+  rep_.push_back(static_cast<char>(kTypeTouch));
+  PutLengthPrefixedSlice(&rep_, key);
+}
+
+void WriteBatch::Merge(const KeyMeta& meta, const Slice& key,
+                       int64_t delta, int64_t initial, bool drop_zero) {
+  WriteBatchInternal::SetCount(this, WriteBatchInternal::Count(this) + 1);
+  rep_.push_back(drop_zero ? kTagMergeDropZero : kTagMerge);
+  PutVarint32(&rep_, meta.versioncare);
+  PutVarint64(&rep_, meta.lastversion);
+  PutVarint64(&rep_, meta.nextversion);
+  PutVarint64(&rep_, meta.expiration);
+  PutLengthPrefixedSlice(&rep_, key);
+  PutFixed64(&rep_, static_cast<uint64_t>(delta));
+  PutFixed64(&rep_, static_cast<uint64_t>(initial));
+}
+
 namespace {
 class MemTableInserter : public WriteBatch::Handler {
  public:
@@ -118,10 +224,26 @@ class MemTableInserter : public WriteBatch::Handler {
     mem_->Add(sequence_, kTypeValue, key, value);
     sequence_++;
   }
+  virtual void PutWithMeta(const KeyMeta& meta, const Slice& key,
+                           const Slice& value) {
+    mem_->Add(sequence_, kTypeValue, meta, key, value);
+    sequence_++;
+  }
   virtual void Delete(const Slice& key) {
     mem_->Add(sequence_, kTypeDeletion, key, Slice());
     sequence_++;
   }
+  virtual void Touch(const Slice& key) {
+    mem_->Add(sequence_, ValueType(kTypeValue | kTypeTouch), key, Slice());
+    sequence_++;
+  }
+  virtual void Merge(const KeyMeta& meta, const Slice& key,
+                     const Slice& operand, bool drop_zero) {
+    int type = kTypeValue | kTypeMerge;
+    if (drop_zero) type |= kTypeDropZero;
+    mem_->Add(sequence_, ValueType(type), meta, key, operand);
+    sequence_++;
+  }
 };
 }  // namespace
 
@@ -59,7 +59,9 @@ typedef struct leveldb_filterpolicy_t  leveldb_filterpolicy_t;
 typedef struct leveldb_iterator_t      leveldb_iterator_t;
 typedef struct leveldb_logger_t        leveldb_logger_t;
 typedef struct leveldb_options_t       leveldb_options_t;
+typedef struct leveldb_pinned_t        leveldb_pinned_t;
 typedef struct leveldb_randomfile_t    leveldb_randomfile_t;
+typedef struct leveldb_ratelimiter_t   leveldb_ratelimiter_t;
 typedef struct leveldb_readoptions_t   leveldb_readoptions_t;
 typedef struct leveldb_seqfile_t       leveldb_seqfile_t;
 typedef struct leveldb_snapshot_t      leveldb_snapshot_t;
@@ -101,11 +103,28 @@ extern void leveldb_put(
     const char* val, size_t vallen,
     char** errptr);
 
+/* leveldb_put() for a key without the meta prefix, the meta fields are
+   passed apart instead. */
+extern void leveldb_put_with_meta(
+    leveldb_t* db,
+    const leveldb_writeoptions_t* options,
+    uint32_t versioncare, uint64_t lastversion,
+    uint64_t nextversion, uint64_t expiration,
+    const char* key, size_t keylen,
+    const char* val, size_t vallen,
+    char** errptr);
+
 extern void leveldb_put_meta(
     leveldb_t* db,
     const char* key, size_t keylen,
     char** errptr);
 
+extern void leveldb_put_meta_version(
+    leveldb_t* db,
+    const char* key, size_t keylen,
+    uint64_t version,
+    char** errptr);
+
 extern void leveldb_delete(
     leveldb_t* db,
     const leveldb_writeoptions_t* options,
@@ -131,6 +150,41 @@ extern char* leveldb_get(
     size_t* vallen,
     char** errptr);
 
+/* Looks up num_keys keys at once.  values[i] is a malloc()ed copy of the
+   value of keys[i] with its length in vallens[i], or NULL if keys[i] is
+   absent.  The first error, if any, is stored in *errptr. */
+extern void leveldb_multi_get(
+    leveldb_t* db,
+    const leveldb_readoptions_t* options,
+    size_t num_keys,
+    const char* const* keys, const size_t* keylens,
+    char** values, size_t* vallens,
+    char** errptr);
+
+/* Like leveldb_get() but without copying the value: *val points into
+   the DB and stays valid until the returned handle is passed to
+   leveldb_pinned_release().  Returns NULL if the key is not found or on
+   error, the handle must be released before the DB is closed. */
+extern leveldb_pinned_t* leveldb_get_pinned(
+    leveldb_t* db,
+    const leveldb_readoptions_t* options,
+    const char* key, size_t keylen,
+    const char** val, size_t* vallen,
+    char** errptr);
+
+extern void leveldb_pinned_release(leveldb_pinned_t* pinned);
+
+/* Returns 1 if key exists and 0 if not found or on error, without
+   copying the value out: only its first *headerlen bytes (or all of it
+   if shorter) are copied into header, and *headerlen is set to the
+   number of bytes copied. */
+extern unsigned char leveldb_exists(
+    leveldb_t* db,
+    const leveldb_readoptions_t* options,
+    const char* key, size_t keylen,
+    char* header, size_t* headerlen,
+    char** errptr);
+
 extern leveldb_iterator_t* leveldb_create_iterator(
     leveldb_t* db,
     const leveldb_readoptions_t* options);
@@ -145,6 +199,10 @@ extern void leveldb_release_snapshot(
     leveldb_t* db,
     const leveldb_snapshot_t* snapshot);
 
+/* Sequence number of the most recent write, iterators created since it
+   last changed are up to date. */
+extern uint64_t leveldb_latest_sequence(leveldb_t* db);
+
 /* Returns NULL if property name is unknown.
    Else returns a pointer to a malloc()-ed null-terminated value. */
 extern char* leveldb_property_value(
@@ -197,9 +255,37 @@ extern void leveldb_writebatch_put(
     leveldb_writebatch_t*,
     const char* key, size_t klen,
     const char* val, size_t vlen);
+extern void leveldb_writebatch_put_with_meta(
+    leveldb_writebatch_t*,
+    uint32_t versioncare, uint64_t lastversion,
+    uint64_t nextversion, uint64_t expiration,
+    const char* key, size_t klen,
+    const char* val, size_t vlen);
 extern void leveldb_writebatch_delete(
     leveldb_writebatch_t*,
     const char* key, size_t klen);
+/* Sets the version and expiration of the value of key to those in the
+   meta prefix of key, without rewriting the value. */
+extern void leveldb_writebatch_touch(
+    leveldb_writebatch_t*,
+    const char* key, size_t klen);
+/* Adds delta to the 8 byte counter of key, which starts from initial if
+   there is none, without reading it.  key comes without the meta
+   prefix, see leveldb_writebatch_put_with_meta().  With drop_zero,
+   compactions remove the counter once it is 0. */
+extern void leveldb_writebatch_merge(
+    leveldb_writebatch_t*,
+    uint32_t versioncare, uint64_t lastversion,
+    uint64_t nextversion, uint64_t expiration,
+    const char* key, size_t klen,
+    int64_t delta, int64_t initial,
+    unsigned char drop_zero);
+/* Appends the records of src to dst, so that both go in one write. */
+extern void leveldb_writebatch_append(
+    leveldb_writebatch_t* dst,
+    const leveldb_writebatch_t* src);
+/* Bytes taken by the records of the batch. */
+extern size_t leveldb_writebatch_size(const leveldb_writebatch_t*);
 extern void leveldb_writebatch_iterate(
     leveldb_writebatch_t*,
     void* state,
@@ -230,6 +316,16 @@ extern void leveldb_options_set_cache(leveldb_options_t*, leveldb_cache_t*);
 extern void leveldb_options_set_block_size(leveldb_options_t*, size_t);
 extern void leveldb_options_set_block_restart_interval(leveldb_options_t*, int);
 extern void leveldb_options_set_compaction_speed(leveldb_options_t*, int);
+extern void leveldb_options_set_rate_limiter(leveldb_options_t*,
+                                             leveldb_ratelimiter_t*);
+extern void leveldb_options_set_met_table_capacity(leveldb_options_t*, size_t);
+extern void leveldb_options_set_met_table_checkpoint(
+    leveldb_options_t*, unsigned char);
+extern void leveldb_options_set_row_cache_size(leveldb_options_t*, size_t);
+extern void leveldb_options_set_row_cache_max_value_size(
+    leveldb_options_t*, size_t);
+extern void leveldb_options_set_expired_compaction_ratio(
+    leveldb_options_t*, double);
 
 enum {
   leveldb_no_compression = 0,
@@ -292,8 +388,22 @@ extern void leveldb_writeoptions_set_sync(
 /* Cache */
 
 extern leveldb_cache_t* leveldb_cache_create_lru(size_t capacity);
+extern leveldb_cache_t* leveldb_cache_create_clock(size_t capacity,
+                                                   int num_shard_bits);
 extern void leveldb_cache_destroy(leveldb_cache_t* cache);
 
+/* Rate limiter */
+
+extern leveldb_ratelimiter_t* leveldb_ratelimiter_create(
+    uint64_t bytes_per_second);
+extern leveldb_ratelimiter_t* leveldb_ratelimiter_create_adaptive(
+    uint64_t bytes_per_second, uint64_t write_micros_target);
+extern void leveldb_ratelimiter_set_bytes_per_second(
+    leveldb_ratelimiter_t*, uint64_t bytes_per_second);
+extern uint64_t leveldb_ratelimiter_get_bytes_per_second(
+    leveldb_ratelimiter_t*);
+extern void leveldb_ratelimiter_destroy(leveldb_ratelimiter_t*);
+
 /* Env */
 
 extern leveldb_env_t* leveldb_create_default_env();
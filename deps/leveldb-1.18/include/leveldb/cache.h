@@ -29,6 +29,13 @@ class Cache;
 // of Cache uses a least-recently-used eviction policy.
 extern Cache* NewLRUCache(size_t capacity);
 
+// Create a new cache with a fixed size capacity, split into
+// 2^num_shard_bits shards.  Entries are evicted by the CLOCK policy:
+// Lookup() only marks an entry as used, so lookups of a shard share a
+// reader lock and only Insert() and Erase() exclude each other.  Suited
+// to many threads reading a cache that rarely changes.
+extern Cache* NewClockCache(size_t capacity, int num_shard_bits);
+
 class Cache {
  public:
   Cache() { }
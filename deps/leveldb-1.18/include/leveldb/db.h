@@ -19,6 +19,7 @@ static const int kMinorVersion = 18;
 struct Options;
 struct ReadOptions;
 struct WriteOptions;
+struct KeyMeta;
 class WriteBatch;
 
 // Abstract handle to particular state of a DB.
@@ -38,6 +39,45 @@ struct Range {
   Range(const Slice& s, const Slice& l) : start(s), limit(l) { }
 };
 
+// The value of a key read in place by DB::GetPinned().  value() points
+// into a memtable or a data block that stays pinned until the
+// PinnedValue is Reset() or destroyed.  A PinnedValue must be released
+// before the DB it was read from is deleted.
+class PinnedValue {
+ public:
+  PinnedValue();
+  ~PinnedValue();
+
+  const Slice& value() const { return value_; }
+
+  // Unpin the value, the PinnedValue may be reused afterwards.
+  void Reset();
+
+  // For implementations of DB::GetPinned().  Pin() points value() at
+  // memory kept alive by the cleanups registered with RegisterCleanup(),
+  // PinSelf() copies the value instead.
+  typedef void (*CleanupFunction)(void* arg1, void* arg2);
+  void RegisterCleanup(CleanupFunction function, void* arg1, void* arg2);
+  void Pin(const Slice& value) { value_ = value; }
+  void PinSelf(const Slice& value);
+  std::string* GetSelf() { return &buf_; }
+
+ private:
+  struct Cleanup {
+    CleanupFunction function;
+    void* arg1;
+    void* arg2;
+    Cleanup* next;
+  };
+  Slice value_;
+  std::string buf_;
+  Cleanup* cleanup_;
+
+  // No copying allowed
+  PinnedValue(const PinnedValue&);
+  void operator=(const PinnedValue&);
+};
+
 // A DB is a persistent ordered map from keys to values.
 // A DB is safe for concurrent access from multiple threads without
 // any external synchronization.
@@ -62,6 +102,14 @@ class DB {
                      const Slice& key,
                      const Slice& value) = 0;
 
+  // Put() for a key without the meta prefix, see
+  // WriteBatch::PutWithMeta().  The default implementation writes a
+  // batch of one.
+  virtual Status PutWithMeta(const WriteOptions& options,
+                             const KeyMeta& meta,
+                             const Slice& key,
+                             const Slice& value);
+
   virtual Status PutMeta(const Slice& key) = 0;
 
   // Remove the database entry (if any) for "key".  Returns OK on
@@ -76,6 +124,11 @@ class DB {
   virtual Status Write(const WriteOptions& options, WriteBatch* updates) = 0;
 
   virtual Status WriteMeta(const Slice& key) = 0;
+
+  // Record "version" as the newest version of the user key "key" in the
+  // index of key versions, without writing anything.  Meant for
+  // rebuilding the index, may be called from several threads at once.
+  virtual Status PutMetaVersion(const Slice& key, uint64_t version) = 0;
   virtual void WriteRecovering(const WriteOptions& options) = 0;
 
   // If the database contains an entry for "key" store the
@@ -88,6 +141,18 @@ class DB {
   virtual Status Get(const ReadOptions& options,
                      const Slice& key, std::string* value) = 0;
 
+  // Get() for keys[0,n-1], leaving the outcome for keys[i] in values[i]
+  // and statuses[i].  All keys are read from the same state of the
+  // database.  The default implementation calls Get() for each key.
+  virtual void MultiGet(const ReadOptions& options, int n,
+                        const Slice* keys, std::string* values,
+                        Status* statuses);
+
+  // Get() without copying the value out, see PinnedValue.  The default
+  // implementation copies the value into *value.
+  virtual Status GetPinned(const ReadOptions& options,
+                           const Slice& key, PinnedValue* value);
+
   // Return a heap-allocated iterator over the contents of the database.
   // The result of NewIterator() is initially invalid (caller must
   // call one of the Seek methods on the iterator before using it).
@@ -107,6 +172,10 @@ class DB {
   // use "snapshot" after this call.
   virtual void ReleaseSnapshot(const Snapshot* snapshot) = 0;
 
+  // Sequence number of the most recent write.  An iterator created when
+  // this returned n has seen every write as long as it still returns n.
+  virtual uint64_t GetLatestSequenceNumber() = 0;
+
   // DB implementations can export properties about their state
   // via this method.  If "property" is a valid property understood by this
   // DB implementation, fills "*value" with its current value and returns
@@ -121,6 +190,8 @@ class DB {
   //     about the internal operation of the DB.
   //  "leveldb.sstables" - returns a multi-line string that describes all
   //     of the sstables that make up the db contents.
+  //  "leveldb.met-checkpoint-loaded" - "1" if Open() restored the index of
+  //     key versions from its checkpoint, "0" otherwise.
   virtual bool GetProperty(const Slice& property, std::string* value) = 0;
 
   // For each i in [0,n-1], store in "sizes[i]", the approximate
@@ -14,6 +14,7 @@ class Comparator;
 class Env;
 class FilterPolicy;
 class Logger;
+class RateLimiter;
 class Snapshot;
 
 // DB contents are stored in a set of blocks, each of which holds a
@@ -34,7 +35,16 @@ struct Options {
   // Limit compaction IO speed to this, in MB
   // Default: 0(not limited)
   // Added by me@ideawu.com
+  //
+  // Only used when rate_limiter is NULL, in which case flushes and
+  // compactions share a limiter of this many MB per second.
   int compaction_speed;
+
+  // If non-NULL, flushes and compactions write their tables no faster
+  // than this limiter lets them.  Its rate may be changed while the
+  // database is open.
+  // Default: NULL
+  RateLimiter* rate_limiter;
   // -------------------
   // Parameters that affect behavior
 
@@ -141,6 +151,45 @@ struct Options {
   // Default: NULL
   const FilterPolicy* filter_policy;
 
+  // Upper bound, in bytes, on the memory used by the in-memory index of
+  // key versions.  Once reached, cold keys are dropped from the index and
+  // their version is read back from the value header on the next write.
+  // 0 keeps every key in memory.
+  //
+  // Default: 0
+  size_t met_table_capacity;
+
+  // If true, the in-memory index of key versions is saved to a
+  // checkpoint file after every memtable compaction, and Open() loads
+  // it instead of leaving the index to be rebuilt from a full scan.
+  // Only the log written since the checkpoint then needs to be
+  // replayed, see the "leveldb.met-checkpoint-loaded" property.
+  //
+  // Default: false
+  bool met_table_checkpoint;
+
+  // If non-zero, up to this many bytes of recently read small values are
+  // kept in a cache keyed by user key, and reads without a snapshot that
+  // hit it take a single hash probe.  Every write of a key drops its
+  // entry.
+  //
+  // Default: 0
+  size_t row_cache_size;
+
+  // Values longer than this, value header included, are not kept in the
+  // row cache.
+  //
+  // Default: 128
+  size_t row_cache_max_value_size;
+
+  // A table is compacted once this share of its entries has expired or
+  // is a deletion that has become due, even if its level does not need
+  // a compaction.  Tables in the last level are left alone.  0 disables
+  // it.
+  //
+  // Default: 0.5
+  double expired_compaction_ratio;
+
   // Create an Options object with default values for all fields.
   Options();
 };
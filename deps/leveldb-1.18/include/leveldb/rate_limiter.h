@@ -0,0 +1,56 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// A RateLimiter bounds the rate at which a database writes table files,
+// so that memtable flushes and compactions leave disk bandwidth to the
+// foreground writes.  One limiter may be shared by several databases,
+// which then share its rate.
+
+#ifndef STORAGE_LEVELDB_INCLUDE_RATE_LIMITER_H_
+#define STORAGE_LEVELDB_INCLUDE_RATE_LIMITER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace leveldb {
+
+class RateLimiter {
+ public:
+  virtual ~RateLimiter();
+
+  // Blocks until "bytes" more may be written.  Safe to call from
+  // several threads at once.
+  virtual void Request(size_t bytes) = 0;
+
+  // Change the rate.  Takes effect with the next Request().  0 lifts
+  // the limit.  For an adaptive limiter, this is the upper bound of
+  // the rates it picks.
+  virtual void SetBytesPerSecond(uint64_t bytes_per_second) = 0;
+
+  // The rate currently enforced.
+  virtual uint64_t GetBytesPerSecond() = 0;
+
+  // Called by the database after each foreground write with the time it
+  // took and whether level-0 holds more files than a compaction takes,
+  // i.e. compactions fall behind.  The default ignores it.
+  virtual void ReportWrite(uint64_t write_micros, bool level0_backlog);
+};
+
+// Return a new token bucket limiter writing "bytes_per_second" on
+// average, in bursts of up to a tenth of a second worth of bytes.
+extern RateLimiter* NewRateLimiter(uint64_t bytes_per_second);
+
+// Return a new limiter that adjusts its rate between 1/16 of
+// "bytes_per_second" and "bytes_per_second" by what ReportWrite() sees:
+// it halves the rate while more than 1% of the foreground writes take
+// longer than "write_micros_target" and raises it again once they are
+// fast.  It goes back up whenever level-0 has a backlog, as only
+// compactions drain it and a stalled level-0 slows writes down far more
+// than the disk bandwidth compactions take.
+extern RateLimiter* NewAdaptiveRateLimiter(uint64_t bytes_per_second,
+                                           uint64_t write_micros_target);
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_INCLUDE_RATE_LIMITER_H_
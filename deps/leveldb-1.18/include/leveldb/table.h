@@ -65,11 +65,23 @@ class Table {
   // Calls (*handle_result)(arg, ...) with the entry found after a call
   // to Seek(key).  May not make such a call if filter policy says
   // that key is not present.
+  // If block is non-NULL and handle_result was called, the data block
+  // iterator is handed back in *block instead of being deleted, so that
+  // the slices passed to handle_result stay valid until it is deleted.
   friend class TableCache;
   Status InternalGet(
       const ReadOptions&, const Slice& key,
       void* arg,
-      void (*handle_result)(void* arg, const Slice& k, const Slice& v));
+      void (*handle_result)(void* arg, const Slice& k, const Slice& v),
+      Iterator** block = NULL);
+
+  // InternalGet() for each of the n sorted keys, calling
+  // (*handle_result)(arg, i, ...) for the entry found for keys[i].  Keys
+  // landing in the same data block share a single read of it.
+  Status InternalMultiGet(
+      const ReadOptions&, const Slice* keys, int n,
+      void* arg,
+      void (*handle_result)(void* arg, int i, const Slice& k, const Slice& v));
 
 
   void ReadMeta(const Footer& footer);
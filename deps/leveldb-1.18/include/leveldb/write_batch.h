@@ -21,6 +21,7 @@
 #ifndef STORAGE_LEVELDB_INCLUDE_WRITE_BATCH_H_
 #define STORAGE_LEVELDB_INCLUDE_WRITE_BATCH_H_
 
+#include <stdint.h>
 #include <string>
 #include "leveldb/status.h"
 
@@ -28,6 +29,19 @@ namespace leveldb {
 
 class Slice;
 
+// Versioning and expiration of a write, which Put() takes from the 28
+// byte prefix of the key: fixed32 versioncare, then fixed64 lastversion,
+// nextversion and expiration.
+struct KeyMeta {
+  uint32_t versioncare;
+  uint64_t lastversion;
+  uint64_t nextversion;
+  uint64_t expiration;
+
+  KeyMeta()
+      : versioncare(0), lastversion(0), nextversion(0), expiration(0) { }
+};
+
 class WriteBatch {
  public:
   WriteBatch();
@@ -36,9 +50,27 @@ class WriteBatch {
   // Store the mapping "key->value" in the database.
   void Put(const Slice& key, const Slice& value);
 
+  // Put() for a key without the meta prefix.  The meta is logged apart
+  // from the key as varints.
+  void PutWithMeta(const KeyMeta& meta, const Slice& key, const Slice& value);
+
   // If the database contains a mapping for "key", erase it.  Else do nothing.
   void Delete(const Slice& key);
 
+  // Replace the version and expiration of the value of "key" by those
+  // carried in the meta prefix of "key", leaving the value itself where
+  // it is.  Compactions fold the record into the value below it.
+  void Touch(const Slice& key);
+
+  // Add "delta" to the 8 byte counter stored at "key", which comes
+  // without the meta prefix like for PutWithMeta().  The counter starts
+  // from "initial" if "key" has no counter.  Nothing is read: the record
+  // is folded into the value below it by reads and compactions.  With
+  // "drop_zero", compactions remove the counter once it is 0 with
+  // nothing below it, reads then find no counter.
+  void Merge(const KeyMeta& meta, const Slice& key,
+             int64_t delta, int64_t initial, bool drop_zero);
+
   // Clear all updates buffered in this batch.
   void Clear();
 
@@ -47,7 +79,16 @@ class WriteBatch {
    public:
     virtual ~Handler();
     virtual void Put(const Slice& key, const Slice& value) = 0;
+    // The default implementation prefixes key with meta and calls Put().
+    virtual void PutWithMeta(const KeyMeta& meta, const Slice& key,
+                             const Slice& value);
     virtual void Delete(const Slice& key) = 0;
+    // The default implementation ignores touch records.
+    virtual void Touch(const Slice& key);
+    // operand holds the fixed64 delta and initial value.  The default
+    // implementation ignores merge operands.
+    virtual void Merge(const KeyMeta& meta, const Slice& key,
+                       const Slice& operand, bool drop_zero);
   };
   Status Iterate(Handler* handler) const;
 
@@ -42,6 +42,22 @@ class Mutex {
   void AssertHeld();
 };
 
+// A RWMutex may be held by many readers or by a single writer.
+class RWMutex {
+ public:
+  RWMutex();
+  ~RWMutex();
+
+  // Lock for reading.  Waits while a writer holds the mutex.
+  void ReadLock();
+
+  // Lock for writing.  Waits until no reader or writer holds the mutex.
+  void WriteLock();
+
+  // Release the lock taken by ReadLock() or WriteLock().
+  void Unlock();
+};
+
 class CondVar {
  public:
   explicit CondVar(Mutex* mu);
@@ -53,6 +69,11 @@ class CondVar {
   // REQUIRES: this thread holds *mu
   void Wait();
 
+  // Like Wait(), but also returns once "micros" have passed.  Returns
+  // false if it timed out.
+  // REQUIRES: this thread holds *mu
+  bool TimedWait(uint64_t micros);
+
   // If there are some threads waiting, wake up at least one of them.
   void Signal();
 
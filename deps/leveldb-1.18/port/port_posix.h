@@ -97,11 +97,30 @@ class Mutex {
   void operator=(const Mutex&);
 };
 
+class RWMutex {
+ public:
+  RWMutex();
+  ~RWMutex();
+
+  void ReadLock();
+  void WriteLock();
+  void Unlock();
+
+ private:
+  pthread_rwlock_t mu_;
+
+  // No copying
+  RWMutex(const RWMutex&);
+  void operator=(const RWMutex&);
+};
+
 class CondVar {
  public:
   explicit CondVar(Mutex* mu);
   ~CondVar();
   void Wait();
+  // Returns false if "micros" passed without a signal.
+  bool TimedWait(uint64_t micros);
   void Signal();
   void SignalAll();
  private:
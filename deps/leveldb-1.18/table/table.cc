@@ -225,7 +225,8 @@ Iterator* Table::NewIterator(const ReadOptions& options) const {
 
 Status Table::InternalGet(const ReadOptions& options, const Slice& k,
                           void* arg,
-                          void (*saver)(void*, const Slice&, const Slice&)) {
+                          void (*saver)(void*, const Slice&, const Slice&),
+                          Iterator** block) {
   Status s;
   Iterator* iiter = rep_->index_block->NewIterator(rep_->options.comparator);
   iiter->Seek(k);
@@ -240,11 +241,17 @@ Status Table::InternalGet(const ReadOptions& options, const Slice& k,
     } else {
       Iterator* block_iter = BlockReader(this, options, iiter->value());
       block_iter->Seek(k);
+      bool saved = false;
       if (block_iter->Valid()) {
         (*saver)(arg, block_iter->key(), block_iter->value());
+        saved = true;
       }
       s = block_iter->status();
-      delete block_iter;
+      if (saved && block != NULL) {
+        *block = block_iter;
+      } else {
+        delete block_iter;
+      }
     }
   }
   if (s.ok()) {
@@ -254,6 +261,48 @@ Status Table::InternalGet(const ReadOptions& options, const Slice& k,
   return s;
 }
 
+Status Table::InternalMultiGet(
+    const ReadOptions& options, const Slice* keys, int n,
+    void* arg,
+    void (*saver)(void*, int, const Slice&, const Slice&)) {
+  Status s;
+  Iterator* iiter = rep_->index_block->NewIterator(rep_->options.comparator);
+  Iterator* block_iter = NULL;
+  uint64_t block_offset = 0;
+  FilterBlockReader* filter = rep_->filter;
+  for (int i = 0; i < n && s.ok(); i++) {
+    iiter->Seek(keys[i]);
+    if (!iiter->Valid()) {
+      // Every later key is past the last block too
+      break;
+    }
+    Slice handle_value = iiter->value();
+    BlockHandle handle;
+    if (!handle.DecodeFrom(&handle_value).ok()) {
+      s = Status::Corruption("bad block handle");
+      break;
+    }
+    if (filter != NULL && !filter->KeyMayMatch(handle.offset(), keys[i])) {
+      continue;
+    }
+    if (block_iter == NULL || block_offset != handle.offset()) {
+      delete block_iter;
+      block_iter = BlockReader(this, options, iiter->value());
+      block_offset = handle.offset();
+    }
+    block_iter->Seek(keys[i]);
+    if (block_iter->Valid()) {
+      (*saver)(arg, i, block_iter->key(), block_iter->value());
+    }
+    s = block_iter->status();
+  }
+  delete block_iter;
+  if (s.ok()) {
+    s = iiter->status();
+  }
+  delete iiter;
+  return s;
+}
 
 uint64_t Table::ApproximateOffsetOf(const Slice& key) const {
   Iterator* index_iter =
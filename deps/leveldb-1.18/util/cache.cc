@@ -32,6 +32,7 @@ struct LRUHandle {
   size_t key_length;
   uint32_t refs;
   uint32_t hash;      // Hash of key(); used for fast sharding and comparisons
+  bool referenced;    // Looked up since the clock hand last passed; CLOCK only
   char key_data[1];   // Beginning of key
 
   Slice key() const {
@@ -316,10 +317,221 @@ class ShardedLRUCache : public Cache {
   }
 };
 
+// A single shard of sharded CLOCK cache.
+//
+// Entries are kept in a circular list that the clock hand walks when
+// the shard is over capacity.  An entry looked up since the hand last
+// passed it gets another round, else it is evicted.  Lookups only set
+// that flag and take a reference, both of which are safe under a
+// reader lock, so concurrent lookups never wait for each other.
+class ClockCache {
+ public:
+  ClockCache();
+  ~ClockCache();
+
+  // Separate from constructor so caller can easily make an array of ClockCache
+  void SetCapacity(size_t capacity) { capacity_ = capacity; }
+
+  // Like Cache methods, but with an extra "hash" parameter.
+  Cache::Handle* Insert(const Slice& key, uint32_t hash,
+                        void* value, size_t charge,
+                        void (*deleter)(const Slice& key, void* value));
+  Cache::Handle* Lookup(const Slice& key, uint32_t hash);
+  void Release(Cache::Handle* handle);
+  void Erase(const Slice& key, uint32_t hash);
+
+ private:
+  void Remove(LRUHandle* e);
+  static void Unref(LRUHandle* e);
+
+  // Initialized before use.
+  size_t capacity_;
+
+  // Lookup() holds mutex_ for reading, everything else for writing.
+  // refs are changed atomically, as Release() does not lock at all.
+  port::RWMutex mutex_;
+  size_t usage_;
+
+  // Dummy head of the circular list, skipped by the hand.
+  LRUHandle clock_;
+  LRUHandle* hand_;
+
+  HandleTable table_;
+};
+
+ClockCache::ClockCache()
+    : usage_(0) {
+  clock_.next = &clock_;
+  clock_.prev = &clock_;
+  hand_ = &clock_;
+}
+
+ClockCache::~ClockCache() {
+  for (LRUHandle* e = clock_.next; e != &clock_; ) {
+    LRUHandle* next = e->next;
+    assert(e->refs == 1);  // Error if caller has an unreleased handle
+    Unref(e);
+    e = next;
+  }
+}
+
+void ClockCache::Unref(LRUHandle* e) {
+  assert(e->refs > 0);
+  if (__sync_sub_and_fetch(&e->refs, 1) == 0) {
+    // Already out of the table, nobody else can reach it
+    (*e->deleter)(e->key(), e->value);
+    free(e);
+  }
+}
+
+// Drops the cache's own reference to "e", which left table_.
+// REQUIRES: mutex_ held for writing
+void ClockCache::Remove(LRUHandle* e) {
+  if (hand_ == e) {
+    hand_ = e->next;
+  }
+  e->next->prev = e->prev;
+  e->prev->next = e->next;
+  usage_ -= e->charge;
+  Unref(e);
+}
+
+Cache::Handle* ClockCache::Lookup(const Slice& key, uint32_t hash) {
+  ReadLock l(&mutex_);
+  LRUHandle* e = table_.Lookup(key, hash);
+  if (e != NULL) {
+    __sync_add_and_fetch(&e->refs, 1);
+    // Other lookups may set it at the same time, only the clock hand
+    // clears it and that takes the lock exclusively
+    if (!__atomic_load_n(&e->referenced, __ATOMIC_RELAXED)) {
+      __atomic_store_n(&e->referenced, true, __ATOMIC_RELAXED);
+    }
+  }
+  return reinterpret_cast<Cache::Handle*>(e);
+}
+
+void ClockCache::Release(Cache::Handle* handle) {
+  Unref(reinterpret_cast<LRUHandle*>(handle));
+}
+
+Cache::Handle* ClockCache::Insert(
+    const Slice& key, uint32_t hash, void* value, size_t charge,
+    void (*deleter)(const Slice& key, void* value)) {
+  LRUHandle* e = reinterpret_cast<LRUHandle*>(
+      malloc(sizeof(LRUHandle)-1 + key.size()));
+  e->value = value;
+  e->deleter = deleter;
+  e->charge = charge;
+  e->key_length = key.size();
+  e->hash = hash;
+  e->refs = 2;  // One from ClockCache, one for the returned handle
+  e->referenced = false;
+  memcpy(e->key_data, key.data(), key.size());
+
+  WriteLock l(&mutex_);
+  // Just behind the hand, so a new entry is the last one it looks at
+  e->next = hand_;
+  e->prev = hand_->prev;
+  e->prev->next = e;
+  e->next->prev = e;
+  usage_ += charge;
+
+  LRUHandle* old = table_.Insert(e);
+  if (old != NULL) {
+    Remove(old);
+  }
+
+  // Every entry passed gets its flag cleared, so this ends within two
+  // turns of the hand.
+  while (usage_ > capacity_ && clock_.next != &clock_) {
+    LRUHandle* victim = hand_;
+    hand_ = victim->next;
+    if (victim == &clock_) {
+      continue;
+    }
+    if (victim->referenced) {
+      victim->referenced = false;
+    } else {
+      table_.Remove(victim->key(), victim->hash);
+      Remove(victim);
+    }
+  }
+
+  return reinterpret_cast<Cache::Handle*>(e);
+}
+
+void ClockCache::Erase(const Slice& key, uint32_t hash) {
+  WriteLock l(&mutex_);
+  LRUHandle* e = table_.Remove(key, hash);
+  if (e != NULL) {
+    Remove(e);
+  }
+}
+
+class ShardedClockCache : public Cache {
+ private:
+  const int num_shard_bits_;
+  ClockCache* shard_;
+  port::Mutex id_mutex_;
+  uint64_t last_id_;
+
+  static inline uint32_t HashSlice(const Slice& s) {
+    return Hash(s.data(), s.size(), 0);
+  }
+
+  uint32_t Shard(uint32_t hash) const {
+    return num_shard_bits_ > 0 ? hash >> (32 - num_shard_bits_) : 0;
+  }
+
+ public:
+  ShardedClockCache(size_t capacity, int num_shard_bits)
+      : num_shard_bits_(num_shard_bits),
+        last_id_(0) {
+    assert(num_shard_bits >= 0 && num_shard_bits < 20);
+    const int num_shards = 1 << num_shard_bits_;
+    shard_ = new ClockCache[num_shards];
+    const size_t per_shard = (capacity + (num_shards - 1)) / num_shards;
+    for (int s = 0; s < num_shards; s++) {
+      shard_[s].SetCapacity(per_shard);
+    }
+  }
+  virtual ~ShardedClockCache() {
+    delete[] shard_;
+  }
+  virtual Handle* Insert(const Slice& key, void* value, size_t charge,
+                         void (*deleter)(const Slice& key, void* value)) {
+    const uint32_t hash = HashSlice(key);
+    return shard_[Shard(hash)].Insert(key, hash, value, charge, deleter);
+  }
+  virtual Handle* Lookup(const Slice& key) {
+    const uint32_t hash = HashSlice(key);
+    return shard_[Shard(hash)].Lookup(key, hash);
+  }
+  virtual void Release(Handle* handle) {
+    LRUHandle* h = reinterpret_cast<LRUHandle*>(handle);
+    shard_[Shard(h->hash)].Release(handle);
+  }
+  virtual void Erase(const Slice& key) {
+    const uint32_t hash = HashSlice(key);
+    shard_[Shard(hash)].Erase(key, hash);
+  }
+  virtual void* Value(Handle* handle) {
+    return reinterpret_cast<LRUHandle*>(handle)->value;
+  }
+  virtual uint64_t NewId() {
+    MutexLock l(&id_mutex_);
+    return ++(last_id_);
+  }
+};
+
 }  // end anonymous namespace
 
 Cache* NewLRUCache(size_t capacity) {
   return new ShardedLRUCache(capacity);
 }
 
+Cache* NewClockCache(size_t capacity, int num_shard_bits) {
+  return new ShardedClockCache(capacity, num_shard_bits);
+}
+
 }  // namespace leveldb
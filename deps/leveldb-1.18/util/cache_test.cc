@@ -5,7 +5,10 @@
 #include "leveldb/cache.h"
 
 #include <vector>
+#include "leveldb/env.h"
+#include "port/port.h"
 #include "util/coding.h"
+#include "util/mutexlock.h"
 #include "util/testharness.h"
 
 namespace leveldb {
@@ -179,6 +182,130 @@ TEST(CacheTest, NewId) {
   ASSERT_NE(a, b);
 }
 
+class ClockCacheTest : public CacheTest {
+ public:
+  ClockCacheTest() {
+    delete cache_;
+    cache_ = NewClockCache(kCacheSize, 2);
+  }
+};
+
+TEST(ClockCacheTest, ClockHitAndMiss) {
+  ASSERT_EQ(-1, Lookup(100));
+  Insert(100, 101);
+  Insert(200, 201);
+  ASSERT_EQ(101, Lookup(100));
+  ASSERT_EQ(201, Lookup(200));
+  ASSERT_EQ(-1,  Lookup(300));
+
+  Insert(100, 102);
+  ASSERT_EQ(102, Lookup(100));
+  ASSERT_EQ(1, deleted_keys_.size());
+  ASSERT_EQ(100, deleted_keys_[0]);
+  ASSERT_EQ(101, deleted_values_[0]);
+
+  Erase(100);
+  ASSERT_EQ(-1,  Lookup(100));
+  ASSERT_EQ(201, Lookup(200));
+  ASSERT_EQ(2, deleted_keys_.size());
+}
+
+TEST(ClockCacheTest, ClockEntriesArePinned) {
+  Insert(100, 101);
+  Cache::Handle* h1 = cache_->Lookup(EncodeKey(100));
+  Erase(100);
+  ASSERT_EQ(-1, Lookup(100));
+  ASSERT_EQ(0, deleted_keys_.size());
+  ASSERT_EQ(101, DecodeValue(cache_->Value(h1)));
+  cache_->Release(h1);
+  ASSERT_EQ(1, deleted_keys_.size());
+}
+
+TEST(ClockCacheTest, ClockEvictionPolicy) {
+  Insert(100, 101);
+  Insert(200, 201);
+
+  // Frequently used entry must be kept around
+  for (int i = 0; i < kCacheSize + 100; i++) {
+    Insert(1000+i, 2000+i);
+    ASSERT_EQ(101, Lookup(100));
+  }
+  ASSERT_EQ(101, Lookup(100));
+  ASSERT_EQ(-1, Lookup(200));
+}
+
+TEST(ClockCacheTest, ClockHeavyEntries) {
+  const int kLight = 1;
+  const int kHeavy = 10;
+  int added = 0;
+  int index = 0;
+  while (added < 2*kCacheSize) {
+    const int weight = (index & 1) ? kLight : kHeavy;
+    Insert(index, 1000+index, weight);
+    added += weight;
+    index++;
+  }
+
+  int cached_weight = 0;
+  for (int i = 0; i < index; i++) {
+    const int weight = (i & 1 ? kLight : kHeavy);
+    int r = Lookup(i);
+    if (r >= 0) {
+      cached_weight += weight;
+      ASSERT_EQ(1000+i, r);
+    }
+  }
+  ASSERT_LE(cached_weight, kCacheSize + kCacheSize/10);
+}
+
+namespace {
+
+struct ConcurrentState {
+  Cache* cache;
+  port::Mutex mu;
+  int done;
+};
+
+void NoopDeleter(const Slice& key, void* v) { }
+
+void ConcurrentReader(void* arg) {
+  ConcurrentState* state = reinterpret_cast<ConcurrentState*>(arg);
+  for (int i = 0; i < 20000; i++) {
+    const int key = i % 300;
+    Cache::Handle* h = state->cache->Lookup(EncodeKey(key));
+    if (h != NULL) {
+      ASSERT_EQ(key + 1000, DecodeValue(state->cache->Value(h)));
+      state->cache->Release(h);
+    } else {
+      state->cache->Release(state->cache->Insert(
+          EncodeKey(key), EncodeValue(key + 1000), 1, &NoopDeleter));
+    }
+  }
+  MutexLock l(&state->mu);
+  state->done++;
+}
+
+}  // namespace
+
+TEST(ClockCacheTest, ConcurrentLookups) {
+  // Evictions and lookups racing on the same entries
+  const int kThreads = 4;
+  ConcurrentState state;
+  state.cache = NewClockCache(100, 1);
+  state.done = 0;
+  for (int i = 0; i < kThreads; i++) {
+    Env::Default()->StartThread(&ConcurrentReader, &state);
+  }
+  for (;;) {
+    {
+      MutexLock l(&state.mu);
+      if (state.done == kThreads) break;
+    }
+    Env::Default()->SleepForMicroseconds(1000);
+  }
+  delete state.cache;
+}
+
 }  // namespace leveldb
 
 int main(int argc, char** argv) {
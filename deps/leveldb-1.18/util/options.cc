@@ -12,6 +12,7 @@ namespace leveldb {
 Options::Options()
     : comparator(BytewiseComparator()),
       compaction_speed(4096),
+      rate_limiter(NULL),
       create_if_missing(false),
       error_if_exists(false),
       paranoid_checks(false),
@@ -23,7 +24,12 @@ Options::Options()
       block_size(4096),
       block_restart_interval(16),
       compression(kSnappyCompression),
-      filter_policy(NULL) {
+      filter_policy(NULL),
+      met_table_capacity(0),
+      met_table_checkpoint(false),
+      row_cache_size(0),
+      row_cache_max_value_size(128),
+      expired_compaction_ratio(0.5) {
 }
 
 
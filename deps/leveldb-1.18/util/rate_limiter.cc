@@ -0,0 +1,210 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "util/rate_limiter.h"
+
+#include "port/port.h"
+#include "util/mutexlock.h"
+
+namespace leveldb {
+
+RateLimiter::~RateLimiter() {
+}
+
+void RateLimiter::ReportWrite(uint64_t write_micros, bool level0_backlog) {
+}
+
+namespace {
+
+// Tokens are bytes.  The bucket refills at rate_ bytes per second and
+// holds up to a tenth of a second worth of them.  A request larger than
+// what the bucket holds takes the balance negative and sleeps until the
+// refill would have covered it, so later requests queue up behind it.
+class TokenBucket : public RateLimiter {
+ public:
+  explicit TokenBucket(uint64_t bytes_per_second)
+      : env_(Env::Default()),
+        rate_(bytes_per_second),
+        available_(0),
+        last_refill_(env_->NowMicros()) {
+  }
+
+  virtual void Request(size_t bytes) {
+    uint64_t wait = 0;
+    {
+      MutexLock l(&mu_);
+      if (rate_ == 0) {
+        return;
+      }
+      Refill();
+      available_ -= static_cast<int64_t>(bytes);
+      if (available_ < 0) {
+        wait = static_cast<uint64_t>(-available_) * 1000000 / rate_;
+      }
+    }
+    if (wait > 0) {
+      env_->SleepForMicroseconds(static_cast<int>(wait));
+    }
+  }
+
+  virtual void SetBytesPerSecond(uint64_t bytes_per_second) {
+    MutexLock l(&mu_);
+    SetRate(bytes_per_second);
+  }
+
+  virtual uint64_t GetBytesPerSecond() {
+    MutexLock l(&mu_);
+    return rate_;
+  }
+
+ protected:
+  // REQUIRES: mu_ held
+  uint64_t Rate() const { return rate_; }
+
+  // REQUIRES: mu_ held
+  void SetRate(uint64_t bytes_per_second) {
+    Refill();
+    rate_ = bytes_per_second;
+  }
+
+  Env* const env_;
+  port::Mutex mu_;
+
+ private:
+  // REQUIRES: mu_ held
+  void Refill() {
+    const uint64_t now = env_->NowMicros();
+    if (now > last_refill_) {
+      // Anything over a second fills the bucket anyway
+      uint64_t elapsed = now - last_refill_;
+      if (elapsed > 1000000) {
+        elapsed = 1000000;
+      }
+      available_ += static_cast<int64_t>(elapsed * rate_ / 1000000);
+      const int64_t burst = static_cast<int64_t>(rate_ / 10);
+      if (available_ > burst) {
+        available_ = burst;
+      }
+    }
+    last_refill_ = now;
+  }
+
+  uint64_t rate_;
+  int64_t available_;       // Negative while requests wait for their bytes
+  uint64_t last_refill_;
+};
+
+class AdaptiveRateLimiter : public TokenBucket {
+ public:
+  AdaptiveRateLimiter(uint64_t bytes_per_second, uint64_t write_micros_target)
+      : TokenBucket(bytes_per_second),
+        max_rate_(bytes_per_second),
+        target_(write_micros_target),
+        writes_(0),
+        slow_writes_(0),
+        backlog_(false),
+        window_start_(env_->NowMicros()) {
+  }
+
+  virtual void SetBytesPerSecond(uint64_t bytes_per_second) {
+    MutexLock l(&mu_);
+    max_rate_ = bytes_per_second;
+    SetRate(bytes_per_second);
+  }
+
+  virtual void ReportWrite(uint64_t write_micros, bool level0_backlog) {
+    MutexLock l(&mu_);
+    writes_++;
+    if (write_micros > target_) {
+      slow_writes_++;
+    }
+    if (level0_backlog) {
+      backlog_ = true;
+    }
+    if (writes_ < kMinWrites) {
+      return;
+    }
+    const uint64_t now = env_->NowMicros();
+    if (now < window_start_ + kWindowMicros) {
+      return;
+    }
+
+    // max_rate_ of 0 means unlimited, leave it that way
+    if (max_rate_ > 0) {
+      const uint64_t min_rate = max_rate_ / 16;
+      uint64_t rate = Rate();
+      if (backlog_) {
+        rate *= 2;
+      } else if (slow_writes_ * 100 > writes_) {
+        // The 99th percentile is over the target
+        rate /= 2;
+      } else if (slow_writes_ * 400 < writes_) {
+        rate += rate / 4;
+      }
+      if (rate < min_rate) rate = min_rate;
+      if (rate > max_rate_) rate = max_rate_;
+      SetRate(rate);
+    }
+    writes_ = 0;
+    slow_writes_ = 0;
+    backlog_ = false;
+    window_start_ = now;
+  }
+
+ private:
+  enum { kMinWrites = 100 };
+  static const uint64_t kWindowMicros = 1000000;
+
+  uint64_t max_rate_;
+  const uint64_t target_;
+
+  // Writes seen since window_start_
+  uint64_t writes_;
+  uint64_t slow_writes_;
+  bool backlog_;
+  uint64_t window_start_;
+};
+
+class RateLimitedFile : public WritableFile {
+ public:
+  RateLimitedFile(WritableFile* base, RateLimiter* limiter)
+      : base_(base),
+        limiter_(limiter) {
+  }
+  virtual ~RateLimitedFile() {
+    delete base_;
+  }
+
+  virtual Status Append(const Slice& data) {
+    limiter_->Request(data.size());
+    return base_->Append(data);
+  }
+  virtual Status Close() { return base_->Close(); }
+  virtual Status Flush() { return base_->Flush(); }
+  virtual Status Sync() { return base_->Sync(); }
+
+ private:
+  WritableFile* base_;
+  RateLimiter* limiter_;
+};
+
+}  // namespace
+
+RateLimiter* NewRateLimiter(uint64_t bytes_per_second) {
+  return new TokenBucket(bytes_per_second);
+}
+
+RateLimiter* NewAdaptiveRateLimiter(uint64_t bytes_per_second,
+                                    uint64_t write_micros_target) {
+  return new AdaptiveRateLimiter(bytes_per_second, write_micros_target);
+}
+
+WritableFile* NewRateLimitedFile(WritableFile* base, RateLimiter* limiter) {
+  if (limiter == NULL) {
+    return base;
+  }
+  return new RateLimitedFile(base, limiter);
+}
+
+}  // namespace leveldb
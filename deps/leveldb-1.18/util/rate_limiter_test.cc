@@ -0,0 +1,136 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "leveldb/rate_limiter.h"
+
+#include <string>
+#include "db/db_impl.h"
+#include "leveldb/db.h"
+#include "leveldb/env.h"
+#include "util/coding.h"
+#include "util/testharness.h"
+
+namespace leveldb {
+
+class RateLimiterTest { };
+
+TEST(RateLimiterTest, TokenBucket) {
+  Env* env = Env::Default();
+  RateLimiter* limiter = NewRateLimiter(100 << 20);
+  ASSERT_EQ(100 << 20, limiter->GetBytesPerSecond());
+
+  // A tenth of a second worth of bytes
+  const uint64_t start = env->NowMicros();
+  for (int i = 0; i < 10; i++) {
+    limiter->Request(1 << 20);
+  }
+  ASSERT_GE(env->NowMicros() - start, 80000);
+
+  // Unlimited
+  limiter->SetBytesPerSecond(0);
+  ASSERT_EQ(0, limiter->GetBytesPerSecond());
+  const uint64_t unlimited = env->NowMicros();
+  for (int i = 0; i < 100; i++) {
+    limiter->Request(10 << 20);
+  }
+  ASSERT_LT(env->NowMicros() - unlimited, 50000);
+  delete limiter;
+}
+
+TEST(RateLimiterTest, Adaptive) {
+  const uint64_t kMax = 64 << 20;
+  RateLimiter* limiter = NewAdaptiveRateLimiter(kMax, 1000);
+
+  // More than 1% of the writes over the target
+  for (int i = 0; i < 200; i++) {
+    limiter->ReportWrite(i % 10 == 0 ? 5000 : 100, false);
+  }
+  Env::Default()->SleepForMicroseconds(1001000);
+  limiter->ReportWrite(100, false);
+  ASSERT_EQ(kMax / 2, limiter->GetBytesPerSecond());
+
+  // Fast again
+  for (int i = 0; i < 200; i++) {
+    limiter->ReportWrite(100, false);
+  }
+  Env::Default()->SleepForMicroseconds(1001000);
+  limiter->ReportWrite(100, false);
+  ASSERT_EQ(kMax / 2 + kMax / 8, limiter->GetBytesPerSecond());
+
+  // Slow writes, but level-0 needs the compactions
+  for (int i = 0; i < 200; i++) {
+    limiter->ReportWrite(5000, i == 0);
+  }
+  Env::Default()->SleepForMicroseconds(1001000);
+  limiter->ReportWrite(5000, false);
+  ASSERT_EQ(kMax, limiter->GetBytesPerSecond());
+
+  limiter->SetBytesPerSecond(kMax / 4);
+  ASSERT_EQ(kMax / 4, limiter->GetBytesPerSecond());
+  delete limiter;
+}
+
+namespace {
+
+class CountingLimiter : public RateLimiter {
+ public:
+  uint64_t bytes_;
+  int writes_;
+  CountingLimiter() : bytes_(0), writes_(0) { }
+  virtual void Request(size_t bytes) { bytes_ += bytes; }
+  virtual void SetBytesPerSecond(uint64_t bytes_per_second) { }
+  virtual uint64_t GetBytesPerSecond() { return 0; }
+  virtual void ReportWrite(uint64_t write_micros, bool level0_backlog) {
+    writes_++;
+  }
+};
+
+// Key as passed to DB::Put(), see db/touch_test.cc
+std::string MetaKey(const std::string& key) {
+  std::string result;
+  PutFixed32(&result, 2);
+  PutFixed64(&result, 0);
+  PutFixed64(&result, 1);
+  PutFixed64(&result, 0);
+  result.append(key);
+  return result;
+}
+
+}  // namespace
+
+TEST(RateLimiterTest, FlushAndCompaction) {
+  CountingLimiter limiter;
+  Options options;
+  options.create_if_missing = true;
+  options.rate_limiter = &limiter;
+  const std::string dbname = test::TmpDir() + "/rate_limiter_test";
+  DestroyDB(dbname, options);
+  DB* db;
+  ASSERT_OK(DB::Open(options, dbname, &db));
+  DBImpl* dbi = reinterpret_cast<DBImpl*>(db);
+
+  ASSERT_OK(db->Put(WriteOptions(), MetaKey("a"), "va"));
+  ASSERT_OK(db->Put(WriteOptions(), MetaKey("b"), "vb"));
+  ASSERT_EQ(2, limiter.writes_);
+  ASSERT_EQ(0, limiter.bytes_);
+  ASSERT_OK(dbi->TEST_CompactMemTable());
+  const uint64_t flushed = limiter.bytes_;
+  ASSERT_GT(flushed, 0);
+  // Overlapping files, so that the compaction below is not a move
+  ASSERT_OK(db->Put(WriteOptions(), MetaKey("a"), "va2"));
+  ASSERT_OK(dbi->TEST_CompactMemTable());
+  ASSERT_GT(limiter.bytes_, flushed);
+  const uint64_t before_compaction = limiter.bytes_;
+  db->CompactRange(NULL, NULL);
+  ASSERT_GT(limiter.bytes_, before_compaction);
+
+  delete db;
+  DestroyDB(dbname, options);
+}
+
+}  // namespace leveldb
+
+int main(int argc, char** argv) {
+  return leveldb::test::RunAllTests();
+}
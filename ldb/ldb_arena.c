@@ -0,0 +1,179 @@
+#include "ldb_arena.h"
+#include "lmalloc.h"
+
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+
+
+#define LDB_ARENA_ALIGN(size)  (((size) + 7) & ~((size_t)7))
+
+typedef struct ldb_arena_block_t {
+    struct ldb_arena_block_t*   next_;
+} ldb_arena_block_t;
+
+struct ldb_arena_t {
+    ldb_arena_block_t*  blocks_;     //newest first, the last one is kept by reset
+    char*               ptr_;
+    size_t              left_;
+    char*               last_;       //last allocation, may be grown in place
+    size_t              usage_;
+    size_t              block_size_;
+    int                 depth_;
+    ldb_arena_t*        prev_;       //arena entered before this one
+};
+
+
+static pthread_key_t thread_arena_key;
+static pthread_once_t thread_arena_once = PTHREAD_ONCE_INIT;
+static __thread ldb_arena_t* thread_arena = NULL;
+static __thread ldb_arena_t* current_arena = NULL;
+
+static void thread_arena_free(void* arena){
+    ldb_arena_destroy((ldb_arena_t*)arena);
+}
+
+static void thread_arena_key_create(void){
+    pthread_key_create(&thread_arena_key, thread_arena_free);
+}
+
+
+static char* arena_new_block(ldb_arena_t* arena, size_t size){
+    ldb_arena_block_t* block = (ldb_arena_block_t*)lmalloc(sizeof(ldb_arena_block_t) + size);
+    //the first block ends up at the tail, where reset finds it
+    block->next_ = arena->blocks_;
+    arena->blocks_ = block;
+    arena->usage_ += size;
+    return (char*)(block + 1);
+}
+
+ldb_arena_t* ldb_arena_create(size_t block_size){
+    ldb_arena_t* arena = (ldb_arena_t*)lmalloc(sizeof(ldb_arena_t));
+    memset(arena, 0, sizeof(ldb_arena_t));
+    arena->block_size_ = LDB_ARENA_ALIGN(block_size > 0 ? block_size : LDB_ARENA_BLOCK_SIZE);
+    arena->ptr_ = arena_new_block(arena, arena->block_size_);
+    arena->left_ = arena->block_size_;
+    return arena;
+}
+
+void ldb_arena_destroy(ldb_arena_t* arena){
+    if(arena == NULL){
+        return;
+    }
+    ldb_arena_block_t* block = arena->blocks_;
+    while(block != NULL){
+        ldb_arena_block_t* next = block->next_;
+        lfree(block);
+        block = next;
+    }
+    lfree(arena);
+}
+
+void* ldb_arena_alloc(ldb_arena_t* arena, size_t size){
+    size = LDB_ARENA_ALIGN(size);
+    if(size > arena->left_){
+        if(size > arena->block_size_/4){
+            //big allocations get a block of their own and leave the
+            //rest of the current one for the following small ones
+            arena->last_ = NULL;
+            return arena_new_block(arena, size);
+        }
+        arena->ptr_ = arena_new_block(arena, arena->block_size_);
+        arena->left_ = arena->block_size_;
+    }
+    char* result = arena->ptr_;
+    arena->ptr_ += size;
+    arena->left_ -= size;
+    arena->last_ = result;
+    return result;
+}
+
+void* ldb_arena_grow(ldb_arena_t* arena, void* ptr, size_t oldsize, size_t newsize){
+    if(ptr == NULL){
+        return ldb_arena_alloc(arena, newsize);
+    }
+    if(ptr == arena->last_){
+        size_t used = arena->ptr_ - arena->last_;
+        size_t need = LDB_ARENA_ALIGN(newsize);
+        if(need <= used + arena->left_){
+            arena->ptr_ = arena->last_ + need;
+            arena->left_ = used + arena->left_ - need;
+            return ptr;
+        }
+    }
+    void* result = ldb_arena_alloc(arena, newsize);
+    memcpy(result, ptr, oldsize < newsize ? oldsize : newsize);
+    return result;
+}
+
+void ldb_arena_reset(ldb_arena_t* arena){
+    ldb_arena_block_t* block = arena->blocks_;
+    while(block->next_ != NULL){
+        ldb_arena_block_t* next = block->next_;
+        lfree(block);
+        block = next;
+    }
+    arena->blocks_ = block;
+    arena->ptr_ = (char*)(block + 1);
+    arena->left_ = arena->block_size_;
+    arena->last_ = NULL;
+    arena->usage_ = arena->block_size_;
+}
+
+size_t ldb_arena_usage(const ldb_arena_t* arena){
+    return arena->usage_;
+}
+
+ldb_arena_t* ldb_arena_enter(ldb_arena_t* arena){
+    if(arena == NULL){
+        if(thread_arena == NULL){
+            pthread_once(&thread_arena_once, thread_arena_key_create);
+            thread_arena = ldb_arena_create(LDB_ARENA_BLOCK_SIZE);
+            pthread_setspecific(thread_arena_key, thread_arena);
+        }
+        arena = thread_arena;
+    }
+    if(arena->depth_++ == 0){
+        arena->prev_ = current_arena;
+        current_arena = arena;
+    }
+    return arena;
+}
+
+void ldb_arena_leave(ldb_arena_t* arena){
+    if(--arena->depth_ == 0){
+        current_arena = arena->prev_;
+        arena->prev_ = NULL;
+        ldb_arena_reset(arena);
+    }
+}
+
+ldb_arena_t* ldb_arena_current(void){
+    ldb_arena_t* arena = current_arena;
+    if(arena != NULL && arena->usage_ >= LDB_ARENA_MAX_SIZE){
+        return NULL;
+    }
+    return arena;
+}
+
+void* ldb_arena_lmalloc(size_t size, ldb_arena_t** parena){
+    ldb_arena_t* arena = ldb_arena_current();
+    *parena = arena;
+    if(arena != NULL){
+        return ldb_arena_alloc(arena, size);
+    }
+    return lmalloc(size);
+}
+
+void* ldb_arena_lrealloc(ldb_arena_t* arena, void* ptr, size_t oldsize, size_t newsize){
+    if(arena != NULL){
+        return ldb_arena_grow(arena, ptr, oldsize, newsize);
+    }
+    return lrealloc(ptr, newsize);
+}
+
+void ldb_arena_lfree(ldb_arena_t* arena, void* ptr){
+    if(arena == NULL){
+        lfree(ptr);
+    }
+}
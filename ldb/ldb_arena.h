@@ -0,0 +1,49 @@
+#ifndef LDB_ARENA_H
+#define LDB_ARENA_H
+
+#include <stddef.h>
+
+#define LDB_ARENA_BLOCK_SIZE                 8192
+//past this a command's temporaries go back to lmalloc
+#define LDB_ARENA_MAX_SIZE                   (64 << 20)
+
+//a bump allocator for the temporaries of one command, everything taken
+//from it is given back at once by ldb_arena_reset
+typedef struct ldb_arena_t     ldb_arena_t;
+
+ldb_arena_t* ldb_arena_create(size_t block_size);
+
+void ldb_arena_destroy(ldb_arena_t* arena);
+
+void* ldb_arena_alloc(ldb_arena_t* arena, size_t size);
+
+//grows ptr, extended in place when it is the last allocation of arena
+void* ldb_arena_grow(ldb_arena_t* arena, void* ptr, size_t oldsize, size_t newsize);
+
+//frees everything but the first block, which is kept for the next command
+void ldb_arena_reset(ldb_arena_t* arena);
+
+size_t ldb_arena_usage(const ldb_arena_t* arena);
+
+//makes arena, or the calling thread's own arena when NULL, the one the
+//slices, metas, bytes and lists created by this thread come from, until
+//the matching ldb_arena_leave resets it. calls nest, only the outermost
+//leave resets.
+ldb_arena_t* ldb_arena_enter(ldb_arena_t* arena);
+
+void ldb_arena_leave(ldb_arena_t* arena);
+
+//the arena entered by the calling thread, NULL if none or if it is full
+ldb_arena_t* ldb_arena_current(void);
+
+//lmalloc from the current arena, *parena is set to the arena used or NULL
+//if the memory came from lmalloc
+void* ldb_arena_lmalloc(size_t size, ldb_arena_t** parena);
+
+//lrealloc for memory from ldb_arena_lmalloc
+void* ldb_arena_lrealloc(ldb_arena_t* arena, void* ptr, size_t oldsize, size_t newsize);
+
+//lfree for memory from ldb_arena_lmalloc
+void ldb_arena_lfree(ldb_arena_t* arena, void* ptr);
+
+#endif //LDB_ARENA_H
@@ -0,0 +1,235 @@
+#include "ldb_async.h"
+#include "ldb_define.h"
+#include "lmalloc.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+
+typedef struct ldb_async_write_t{
+    ldb_txn_t* txn_;
+    uint32_t* stripes_;
+    size_t stripenum_;
+    uint64_t tag_;
+    struct ldb_async_write_t* next_;
+} ldb_async_write_t;
+
+struct ldb_async_t{
+    ldb_context_t* context_;
+    pthread_mutex_t lock_;
+    pthread_cond_t queued_;                  //the writer waits for writes
+    pthread_cond_t room_;                    //ldb_write_async waits for room
+    pthread_cond_t written_;                 //ldb_async_drain waits for writes
+    ldb_async_write_t* head_;
+    ldb_async_write_t* tail_;
+    size_t pending_;                         //queued, being written or not yet polled
+    ldb_async_done_t* dones_;                //ring of LDB_ASYNC_PENDING_MAX
+    size_t donehead_;
+    size_t donenum_;
+    int eventfd_;
+    int started_;
+    int stopping_;
+    pthread_t writer_;
+};
+
+
+static void async_write_destroy(ldb_async_write_t* write){
+    ldb_txn_destroy(write->txn_);
+    lfree(write->stripes_);
+    lfree(write);
+}
+
+//commits group, the writes linked from it, as one write and returns the
+//number of writes in it
+static size_t async_commit(ldb_async_t* async, ldb_async_write_t* group, int* retval){
+    size_t num = 0, stripenum = 0;
+    for(ldb_async_write_t* write = group; write != NULL; write = write->next_){
+        stripenum += write->stripenum_;
+        ++num;
+    }
+    uint32_t *stripes = (uint32_t*)lmalloc(sizeof(uint32_t) * (stripenum + 1));
+    stripenum = 0;
+    for(ldb_async_write_t* write = group; write != NULL; write = write->next_){
+        memcpy(stripes + stripenum, write->stripes_, sizeof(uint32_t) * write->stripenum_);
+        stripenum += write->stripenum_;
+        if(write != group){
+            ldb_txn_append(group->txn_, write->txn_);
+        }
+    }
+
+    char *errptr = NULL;
+    stripenum = ldb_context_lock_stripes(async->context_, stripes, stripenum);
+    ldb_txn_commit(async->context_, group->txn_, &errptr);
+    ldb_context_unlock_stripes(async->context_, stripes, stripenum);
+    lfree(stripes);
+    *retval = LDB_OK;
+    if(errptr != NULL){
+        fprintf(stderr, "%s ldb_txn_commit failed %s.\n", __func__, errptr);
+        leveldb_free(errptr);
+        *retval = LDB_ERR;
+    }
+    return num;
+}
+
+static void* async_writer(void* arg){
+    ldb_async_t *async = (ldb_async_t*)arg;
+    pthread_mutex_lock(&async->lock_);
+    while(1){
+        while(async->head_ == NULL && !async->stopping_){
+            pthread_cond_wait(&async->queued_, &async->lock_);
+        }
+        if(async->head_ == NULL){
+            break;
+        }
+        //everything queued since the last write, at least one
+        ldb_async_write_t *group = async->head_, *last = group;
+        size_t bytes = ldb_txn_size(group->txn_);
+        while(last->next_ != NULL && bytes + ldb_txn_size(last->next_->txn_) <= LDB_ASYNC_GROUP_BYTES){
+            last = last->next_;
+            bytes += ldb_txn_size(last->txn_);
+        }
+        async->head_ = last->next_;
+        if(async->head_ == NULL){
+            async->tail_ = NULL;
+        }
+        last->next_ = NULL;
+        pthread_mutex_unlock(&async->lock_);
+
+        int retval = LDB_OK;
+        uint64_t num = async_commit(async, group, &retval);
+
+        pthread_mutex_lock(&async->lock_);
+        //pending_ kept a slot for each of them
+        while(group != NULL){
+            ldb_async_write_t *next = group->next_;
+            size_t slot = (async->donehead_ + async->donenum_) % LDB_ASYNC_PENDING_MAX;
+            async->dones_[slot].tag_ = group->tag_;
+            async->dones_[slot].retval_ = retval;
+            ++async->donenum_;
+            async_write_destroy(group);
+            group = next;
+        }
+        pthread_cond_broadcast(&async->written_);
+        if(async->eventfd_ >= 0 && write(async->eventfd_, &num, sizeof(num)) != sizeof(num)){
+            fprintf(stderr, "%s eventfd write failed.\n", __func__);
+        }
+    }
+    pthread_mutex_unlock(&async->lock_);
+    return NULL;
+}
+
+ldb_async_t* ldb_async_create(ldb_context_t* context){
+    ldb_async_t *async = (ldb_async_t*)lmalloc(sizeof(ldb_async_t));
+    memset(async, 0, sizeof(ldb_async_t));
+    async->context_ = context;
+    pthread_mutex_init(&async->lock_, NULL);
+    pthread_cond_init(&async->queued_, NULL);
+    pthread_cond_init(&async->room_, NULL);
+    pthread_cond_init(&async->written_, NULL);
+    async->dones_ = (ldb_async_done_t*)lmalloc(sizeof(ldb_async_done_t) * LDB_ASYNC_PENDING_MAX);
+    async->eventfd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if(async->eventfd_ < 0){
+        fprintf(stderr, "%s eventfd failed, completions can only be polled.\n", __func__);
+    }
+    return async;
+}
+
+void ldb_async_destroy(ldb_async_t* async){
+    if(async == NULL){
+        return;
+    }
+    pthread_mutex_lock(&async->lock_);
+    async->stopping_ = 1;
+    pthread_cond_signal(&async->queued_);
+    pthread_mutex_unlock(&async->lock_);
+    if(async->started_){
+        pthread_join(async->writer_, NULL);
+    }
+    if(async->eventfd_ >= 0){
+        close(async->eventfd_);
+    }
+    pthread_cond_destroy(&async->written_);
+    pthread_cond_destroy(&async->room_);
+    pthread_cond_destroy(&async->queued_);
+    pthread_mutex_destroy(&async->lock_);
+    lfree(async->dones_);
+    lfree(async);
+}
+
+int ldb_write_async(ldb_context_t* context, ldb_txn_t* txn, const uint32_t* stripes, size_t stripenum, uint64_t tag){
+    ldb_async_t *async = context->async_;
+    ldb_async_write_t *write = (ldb_async_write_t*)lmalloc(sizeof(ldb_async_write_t));
+    write->txn_ = txn;
+    write->stripes_ = (uint32_t*)lmalloc(sizeof(uint32_t) * (stripenum + 1));
+    if(stripenum > 0){
+        memcpy(write->stripes_, stripes, sizeof(uint32_t) * stripenum);
+    }
+    write->stripenum_ = stripenum;
+    write->tag_ = tag;
+    write->next_ = NULL;
+
+    int retval = LDB_OK;
+    pthread_mutex_lock(&async->lock_);
+    if(async->stopping_){
+        retval = LDB_ERR;
+        goto end;
+    }
+    if(!async->started_){
+        if(pthread_create(&async->writer_, NULL, async_writer, async) != 0){
+            fprintf(stderr, "%s pthread_create failed.\n", __func__);
+            retval = LDB_ERR;
+            goto end;
+        }
+        async->started_ = 1;
+    }
+    while(async->pending_ >= LDB_ASYNC_PENDING_MAX){
+        pthread_cond_wait(&async->room_, &async->lock_);
+    }
+    ++async->pending_;
+    if(async->tail_ == NULL){
+        async->head_ = write;
+    }else{
+        async->tail_->next_ = write;
+    }
+    async->tail_ = write;
+    pthread_cond_signal(&async->queued_);
+
+end:
+    pthread_mutex_unlock(&async->lock_);
+    if(retval != LDB_OK){
+        async_write_destroy(write);
+    }
+    return retval;
+}
+
+int ldb_async_fd(ldb_context_t* context){
+    return context->async_->eventfd_;
+}
+
+void ldb_async_drain(ldb_context_t* context){
+    ldb_async_t *async = context->async_;
+    pthread_mutex_lock(&async->lock_);
+    while(async->pending_ > async->donenum_){
+        pthread_cond_wait(&async->written_, &async->lock_);
+    }
+    pthread_mutex_unlock(&async->lock_);
+}
+
+size_t ldb_async_poll(ldb_context_t* context, ldb_async_done_t* dones, size_t max){
+    ldb_async_t *async = context->async_;
+    pthread_mutex_lock(&async->lock_);
+    size_t num = async->donenum_ < max ? async->donenum_ : max;
+    for(size_t i = 0; i < num; ++i){
+        dones[i] = async->dones_[(async->donehead_ + i) % LDB_ASYNC_PENDING_MAX];
+    }
+    async->donehead_ = (async->donehead_ + num) % LDB_ASYNC_PENDING_MAX;
+    async->donenum_ -= num;
+    async->pending_ -= num;
+    if(num > 0){
+        pthread_cond_broadcast(&async->room_);
+    }
+    pthread_mutex_unlock(&async->lock_);
+    return num;
+}
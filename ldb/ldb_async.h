@@ -0,0 +1,48 @@
+#ifndef LDB_ASYNC_H
+#define LDB_ASYNC_H
+
+#include "ldb_context.h"
+#include "ldb_txn.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+
+
+//a writer thread commits the txns queued meanwhile as one write of up to
+//this many bytes, well over the 1MB groups of leveldb's own group commit
+#define LDB_ASYNC_GROUP_BYTES                (16*1024*1024)
+
+//writes queued or done but not yet polled, ldb_write_async waits for room
+#define LDB_ASYNC_PENDING_MAX                65536
+
+typedef struct ldb_async_t      ldb_async_t;
+
+typedef struct ldb_async_done_t{
+    uint64_t tag_;
+    int retval_;                             //LDB_OK or LDB_ERR
+} ldb_async_done_t;
+
+
+ldb_async_t* ldb_async_create(ldb_context_t* context);
+
+//commits what is still queued and stops the writer thread
+void ldb_async_destroy(ldb_async_t* async);
+
+//queues txn and returns without waiting for the write. txn is taken over
+//and destroyed once written, or right away on LDB_ERR. stripes are those of the keys txn writes, they
+//are locked while it is committed. the writes are visible to reads once
+//committed, possibly before the completion is posted with tag.
+int ldb_write_async(ldb_context_t* context, ldb_txn_t* txn, const uint32_t* stripes, size_t stripenum, uint64_t tag);
+
+//an eventfd that turns readable once completions are posted. read it
+//before ldb_async_poll and poll until nothing is left, so that no
+//completion posted meanwhile goes unnoticed.
+int ldb_async_fd(ldb_context_t* context);
+
+//waits until every queued write is done, its completion may still be polled
+void ldb_async_drain(ldb_context_t* context);
+
+//takes up to max completions in the order their writes were queued
+size_t ldb_async_poll(ldb_context_t* context, ldb_async_done_t* dones, size_t max);
+
+#endif //LDB_ASYNC_H
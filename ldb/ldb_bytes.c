@@ -1,5 +1,6 @@
 #include "ldb_bytes.h"
 #include "ldb_slice.h"
+#include "ldb_arena.h"
 #include "lmalloc.h"
 
 #include <leveldb/c.h>
@@ -8,17 +9,22 @@
 struct ldb_bytes_t{
   const char* data_;
   size_t size_;
+  ldb_arena_t* arena_;
 };
 
 ldb_bytes_t* ldb_bytes_create(const char* data, size_t size){
-  ldb_bytes_t *bytes = (ldb_bytes_t*)lmalloc(sizeof(ldb_bytes_t));
+  ldb_arena_t *arena = NULL;
+  ldb_bytes_t *bytes = (ldb_bytes_t*)ldb_arena_lmalloc(sizeof(ldb_bytes_t), &arena);
+  bytes->arena_ = arena;
   bytes->data_ = data;
   bytes->size_ = size;
   return bytes;
 }
 
 void ldb_bytes_destroy(ldb_bytes_t* bytes){
-  lfree(bytes);
+  if(bytes != NULL){
+    ldb_arena_lfree(bytes->arena_, bytes);
+  }
 }
 
 int ldb_bytes_skip(ldb_bytes_t* bytes, size_t n){
@@ -101,3 +107,45 @@ int ldb_bytes_read_slice_size_uint16(ldb_bytes_t* bytes, ldb_slice_t** pslice){
   return size+sizeof(uint16_t);
 }
 
+
+int ldb_bytes_read_slice_size_uint32(ldb_bytes_t* bytes, ldb_slice_t** pslice){
+  if(bytes->size_ < sizeof(uint32_t)){
+    return -1;
+  }
+  uint32_t size = leveldb_decode_fixed32(bytes->data_);
+  bytes->size_ -= sizeof(uint32_t);
+  bytes->data_ += sizeof(uint32_t);
+  if(bytes->size_ < size){
+    return -1;
+  }
+  if(pslice != NULL){
+    *pslice = ldb_slice_create(bytes->data_, size);
+  }
+  bytes->size_ -= size;
+  bytes->data_ += size;
+  return size+sizeof(uint32_t);
+}
+
+int ldb_bytes_read_uint8(ldb_bytes_t* bytes, uint8_t* val){
+  if(bytes->size_ < sizeof(uint8_t)){
+    return -1;
+  }
+  if(val != NULL){
+    *val = leveldb_decode_fixed8(bytes->data_);
+  }
+  bytes->data_ += sizeof(uint8_t);
+  bytes->size_ -= sizeof(uint8_t);
+  return sizeof(uint8_t);
+}
+
+int ldb_bytes_read_uint32(ldb_bytes_t* bytes, uint32_t* val){
+  if(bytes->size_ < sizeof(uint32_t)){
+    return -1;
+  }
+  if(val != NULL){
+    *val = leveldb_decode_fixed32(bytes->data_);
+  }
+  bytes->data_ += sizeof(uint32_t);
+  bytes->size_ -= sizeof(uint32_t);
+  return sizeof(uint32_t);
+}
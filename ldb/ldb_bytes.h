@@ -23,4 +23,10 @@ int ldb_bytes_read_slice_size_uint8(ldb_bytes_t* bytes, ldb_slice_t** pslice);
 
 int ldb_bytes_read_slice_size_uint16(ldb_bytes_t* bytes, ldb_slice_t** pslice);
 
+int ldb_bytes_read_slice_size_uint32(ldb_bytes_t* bytes, ldb_slice_t** pslice);
+
+int ldb_bytes_read_uint8(ldb_bytes_t* bytes, uint8_t* val);
+
+int ldb_bytes_read_uint32(ldb_bytes_t* bytes, uint32_t* val);
+
 #endif //LDB_BYTES_H
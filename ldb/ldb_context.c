@@ -1,4 +1,6 @@
 #include "ldb_context.h"
+#include "ldb_async.h"
+#include "ldb_slice.h"
 #include "lmalloc.h"
 
 #include <leveldb/c.h>
@@ -9,7 +11,7 @@
 
 
 
-ldb_context_t* ldb_context_create(const char* name, size_t cache_size, size_t write_buffer_size, int compression){
+ldb_context_t* ldb_context_create(const char* name, size_t cache_size, size_t write_buffer_size, int compression, int cache_type){
     ldb_context_t* context = (ldb_context_t*)(lmalloc(sizeof(ldb_context_t)));
     memset(context, 0, sizeof(ldb_context_t));
     context->options_ = leveldb_options_create();
@@ -17,22 +19,43 @@ ldb_context_t* ldb_context_create(const char* name, size_t cache_size, size_t wr
     leveldb_options_set_max_open_files(context->options_, 10000);
     context->filter_policy_ = leveldb_filterpolicy_create_bloom(10);
     leveldb_options_set_filter_policy(context->options_, context->filter_policy_);
-    context->block_cache_ = leveldb_cache_create_lru(cache_size*1024*1024);
+    if(cache_type == LDB_CACHE_CLOCK){
+        context->block_cache_ = leveldb_cache_create_clock(cache_size*1024*1024, LDB_CACHE_CLOCK_SHARD_BITS);
+    }else{
+        context->block_cache_ = leveldb_cache_create_lru(cache_size*1024*1024);
+    }
     leveldb_options_set_cache(context->options_, context->block_cache_);
-    context->batch_ = leveldb_writebatch_create();
-    context->mutex_ = leveldb_mutex_create();
+    //small values of hot keys are answered before the memtables are searched
+    leveldb_options_set_row_cache_size(context->options_, cache_size*1024*1024/16);
     leveldb_options_set_block_size(context->options_, 32*1024);
     leveldb_options_set_write_buffer_size(context->options_, write_buffer_size*1024*1024);
     if(compression){
         leveldb_options_set_compression(context->options_, leveldb_snappy_compression); 
     }
-    leveldb_options_set_compaction_speed(context->options_, 1000);
+    context->rate_limiter_ = leveldb_ratelimiter_create_adaptive((uint64_t)LDB_COMPACTION_RATE_MB*1024*1024, LDB_WRITE_MICROS_TARGET);
+    leveldb_options_set_rate_limiter(context->options_, context->rate_limiter_);
+    leveldb_options_set_expired_compaction_ratio(context->options_, LDB_EXPIRED_COMPACTION_RATIO);
+    leveldb_options_set_met_table_checkpoint(context->options_, 1);
     char* leveldb_error = NULL;
     context->database_ = leveldb_open(context->options_, name, &leveldb_error); 
     if(leveldb_error!=NULL){
         goto err;
     }
     context->for_recovering_ = (leveldb_snapshot_t*)leveldb_create_snapshot_for_recovering(context->database_);
+    context->readoptions_ = leveldb_readoptions_create();
+    context->scanoptions_ = leveldb_readoptions_create();
+    leveldb_readoptions_set_fill_cache(context->scanoptions_, 0);
+    context->writeoptions_ = leveldb_writeoptions_create();
+    pthread_mutex_init(&context->iterator_lock_, NULL);
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    for(size_t i = 0; i < LDB_KEY_LOCK_STRIPES; ++i){
+        pthread_mutex_init(&context->key_locks_[i], &attr);
+    }
+    pthread_mutexattr_destroy(&attr);
+    pthread_rwlock_init(&context->zrank_lock_, NULL);
+    context->async_ = ldb_async_create(context);
 
     return context;
 err:
@@ -51,11 +74,8 @@ err:
     if(context->block_cache_!=NULL){
         leveldb_cache_destroy(context->block_cache_);
     }
-    if(context->batch_!=NULL){
-        leveldb_writebatch_destroy(context->batch_);
-    }
-    if(context->mutex_!=NULL){
-        leveldb_mutex_destroy(context->mutex_);
+    if(context->rate_limiter_!=NULL){
+        leveldb_ratelimiter_destroy(context->rate_limiter_);
     }
     lfree(context);
     return NULL;
@@ -63,6 +83,22 @@ err:
 
 void ldb_context_destroy( ldb_context_t* context){
     if(context!=NULL){
+        ldb_async_destroy(context->async_);
+        for(size_t i = 0; i < context->iterator_num_; ++i){
+            leveldb_iter_destroy(context->iterators_[i].iterator_);
+        }
+        pthread_mutex_destroy(&context->iterator_lock_);
+        for(size_t i = 0; i < LDB_KEY_LOCK_STRIPES; ++i){
+            pthread_mutex_destroy(&context->key_locks_[i]);
+        }
+        for(size_t i = 0; i < context->zrank_num_; ++i){
+            ldb_slice_destroy(context->zrank_names_[i]);
+        }
+        lfree(context->zrank_names_);
+        pthread_rwlock_destroy(&context->zrank_lock_);
+        leveldb_readoptions_destroy(context->readoptions_);
+        leveldb_readoptions_destroy(context->scanoptions_);
+        leveldb_writeoptions_destroy(context->writeoptions_);
         if(context->for_recovering_ != NULL){
             leveldb_release_snapshot(context->database_, context->for_recovering_);
         }
@@ -70,8 +106,7 @@ void ldb_context_destroy( ldb_context_t* context){
         leveldb_options_destroy(context->options_);
         leveldb_filterpolicy_destroy(context->filter_policy_);
         leveldb_cache_destroy(context->block_cache_);
-        leveldb_writebatch_destroy(context->batch_);
-        leveldb_mutex_destroy(context->mutex_);
+        leveldb_ratelimiter_destroy(context->rate_limiter_);
     }
     lfree(context);
 }
@@ -83,32 +118,117 @@ void ldb_context_release_recovering_snapshot(ldb_context_t* context){
     }
 }
 
+int ldb_context_met_checkpoint_loaded(ldb_context_t* context){
+    char* value = leveldb_property_value(context->database_, "leveldb.met-checkpoint-loaded");
+    int loaded = (value != NULL && strcmp(value, "1") == 0);
+    free(value);
+    return loaded;
+}
+
 void ldb_context_do_write_recovering(ldb_context_t* context){
-    leveldb_writeoptions_t* writeoptions = leveldb_writeoptions_create();
-    leveldb_write_recovering(context->database_, writeoptions); 
-    leveldb_writeoptions_destroy(writeoptions);
+    leveldb_write_recovering(context->database_, context->writeoptions_); 
+    //the replay may have built rank indexes
+    pthread_rwlock_wrlock(&context->zrank_lock_);
+    context->zrank_loaded_ = 0;
+    pthread_rwlock_unlock(&context->zrank_lock_);
 }
 
+void ldb_context_set_compaction_rate(ldb_context_t* context, size_t mb_per_second){
+    leveldb_ratelimiter_set_bytes_per_second(context->rate_limiter_, (uint64_t)mb_per_second*1024*1024);
+}
 
-void ldb_context_writebatch_commit(ldb_context_t* context, char** errptr){
-    leveldb_writeoptions_t *writeoptions = leveldb_writeoptions_create();
+uint32_t ldb_context_key_stripe(const char* key, size_t keylen){
+    //fnv-1a
+    uint32_t h = 2166136261u;
+    for(size_t i = 0; i < keylen; ++i){
+        h ^= (uint8_t)key[i];
+        h *= 16777619u;
+    }
+    return h % LDB_KEY_LOCK_STRIPES;
+}
 
-    leveldb_mutex_lock(context->mutex_);
-    leveldb_write(context->database_, writeoptions, context->batch_, errptr);
-    leveldb_writebatch_clear(context->batch_);
-    leveldb_mutex_unlock(context->mutex_);
+void ldb_context_lock_key(ldb_context_t* context, const char* key, size_t keylen){
+    pthread_mutex_lock(&context->key_locks_[ldb_context_key_stripe(key, keylen)]);
+}
 
-    leveldb_writeoptions_destroy(writeoptions);
+void ldb_context_unlock_key(ldb_context_t* context, const char* key, size_t keylen){
+    pthread_mutex_unlock(&context->key_locks_[ldb_context_key_stripe(key, keylen)]);
 }
 
-void ldb_context_writebatch_put(ldb_context_t* context, const char* key, size_t klen, const char* val, size_t vlen){
-    leveldb_mutex_lock(context->mutex_);
-    leveldb_writebatch_put(context->batch_, key, klen, val, vlen);
-    leveldb_mutex_unlock(context->mutex_);
+static int compare_stripe(const void* a, const void* b){
+    uint32_t sa = *(const uint32_t*)a, sb = *(const uint32_t*)b;
+    return sa < sb ? -1 : (sa > sb ? 1 : 0);
 }
 
-void ldb_context_writebatch_delete(ldb_context_t* context, const char* key, size_t klen){
-    leveldb_mutex_lock(context->mutex_);
-    leveldb_writebatch_delete(context->batch_, key, klen);
-    leveldb_mutex_unlock(context->mutex_);
+size_t ldb_context_lock_stripes(ldb_context_t* context, uint32_t* stripes, size_t num){
+    if(num == 0){
+        return 0;
+    }
+    qsort(stripes, num, sizeof(uint32_t), compare_stripe);
+    size_t distinct = 1;
+    for(size_t i = 1; i < num; ++i){
+        if(stripes[i] != stripes[distinct-1]){
+            stripes[distinct++] = stripes[i];
+        }
+    }
+    for(size_t i = 0; i < distinct; ++i){
+        pthread_mutex_lock(&context->key_locks_[stripes[i]]);
+    }
+    return distinct;
 }
+
+void ldb_context_unlock_stripes(ldb_context_t* context, const uint32_t* stripes, size_t num){
+    while(num > 0){
+        pthread_mutex_unlock(&context->key_locks_[stripes[--num]]);
+    }
+}
+
+leveldb_iterator_t* ldb_context_iterator_acquire(ldb_context_t* context, uint64_t* psequence){
+    uint64_t sequence = leveldb_latest_sequence(context->database_);
+    leveldb_iterator_t* iterator = NULL;
+    leveldb_iterator_t* outdated[LDB_ITERATOR_POOL_SIZE];
+    size_t outdated_num = 0;
+    pthread_mutex_lock(&context->iterator_lock_);
+    while(context->iterator_num_ > 0){
+        ldb_pooled_iterator_t* pooled = &context->iterators_[--context->iterator_num_];
+        if(pooled->sequence_ == sequence){
+            iterator = pooled->iterator_;
+            break;
+        }
+        outdated[outdated_num++] = pooled->iterator_;
+    }
+    pthread_mutex_unlock(&context->iterator_lock_);
+    for(size_t i = 0; i < outdated_num; ++i){
+        leveldb_iter_destroy(outdated[i]);
+    }
+    if(iterator == NULL){
+        iterator = leveldb_create_iterator(context->database_, context->scanoptions_);
+    }
+    *psequence = sequence;
+    return iterator;
+}
+
+void ldb_context_iterator_release(ldb_context_t* context, leveldb_iterator_t* iterator, uint64_t sequence){
+    if(iterator == NULL){
+        return;
+    }
+    char* errptr = NULL;
+    leveldb_iter_get_error(iterator, &errptr);
+    if(errptr == NULL && sequence == leveldb_latest_sequence(context->database_)){
+        pthread_mutex_lock(&context->iterator_lock_);
+        if(context->iterator_num_ < LDB_ITERATOR_POOL_SIZE){
+            context->iterators_[context->iterator_num_].iterator_ = iterator;
+            context->iterators_[context->iterator_num_].sequence_ = sequence;
+            context->iterator_num_ += 1;
+            iterator = NULL;
+        }
+        pthread_mutex_unlock(&context->iterator_lock_);
+    }
+    if(errptr != NULL){
+        leveldb_free(errptr);
+    }
+    if(iterator != NULL){
+        leveldb_iter_destroy(iterator);
+    }
+}
+
@@ -3,35 +3,97 @@
 
 
 #include <leveldb/c.h>
+#include <pthread.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <unistd.h>
 
 
+#define LDB_ITERATOR_POOL_SIZE               16
+
+//block cache of ldb_context_create
+#define LDB_CACHE_LRU                        0
+#define LDB_CACHE_CLOCK                      1     //lookups share a reader lock
+#define LDB_CACHE_CLOCK_SHARD_BITS           6
+
+//flushes and compactions write at most this many MB per second, less while
+//the p99 of foreground writes is over LDB_WRITE_MICROS_TARGET
+#define LDB_COMPACTION_RATE_MB               1000
+#define LDB_WRITE_MICROS_TARGET              5000
+
+//tables are compacted once this share of their entries expired
+#define LDB_EXPIRED_COMPACTION_RATIO         0.3
+
+//commands reading a key before they write it hold the lock of its stripe
+#define LDB_KEY_LOCK_STRIPES                 4096
+
+typedef struct ldb_pooled_iterator_t{
+    leveldb_iterator_t*         iterator_;
+    uint64_t                    sequence_;   //latest write when it was created
+} ldb_pooled_iterator_t;
+
 struct ldb_context_t{
     leveldb_t*                  database_;
     leveldb_options_t*          options_;
     leveldb_filterpolicy_t*     filter_policy_;
     leveldb_cache_t*            block_cache_;
+    leveldb_ratelimiter_t*      rate_limiter_;
     leveldb_snapshot_t*         for_recovering_;
-    leveldb_writebatch_t*       batch_;
-    leveldb_mutex_t*            mutex_; //protect batch_
+    //shared by every call, never changed once the context is created
+    leveldb_readoptions_t*      readoptions_;
+    leveldb_readoptions_t*      scanoptions_;    //no block cache fill
+    leveldb_writeoptions_t*     writeoptions_;
+    pthread_mutex_t             iterator_lock_;
+    ldb_pooled_iterator_t       iterators_[LDB_ITERATOR_POOL_SIZE];
+    size_t                      iterator_num_;
+    //recursive, so that a command may call another one on the same key
+    pthread_mutex_t             key_locks_[LDB_KEY_LOCK_STRIPES];
+    struct ldb_async_t*         async_;          //see ldb_write_async
+    //names of the zsets with a rank index, sorted. loaded on first use
+    pthread_rwlock_t            zrank_lock_;
+    int                         zrank_loaded_;
+    struct ldb_slice_t**        zrank_names_;
+    size_t                      zrank_num_;
+    size_t                      zrank_cap_;
 };
 
 typedef struct ldb_context_t    ldb_context_t;
 
 
-ldb_context_t* ldb_context_create(const char* name, size_t cache_size, size_t write_buffer_size, int compression);
+//cache_type is LDB_CACHE_LRU or LDB_CACHE_CLOCK
+ldb_context_t* ldb_context_create(const char* name, size_t cache_size, size_t write_buffer_size, int compression, int cache_type);
 
 void ldb_context_destroy( ldb_context_t* context);
 
 void ldb_context_release_recovering_snapshot(ldb_context_t* context);
 
+int ldb_context_met_checkpoint_loaded(ldb_context_t* context);
+
 void ldb_context_do_write_recovering(ldb_context_t* context);
 
-void ldb_context_writebatch_commit(ldb_context_t* context, char** errptr);
+//changes the upper bound of the flush and compaction rate, 0 lifts it
+void ldb_context_set_compaction_rate(ldb_context_t* context, size_t mb_per_second);
+
+//the stripe of key in key_locks_
+uint32_t ldb_context_key_stripe(const char* key, size_t keylen);
+
+void ldb_context_lock_key(ldb_context_t* context, const char* key, size_t keylen);
+
+void ldb_context_unlock_key(ldb_context_t* context, const char* key, size_t keylen);
+
+//sorts and dedups the stripes in place and locks them in ascending order, so
+//that commands on several keys never wait on each other in a cycle. returns
+//the number of distinct stripes to be handed to ldb_context_unlock_stripes.
+size_t ldb_context_lock_stripes(ldb_context_t* context, uint32_t* stripes, size_t num);
+
+void ldb_context_unlock_stripes(ldb_context_t* context, const uint32_t* stripes, size_t num);
 
-void ldb_context_writebatch_put(ldb_context_t* context, const char* key, size_t klen, const char* val, size_t vlen);
+//an iterator over the latest state without the block cache fill, one from
+//the pool when no write happened since it was created. *psequence is to be
+//handed back to ldb_context_iterator_release.
+leveldb_iterator_t* ldb_context_iterator_acquire(ldb_context_t* context, uint64_t* psequence);
 
-void ldb_context_writebatch_delete(ldb_context_t* context, const char* key, size_t klen);
+//pools iterator for the next acquire or destroys it if it is outdated
+void ldb_context_iterator_release(ldb_context_t* context, leveldb_iterator_t* iterator, uint64_t sequence);
 
 #endif //LDB_CONTEXT_H
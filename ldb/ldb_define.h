@@ -13,9 +13,20 @@
 #define LDB_KEY_META_SIZE                    28
 #define LDB_VAL_META_SIZE                    9
 #define LDB_VAL_TYPE_SIZE                    1
+//type, version and the expire time if any
+#define LDB_VAL_HEADER_MAX_SIZE              17
 
 #define LDB_DATA_TYPE_KEY_LEN_MAX            255
 #define LDB_DATA_TYPE_ZSET_SCORE_WIDTH       9
+#define LDB_DATA_TYPE_ZRANK_LEVELS           8
+//sets up to this size are sampled by a scan, bigger ones by random seeks
+#define LDB_SET_SAMPLE_SCAN_MAX              1024
+#define LDB_SET_SAMPLE_SEEK_MAX              128
+//room for any scan cursor, a type byte, two lengths, name, separator and member
+#define LDB_SCAN_CURSOR_MAX                  (4 + 2 * LDB_DATA_TYPE_KEY_LEN_MAX)
+//room for any hash, set or zset key without the meta prefix, the score
+//of a zscore key comes on top of what a cursor holds
+#define LDB_KEY_BUF_SIZE                     (LDB_SCAN_CURSOR_MAX + LDB_DATA_TYPE_ZSET_SCORE_WIDTH)
 
 #define LDB_DATA_TYPE_STRING                 "t"
 #define LDB_DATA_TYPE_HASH                   "h" 
@@ -23,6 +34,7 @@
 #define LDB_DATA_TYPE_ZSET                   "s"
 #define LDB_DATA_TYPE_ZSCORE                 "z"
 #define LDB_DATA_TYPE_ZSIZE                  "Z"
+#define LDB_DATA_TYPE_ZRANK                  "r"
 #define LDB_DATA_TYPE_SET                    "e"
 #define LDB_DATA_TYPE_SSIZE                  "E"
 
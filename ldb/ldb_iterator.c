@@ -17,13 +17,23 @@ struct ldb_data_iterator_t {
     ldb_slice_t *end_;
     int direction_;
     uint64_t limit_;
+    ldb_context_t *context_;
     leveldb_iterator_t *iterator_;
+    uint64_t sequence_;
 };
 
 struct ldb_recov_iterator_t {
     leveldb_iterator_t *iterator_;
 };
 
+struct ldb_cursor_iterator_t {
+    ldb_slice_t *prefix_;
+    int valid_;
+    ldb_context_t *context_;
+    leveldb_iterator_t *iterator_;
+    uint64_t sequence_;
+};
+
 ldb_zset_iterator_t* ldb_zset_iterator_create(ldb_context_t *context, const ldb_slice_t *name, 
                                               ldb_slice_t *start, ldb_slice_t *end, uint64_t limit, int direction){
     ldb_zset_iterator_t *iterator = (ldb_zset_iterator_t*)lmalloc(sizeof(ldb_zset_iterator_t));
@@ -31,9 +41,8 @@ ldb_zset_iterator_t* ldb_zset_iterator_create(ldb_context_t *context, const ldb_
     iterator->end_ = ldb_slice_create(ldb_slice_data(end) + LDB_KEY_META_SIZE, ldb_slice_size(end) - LDB_KEY_META_SIZE);
     iterator->direction_ = direction;
     iterator->limit_ = limit;
-    leveldb_readoptions_t *readoptions = leveldb_readoptions_create();
-    leveldb_readoptions_set_fill_cache(readoptions, 0);
-    iterator->iterator_ = leveldb_create_iterator(context->database_, readoptions);
+    iterator->context_ = context;
+    iterator->iterator_ = ldb_context_iterator_acquire(context, &iterator->sequence_);
     leveldb_iter_seek(iterator->iterator_, ldb_slice_data(start) + LDB_KEY_META_SIZE, ldb_slice_size(start) - LDB_KEY_META_SIZE);
 
     if(iterator->direction_ == FORWARD){
@@ -52,7 +61,6 @@ ldb_zset_iterator_t* ldb_zset_iterator_create(ldb_context_t *context, const ldb_
         }
     }
 
-    leveldb_readoptions_destroy(readoptions);
     return iterator;
 }
 
@@ -60,7 +68,7 @@ void ldb_zset_iterator_destroy(ldb_zset_iterator_t* iterator){
     if(iterator!=NULL){
         ldb_slice_destroy(iterator->name_);
         ldb_slice_destroy(iterator->end_);
-        leveldb_iter_destroy(iterator->iterator_);
+        ldb_context_iterator_release(iterator->context_, iterator->iterator_, iterator->sequence_);
     }
     lfree(iterator);
 }
@@ -176,9 +184,8 @@ ldb_set_iterator_t* ldb_set_iterator_create(ldb_context_t *context, const ldb_sl
     iterator->end_ = ldb_slice_create(ldb_slice_data(end) + LDB_KEY_META_SIZE, ldb_slice_size(end) - LDB_KEY_META_SIZE);
     iterator->direction_ = direction;
     iterator->limit_ = limit;
-    leveldb_readoptions_t *readoptions = leveldb_readoptions_create();
-    leveldb_readoptions_set_fill_cache(readoptions, 0);
-    iterator->iterator_ = leveldb_create_iterator(context->database_, readoptions);
+    iterator->context_ = context;
+    iterator->iterator_ = ldb_context_iterator_acquire(context, &iterator->sequence_);
     leveldb_iter_seek(iterator->iterator_, ldb_slice_data(start) + LDB_KEY_META_SIZE, ldb_slice_size(start) - LDB_KEY_META_SIZE);
 
     if(iterator->direction_ == FORWARD){
@@ -197,7 +204,6 @@ ldb_set_iterator_t* ldb_set_iterator_create(ldb_context_t *context, const ldb_sl
         }
     }
 
-    leveldb_readoptions_destroy(readoptions);
     return iterator;
 }
 
@@ -205,7 +211,7 @@ void ldb_set_iterator_destroy(ldb_zset_iterator_t* iterator){
     if(iterator!=NULL){
         ldb_slice_destroy(iterator->name_);
         ldb_slice_destroy(iterator->end_);
-        leveldb_iter_destroy(iterator->iterator_);
+        ldb_context_iterator_release(iterator->context_, iterator->iterator_, iterator->sequence_);
     }
     lfree(iterator);
 }
@@ -323,9 +329,8 @@ ldb_hash_iterator_t* ldb_hash_iterator_create(ldb_context_t *context, const ldb_
     iterator->end_ = ldb_slice_create(ldb_slice_data(end) + LDB_KEY_META_SIZE, ldb_slice_size(end) - LDB_KEY_META_SIZE);
     iterator->direction_ = direction;
     iterator->limit_ = limit;
-    leveldb_readoptions_t *readoptions = leveldb_readoptions_create();
-    leveldb_readoptions_set_fill_cache(readoptions, 0);
-    iterator->iterator_ = leveldb_create_iterator(context->database_, readoptions);
+    iterator->context_ = context;
+    iterator->iterator_ = ldb_context_iterator_acquire(context, &iterator->sequence_);
     leveldb_iter_seek(iterator->iterator_, ldb_slice_data(start) + LDB_KEY_META_SIZE, ldb_slice_size(start) - LDB_KEY_META_SIZE);
     if(iterator->direction_ == FORWARD){
         if(leveldb_iter_valid(iterator->iterator_)){
@@ -342,7 +347,6 @@ ldb_hash_iterator_t* ldb_hash_iterator_create(ldb_context_t *context, const ldb_
             leveldb_iter_seek_to_last(iterator->iterator_);
         }
     }
-    leveldb_readoptions_destroy(readoptions);
     return iterator;
 }
 
@@ -350,7 +354,7 @@ void ldb_hash_iterator_destroy(ldb_hash_iterator_t* iterator){
     if(iterator!=NULL){
         ldb_slice_destroy(iterator->name_);
         ldb_slice_destroy(iterator->end_);
-        leveldb_iter_destroy(iterator->iterator_);
+        ldb_context_iterator_release(iterator->context_, iterator->iterator_, iterator->sequence_);
     }
     lfree(iterator);
 }
@@ -456,9 +460,8 @@ ldb_string_iterator_t* ldb_string_iterator_create(ldb_context_t *context, ldb_sl
     iterator->end_ = ldb_slice_create(ldb_slice_data(end) + LDB_KEY_META_SIZE, ldb_slice_size(end) - LDB_KEY_META_SIZE);
     iterator->direction_ = direction;
     iterator->limit_ = limit;
-    leveldb_readoptions_t *readoptions = leveldb_readoptions_create();
-    leveldb_readoptions_set_fill_cache(readoptions, 0);
-    iterator->iterator_ = leveldb_create_iterator(context->database_, readoptions);
+    iterator->context_ = context;
+    iterator->iterator_ = ldb_context_iterator_acquire(context, &iterator->sequence_);
     leveldb_iter_seek(iterator->iterator_, ldb_slice_data(start) + LDB_KEY_META_SIZE, ldb_slice_size(start) - LDB_KEY_META_SIZE);
     if(iterator->direction_ == FORWARD){
         if(leveldb_iter_valid(iterator->iterator_)){
@@ -475,7 +478,6 @@ ldb_string_iterator_t* ldb_string_iterator_create(ldb_context_t *context, ldb_sl
             leveldb_iter_seek_to_last(iterator->iterator_);
         }
     }
-    leveldb_readoptions_destroy(readoptions);
     return iterator;
 }
 
@@ -484,7 +486,7 @@ void ldb_string_iterator_destroy(ldb_string_iterator_t* iterator){
     if(iterator!=NULL){
         ldb_slice_destroy(iterator->name_);
         ldb_slice_destroy(iterator->end_);
-        leveldb_iter_destroy(iterator->iterator_);
+        ldb_context_iterator_release(iterator->context_, iterator->iterator_, iterator->sequence_);
     }
     lfree(iterator); 
 }
@@ -583,7 +585,7 @@ int ldb_string_iterator_valid(const ldb_string_iterator_t *iterator){
 }
 
 
-ldb_recov_iterator_t* ldb_recov_iterator_create(ldb_context_t *context){
+ldb_recov_iterator_t* ldb_recov_iterator_create(ldb_context_t *context, const char* start, size_t slen){
     ldb_recov_iterator_t *iterator = (ldb_recov_iterator_t*)lmalloc(sizeof(ldb_recov_iterator_t));
     leveldb_readoptions_t *readoptions = leveldb_readoptions_create();
     leveldb_readoptions_set_fill_cache(readoptions, 0);
@@ -591,6 +593,11 @@ ldb_recov_iterator_t* ldb_recov_iterator_create(ldb_context_t *context){
     leveldb_readoptions_set_snapshot(readoptions, context->for_recovering_);
     iterator->iterator_ = leveldb_create_iterator(context->database_, readoptions);
     leveldb_readoptions_destroy(readoptions);
+    if(start == NULL){
+        leveldb_iter_seek_to_first(iterator->iterator_);
+    }else{
+        leveldb_iter_seek(iterator->iterator_, start, slen);
+    }
     return iterator;
 }
 
@@ -616,7 +623,7 @@ int ldb_recov_iterator_next(ldb_recov_iterator_t *iterator){
         size_t vlen = 0;
         const char *val = leveldb_iter_value(iterator->iterator_, &vlen);
         assert(vlen >= LDB_VAL_META_SIZE);
-        uint64_t version = leveldb_decode_fixed64(val + LDB_VAL_META_SIZE);
+        uint64_t version = leveldb_decode_fixed64(val + LDB_VAL_TYPE_SIZE);
         if(version > 0){
             retval = 0;
             goto end;
@@ -650,3 +657,87 @@ const char* ldb_recov_iterator_key_raw(const ldb_recov_iterator_t *iterator, siz
 int ldb_recov_iterator_valid(const ldb_recov_iterator_t *iterator){
     return leveldb_iter_valid(iterator->iterator_); 
 }
+
+
+//skips the deleted and expired entries, leaves valid_ 0 past the prefix
+static void cursor_iterator_settle(ldb_cursor_iterator_t *iterator){
+    uint64_t now = 0;
+    iterator->valid_ = 0;
+    while(leveldb_iter_valid(iterator->iterator_)){
+        size_t klen = 0, vlen = 0;
+        const char *key = leveldb_iter_key(iterator->iterator_, &klen);
+        if(klen < ldb_slice_size(iterator->prefix_) ||
+           memcmp(key, ldb_slice_data(iterator->prefix_), ldb_slice_size(iterator->prefix_)) != 0){
+            return;
+        }
+        const char *val = leveldb_iter_value(iterator->iterator_, &vlen);
+        assert(vlen >= LDB_VAL_META_SIZE);
+        uint8_t type = leveldb_decode_fixed8(val);
+        int live = (type & LDB_VALUE_TYPE_VAL) && !(type & LDB_VALUE_TYPE_LAT);
+        if(live && (type & LDB_VALUE_TYPE_EXP)){
+            if(now == 0){
+                now = time_ms();
+            }
+            live = now < leveldb_decode_fixed64(val + LDB_VAL_META_SIZE);
+        }
+        if(live){
+            iterator->valid_ = 1;
+            return;
+        }
+        leveldb_iter_next(iterator->iterator_);
+    }
+}
+
+ldb_cursor_iterator_t* ldb_cursor_iterator_create(ldb_context_t *context, const char* prefix, size_t plen,
+                                                  const char* cursor, size_t cursorlen){
+    if(cursorlen > 0 && (cursorlen < plen || memcmp(cursor, prefix, plen) != 0)){
+        return NULL;
+    }
+    ldb_cursor_iterator_t *iterator = (ldb_cursor_iterator_t*)lmalloc(sizeof(ldb_cursor_iterator_t));
+    iterator->prefix_ = ldb_slice_create(prefix, plen);
+    iterator->context_ = context;
+    iterator->iterator_ = ldb_context_iterator_acquire(context, &iterator->sequence_);
+    if(cursorlen > 0){
+        leveldb_iter_seek(iterator->iterator_, cursor, cursorlen);
+        if(leveldb_iter_valid(iterator->iterator_)){
+            size_t klen = 0;
+            const char* key = leveldb_iter_key(iterator->iterator_, &klen);
+            if(compare_with_length(cursor, cursorlen, key, klen) == 0){
+                leveldb_iter_next(iterator->iterator_);
+            }
+        }
+    }else{
+        leveldb_iter_seek(iterator->iterator_, prefix, plen);
+    }
+    cursor_iterator_settle(iterator);
+    return iterator;
+}
+
+void ldb_cursor_iterator_destroy(ldb_cursor_iterator_t* iterator){
+    if(iterator!=NULL){
+        ldb_slice_destroy(iterator->prefix_);
+        ldb_context_iterator_release(iterator->context_, iterator->iterator_, iterator->sequence_);
+    }
+    lfree(iterator);
+}
+
+int ldb_cursor_iterator_next(ldb_cursor_iterator_t *iterator){
+    if(!iterator->valid_){
+        return -1;
+    }
+    leveldb_iter_next(iterator->iterator_);
+    cursor_iterator_settle(iterator);
+    return iterator->valid_ ? 0 : -1;
+}
+
+const char* ldb_cursor_iterator_key_raw(const ldb_cursor_iterator_t *iterator, size_t* klen){
+    return leveldb_iter_key(iterator->iterator_, klen);
+}
+
+const char* ldb_cursor_iterator_val_raw(const ldb_cursor_iterator_t *iterator, size_t* vlen){
+    return leveldb_iter_value(iterator->iterator_, vlen);
+}
+
+int ldb_cursor_iterator_valid(const ldb_cursor_iterator_t *iterator){
+    return iterator->valid_;
+}
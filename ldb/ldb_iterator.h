@@ -22,6 +22,8 @@ typedef struct ldb_data_iterator_t      ldb_set_iterator_t;
 
 typedef struct ldb_recov_iterator_t     ldb_recov_iterator_t;
 
+typedef struct ldb_cursor_iterator_t    ldb_cursor_iterator_t;
+
 
 ldb_zset_iterator_t* ldb_zset_iterator_create(ldb_context_t *context, const ldb_slice_t *name,
                                               ldb_slice_t *start, ldb_slice_t *end, uint64_t limit, int direction);
@@ -95,7 +97,8 @@ const char* ldb_string_iterator_key_raw(const ldb_string_iterator_t *iterator, s
 int ldb_string_iterator_valid(const ldb_string_iterator_t *iterator);
 
 
-ldb_recov_iterator_t* ldb_recov_iterator_create(ldb_context_t *context);
+//positioned at the first key at or after start, or at the first key if start is NULL
+ldb_recov_iterator_t* ldb_recov_iterator_create(ldb_context_t *context, const char* start, size_t slen);
 
 void ldb_recov_iterator_destroy(ldb_recov_iterator_t* iterator);
 
@@ -111,5 +114,22 @@ const char* ldb_recov_iterator_key_raw(const ldb_recov_iterator_t *iterator, siz
 
 int ldb_recov_iterator_valid(const ldb_recov_iterator_t *iterator);
 
+
+//walks the live entries whose keys start with prefix, after the key cursor
+//when cursorlen is not 0. NULL when cursor does not start with prefix.
+ldb_cursor_iterator_t* ldb_cursor_iterator_create(ldb_context_t *context, const char* prefix, size_t plen,
+                                                  const char* cursor, size_t cursorlen);
+
+void ldb_cursor_iterator_destroy(ldb_cursor_iterator_t* iterator);
+
+int ldb_cursor_iterator_next(ldb_cursor_iterator_t *iterator);
+
+const char* ldb_cursor_iterator_key_raw(const ldb_cursor_iterator_t *iterator, size_t* klen);
+
+//the value with its header
+const char* ldb_cursor_iterator_val_raw(const ldb_cursor_iterator_t *iterator, size_t* vlen);
+
+int ldb_cursor_iterator_valid(const ldb_cursor_iterator_t *iterator);
+
 #endif //LDB_ITERATOR_H
 
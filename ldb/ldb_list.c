@@ -2,6 +2,7 @@
 #include "ldb_slice.h"
 #include "ldb_meta.h"
 #include "ldb_define.h"
+#include "ldb_arena.h"
 
 #include "lmalloc.h"
 
@@ -9,10 +10,12 @@
 
 
 ldb_list_node_t* ldb_list_node_create(){
-  ldb_list_node_t *node = lmalloc(sizeof(ldb_list_node_t));
+  ldb_arena_t *arena = NULL;
+  ldb_list_node_t *node = ldb_arena_lmalloc(sizeof(ldb_list_node_t), &arena);
   if(node == NULL ){
     return NULL;
   }
+  node->arena_ = arena;
   node->next_ = NULL;
   node->prev_ = NULL;
   node->type_ = 0;
@@ -27,14 +30,16 @@ void ldb_list_node_destroy(ldb_list_node_t* node){
   }else if(node->type_ == LDB_LIST_NODE_TYPE_META){
     ldb_meta_destroy(node->data_);
   }
-  lfree(node);
+  ldb_arena_lfree(node->arena_, node);
 }
 
 ldb_list_t* ldb_list_create(){
-  ldb_list_t *list = lmalloc(sizeof(ldb_list_t));
+  ldb_arena_t *arena = NULL;
+  ldb_list_t *list = ldb_arena_lmalloc(sizeof(ldb_list_t), &arena);
   if(list == NULL){
     return NULL;
   }
+  list->arena_ = arena;
   list->head_ = NULL;
   list->tail_ = NULL;
   list->length_ = 0;
@@ -50,7 +55,7 @@ void ldb_list_destroy(ldb_list_t* list){
       list->length_ -= 1;
       list->head_ = node;
     }
-    lfree(list);
+    ldb_arena_lfree(list->arena_, list);
   }
 }
 
@@ -132,14 +137,18 @@ ldb_list_iterator_t* ldb_list_iterator_create(const ldb_list_t* list){
   if(list == NULL || list->head_== NULL){
     return NULL;
   }
-  ldb_list_iterator_t *iterator = lmalloc(sizeof(ldb_list_iterator_t));
+  ldb_arena_t *arena = NULL;
+  ldb_list_iterator_t *iterator = ldb_arena_lmalloc(sizeof(ldb_list_iterator_t), &arena);
+  iterator->arena_ = arena;
   iterator->next_ = list->head_;
   iterator->now_ = 0;
   return iterator;
 }
 
 void ldb_list_iterator_destroy(ldb_list_iterator_t* iterator){
-  lfree(iterator);
+  if(iterator != NULL){
+    ldb_arena_lfree(iterator->arena_, iterator);
+  }
 }
 
 ldb_list_node_t* ldb_list_next(ldb_list_iterator_t** piterator){
@@ -5,23 +5,28 @@
 #include <stddef.h>
 #include <stdint.h>
 
+struct ldb_arena_t;
+
 struct ldb_list_node_t {
   struct ldb_list_node_t* next_;
   struct ldb_list_node_t* prev_;
   uint32_t type_;
   uint64_t value_;
   void* data_;
+  struct ldb_arena_t* arena_;
 };
 
 struct ldb_list_t {
   struct ldb_list_node_t *head_;
   struct ldb_list_node_t *tail_;
   size_t length_;
+  struct ldb_arena_t* arena_;
 };
 
 struct ldb_list_iterator_t {
   struct ldb_list_node_t *next_;
   int now_; 
+  struct ldb_arena_t* arena_;
 };
 
 
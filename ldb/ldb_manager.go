@@ -9,18 +9,18 @@ package ldb
 import "C"
 
 import (
-	"hash/crc32"
+	"os"
 	"reflect"
 	"strconv"
 	"sync"
+	"sync/atomic"
+	"syscall"
 	"time"
 	"unsafe"
 
 	log "github.com/golang/glog"
 )
 
-var KEY_LOCK_NUM int = 8
-
 const (
 	VALUE_ITEM_SIZE = unsafe.Sizeof(C.value_item_t{})
 	DOUBLE_SIZE     = unsafe.Sizeof(C.double(0.0))
@@ -90,13 +90,25 @@ func GetRevisedExpireTime(ttl uint32, unit int) uint64 {
 	return uint64(nowTime + t)
 }
 
+// The C layer locks the keys a command reads before it writes them, so
+// ldbLock only keeps the context from being closed under running commands.
 type LdbManager struct {
-	inited     bool
-	readCnt    uint64
-	writeCnt   uint64
-	context    *C.ldb_context_t
-	ldbLock    sync.RWMutex
-	ldbKeyLock []sync.RWMutex
+	inited   bool
+	readCnt  uint64
+	writeCnt uint64
+	context  *C.ldb_context_t
+	ldbLock  sync.RWMutex
+	async    asyncWrites
+}
+
+// asyncWrites hands the completions of ExecPipelineAsync to their callbacks.
+// One goroutine waits on the eventfd of the C writer through the netpoller,
+// so waiting writes take no OS thread.
+type asyncWrites struct {
+	once  sync.Once
+	file  *os.File
+	tag   uint64
+	dones sync.Map // tag -> func(ret int)
 }
 
 func (manager *LdbManager) doLdbLock() {
@@ -115,53 +127,6 @@ func (manager *LdbManager) doLdbRUnlock() {
 	manager.ldbLock.RUnlock()
 }
 
-func getLockID(key string) uint32 {
-	v := crc32.ChecksumIEEE([]byte(key))
-	return uint32(v % uint32(KEY_LOCK_NUM))
-}
-
-func getMLockID(keys []string) []uint32 {
-	h := crc32.NewIEEE()
-	keymap := make(map[uint32]uint32)
-	for i := 0; i < len(keys); i += 1 {
-		h.Write([]byte(keys[i]))
-		v := h.Sum32()
-		keymap[uint32(v%uint32(KEY_LOCK_NUM))] = 1
-		h.Reset()
-	}
-	keyslice := make([]uint32, len(keymap))
-	i := 0
-	for f, _ := range keymap {
-		keyslice[i] = f
-		i += 1
-	}
-	return keyslice
-}
-
-func (manager *LdbManager) doLdbMKeyLock(ids []uint32) {
-	manager.doLdbLock()
-	for i := 0; i < len(ids); i += 1 {
-		manager.ldbKeyLock[ids[i]].Lock()
-	}
-}
-
-func (manager *LdbManager) doLdbMKeyUnlock(ids []uint32) {
-	manager.doLdbUnlock()
-	for i := 0; i < len(ids); i += 1 {
-		manager.ldbKeyLock[ids[i]].Unlock()
-	}
-}
-
-func (manager *LdbManager) doLdbKeyLock(id uint32) {
-	manager.doLdbRLock()
-	manager.ldbKeyLock[id].Lock()
-}
-
-func (manager *LdbManager) doLdbKeyUnlock(id uint32) {
-	defer manager.doLdbRUnlock()
-	manager.ldbKeyLock[id].Unlock()
-}
-
 func NewLdbManager() (*LdbManager, error) {
 	ldbManager := &LdbManager{
 		inited:   false,
@@ -184,13 +149,12 @@ func (manager *LdbManager) InitDB(file_path string, cache_size int, write_buffer
 	manager.context = (*C.ldb_context_t)(C.ldb_context_create(C.CString(file_path),
 		C.size_t(cache_size),
 		C.size_t(write_buffer_size),
-		C.int(1)))
+		C.int(1),
+		C.int(C.LDB_CACHE_CLOCK)))
 	if unsafe.Pointer(manager.context) == CNULL {
 		log.Errorf("leveldb_context_create error")
 		return -1
 	}
-	KEY_LOCK_NUM = 64
-	manager.ldbKeyLock = make([]sync.RWMutex, KEY_LOCK_NUM)
 	manager.inited = true
 
 	manager.RecoverMetaData()
@@ -202,6 +166,13 @@ func (manager *LdbManager) FinaliseDB() {
 	manager.doLdbLock()
 	defer manager.doLdbUnlock()
 	if manager.inited {
+		if manager.async.file != nil {
+			C.ldb_async_drain(manager.context)
+			manager.pollAsyncDones()
+			manager.async.file.Close()
+			manager.async.file = nil
+			manager.async.once = sync.Once{}
+		}
 		C.ldb_context_destroy(manager.context)
 		manager.inited = false
 	}
@@ -209,11 +180,19 @@ func (manager *LdbManager) FinaliseDB() {
 
 func (manager *LdbManager) RecoverMetaData() {
 	recovery := (*C.ldb_recovery_t)(CNULL)
+	last := time.Now()
 	for {
 		ret := C.ldb_recover_meta(manager.context, &recovery)
 		if int(ret) < 0 {
 			break
 		}
+		if time.Since(last) >= time.Second {
+			var keys C.uint64_t
+			var done, ranges C.int
+			C.ldb_recovery_progress(recovery, &keys, &done, &ranges)
+			log.Infof("RecoverMetaData keys %v ranges %v/%v", uint64(keys), int(done), int(ranges))
+			last = time.Now()
+		}
 		time.Sleep(time.Duration(2) * time.Millisecond)
 	}
 }
@@ -226,9 +205,8 @@ func (manager *LdbManager) SetExceptionTrace(programName string) {
 }
 
 func (manager *LdbManager) Expire(key string, seconds uint32, version StorageVersionType) int {
-	id := getLockID(key)
-	manager.doLdbKeyLock(id)
-	defer manager.doLdbKeyUnlock(id)
+	manager.doLdbRLock()
+	defer manager.doLdbRUnlock()
 
 	csKey := C.CString(key)
 	defer C.free(unsafe.Pointer(csKey))
@@ -247,9 +225,8 @@ func (manager *LdbManager) Expire(key string, seconds uint32, version StorageVer
 }
 
 func (manager *LdbManager) PExpire(key string, seconds uint32, version StorageVersionType) int {
-	id := getLockID(key)
-	manager.doLdbKeyLock(id)
-	defer manager.doLdbKeyUnlock(id)
+	manager.doLdbRLock()
+	defer manager.doLdbRUnlock()
 
 	csKey := C.CString(key)
 	defer C.free(unsafe.Pointer(csKey))
@@ -266,9 +243,8 @@ func (manager *LdbManager) PExpire(key string, seconds uint32, version StorageVe
 }
 
 func (manager *LdbManager) Persist(key string, version StorageVersionType) int {
-	id := getLockID(key)
-	manager.doLdbKeyLock(id)
-	defer manager.doLdbKeyUnlock(id)
+	manager.doLdbRLock()
+	defer manager.doLdbRUnlock()
 
 	csKey := C.CString(key)
 	defer C.free(unsafe.Pointer(csKey))
@@ -329,9 +305,8 @@ func (manager *LdbManager) PTtl(key string, remain *uint32) int {
 }
 
 func (manager *LdbManager) Set(key string, value StorageValueData, meta StorageMetaData, en SetOpt) int {
-	id := getLockID(key)
-	manager.doLdbKeyLock(id)
-	defer manager.doLdbKeyUnlock(id)
+	manager.doLdbRLock()
+	defer manager.doLdbRUnlock()
 
 	csKey := (*C.char)(StringPointer(key))
 	csVal := (*C.char)(StringPointer(value.Value))
@@ -359,9 +334,8 @@ func (manager *LdbManager) Set(key string, value StorageValueData, meta StorageM
 }
 
 func (manager *LdbManager) SetEx(key string, value StorageValueData, ttl uint32) int {
-	id := getLockID(key)
-	manager.doLdbKeyLock(id)
-	defer manager.doLdbKeyUnlock(id)
+	manager.doLdbRLock()
+	defer manager.doLdbRUnlock()
 
 	csKey := (*C.char)(StringPointer(key))         //C.CString(key)
 	csVal := (*C.char)(StringPointer(value.Value)) //C.CString(value.Value)
@@ -394,9 +368,8 @@ func (manager *LdbManager) SetEx(key string, value StorageValueData, ttl uint32)
 }
 
 func (manager *LdbManager) SetWithSecond(key string, value StorageValueData, meta StorageMetaData, args []string) int {
-	id := getLockID(key)
-	manager.doLdbKeyLock(id)
-	defer manager.doLdbKeyUnlock(id)
+	manager.doLdbRLock()
+	defer manager.doLdbRUnlock()
 
 	var en SetOpt
 	en = IS_EXIST_AND_EXPIRE
@@ -458,19 +431,21 @@ func (manager *LdbManager) Get(key string) (int, StorageByteValueData) {
 	defer manager.doLdbRUnlock()
 
 	csKey := (*C.char)(StringPointer(key))
-	var valueItem *C.value_item_t
-	valueItem = (*C.value_item_t)(CNULL)
+	// The value is read in place and copied once, into Go memory
+	var valueItem C.value_item_t
+	var pinned *C.leveldb_pinned_t
 
-	ret := C.ldb_get(manager.context,
+	ret := C.ldb_get_pinned(manager.context,
 		csKey,
 		C.size_t(len(key)),
-		&valueItem)
+		&valueItem,
+		&pinned)
 	iRet := int(ret)
 	value := StorageByteValueData{}
 	if iRet == 0 {
-		ConvertCValueItemPointer2GoByte(valueItem, 0, &value)
+		ConvertCValueItemPointer2GoByte(&valueItem, 0, &value)
 	}
-	FreeValueItems(valueItem, 1)
+	C.ldb_release_pinned(pinned)
 	return iRet, value
 }
 
@@ -479,25 +454,27 @@ func (manager *LdbManager) GetWithByte(key []byte) (int, StorageByteValueData) {
 	defer manager.doLdbRUnlock()
 
 	csKey := (*C.char)(unsafe.Pointer(&key[0]))
-	var valueItem *C.value_item_t
-	valueItem = (*C.value_item_t)(CNULL)
+	// The value is read in place and copied once, into Go memory
+	var valueItem C.value_item_t
+	var pinned *C.leveldb_pinned_t
 
-	ret := C.ldb_get(manager.context,
+	ret := C.ldb_get_pinned(manager.context,
 		csKey,
 		C.size_t(len(key)),
-		&valueItem)
+		&valueItem,
+		&pinned)
 	iRet := int(ret)
 	value := StorageByteValueData{}
 	if iRet == 0 {
-		ConvertCValueItemPointer2GoByte(valueItem, 0, &value)
+		ConvertCValueItemPointer2GoByte(&valueItem, 0, &value)
 	}
-	FreeValueItems(valueItem, 1)
+	C.ldb_release_pinned(pinned)
 	return iRet, value
 }
 
 func (manager *LdbManager) Del(keys []string, versions []StorageVersionType, meta StorageMetaData) (int, []int) {
-	manager.doLdbLock()
-	defer manager.doLdbUnlock()
+	manager.doLdbRLock()
+	defer manager.doLdbRUnlock()
 
 	if len(keys) != len(versions) {
 		log.Errorf("Del count dont match keys %d versions %d", len(keys), len(versions))
@@ -533,9 +510,8 @@ func (manager *LdbManager) Decrby(key string, meta StorageMetaData, version Stor
 }
 
 func (manager *LdbManager) IncrDecr(key string, meta StorageMetaData, version StorageVersionType, by int64, value *int64) int {
-	id := getLockID(string(key))
-	manager.doLdbKeyLock(id)
-	defer manager.doLdbKeyUnlock(id)
+	manager.doLdbRLock()
+	defer manager.doLdbRUnlock()
 
 	csKey := C.CString(key)
 
@@ -561,8 +537,8 @@ func (manager *LdbManager) IncrDecr(key string, meta StorageMetaData, version St
 }
 
 func (manager *LdbManager) MSet(keyVals [][]byte, versions []StorageVersionType, meta StorageMetaData, en SetOpt, results []uint64) int {
-	manager.doLdbLock()
-	defer manager.doLdbUnlock()
+	manager.doLdbRLock()
+	defer manager.doLdbRUnlock()
 
 	cSize := C.size_t(len(keyVals))
 	cEn := C.int(en)
@@ -612,9 +588,8 @@ func (manager *LdbManager) MGet(keys [][]byte, results *[][]byte, versions []uin
 }
 
 func (manager *LdbManager) HSet(key, field string, value StorageValueData, meta StorageMetaData) int {
-	id := getLockID(string(key))
-	manager.doLdbKeyLock(id)
-	defer manager.doLdbKeyUnlock(id)
+	manager.doLdbRLock()
+	defer manager.doLdbRUnlock()
 
 	csKey := C.CString(key)
 	csField := C.CString(field)
@@ -685,9 +660,8 @@ func (manager *LdbManager) HExists(key, field string) int {
 }
 
 func (manager *LdbManager) HIncrby(key, field string, version StorageVersionType, by int64, result *int64, meta StorageMetaData) int {
-	id := getLockID(string(key))
-	manager.doLdbKeyLock(id)
-	defer manager.doLdbKeyUnlock(id)
+	manager.doLdbRLock()
+	defer manager.doLdbRUnlock()
 
 	csKey := C.CString(key)
 	csField := C.CString(field)
@@ -716,9 +690,8 @@ func (manager *LdbManager) HIncrby(key, field string, version StorageVersionType
 }
 
 func (manager *LdbManager) HmSet(key string, values map[string]StorageValueData, meta StorageMetaData) (int, map[string]int) {
-	id := getLockID(string(key))
-	manager.doLdbKeyLock(id)
-	defer manager.doLdbKeyUnlock(id)
+	manager.doLdbRLock()
+	defer manager.doLdbRUnlock()
 
 	csKey := C.CString(key)
 	defer C.free(unsafe.Pointer(csKey))
@@ -834,9 +807,8 @@ func (manager *LdbManager) HmGet(key string, fields []string) (int, []StorageByt
 }
 
 func (manager *LdbManager) HDel(key string, fields map[string]StorageValueData, meta StorageMetaData) (int, map[string]int) {
-	id := getLockID(string(key))
-	manager.doLdbKeyLock(id)
-	defer manager.doLdbKeyUnlock(id)
+	manager.doLdbRLock()
+	defer manager.doLdbRUnlock()
 
 	csKey := C.CString(key)
 
@@ -1009,10 +981,77 @@ func (manager *LdbManager) HGetAll(key string) (ret int, values map[string]Stora
 	return iRet, members
 }
 
+// SCAN_PAGE_BUF_SIZE bounds the bytes one HScan/SScan/ZScan page copies out
+const SCAN_PAGE_BUF_SIZE = 1 << 20
+
+func newScanPage(count int, withValues, withScores bool) *C.ldb_scan_page_t {
+	page := (*C.ldb_scan_page_t)(C.calloc(1, C.size_t(unsafe.Sizeof(C.ldb_scan_page_t{}))))
+	page.count_ = C.size_t(count)
+	page.items_ = (*C.value_item_t)(C.calloc(C.size_t(count), C.size_t(VALUE_ITEM_SIZE)))
+	if withValues {
+		page.values_ = (*C.value_item_t)(C.calloc(C.size_t(count), C.size_t(VALUE_ITEM_SIZE)))
+	}
+	if withScores {
+		page.scores_ = (*C.int64_t)(C.calloc(C.size_t(count), C.size_t(INT64_SIZE)))
+	}
+	page.buf_ = (*C.char)(C.malloc(SCAN_PAGE_BUF_SIZE))
+	page.buflen_ = SCAN_PAGE_BUF_SIZE
+	return page
+}
+
+// the items point into buf_, they are not freed one by one
+func freeScanPage(page *C.ldb_scan_page_t) {
+	C.free(unsafe.Pointer(page.items_))
+	C.free(unsafe.Pointer(page.values_))
+	C.free(unsafe.Pointer(page.scores_))
+	C.free(unsafe.Pointer(page.buf_))
+	C.free(unsafe.Pointer(page))
+}
+
+func scanCursor(cursor []byte) (*C.char, C.size_t) {
+	if len(cursor) == 0 {
+		return (*C.char)(CNULL), 0
+	}
+	return (*C.char)(unsafe.Pointer(&cursor[0])), C.size_t(len(cursor))
+}
+
+func scanNext(page *C.ldb_scan_page_t) []byte {
+	if page.nextlen_ == 0 {
+		return nil
+	}
+	return C.GoBytes(unsafe.Pointer(&page.next_[0]), C.int(page.nextlen_))
+}
+
+// HScan returns up to count fields with their values after cursor, nil for
+// the first page, and the cursor of the next page, nil once the hash is done
+func (manager *LdbManager) HScan(key string, cursor []byte, count int) (int, []StorageByteValueData, []StorageByteValueData, []byte) {
+	manager.doLdbRLock()
+	defer manager.doLdbRUnlock()
+
+	csKey := C.CString(key)
+	defer C.free(unsafe.Pointer(csKey))
+
+	page := newScanPage(count, true, false)
+	defer freeScanPage(page)
+
+	cCursor, cCursorLen := scanCursor(cursor)
+	iRet := int(C.ldb_hscan(manager.context, csKey, C.size_t(len(key)), cCursor, cCursorLen, page))
+
+	var fields, values []StorageByteValueData
+	if iRet == 0 {
+		fields = make([]StorageByteValueData, int(page.itemnum_))
+		values = make([]StorageByteValueData, int(page.itemnum_))
+		for i := 0; i < int(page.itemnum_); i += 1 {
+			ConvertCValueItemPointer2GoByte(page.items_, i, &fields[i])
+			ConvertCValueItemPointer2GoByte(page.values_, i, &values[i])
+		}
+	}
+	return iRet, fields, values, scanNext(page)
+}
+
 func (manager *LdbManager) SAdd(key string, values []StorageValueData, meta StorageMetaData) (int, []int) {
-	id := getLockID(key)
-	manager.doLdbKeyLock(id)
-	defer manager.doLdbKeyUnlock(id)
+	manager.doLdbRLock()
+	defer manager.doLdbRUnlock()
 
 	csKey := C.CString(key)
 
@@ -1092,10 +1131,33 @@ func (manager *LdbManager) SMembers(key string) (int, []StorageByteValueData) {
 	return iRet, values
 }
 
+// SScan pages through the members like HScan
+func (manager *LdbManager) SScan(key string, cursor []byte, count int) (int, []StorageByteValueData, []byte) {
+	manager.doLdbRLock()
+	defer manager.doLdbRUnlock()
+
+	csKey := C.CString(key)
+	defer C.free(unsafe.Pointer(csKey))
+
+	page := newScanPage(count, false, false)
+	defer freeScanPage(page)
+
+	cCursor, cCursorLen := scanCursor(cursor)
+	iRet := int(C.ldb_sscan(manager.context, csKey, C.size_t(len(key)), cCursor, cCursorLen, page))
+
+	var members []StorageByteValueData
+	if iRet == 0 {
+		members = make([]StorageByteValueData, int(page.itemnum_))
+		for i := 0; i < int(page.itemnum_); i += 1 {
+			ConvertCValueItemPointer2GoByte(page.items_, i, &members[i])
+		}
+	}
+	return iRet, members, scanNext(page)
+}
+
 func (manager *LdbManager) SPop(key string, meta StorageMetaData) (int, StorageByteValueData) {
-	id := getLockID(key)
-	manager.doLdbKeyLock(id)
-	defer manager.doLdbKeyUnlock(id)
+	manager.doLdbRLock()
+	defer manager.doLdbRUnlock()
 
 	log.Errorf("Dont support SPop at present!")
 
@@ -1107,6 +1169,7 @@ func (manager *LdbManager) SPop(key string, meta StorageMetaData) (int, StorageB
 
 	var valueItem *C.value_item_t
 	valueItem = (*C.value_item_t)(CNULL)
+	size := C.size_t(0)
 
 	version := StorageVersionType((time.Now().UnixNano() / 1000) << 8)
 
@@ -1115,25 +1178,55 @@ func (manager *LdbManager) SPop(key string, meta StorageMetaData) (int, StorageB
 		C.size_t(len(key)),
 		C.uint64_t(meta.Lastversion),
 		C.int(meta.Versioncare),
+		C.uint64_t(1),
 		&valueItem,
+		&size,
 		C.uint64_t(version))
 	iRet := int(ret)
 
 	value := StorageByteValueData{}
 
-	if iRet == 0 {
+	if iRet == 0 && int(size) > 0 {
 		ConvertCValueItemPointer2GoByte(valueItem, 0, &value)
 	}
 
-	FreeValueItems(valueItem, 1)
+	FreeValueItems(valueItem, size)
 
 	return iRet, value
 }
 
+func (manager *LdbManager) SRandMember(key string, count int64) (int, []StorageByteValueData) {
+	manager.doLdbRLock()
+	defer manager.doLdbRUnlock()
+
+	csKey := C.CString(key)
+
+	defer C.free(unsafe.Pointer(csKey))
+
+	var valueItems *C.value_item_t
+	valueItems = (*C.value_item_t)(CNULL)
+	size := C.size_t(0)
+
+	ret := C.ldb_srandmember(manager.context, csKey, C.size_t(len(key)), C.int64_t(count), &valueItems, &size)
+	iRet := int(ret)
+
+	var values []StorageByteValueData
+
+	if iRet == 0 {
+		values = make([]StorageByteValueData, int(size))
+		for i := 0; i < int(size); i += 1 {
+			ConvertCValueItemPointer2GoByte(valueItems, i, &values[i])
+		}
+	}
+
+	FreeValueItems(valueItems, size)
+
+	return iRet, values
+}
+
 func (manager *LdbManager) SRem(key string, values []StorageValueData, meta StorageMetaData) (int, []int) {
-	id := getLockID(key)
-	manager.doLdbKeyLock(id)
-	defer manager.doLdbKeyUnlock(id)
+	manager.doLdbRLock()
+	defer manager.doLdbRUnlock()
 
 	csKey := C.CString(key)
 
@@ -1211,9 +1304,8 @@ func (manager *LdbManager) SIsMember(key string, value string) int {
 }
 
 func (manager *LdbManager) ZAdd(key string, scoreValues []StorageScoreValueData, meta StorageMetaData) (int, []int) {
-	id := getLockID(key)
-	manager.doLdbKeyLock(id)
-	defer manager.doLdbKeyUnlock(id)
+	manager.doLdbRLock()
+	defer manager.doLdbRUnlock()
 
 	csKey := C.CString(key)
 
@@ -1271,9 +1363,8 @@ func (manager *LdbManager) ZAdd(key string, scoreValues []StorageScoreValueData,
 }
 
 func (manager *LdbManager) ZRem(key string, values []StorageValueData, meta StorageMetaData) (int, []int) {
-	id := getLockID(key)
-	manager.doLdbKeyLock(id)
-	defer manager.doLdbKeyUnlock(id)
+	manager.doLdbRLock()
+	defer manager.doLdbRUnlock()
 
 	csKey := C.CString(key)
 
@@ -1363,6 +1454,19 @@ func (manager *LdbManager) ZCard(key string) (int, uint64) {
 	return int(ret), uint64(cSize)
 }
 
+func (manager *LdbManager) ZRankIndex(key string) int {
+	manager.doLdbRLock()
+	defer manager.doLdbRUnlock()
+
+	csKey := C.CString(key)
+
+	defer C.free(unsafe.Pointer(csKey))
+
+	ret := C.ldb_zrank_index(manager.context, csKey, C.size_t(len(key)))
+
+	return int(ret)
+}
+
 func (manager *LdbManager) ZScore(key string, value StorageValueData) (int, int64) {
 	manager.doLdbRLock()
 	defer manager.doLdbRUnlock()
@@ -1493,6 +1597,33 @@ func (manager *LdbManager) ZRevrange(key string, start, end, withscore int) (int
 	return iRet, values, scores
 }
 
+// ZScan pages through the members with their scores, in member order
+func (manager *LdbManager) ZScan(key string, cursor []byte, count int) (int, []StorageByteValueData, []int64, []byte) {
+	manager.doLdbRLock()
+	defer manager.doLdbRUnlock()
+
+	csKey := C.CString(key)
+	defer C.free(unsafe.Pointer(csKey))
+
+	page := newScanPage(count, false, true)
+	defer freeScanPage(page)
+
+	cCursor, cCursorLen := scanCursor(cursor)
+	iRet := int(C.ldb_zscan(manager.context, csKey, C.size_t(len(key)), cCursor, cCursorLen, page))
+
+	var members []StorageByteValueData
+	var scores []int64
+	if iRet == 0 {
+		members = make([]StorageByteValueData, int(page.itemnum_))
+		scores = make([]int64, int(page.itemnum_))
+		for i := 0; i < int(page.itemnum_); i += 1 {
+			ConvertCValueItemPointer2GoByte(page.items_, i, &members[i])
+			ConvertCInt64Pointer2Go(page.scores_, i, &scores[i])
+		}
+	}
+	return iRet, members, scores, scanNext(page)
+}
+
 func (manager *LdbManager) ZRangeByScore(key string, min, max string, withscore int, reverse int) (int, []StorageByteValueData, []int64) {
 	manager.doLdbRLock()
 	defer manager.doLdbRUnlock()
@@ -1564,9 +1695,8 @@ func (manager *LdbManager) ZRangeByScore(key string, min, max string, withscore
 }
 
 func (manager *LdbManager) ZRemRangeByScore(key string, min, max string, version StorageVersionType, meta StorageMetaData) (int, uint64) {
-	id := getLockID(key)
-	manager.doLdbKeyLock(id)
-	defer manager.doLdbKeyUnlock(id)
+	manager.doLdbRLock()
+	defer manager.doLdbRUnlock()
 
 	csKey := C.CString(key)
 
@@ -1637,3 +1767,101 @@ func (manager *LdbManager) ZRevRank(key string, value StorageValueData) (int, ui
 
 	return int(ret), uint64(cRank)
 }
+
+func (manager *LdbManager) ExecPipeline(p *StoragePipeline) (int, []StoragePipelineResult) {
+	manager.doLdbRLock()
+	defer manager.doLdbRUnlock()
+
+	if p.n == 0 {
+		return STORAGE_OK, nil
+	}
+	cResults := (*C.ldb_exec_result_t)(C.malloc(C.size_t(p.n) * C.size_t(unsafe.Sizeof(C.ldb_exec_result_t{}))))
+	defer C.free(unsafe.Pointer(cResults))
+
+	ret := C.ldb_exec_batch(manager.context,
+		(*C.char)(unsafe.Pointer(&p.buf[0])),
+		C.size_t(len(p.buf)),
+		C.size_t(p.n),
+		cResults)
+
+	results := make([]StoragePipelineResult, p.n)
+	for i := 0; i < p.n; i++ {
+		result := (*C.ldb_exec_result_t)(unsafe.Pointer(uintptr(unsafe.Pointer(cResults)) + uintptr(i)*unsafe.Sizeof(C.ldb_exec_result_t{})))
+		results[i].Ret = int(result.retval_)
+		results[i].Num = int64(result.num_)
+		if unsafe.Pointer(result.item_.data_) != CNULL {
+			ConvertCValueItemPointer2GoByte(&result.item_, 0, &results[i].Value)
+			C.free_value_item(&result.item_)
+		}
+	}
+	return int(ret), results
+}
+
+// ExecPipelineAsync queues the sets and deletes of p as one write and returns
+// without waiting for it, done gets the result once it is written. Reads see
+// the writes only from then on.
+func (manager *LdbManager) ExecPipelineAsync(p *StoragePipeline, done func(ret int)) int {
+	manager.doLdbRLock()
+	defer manager.doLdbRUnlock()
+
+	if p.n == 0 {
+		return STORAGE_ERR
+	}
+	manager.async.once.Do(manager.startAsyncPoller)
+	if manager.async.file == nil {
+		return STORAGE_ERR
+	}
+	tag := atomic.AddUint64(&manager.async.tag, 1)
+	manager.async.dones.Store(tag, done)
+	ret := C.ldb_exec_batch_async(manager.context,
+		(*C.char)(unsafe.Pointer(&p.buf[0])),
+		C.size_t(len(p.buf)),
+		C.size_t(p.n),
+		C.uint64_t(tag))
+	if int(ret) != STORAGE_OK {
+		manager.async.dones.Delete(tag)
+	}
+	return int(ret)
+}
+
+func (manager *LdbManager) startAsyncPoller() {
+	// our own copy, the C side closes its fd with the context
+	fd, err := syscall.Dup(int(C.ldb_async_fd(manager.context)))
+	if err != nil {
+		log.Errorf("ExecPipelineAsync no eventfd: %v", err)
+		return
+	}
+	syscall.SetNonblock(fd, true)
+	manager.async.file = os.NewFile(uintptr(fd), "ldb-async")
+	go func(file *os.File) {
+		var count [8]byte
+		for {
+			if _, err := file.Read(count[:]); err != nil {
+				return
+			}
+			manager.doLdbRLock()
+			if manager.inited {
+				manager.pollAsyncDones()
+			}
+			manager.doLdbRUnlock()
+		}
+	}(manager.async.file)
+}
+
+// The callbacks run on their own goroutines, they may call into the manager.
+func (manager *LdbManager) pollAsyncDones() {
+	var dones [256]C.ldb_async_done_t
+	for {
+		n := int(C.ldb_async_poll(manager.context, &dones[0], C.size_t(len(dones))))
+		for i := 0; i < n; i++ {
+			tag := uint64(dones[i].tag_)
+			if done, ok := manager.async.dones.Load(tag); ok {
+				manager.async.dones.Delete(tag)
+				go done.(func(int))(int(dones[i].retval_))
+			}
+		}
+		if n < len(dones) {
+			return
+		}
+	}
+}
@@ -3,7 +3,7 @@ package ldb
 import (
 	"fmt"
 	"testing"
-	_ "time"
+	"time"
 )
 
 var _engine *LdbManager
@@ -62,3 +62,149 @@ func TestString(t *testing.T) {
 	}
 	fmt.Printf("Ttl key %s ttl %v\n", key, ttl)
 }
+
+func TestHScan(t *testing.T) {
+	engine, err := GetLdbManager()
+	if err != nil {
+		t.Fatalf("GetLdbManager error\n")
+	}
+	key := string("hscan1")
+	meta := StorageMetaData{
+		0,
+		0,
+		0,
+	}
+	for i := 0; i < 10; i += 1 {
+		value := StorageValueData{
+			fmt.Sprintf("value%d", i),
+			1 << 8,
+		}
+		if ret := engine.HSet(key, fmt.Sprintf("field%d", i), value, meta); ret != STORAGE_OK {
+			t.Fatalf("HSet error, ret %d", ret)
+		}
+	}
+
+	var cursor []byte
+	seen := 0
+	for {
+		ret, fields, values, next := engine.HScan(key, cursor, 3)
+		if ret != STORAGE_OK {
+			t.Fatalf("HScan error, ret %d", ret)
+		}
+		for i := range fields {
+			if string(fields[i].Value) != fmt.Sprintf("field%d", seen) ||
+				string(values[i].Value) != fmt.Sprintf("value%d", seen) {
+				t.Errorf("HScan got %s=%s at %d", fields[i].Value, values[i].Value, seen)
+			}
+			seen += 1
+		}
+		if next == nil {
+			break
+		}
+		cursor = next
+	}
+	if seen != 10 {
+		t.Errorf("HScan saw %d fields", seen)
+	}
+}
+
+func TestPipeline(t *testing.T) {
+	engine, err := GetLdbManager()
+	if err != nil {
+		t.Fatalf("GetLdbManager error\n")
+	}
+	meta := StorageMetaData{
+		0,
+		0,
+		0,
+	}
+	version := StorageVersionType(1 << 20)
+	// counters and collections of their own on every run
+	run := fmt.Sprint(time.Now().UnixNano())
+	p := &StoragePipeline{}
+	p.Set("pipe1", StorageValueData{"value1", version}, meta)
+	p.Set("pipe2", StorageValueData{"value2", version}, meta)
+	p.Get("pipe1")
+	p.Del("pipe2", version+1, meta)
+	p.Get("pipe2")
+	p.Incrby("pipe3"+run, version, 5, meta)
+	p.Incrby("pipe3"+run, version+1, 5, meta)
+	p.HSet("pipeh"+run, "field", StorageValueData{"hvalue", version}, meta)
+	p.HGet("pipeh"+run, "field")
+	p.HLen("pipeh" + run)
+	p.SAdd("pipes"+run, StorageValueData{"m1", version}, meta)
+	p.SAdd("pipes"+run, StorageValueData{"m2", version}, meta)
+	p.SIsMember("pipes"+run, "m2")
+	p.SCard("pipes" + run)
+	p.ZAdd("pipez"+run, StorageScoreValueData{"m1", version, 10}, meta)
+	p.ZIncrby("pipez"+run, StorageValueData{"m1", version + 1}, 5, meta)
+	p.ZScore("pipez"+run, "m1")
+	p.ZCard("pipez" + run)
+
+	ret, results := engine.ExecPipeline(p)
+	if ret != STORAGE_OK || len(results) != p.Len() {
+		t.Fatalf("ExecPipeline error, ret %d, %d results", ret, len(results))
+	}
+	rets := []int{STORAGE_OK, STORAGE_OK, STORAGE_OK, STORAGE_OK, STORAGE_OK_NOT_EXIST, STORAGE_OK, STORAGE_OK,
+		STORAGE_OK, STORAGE_OK, STORAGE_OK, STORAGE_OK, STORAGE_OK, STORAGE_OK, STORAGE_OK,
+		STORAGE_OK, STORAGE_OK, STORAGE_OK, STORAGE_OK}
+	for i := range rets {
+		if results[i].Ret != rets[i] {
+			t.Errorf("ExecPipeline command %d ret %d, want %d", i, results[i].Ret, rets[i])
+		}
+	}
+	if string(results[2].Value.Value) != "value1" || results[2].Value.Version != version {
+		t.Errorf("ExecPipeline get %s version %d", results[2].Value.Value, results[2].Value.Version)
+	}
+	if results[6].Num != 10 {
+		t.Errorf("ExecPipeline incrby %d", results[6].Num)
+	}
+	if string(results[8].Value.Value) != "hvalue" || results[9].Num != 1 {
+		t.Errorf("ExecPipeline hget %s hlen %d", results[8].Value.Value, results[9].Num)
+	}
+	if results[13].Num != 2 {
+		t.Errorf("ExecPipeline scard %d", results[13].Num)
+	}
+	if results[15].Num != 15 || results[16].Num != 15 || results[17].Num != 1 {
+		t.Errorf("ExecPipeline zincrby %d zscore %d zcard %d", results[15].Num, results[16].Num, results[17].Num)
+	}
+}
+
+func TestPipelineAsync(t *testing.T) {
+	engine, err := GetLdbManager()
+	if err != nil {
+		t.Fatalf("GetLdbManager error\n")
+	}
+	meta := StorageMetaData{
+		0,
+		0,
+		0,
+	}
+	version := StorageVersionType(1 << 20)
+	rets := make(chan int, 50)
+	for i := 0; i < 50; i += 1 {
+		p := &StoragePipeline{}
+		p.Set(fmt.Sprintf("async%d", i), StorageValueData{fmt.Sprintf("value%d", i), version}, meta)
+		p.Set(fmt.Sprintf("async%d.2", i), StorageValueData{"second", version}, meta)
+		if ret := engine.ExecPipelineAsync(p, func(ret int) { rets <- ret }); ret != STORAGE_OK {
+			t.Fatalf("ExecPipelineAsync error, ret %d", ret)
+		}
+	}
+	for i := 0; i < 50; i += 1 {
+		if ret := <-rets; ret != STORAGE_OK {
+			t.Errorf("ExecPipelineAsync done ret %d", ret)
+		}
+	}
+	for i := 0; i < 50; i += 1 {
+		ret, value := engine.Get(fmt.Sprintf("async%d", i))
+		if ret != STORAGE_OK || string(value.Value) != fmt.Sprintf("value%d", i) {
+			t.Errorf("Get async%d ret %d value %s", i, ret, value.Value)
+		}
+	}
+
+	p := &StoragePipeline{}
+	p.Get("async0")
+	if ret := engine.ExecPipelineAsync(p, func(ret int) {}); ret != STORAGE_ERR {
+		t.Errorf("ExecPipelineAsync took a read, ret %d", ret)
+	}
+}
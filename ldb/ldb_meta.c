@@ -1,4 +1,5 @@
 #include "ldb_meta.h"
+#include "ldb_arena.h"
 #include "lmalloc.h"
 
 #include <leveldb/c.h>
@@ -10,10 +11,13 @@ struct ldb_meta_t{
   uint64_t lastver_;
   uint64_t nextver_; 
   uint64_t exptime_;
+  ldb_arena_t* arena_;
 };
 
 ldb_meta_t* ldb_meta_create(uint32_t vercare, uint64_t lastver, uint64_t nextver){
-  ldb_meta_t* meta = (ldb_meta_t*)lmalloc(sizeof(ldb_meta_t)); 
+  ldb_arena_t* arena = NULL;
+  ldb_meta_t* meta = (ldb_meta_t*)ldb_arena_lmalloc(sizeof(ldb_meta_t), &arena); 
+  meta->arena_ = arena;
   meta->vercare_ = vercare;
   meta->lastver_ = lastver;
   meta->nextver_ = nextver;
@@ -23,7 +27,9 @@ ldb_meta_t* ldb_meta_create(uint32_t vercare, uint64_t lastver, uint64_t nextver
 
 
 ldb_meta_t* ldb_meta_create_with_exp(uint32_t vercare, uint64_t lastver, uint64_t nextver, uint64_t exptime){
-  ldb_meta_t* meta = (ldb_meta_t*)lmalloc(sizeof(ldb_meta_t)); 
+  ldb_arena_t* arena = NULL;
+  ldb_meta_t* meta = (ldb_meta_t*)ldb_arena_lmalloc(sizeof(ldb_meta_t), &arena); 
+  meta->arena_ = arena;
   meta->vercare_ = vercare;
   meta->lastver_ = lastver;
   meta->nextver_ = nextver;
@@ -32,7 +38,9 @@ ldb_meta_t* ldb_meta_create_with_exp(uint32_t vercare, uint64_t lastver, uint64_
 }
 
 void ldb_meta_destroy(ldb_meta_t* meta){
-  lfree(meta);
+  if(meta != NULL){
+    ldb_arena_lfree(meta->arena_, meta);
+  }
 }
 
 
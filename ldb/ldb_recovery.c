@@ -1,106 +1,242 @@
 #include "ldb_recovery.h"
-#include "ldb_slice.h"
 #include "ldb_iterator.h"
 #include "ldb_define.h"
-#include "ldb_list.h"
-#include "ldb_meta.h"
 
 #include "lmalloc.h"
 #include "util.h"
 
 
 #include <leveldb/c.h>
+#include <pthread.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <unistd.h>
+
+//candidate boundaries are the two byte prefixes of the keys
+#define LDB_RECOVERY_PREFIX_SIZE             2
+
+typedef struct ldb_recovery_range_t {
+    ldb_context_t*      context_;
+    char*               start_;     //NULL scans from the first key
+    size_t              start_len_;
+    char*               limit_;     //NULL scans up to the last key
+    size_t              limit_len_;
+    pthread_t           thread_;
+    int                 started_;
+    uint64_t            keys_;
+    int                 done_;
+} ldb_recovery_range_t;
 
 struct ldb_recovery_t {
-    ldb_recov_iterator_t* iter_;
+    ldb_recovery_range_t*   ranges_;
+    int                     nranges_;
 };
 
-ldb_recovery_t* ldb_recovery_create( ldb_context_t* context ){
-    ldb_recovery_t *recovery = (ldb_recovery_t*)lmalloc(sizeof(ldb_recovery_t)); 
-    recovery->iter_ = ldb_recov_iterator_create(context);
-    return recovery;
+static int compare_key(const char* key, size_t klen, const char* limit, size_t limit_len){
+    size_t len = klen < limit_len ? klen : limit_len;
+    int ret = memcmp(key, limit, len);
+    if(ret == 0){
+        ret = (klen < limit_len) ? -1 : (klen > limit_len);
+    }
+    return ret;
 }
 
-
-void ldb_recovery_destroy( ldb_recovery_t* recovery ){
-    if(recovery!=NULL){
-        ldb_recov_iterator_destroy(recovery->iter_);
+static void* recovery_range_run(void* arg){
+    ldb_recovery_range_t* range = (ldb_recovery_range_t*)arg;
+    ldb_recov_iterator_t* iter = ldb_recov_iterator_create(range->context_, range->start_, range->start_len_);
+    if(!ldb_recov_iterator_valid(iter)){
+        goto end;
     }
-    lfree(recovery);
-}
+    do{
+        size_t klen = 0, vlen = 0;
+        const char* key = ldb_recov_iterator_key_raw(iter, &klen);
+        if(range->limit_ != NULL && compare_key(key, klen, range->limit_, range->limit_len_) >= 0){
+            break;
+        }
+        const char* val = ldb_recov_iterator_val_raw(iter, &vlen);
+        if(vlen < LDB_VAL_META_SIZE){
+            fprintf(stderr, "%s iterator encountered invalid value length %lu.\n", __func__, vlen);
+            continue;
+        }
+        uint64_t version = leveldb_decode_fixed64(val + LDB_VAL_TYPE_SIZE);
+        if(version == 0){
+            continue;
+        }
+        char* errptr = NULL;
+        leveldb_put_meta_version(range->context_->database_, key, klen, version, &errptr);
+        if(errptr != NULL){
+            fprintf(stderr, "%s leveldb_put_meta_version failed %s.\n", __func__, errptr);
+            leveldb_free(errptr);
+            break;
+        }
+        __sync_add_and_fetch(&range->keys_, 1);
+    }while(ldb_recov_iterator_next(iter) == 0);
 
-static int check_recovery_valid(ldb_recovery_t* recovery){
-    return ldb_recov_iterator_valid(recovery->iter_);
+end:
+    ldb_recov_iterator_destroy(iter);
+    __sync_lock_test_and_set(&range->done_, 1);
+    return NULL;
 }
 
-static int ldb_recovery_next(ldb_recovery_t* recovery){
-    int retval = ldb_recov_iterator_next(recovery->iter_);
-    if(retval<0){
-        return -1;
-    }
-    return 0;
+static char* copy_key(const char* key, size_t len){
+    char* result = (char*)lmalloc(len);
+    memcpy(result, key, len);
+    return result;
 }
 
-int ldb_recovery_rec(ldb_context_t* context, ldb_recovery_t* recovery){
-    int retval = 0;
-    ldb_slice_t *slice_key = NULL;
+//picks at most nranges-1 split keys among the two byte prefixes that lie
+//between the first and the last key, so that the ranges in between hold
+//about as many bytes each according to leveldb_approximate_sizes, returns
+//the number of split keys stored in splits
+static int recovery_split(ldb_context_t* context, int nranges, char (*splits)[LDB_RECOVERY_PREFIX_SIZE]){
+    int nsplits = 0;
+    leveldb_readoptions_t* readoptions = leveldb_readoptions_create();
+    leveldb_readoptions_set_fill_cache(readoptions, 0);
+    leveldb_readoptions_set_snapshot(readoptions, context->for_recovering_);
+    leveldb_iterator_t* iterator = leveldb_create_iterator(context->database_, readoptions);
+    leveldb_readoptions_destroy(readoptions);
 
-    size_t vlen = 0;
-    const char *val = ldb_recov_iterator_val_raw(recovery->iter_, &vlen);
-    if(vlen < LDB_VAL_META_SIZE){
-        fprintf(stderr, "%s iterator encountered invalid value length %lu.\n", __func__, vlen);
-        retval = 0; 
+    unsigned char first = 0, last = 0;
+    size_t klen = 0;
+    leveldb_iter_seek_to_first(iterator);
+    if(!leveldb_iter_valid(iterator)){
         goto end;
     }
-    uint64_t version = leveldb_decode_fixed64(val + LDB_VAL_TYPE_SIZE);
-    if(version == 0){
-       retval = 0; 
-       goto end;
+    first = (unsigned char)leveldb_iter_key(iterator, &klen)[0];
+    leveldb_iter_seek_to_last(iterator);
+    last = (unsigned char)leveldb_iter_key(iterator, &klen)[0];
+
+    //candidate i covers [prefix i, prefix i+1), the last one everything after
+    //its prefix
+    int ncands = (last - first + 1) * 256;
+    char (*bounds)[LDB_RECOVERY_PREFIX_SIZE + 1] = lmalloc(sizeof(*bounds) * (ncands + 1));
+    const char** starts = (const char**)lmalloc(sizeof(char*) * ncands);
+    const char** limits = (const char**)lmalloc(sizeof(char*) * ncands);
+    size_t* start_lens = (size_t*)lmalloc(sizeof(size_t) * ncands);
+    size_t* limit_lens = (size_t*)lmalloc(sizeof(size_t) * ncands);
+    uint64_t* sizes = (uint64_t*)lmalloc(sizeof(uint64_t) * ncands);
+    int i = 0;
+    for(i = 0; i <= ncands; ++i){
+        unsigned int prefix = (first << 8) + i;
+        if(prefix > 0xffff){
+            memset(bounds[i], 0xff, sizeof(bounds[i]));
+        }else{
+            bounds[i][0] = (char)(prefix >> 8);
+            bounds[i][1] = (char)(prefix & 0xff);
+        }
     }
-    size_t klen = 0;
-    const char *key = ldb_recov_iterator_key_raw(recovery->iter_, &klen);
-    ldb_meta_t *meta = ldb_meta_create(0 , 0, version);
-    slice_key = ldb_meta_slice_create(meta);
-    ldb_meta_destroy(meta);
-    ldb_slice_push_back(slice_key, key, klen);
-    char *errptr = NULL;
-    leveldb_put_meta(context->database_, ldb_slice_data(slice_key), ldb_slice_size(slice_key), &errptr);
-    if(errptr!=NULL){
-        fprintf(stderr, "%s leveldb_put_meta failed %s.\n", __func__, errptr);
-        leveldb_free(errptr);
-        retval = -1;
-        goto end;
+    for(i = 0; i < ncands; ++i){
+        starts[i] = bounds[i];
+        start_lens[i] = LDB_RECOVERY_PREFIX_SIZE;
+        limits[i] = bounds[i + 1];
+        limit_lens[i] = ((first << 8) + i + 1 > 0xffff) ? LDB_RECOVERY_PREFIX_SIZE + 1 : LDB_RECOVERY_PREFIX_SIZE;
+    }
+    leveldb_approximate_sizes(context->database_, ncands, starts, start_lens, limits, limit_lens, sizes);
+
+    uint64_t total = 0, acc = 0;
+    for(i = 0; i < ncands; ++i){
+        total += sizes[i];
+    }
+    for(i = 0; i < ncands - 1 && nsplits < nranges - 1; ++i){
+        acc += sizes[i];
+        if(acc * nranges >= total * (nsplits + 1) && acc > 0 && total > 0){
+            memcpy(splits[nsplits++], bounds[i + 1], LDB_RECOVERY_PREFIX_SIZE);
+        }
     }
-    retval = 0;
 
+    lfree(sizes);
+    lfree(limit_lens);
+    lfree(start_lens);
+    lfree(limits);
+    lfree(starts);
+    lfree(bounds);
 end:
-    ldb_slice_destroy(slice_key);
-    return retval;
+    leveldb_iter_destroy(iterator);
+    return nsplits;
 }
 
-int ldb_recovery_rec_batch(ldb_context_t* context, ldb_recovery_t* recovery, size_t limit){
-    int retval = 0;
-    if(!check_recovery_valid(recovery)){
-        retval = -1;
-        goto end;
+ldb_recovery_t* ldb_recovery_create( ldb_context_t* context, int nthreads ){
+    if(nthreads <= 0){
+        nthreads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    }
+    if(nthreads <= 0){
+        nthreads = 1;
     }
-    while(limit>0){
-        if(ldb_recovery_rec(context, recovery) < 0){
-            retval = -1;
-            goto end; 
-        } 
-        --limit;
-        if(ldb_recovery_next(recovery) < 0){
-            fprintf(stderr, "%s iterator came to the end.\n", __func__);
-            retval = -1;
-            goto end;
+    if(nthreads > LDB_RECOVERY_MAX_THREADS){
+        nthreads = LDB_RECOVERY_MAX_THREADS;
+    }
+    char splits[LDB_RECOVERY_MAX_THREADS][LDB_RECOVERY_PREFIX_SIZE];
+    int nsplits = recovery_split(context, nthreads, splits);
+
+    ldb_recovery_t *recovery = (ldb_recovery_t*)lmalloc(sizeof(ldb_recovery_t)); 
+    recovery->nranges_ = nsplits + 1;
+    recovery->ranges_ = (ldb_recovery_range_t*)lmalloc(sizeof(ldb_recovery_range_t) * recovery->nranges_);
+    memset(recovery->ranges_, 0, sizeof(ldb_recovery_range_t) * recovery->nranges_);
+    int i = 0;
+    for(i = 0; i < recovery->nranges_; ++i){
+        ldb_recovery_range_t* range = &recovery->ranges_[i];
+        range->context_ = context;
+        if(i > 0){
+            range->start_ = copy_key(splits[i - 1], LDB_RECOVERY_PREFIX_SIZE);
+            range->start_len_ = LDB_RECOVERY_PREFIX_SIZE;
+        }
+        if(i < nsplits){
+            range->limit_ = copy_key(splits[i], LDB_RECOVERY_PREFIX_SIZE);
+            range->limit_len_ = LDB_RECOVERY_PREFIX_SIZE;
         }
     }
-end:
-    return retval;
-    
+    for(i = 0; i < recovery->nranges_; ++i){
+        ldb_recovery_range_t* range = &recovery->ranges_[i];
+        if(pthread_create(&range->thread_, NULL, recovery_range_run, range) == 0){
+            range->started_ = 1;
+        }else{
+            fprintf(stderr, "%s pthread_create failed, scanning range %d inline.\n", __func__, i);
+            recovery_range_run(range);
+        }
+    }
+    return recovery;
+}
+
+
+void ldb_recovery_destroy( ldb_recovery_t* recovery ){
+    if(recovery!=NULL){
+        int i = 0;
+        for(i = 0; i < recovery->nranges_; ++i){
+            ldb_recovery_range_t* range = &recovery->ranges_[i];
+            if(range->started_){
+                pthread_join(range->thread_, NULL);
+            }
+            lfree(range->start_);
+            lfree(range->limit_);
+        }
+        lfree(recovery->ranges_);
+    }
+    lfree(recovery);
+}
+
+int ldb_recovery_poll(ldb_recovery_t* recovery){
+    int i = 0;
+    for(i = 0; i < recovery->nranges_; ++i){
+        if(!__sync_fetch_and_add(&recovery->ranges_[i].done_, 0)){
+            return 0;
+        }
+    }
+    return -1;
+}
+
+void ldb_recovery_progress(ldb_recovery_t* recovery, uint64_t* keys, int* ranges_done, int* ranges){
+    *keys = 0;
+    *ranges_done = 0;
+    *ranges = 0;
+    if(recovery == NULL){
+        return;
+    }
+    int i = 0;
+    for(i = 0; i < recovery->nranges_; ++i){
+        *keys += __sync_fetch_and_add(&recovery->ranges_[i].keys_, 0);
+        *ranges_done += __sync_fetch_and_add(&recovery->ranges_[i].done_, 0);
+    }
+    *ranges = recovery->nranges_;
 }
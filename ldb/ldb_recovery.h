@@ -3,15 +3,24 @@
 
 #include "ldb_context.h"
 
+#include <stdint.h>
+
+#define LDB_RECOVERY_MAX_THREADS             32
+
 typedef struct ldb_recovery_t     ldb_recovery_t;
 
-ldb_recovery_t* ldb_recovery_create( ldb_context_t* context );
+//splits the keys of the recovering snapshot into about "nthreads" ranges of
+//similar size on disk and starts one thread per range, 0 uses one thread per
+//online cpu
+ldb_recovery_t* ldb_recovery_create( ldb_context_t* context, int nthreads );
 
+//waits for the threads that are still running
 void ldb_recovery_destroy(ldb_recovery_t* recovery);
 
-int ldb_recovery_rec(ldb_context_t* context, ldb_recovery_t* recovery);
+//returns 0 while ranges are still being scanned, -1 once all of them are done
+int ldb_recovery_poll(ldb_recovery_t* recovery);
 
-int ldb_recovery_rec_batch(ldb_context_t* context, ldb_recovery_t* recovery, size_t limit);
+void ldb_recovery_progress(ldb_recovery_t* recovery, uint64_t* keys, int* ranges_done, int* ranges);
 
 
 #endif //LDB_RECOVERY_H
@@ -4,7 +4,11 @@
 #include "ldb_meta.h"
 #include "ldb_define.h"
 #include "ldb_list.h"
+#include "ldb_arena.h"
 #include "ldb_recovery.h"
+#include "ldb_iterator.h"
+#include "ldb_bytes.h"
+#include "ldb_txn.h"
 
 #include "trace.h"
 #include "config.h"
@@ -87,14 +91,31 @@ static char* malloc_and_copy(const char* data, size_t size){
   return result;
 }
 
+static void fill_result_array(const ldb_list_t* retlist, size_t num, int** results){
+  *results = (int*)lmalloc(sizeof(int) * num);
+  ldb_list_iterator_t *iterator = ldb_list_iterator_create(retlist);
+  size_t now = 0;
+  for(; now < num; ++now){
+    ldb_list_node_t *node = ldb_list_next(&iterator);
+    (*results)[now] = (node != NULL) ? (int)(node->value_) : LDB_ERR;
+  }
+  ldb_list_iterator_destroy(iterator);
+}
+
 int ldb_recover_meta(ldb_context_t* context, ldb_recovery_t** recovery){
     int retval = 0;
 
     if(*recovery == NULL){
-        *recovery = ldb_recovery_create(context);
+        //the checkpoint already holds the versions of the keys on disk,
+        //only the log written since needs to be replayed
+        if(ldb_context_met_checkpoint_loaded(context)){
+            retval = -1;
+            goto end;
+        }
+        *recovery = ldb_recovery_create(context, 0);
     }
-    size_t limit = 500000;
-    retval = ldb_recovery_rec_batch(context, *recovery, limit);
+    retval = ldb_recovery_poll(*recovery);
+end:
     if(retval < 0){
         ldb_recovery_destroy(*recovery);
         ldb_context_release_recovering_snapshot(context);
@@ -113,6 +134,7 @@ int ldb_set(ldb_context_t* context,
             uint64_t exptime, 
             value_item_t* item, 
             int en){
+  ldb_arena_t* arena = ldb_arena_enter(NULL);
   int retval = 0;
   ldb_slice_t *slice_key, *slice_val , *slice_value = NULL;
   slice_key = ldb_slice_create(key, keylen);
@@ -137,6 +159,7 @@ int ldb_set(ldb_context_t* context,
   ldb_slice_destroy(slice_value);
   ldb_meta_destroy(meta);
 
+  ldb_arena_leave(arena);
   return retval;
 }
 
@@ -150,6 +173,7 @@ int ldb_mset(ldb_context_t* context,
              size_t length,
              GoUint64Slice* results,
              int en){
+  ldb_arena_t* arena = ldb_arena_enter(NULL);
   int retval = 0;
   ldb_list_t *datalist, *metalist, *retlist = NULL;
   datalist = ldb_list_create();
@@ -209,6 +233,7 @@ end:
   ldb_list_destroy(datalist);
   ldb_list_destroy(metalist);
   ldb_list_destroy(retlist);
+  ldb_arena_leave(arena);
   return retval;
 }
 
@@ -217,24 +242,26 @@ int ldb_expire(ldb_context_t* context,
               size_t keylen,
               uint64_t exptime,
               uint64_t version){
+    ldb_arena_t* arena = ldb_arena_enter(NULL);
     int retval = 0;
     ldb_slice_t *slice_key = ldb_slice_create(key, keylen);
-    ldb_slice_t *slice_val = NULL;
     ldb_meta_t *meta = ldb_meta_create_with_exp(0, 0, version, exptime);
     ldb_meta_t *old_meta = NULL;
 
-    retval = string_get(context, slice_key, &slice_val, &old_meta);
+    //the key must not go away between the check and the touch
+    ldb_context_lock_key(context, key, keylen);
+    retval = string_get_meta(context, slice_key, &old_meta);
     if(retval != LDB_OK){
         goto end;
     }
-    retval = string_set(context, slice_key, slice_val, meta);
-    
+    retval = string_touch(context, slice_key, meta);
 
 end:
+    ldb_context_unlock_key(context, key, keylen);
     ldb_slice_destroy(slice_key);
-    ldb_slice_destroy(slice_val);
     ldb_meta_destroy(meta);
     ldb_meta_destroy(old_meta);
+    ldb_arena_leave(arena);
     return retval;
 }
 
@@ -243,23 +270,26 @@ int ldb_pexpire(ldb_context_t* context,
                size_t keylen,
                uint64_t exptime,
                uint64_t version){
+    ldb_arena_t* arena = ldb_arena_enter(NULL);
     int retval = 0;
     ldb_slice_t *slice_key = ldb_slice_create(key, keylen);
-    ldb_slice_t *slice_val = NULL;
     ldb_meta_t *meta = ldb_meta_create_with_exp(0, 0, version, exptime);
     ldb_meta_t *old_meta = NULL;
 
-    retval = string_get(context, slice_key, &slice_val, &old_meta);
+    //the key must not go away between the check and the touch
+    ldb_context_lock_key(context, key, keylen);
+    retval = string_get_meta(context, slice_key, &old_meta);
     if(retval != LDB_OK){
         goto end;
     }
-    retval = string_set(context, slice_key, slice_val, meta);
+    retval = string_touch(context, slice_key, meta);
 
 end:
+    ldb_context_unlock_key(context, key, keylen);
     ldb_slice_destroy(slice_key);
-    ldb_slice_destroy(slice_val);
     ldb_meta_destroy(meta);
     ldb_meta_destroy(old_meta);
+    ldb_arena_leave(arena);
     return retval;
 }
 
@@ -267,12 +297,13 @@ int ldb_ttl(ldb_context_t* context,
            char* key,
            size_t keylen,
            uint64_t* remain){
+    ldb_arena_t* arena = ldb_arena_enter(NULL);
     int retval = 0;
-    ldb_slice_t *slice_key, *slice_val = NULL;
+    ldb_slice_t *slice_key = NULL;
     ldb_meta_t *meta = NULL;
     slice_key = ldb_slice_create(key, keylen);
 
-    retval = string_get(context, slice_key, &slice_val, &meta);
+    retval = string_get_meta(context, slice_key, &meta);
     if(retval != LDB_OK){
         goto end;
     }
@@ -286,8 +317,8 @@ int ldb_ttl(ldb_context_t* context,
 
 end:
     ldb_slice_destroy(slice_key);
-    ldb_slice_destroy(slice_val);
     ldb_meta_destroy(meta);
+    ldb_arena_leave(arena);
     return retval;
 }
 
@@ -295,12 +326,13 @@ int ldb_pttl(ldb_context_t* context,
             char* key,
             size_t keylen,
             uint64_t* remain){
+    ldb_arena_t* arena = ldb_arena_enter(NULL);
     int retval = 0;
-    ldb_slice_t *slice_key, *slice_val = NULL;
+    ldb_slice_t *slice_key = NULL;
     ldb_meta_t *meta = NULL;
     slice_key = ldb_slice_create(key, keylen);
 
-    retval = string_get(context, slice_key, &slice_val, &meta);
+    retval = string_get_meta(context, slice_key, &meta);
     if(retval != LDB_OK){
         goto end;
     }
@@ -312,8 +344,8 @@ int ldb_pttl(ldb_context_t* context,
 
 end:
     ldb_slice_destroy(slice_key);
-    ldb_slice_destroy(slice_val);
     ldb_meta_destroy(meta);
+    ldb_arena_leave(arena);
     return retval;
 }
 
@@ -322,37 +354,37 @@ int ldb_persist(ldb_context_t* context,
                char* key,
                size_t keylen,
                uint64_t version){
+    ldb_arena_t* arena = ldb_arena_enter(NULL);
     int retval = 0;
     ldb_slice_t *slice_key = ldb_slice_create(key, keylen);
     ldb_meta_t *meta = NULL;
-    ldb_slice_t *slice_val = NULL;
-    retval = string_get(context, slice_key, &slice_val, &meta);
+    ldb_context_lock_key(context, key, keylen);
+    retval = string_get_meta(context, slice_key, &meta);
     if(retval != LDB_OK){
         goto end;
     }
     ldb_meta_t* new_meta = ldb_meta_create_with_exp(0, 0, version, 0);
-    retval = string_set(context, slice_key, slice_val, new_meta);
+    retval = string_touch(context, slice_key, new_meta);
     ldb_meta_destroy(new_meta);
 
 end:
+    ldb_context_unlock_key(context, key, keylen);
     ldb_slice_destroy(slice_key);
-    ldb_slice_destroy(slice_val);
     ldb_meta_destroy(meta);
+    ldb_arena_leave(arena);
     return retval;
 }
 
 int ldb_exists(ldb_context_t* context,
                char* key,
                size_t keylen){
+    ldb_arena_t* arena = ldb_arena_enter(NULL);
     int retval = 0;
     ldb_slice_t *slice_key = ldb_slice_create(key, keylen);
-    ldb_meta_t *meta = NULL;
-    ldb_slice_t *slice_val = NULL;
-    retval = string_get(context, slice_key, &slice_val, &meta);
+    retval = string_exists(context, slice_key);
                    
     ldb_slice_destroy(slice_key);
-    ldb_slice_destroy(slice_val);
-    ldb_meta_destroy(meta);
+    ldb_arena_leave(arena);
     return retval;
 }
 
@@ -360,6 +392,7 @@ int ldb_get(ldb_context_t* context,
             char* key, 
             size_t keylen, 
             value_item_t** item){
+  ldb_arena_t* arena = ldb_arena_enter(NULL);
   int retval = 0;
   ldb_slice_t *slice_key, *slice_val = NULL;
   slice_key = ldb_slice_create(key, keylen);
@@ -379,9 +412,40 @@ end:
   ldb_slice_destroy(slice_val);
   ldb_meta_destroy(meta);
 
+  ldb_arena_leave(arena);
+  return retval;
+}
+
+
+int ldb_get_pinned(ldb_context_t* context,
+                   char* key,
+                   size_t keylen,
+                   value_item_t* item,
+                   leveldb_pinned_t** pinned){
+  ldb_arena_t* arena = ldb_arena_enter(NULL);
+  int retval = 0;
+  ldb_slice_t *slice_key = ldb_slice_create(key, keylen);
+  const char* data = NULL;
+  size_t size = 0;
+  uint64_t version = 0, exptime = 0;
+  *pinned = NULL;
+  retval = string_get_pinned(context, slice_key, &data, &size, &version, &exptime, pinned);
+  if(retval == LDB_OK){
+    item->version_ = version;
+    item->data_len_ = size;
+    item->data_ = (char*)data;
+  }
+  ldb_slice_destroy(slice_key);
+  ldb_arena_leave(arena);
   return retval;
 }
 
+void ldb_release_pinned(leveldb_pinned_t* pinned){
+  if(pinned != NULL){
+    leveldb_pinned_release(pinned);
+  }
+}
+
 
 int ldb_mget(ldb_context_t* context,
              GoByteSlice* slice,
@@ -389,6 +453,7 @@ int ldb_mget(ldb_context_t* context,
              GoByteSliceSlice* items,
              GoUint64Slice* versions,
              size_t* itemnum){
+  ldb_arena_t* arena = ldb_arena_enter(NULL);
   int retval = 0;
   ldb_list_t *keylist, *vallist, *metalist = NULL;
   keylist = ldb_list_create();
@@ -445,6 +510,7 @@ end:
   ldb_list_destroy(keylist);
   ldb_list_destroy(vallist);
   ldb_list_destroy(metalist);
+  ldb_arena_leave(arena);
   return retval;
 }
 
@@ -453,6 +519,7 @@ int ldb_del(ldb_context_t* context,
             size_t keylen, 
             int vercare, 
             uint64_t version){
+  ldb_arena_t* arena = ldb_arena_enter(NULL);
   int retval = 0;
   ldb_slice_t *slice_key = ldb_slice_create(key, keylen);
   ldb_meta_t *meta = ldb_meta_create(vercare, 0, version);
@@ -460,6 +527,7 @@ int ldb_del(ldb_context_t* context,
 
   ldb_slice_destroy(slice_key);
   ldb_meta_destroy(meta);
+  ldb_arena_leave(arena);
   return retval;
 }
 
@@ -473,6 +541,7 @@ int ldb_incrby(ldb_context_t* context,
                int64_t initval,
                int64_t by,
                int64_t* result){
+  ldb_arena_t* arena = ldb_arena_enter(NULL);
   int retval = 0;
   ldb_slice_t *slice_key = ldb_slice_create(key, keylen);
   ldb_meta_t *meta = ldb_meta_create_with_exp(vercare, lastver, version, exptime);
@@ -480,6 +549,7 @@ int ldb_incrby(ldb_context_t* context,
 
   ldb_slice_destroy(slice_key);
   ldb_meta_destroy(meta);
+  ldb_arena_leave(arena);
   return retval;
 }
 
@@ -488,6 +558,7 @@ int ldb_hgetall(ldb_context_t* context,
                 size_t namelen,
                 value_item_t** items,
                 size_t* itemnum){
+    ldb_arena_t* arena = ldb_arena_enter(NULL);
     int retval = 0;
     ldb_slice_t *slice_name = ldb_slice_create(name, namelen);
     ldb_list_t *keylist, *vallist, *metalist = NULL;
@@ -530,6 +601,7 @@ end:
     ldb_list_destroy(keylist);
     ldb_list_destroy(vallist);
     ldb_list_destroy(metalist);
+    ldb_arena_leave(arena);
     return retval;
 }
 
@@ -538,6 +610,7 @@ int ldb_hkeys(ldb_context_t* context,
               size_t namelen,
               value_item_t** items,
               size_t* itemnum){
+    ldb_arena_t* arena = ldb_arena_enter(NULL);
 
     int retval = 0;
     ldb_slice_t *slice_name = ldb_slice_create(name, namelen);
@@ -567,6 +640,7 @@ int ldb_hkeys(ldb_context_t* context,
 end:
     ldb_slice_destroy(slice_name);
     ldb_list_destroy(keylist);
+    ldb_arena_leave(arena);
     return retval;
 }
 
@@ -575,6 +649,7 @@ int ldb_hvals(ldb_context_t* context,
               size_t namelen,
               value_item_t** items,
               size_t* itemnum){
+    ldb_arena_t* arena = ldb_arena_enter(NULL);
 
     int retval = 0;
     ldb_slice_t *slice_name = ldb_slice_create(name, namelen);
@@ -609,6 +684,7 @@ end:
     ldb_slice_destroy(slice_name);
     ldb_list_destroy(vallist);
     ldb_list_destroy(metalist);
+    ldb_arena_leave(arena);
     return retval;
 }
 
@@ -616,6 +692,7 @@ int ldb_hget(ldb_context_t* context,
              GoByteSlice* name,
              GoByteSlice* key,
              value_item_t** items){
+    ldb_arena_t* arena = ldb_arena_enter(NULL);
     int retval = 0;
     ldb_slice_t* slice_name = ldb_slice_create(name->data, name->data_len);
     ldb_slice_t* slice_key = ldb_slice_create(key->data, key->data_len);
@@ -633,6 +710,7 @@ int ldb_hget(ldb_context_t* context,
     ldb_slice_destroy(slice_key);
     ldb_slice_destroy(slice_val);
     ldb_meta_destroy(meta);
+    ldb_arena_leave(arena);
     return retval;
 }
 
@@ -644,6 +722,7 @@ int ldb_hmget(ldb_context_t* context,
               size_t keynum,
               value_item_t** items,
               size_t* itemnum){
+    ldb_arena_t* arena = ldb_arena_enter(NULL);
     int retval = 0;
     ldb_slice_t *slice_name = ldb_slice_create(name, namelen);
     ldb_list_t *keylist, *vallist, *metalist = NULL;
@@ -698,6 +777,7 @@ end:
     ldb_list_destroy(keylist);
     ldb_list_destroy(vallist);
     ldb_list_destroy(metalist);
+    ldb_arena_leave(arena);
     return retval;
 }
 
@@ -710,6 +790,7 @@ int ldb_hincrby(ldb_context_t* context,
                 value_item_t* item,
                 int64_t by,
                 int64_t* result){
+    ldb_arena_t* arena = ldb_arena_enter(NULL);
     int retval = 0;                    
     ldb_slice_t *slice_name = ldb_slice_create(name, namelen);
     ldb_slice_t *slice_key = ldb_slice_create(item->data_, item->data_len_);
@@ -719,6 +800,7 @@ int ldb_hincrby(ldb_context_t* context,
     ldb_slice_destroy(slice_name);
     ldb_slice_destroy(slice_key);
     ldb_meta_destroy(meta);
+    ldb_arena_leave(arena);
     return retval;
 }
 
@@ -731,6 +813,7 @@ int ldb_hset(ldb_context_t* context,
              char* key,
              size_t keylen,
              value_item_t* item){
+    ldb_arena_t* arena = ldb_arena_enter(NULL);
     int retval = 0;
     ldb_slice_t *slice_name = ldb_slice_create(name, namelen);
     ldb_slice_t *slice_key = ldb_slice_create(key, keylen);
@@ -747,6 +830,7 @@ end:
     ldb_slice_destroy(slice_key);
     ldb_slice_destroy(slice_val);
     ldb_meta_destroy(meta);
+    ldb_arena_leave(arena);
     return retval;
 }
 
@@ -759,6 +843,7 @@ int ldb_hmset(ldb_context_t* context,
               value_item_t* items,
               size_t itemnum,
               int** results){
+    ldb_arena_t* arena = ldb_arena_enter(NULL);
 
     int retval = 0;
     ldb_list_t *datalist, *metalist, *retlist = NULL;
@@ -813,6 +898,7 @@ end:
   ldb_list_destroy(datalist);
   ldb_list_destroy(metalist);
   ldb_list_destroy(retlist);
+  ldb_arena_leave(arena);
   return retval;
 }
 
@@ -825,6 +911,7 @@ int ldb_hdel(ldb_context_t* context,
              value_item_t* items,
              size_t itemnum,
              int** results){
+    ldb_arena_t* arena = ldb_arena_enter(NULL);
     int retval = 0;
     ldb_slice_t *slice_name = ldb_slice_create(name, namelen); 
     *results = lmalloc(itemnum * sizeof(int));
@@ -838,6 +925,7 @@ int ldb_hdel(ldb_context_t* context,
     retval = LDB_OK;
 
   ldb_slice_destroy(slice_name);
+  ldb_arena_leave(arena);
   return retval;
 }
 
@@ -846,11 +934,13 @@ int ldb_hlen(ldb_context_t* context,
              char* name,
              size_t namelen,
              uint64_t* length){
+    ldb_arena_t* arena = ldb_arena_enter(NULL);
     int retval = 0;
     ldb_slice_t* slice_name = ldb_slice_create(name, namelen);
     retval = hash_length(context, slice_name, length);
 
     ldb_slice_destroy(slice_name);
+    ldb_arena_leave(arena);
     return retval;
 }
 
@@ -860,6 +950,7 @@ int ldb_hexists(ldb_context_t* context,
                 size_t namelen,
                 char* key,
                 size_t keylen){
+    ldb_arena_t* arena = ldb_arena_enter(NULL);
     int retval = 0;
     ldb_slice_t* slice_name = ldb_slice_create(name, namelen);
     ldb_slice_t* slice_key = ldb_slice_create(key, keylen);
@@ -867,6 +958,7 @@ int ldb_hexists(ldb_context_t* context,
 
     ldb_slice_destroy(slice_name);
     ldb_slice_destroy(slice_key);
+    ldb_arena_leave(arena);
     return retval;
 }
 
@@ -878,6 +970,7 @@ int ldb_sadd(ldb_context_t* context,
                 value_item_t* keys,
                 size_t keynum,
                 int **results){
+  ldb_arena_t* arena = ldb_arena_enter(NULL);
   int retval = 0;
   ldb_slice_t *slice_name = ldb_slice_create(name, namelen);
   *results = (int*)lmalloc(sizeof(int) * keynum);
@@ -893,22 +986,11 @@ int ldb_sadd(ldb_context_t* context,
   retval = LDB_OK;
 
   ldb_slice_destroy(slice_name);
+  ldb_arena_leave(arena);
   return retval;
 }
 
-int ldb_smembers(ldb_context_t* context,
-                 char* name,
-                 size_t namelen,
-                 value_item_t** items,
-                 size_t* itemnum){
-
-    int retval = 0;
-    ldb_slice_t *slice_name = ldb_slice_create(name, namelen);
-    ldb_list_t *keylist, *metalist = NULL;
-    retval = set_members(context, slice_name, &keylist, &metalist);
-    if( retval != LDB_OK ){
-        goto end;
-    }
+static void set_list_to_items(ldb_list_t* keylist, ldb_list_t* metalist, value_item_t** items, size_t* itemnum){
     *itemnum = keylist->length_;
     *items = create_value_item_array(*itemnum);
     ldb_list_iterator_t *keyiterator = ldb_list_iterator_create(keylist);
@@ -917,7 +999,6 @@ int ldb_smembers(ldb_context_t* context,
     while(1){
         ldb_list_node_t* node_key = ldb_list_next(&keyiterator);
         if(node_key == NULL){
-            retval = LDB_OK;
             break;
         }
         ldb_list_node_t* node_met = ldb_list_next(&metiterator);
@@ -930,11 +1011,29 @@ int ldb_smembers(ldb_context_t* context,
     }
     ldb_list_iterator_destroy(keyiterator);
     ldb_list_iterator_destroy(metiterator);
+}
+
+int ldb_smembers(ldb_context_t* context,
+                 char* name,
+                 size_t namelen,
+                 value_item_t** items,
+                 size_t* itemnum){
+    ldb_arena_t* arena = ldb_arena_enter(NULL);
+
+    int retval = 0;
+    ldb_slice_t *slice_name = ldb_slice_create(name, namelen);
+    ldb_list_t *keylist = NULL, *metalist = NULL;
+    retval = set_members(context, slice_name, &keylist, &metalist);
+    if( retval != LDB_OK ){
+        goto end;
+    }
+    set_list_to_items(keylist, metalist, items, itemnum);
 
 end:
     ldb_slice_destroy(slice_name);
     ldb_list_destroy(keylist);
     ldb_list_destroy(metalist);
+    ldb_arena_leave(arena);
     return retval;
 }
 
@@ -943,26 +1042,65 @@ int ldb_spop(ldb_context_t* context,
              size_t namelen,
              uint64_t version,
              int vercare,
+             uint64_t count,
              value_item_t** items,
+             size_t* itemnum,
              uint64_t nextver){
+    ldb_arena_t* arena = ldb_arena_enter(NULL);
     int retval = 0;
     ldb_slice_t *slice_name = ldb_slice_create(name, namelen);
     ldb_meta_t *meta = ldb_meta_create(vercare, version, nextver);
-    ldb_slice_t *key = NULL;
-    *items = create_value_item_array(1);
-    retval = set_pop(context, slice_name, meta, &key);
+    ldb_list_t *keylist = NULL;
+    retval = set_pop(context, slice_name, meta, count, &keylist);
     if( retval != LDB_OK ){
         goto end; 
     }
-    size_t key_len = ldb_slice_size(key);
-    (*items)[0].data_len_ = key_len;
-    (*items)[0].data_ = malloc_and_copy(ldb_slice_data(key), key_len);
-    (*items)[0].version_ = nextver;
+    *itemnum = keylist->length_;
+    *items = create_value_item_array(*itemnum);
+    ldb_list_iterator_t *keyiterator = ldb_list_iterator_create(keylist);
+    size_t now = 0;
+    while(1){
+        ldb_list_node_t* node_key = ldb_list_next(&keyiterator);
+        if(node_key == NULL){
+            break;
+        }
+        size_t key_len = ldb_slice_size((ldb_slice_t*)node_key->data_);
+        (*items)[now].data_len_ = key_len;
+        (*items)[now].data_ = malloc_and_copy(ldb_slice_data((ldb_slice_t*)node_key->data_), key_len);
+        (*items)[now].version_ = nextver;
+        ++now;
+    }
+    ldb_list_iterator_destroy(keyiterator);
 
 end:
     ldb_slice_destroy(slice_name);
-    ldb_slice_destroy(key);
+    ldb_list_destroy(keylist);
     ldb_meta_destroy(meta);
+    ldb_arena_leave(arena);
+    return retval;
+}
+
+int ldb_srandmember(ldb_context_t* context,
+                    char* name,
+                    size_t namelen,
+                    int64_t count,
+                    value_item_t** items,
+                    size_t* itemnum){
+    ldb_arena_t* arena = ldb_arena_enter(NULL);
+    int retval = 0;
+    ldb_slice_t *slice_name = ldb_slice_create(name, namelen);
+    ldb_list_t *keylist = NULL, *metalist = NULL;
+    retval = set_random_members(context, slice_name, count, &keylist, &metalist);
+    if( retval != LDB_OK ){
+        goto end;
+    }
+    set_list_to_items(keylist, metalist, items, itemnum);
+
+end:
+    ldb_slice_destroy(slice_name);
+    ldb_list_destroy(keylist);
+    ldb_list_destroy(metalist);
+    ldb_arena_leave(arena);
     return retval;
 }
 
@@ -974,6 +1112,7 @@ int ldb_srem(ldb_context_t* context,
              value_item_t* keys,
              size_t keynum,
              int **results){
+  ldb_arena_t* arena = ldb_arena_enter(NULL);
 
   int retval = 0;
   ldb_slice_t *slice_name = ldb_slice_create(name, namelen);
@@ -990,6 +1129,7 @@ int ldb_srem(ldb_context_t* context,
   retval = LDB_OK;
 
   ldb_slice_destroy(slice_name);
+  ldb_arena_leave(arena);
   return retval;
 }
 
@@ -997,11 +1137,13 @@ int ldb_scard(ldb_context_t* context,
               char* name,
               size_t namelen,
               uint64_t *count){
+    ldb_arena_t* arena = ldb_arena_enter(NULL);
     int retval = 0;
     ldb_slice_t *slice_name = ldb_slice_create(name, namelen);
     retval = set_card(context, slice_name, count);
 
     ldb_slice_destroy(slice_name);
+    ldb_arena_leave(arena);
     return retval;
 }
 
@@ -1010,6 +1152,7 @@ int ldb_sismember(ldb_context_t* context,
                   size_t namelen,
                   char* key,
                   size_t keylen){
+    ldb_arena_t* arena = ldb_arena_enter(NULL);
     int retval = 0;
     ldb_slice_t *slice_name = ldb_slice_create(name, namelen);
     ldb_slice_t *slice_key = ldb_slice_create(key, keylen);
@@ -1017,6 +1160,7 @@ int ldb_sismember(ldb_context_t* context,
 
     ldb_slice_destroy(slice_name);
     ldb_slice_destroy(slice_key);
+    ldb_arena_leave(arena);
     return retval;
 }
 
@@ -1026,6 +1170,7 @@ int ldb_zscore(ldb_context_t* context,
               char* key,
               size_t keylen,
               int64_t* score){
+  ldb_arena_t* arena = ldb_arena_enter(NULL);
   int retval = 0;
   ldb_slice_t *slice_name = ldb_slice_create(name, namelen);
   ldb_slice_t *slice_key = ldb_slice_create(key, keylen);
@@ -1038,6 +1183,7 @@ int ldb_zscore(ldb_context_t* context,
 end:
   ldb_slice_destroy(slice_name);
   ldb_slice_destroy(slice_key);
+  ldb_arena_leave(arena);
   return retval;
 }
 
@@ -1052,6 +1198,7 @@ int ldb_zrange_by_rank(ldb_context_t* context,
                        size_t* scorenum,
                        int reverse,
                        int withscore){
+  ldb_arena_t* arena = ldb_arena_enter(NULL);
   int retval = 0;
   ldb_slice_t *slice_name = ldb_slice_create(name, namelen);
   ldb_list_t *keylist, *metlist = NULL;
@@ -1104,6 +1251,7 @@ end:
   ldb_list_destroy(keylist);
   ldb_list_destroy(metlist);
   ldb_slice_destroy(slice_name);
+  ldb_arena_leave(arena);
   return retval; 
 }
 
@@ -1118,6 +1266,7 @@ int ldb_zrange_by_score(ldb_context_t* context,
                         size_t* scorenum,
                         int reverse,
                         int withscore){
+  ldb_arena_t* arena = ldb_arena_enter(NULL);
 
   int retval = 0;
   ldb_slice_t *slice_name = ldb_slice_create(name, namelen);
@@ -1171,6 +1320,7 @@ end:
   ldb_list_destroy(keylist);
   ldb_list_destroy(metlist);
   ldb_slice_destroy(slice_name);
+  ldb_arena_leave(arena);
   return retval; 
 }
 
@@ -1183,21 +1333,37 @@ int ldb_zadd(ldb_context_t* context,
              int64_t* scores,
              size_t keynum,
              int** results){
+  ldb_arena_t* arena = ldb_arena_enter(NULL);
   int retval = 0;
-  ldb_slice_t *slice_name = ldb_slice_create(name, namelen);
-  *results = (int*)lmalloc(sizeof(int) * keynum);
+  ldb_list_t *keylist, *metalist, *retlist = NULL;
+  keylist = ldb_list_create();
+  metalist = ldb_list_create();
   size_t now = 0; 
   while(now < keynum){
-    ldb_meta_t *meta = ldb_meta_create(vercare, version, keys[now].version_);
-    ldb_slice_t *slice_key = ldb_slice_create(keys[now].data_, keys[now].data_len_);
-    (*results)[now] = zset_add(context, slice_name, slice_key, meta, scores[now]);
-    ldb_meta_destroy(meta);
-    ldb_slice_destroy(slice_key);
+    //push key with its score
+    ldb_list_node_t *node_key = ldb_list_node_create();
+    node_key->type_ = LDB_LIST_NODE_TYPE_SLICE;
+    node_key->value_ = scores[now];
+    node_key->data_ = ldb_slice_create(keys[now].data_, keys[now].data_len_);
+    rpush_ldb_list_node(keylist, node_key);
+
+    //push meta
+    ldb_list_node_t *node_meta = ldb_list_node_create();
+    node_meta->type_ = LDB_LIST_NODE_TYPE_META;
+    node_meta->data_ = ldb_meta_create(vercare, version, keys[now].version_);
+    rpush_ldb_list_node(metalist, node_meta);
     ++now;
   }
+  ldb_slice_t *slice_name = ldb_slice_create(name, namelen);
+  zset_madd(context, slice_name, keylist, metalist, &retlist);
+  fill_result_array(retlist, keynum, results);
   retval = LDB_OK;
 
   ldb_slice_destroy(slice_name);
+  ldb_list_destroy(keylist);
+  ldb_list_destroy(metalist);
+  ldb_list_destroy(retlist);
+  ldb_arena_leave(arena);
   return retval;
 }
 
@@ -1208,6 +1374,7 @@ int ldb_zrank(ldb_context_t* context,
               size_t keylen,
               int reverse,
               uint64_t* rank){
+  ldb_arena_t* arena = ldb_arena_enter(NULL);
   int retval = 0;
   ldb_slice_t *slice_name, *slice_key = NULL;
   slice_name = ldb_slice_create(name, namelen);
@@ -1219,6 +1386,8 @@ int ldb_zrank(ldb_context_t* context,
 
 end:
   ldb_slice_destroy(slice_name);
+  ldb_slice_destroy(slice_key);
+  ldb_arena_leave(arena);
   return retval;
 }
 
@@ -1228,6 +1397,7 @@ int ldb_zcount(ldb_context_t* context,
                int64_t score_start,
                int64_t score_end,
                uint64_t* count){
+  ldb_arena_t* arena = ldb_arena_enter(NULL);
   int retval = 0;
   ldb_slice_t *slice_name = ldb_slice_create(name, namelen);
   retval = zset_count(context, slice_name, score_start, score_end, count); 
@@ -1237,6 +1407,7 @@ int ldb_zcount(ldb_context_t* context,
 
 end:
   ldb_slice_destroy(slice_name);
+  ldb_arena_leave(arena);
   return retval;
 }
 
@@ -1248,6 +1419,7 @@ int ldb_zincrby(ldb_context_t* context,
                 value_item_t* item,
                 int64_t by,
                 int64_t* score){
+  ldb_arena_t* arena = ldb_arena_enter(NULL);
   int retval = 0;
   ldb_slice_t* slice_name = ldb_slice_create(name, namelen);
   ldb_slice_t* slice_key = ldb_slice_create(item->data_, item->data_len_);
@@ -1257,6 +1429,7 @@ int ldb_zincrby(ldb_context_t* context,
   ldb_slice_destroy(slice_name);
   ldb_slice_destroy(slice_key);
   ldb_meta_destroy(meta);
+  ldb_arena_leave(arena);
   return retval;
 }
 
@@ -1268,19 +1441,32 @@ int ldb_zrem(ldb_context_t* context,
              value_item_t* items,
              size_t itemnum,
              int** retvals){
+  ldb_arena_t* arena = ldb_arena_enter(NULL);
   int retval = 0;
-  ldb_slice_t* slice_name = ldb_slice_create(name, namelen);
-  *retvals = (int*)lmalloc(sizeof(int) * itemnum);
+  ldb_list_t *keylist, *metalist, *retlist = NULL;
+  keylist = ldb_list_create();
+  metalist = ldb_list_create();
   size_t now = 0;
   for(; now< itemnum; ++now){
-    ldb_slice_t* slice_key = ldb_slice_create(items[now].data_, items[now].data_len_);
-    ldb_meta_t* meta = ldb_meta_create(vercare, lastver, items[now].version_);
-    (*retvals)[now] = zset_del(context, slice_name, slice_key, meta);
-    ldb_slice_destroy(slice_key);
-    ldb_meta_destroy(meta);
+    ldb_list_node_t *node_key = ldb_list_node_create();
+    node_key->type_ = LDB_LIST_NODE_TYPE_SLICE;
+    node_key->data_ = ldb_slice_create(items[now].data_, items[now].data_len_);
+    rpush_ldb_list_node(keylist, node_key);
+
+    ldb_list_node_t *node_meta = ldb_list_node_create();
+    node_meta->type_ = LDB_LIST_NODE_TYPE_META;
+    node_meta->data_ = ldb_meta_create(vercare, lastver, items[now].version_);
+    rpush_ldb_list_node(metalist, node_meta);
   }
+  ldb_slice_t* slice_name = ldb_slice_create(name, namelen);
+  zset_mdel(context, slice_name, keylist, metalist, &retlist);
+  fill_result_array(retlist, itemnum, retvals);
 
   ldb_slice_destroy(slice_name);
+  ldb_list_destroy(keylist);
+  ldb_list_destroy(metalist);
+  ldb_list_destroy(retlist);
+  ldb_arena_leave(arena);
   return retval;
 }
 
@@ -1292,6 +1478,7 @@ int ldb_zrem_by_rank(ldb_context_t* context,
                      int rank_start,
                      int rank_end,
                      uint64_t* deleted){
+  ldb_arena_t* arena = ldb_arena_enter(NULL);
   int retval = 0;
   ldb_slice_t* slice_name = ldb_slice_create(name, namelen);
   ldb_meta_t* meta = ldb_meta_create(vercare, 0, nextver);
@@ -1299,6 +1486,7 @@ int ldb_zrem_by_rank(ldb_context_t* context,
 
   ldb_slice_destroy(slice_name);
   ldb_meta_destroy(meta);
+  ldb_arena_leave(arena);
   return retval;
 }
 
@@ -1310,6 +1498,7 @@ int ldb_zrem_by_score(ldb_context_t* context,
                       int64_t score_start,
                       int64_t score_end,
                       uint64_t* deleted){
+  ldb_arena_t* arena = ldb_arena_enter(NULL);
   int retval = 0;
   ldb_slice_t* slice_name = ldb_slice_create(name, namelen);
   ldb_meta_t* meta = ldb_meta_create(vercare, 0, nextver);
@@ -1317,6 +1506,7 @@ int ldb_zrem_by_score(ldb_context_t* context,
 
   ldb_slice_destroy(slice_name);
   ldb_meta_destroy(meta);
+  ldb_arena_leave(arena);
   return retval;
 }
 
@@ -1324,6 +1514,7 @@ int ldb_zcard(ldb_context_t* context,
               char* name,
               size_t namelen,
               uint64_t* size){
+  ldb_arena_t* arena = ldb_arena_enter(NULL);
   int retval = 0;
   ldb_slice_t *slice_name = ldb_slice_create(name, namelen);
   retval = zset_size(context, slice_name, size);
@@ -1333,5 +1524,408 @@ int ldb_zcard(ldb_context_t* context,
   }
   
   ldb_slice_destroy(slice_name);
+  ldb_arena_leave(arena);
+  return retval;
+}
+
+int ldb_zrank_index(ldb_context_t* context,
+                    char* name,
+                    size_t namelen){
+  ldb_arena_t* arena = ldb_arena_enter(NULL);
+  ldb_slice_t *slice_name = ldb_slice_create(name, namelen);
+  int retval = zset_rank_index_build(context, slice_name);
+  ldb_slice_destroy(slice_name);
+  ldb_arena_leave(arena);
+  return retval;
+}
+
+//copies data into the page buffer, -1 when it does not fit
+static int scan_page_copy(ldb_scan_page_t* page, size_t* used, const char* data, size_t size, value_item_t* item, uint64_t version){
+    if(page->buflen_ - *used < size){
+        return -1;
+    }
+    memcpy(page->buf_ + *used, data, size);
+    item->data_ = page->buf_ + *used;
+    item->data_len_ = size;
+    item->version_ = version;
+    *used += size;
+    return 0;
+}
+
+//skip is the bytes between the prefix and the member, zset member keys
+//carry the member length there
+static int scan_page_fill(ldb_context_t* context, const char* type, const char* name, size_t namelen,
+                          const char* sep, size_t skip, const char* cursor, size_t cursorlen, ldb_scan_page_t* page){
+    int retval = LDB_OK;
+    page->itemnum_ = 0;
+    page->nextlen_ = 0;
+    if(namelen > LDB_DATA_TYPE_KEY_LEN_MAX){
+        fprintf(stderr, "%s name too long!\n", __func__);
+        return LDB_ERR;
+    }
+    uint8_t len = (uint8_t)namelen;
+    ldb_slice_t *prefix = ldb_slice_create(type, strlen(type));
+    ldb_slice_push_back(prefix, (const char*)(&len), sizeof(uint8_t));
+    ldb_slice_push_back(prefix, name, namelen);
+    ldb_slice_push_back(prefix, sep, strlen(sep));
+    ldb_cursor_iterator_t *iterator = ldb_cursor_iterator_create(context, ldb_slice_data(prefix), ldb_slice_size(prefix), cursor, cursorlen);
+    if(iterator == NULL){
+        fprintf(stderr, "%s cursor does not belong to the key!\n", __func__);
+        retval = LDB_ERR;
+        goto end;
+    }
+    size_t used = 0;
+    size_t plen = ldb_slice_size(prefix) + skip;
+    while(ldb_cursor_iterator_valid(iterator) && page->itemnum_ < page->count_){
+        size_t klen = 0, vlen = 0;
+        const char *key = ldb_cursor_iterator_key_raw(iterator, &klen);
+        const char *val = ldb_cursor_iterator_val_raw(iterator, &vlen);
+        uint8_t vtype = leveldb_decode_fixed8(val);
+        uint64_t version = leveldb_decode_fixed64(val + LDB_VAL_TYPE_SIZE);
+        size_t header = LDB_VAL_META_SIZE + ((vtype & LDB_VALUE_TYPE_EXP) ? sizeof(uint64_t) : 0);
+        if(klen < plen || klen > LDB_SCAN_CURSOR_MAX || vlen < header){
+            fprintf(stderr, "%s bad entry!\n", __func__);
+            retval = LDB_ERR;
+            goto end;
+        }
+        size_t mark = used;
+        size_t now = page->itemnum_;
+        if(scan_page_copy(page, &used, key + plen, klen - plen, &page->items_[now], version) < 0 ||
+           (page->values_ != NULL &&
+            scan_page_copy(page, &used, val + header, vlen - header, &page->values_[now], version) < 0)){
+            used = mark;
+            if(now == 0){
+                fprintf(stderr, "%s page buffer too small!\n", __func__);
+                retval = LDB_ERR;
+                goto end;
+            }
+            break;
+        }
+        if(page->scores_ != NULL){
+            assert(vlen >= header + sizeof(int64_t));
+            page->scores_[now] = leveldb_decode_fixed64(val + header);
+        }
+        memcpy(page->next_, key, klen);
+        page->nextlen_ = klen;
+        page->itemnum_ += 1;
+        ldb_cursor_iterator_next(iterator);
+    }
+    if(!ldb_cursor_iterator_valid(iterator)){
+        page->nextlen_ = 0;
+    }
+
+end:
+    ldb_cursor_iterator_destroy(iterator);
+    ldb_slice_destroy(prefix);
+    return retval;
+}
+
+int ldb_hscan(ldb_context_t* context,
+              char* name,
+              size_t namelen,
+              const char* cursor,
+              size_t cursorlen,
+              ldb_scan_page_t* page){
+  ldb_arena_t* arena = ldb_arena_enter(NULL);
+  page->scores_ = NULL;
+  int retval = scan_page_fill(context, LDB_DATA_TYPE_HASH, name, namelen, "=", 0, cursor, cursorlen, page);
+  ldb_arena_leave(arena);
+  return retval;
+}
+
+int ldb_sscan(ldb_context_t* context,
+              char* name,
+              size_t namelen,
+              const char* cursor,
+              size_t cursorlen,
+              ldb_scan_page_t* page){
+  ldb_arena_t* arena = ldb_arena_enter(NULL);
+  page->values_ = NULL;
+  page->scores_ = NULL;
+  int retval = scan_page_fill(context, LDB_DATA_TYPE_SET, name, namelen, "=", 0, cursor, cursorlen, page);
+  ldb_arena_leave(arena);
+  return retval;
+}
+
+int ldb_zscan(ldb_context_t* context,
+              char* name,
+              size_t namelen,
+              const char* cursor,
+              size_t cursorlen,
+              ldb_scan_page_t* page){
+  ldb_arena_t* arena = ldb_arena_enter(NULL);
+  page->values_ = NULL;
+  int retval = scan_page_fill(context, LDB_DATA_TYPE_ZSET, name, namelen, "", sizeof(uint8_t), cursor, cursorlen, page);
+  ldb_arena_leave(arena);
+  return retval;
+}
+
+//what follows the op byte of each LDB_CMD_*
+static const struct{
+  int meta_;
+  int nums_;
+  int strs_;
+} exec_args[] = {
+  {0, 0, 0},
+  {1, 0, 2},                          //LDB_CMD_SET
+  {1, 0, 1},                          //LDB_CMD_DEL
+  {1, 2, 1},                          //LDB_CMD_INCRBY
+  {0, 0, 1},                          //LDB_CMD_GET
+  {1, 0, 3},                          //LDB_CMD_HSET
+  {0, 0, 2},                          //LDB_CMD_HGET
+  {1, 0, 2},                          //LDB_CMD_HDEL
+  {1, 1, 2},                          //LDB_CMD_HINCRBY
+  {0, 0, 1},                          //LDB_CMD_HLEN
+  {1, 0, 2},                          //LDB_CMD_SADD
+  {1, 0, 2},                          //LDB_CMD_SREM
+  {0, 0, 2},                          //LDB_CMD_SISMEMBER
+  {0, 0, 1},                          //LDB_CMD_SCARD
+  {1, 1, 2},                          //LDB_CMD_ZADD
+  {1, 0, 2},                          //LDB_CMD_ZREM
+  {1, 1, 2},                          //LDB_CMD_ZINCRBY
+  {0, 0, 2},                          //LDB_CMD_ZSCORE
+  {0, 0, 1},                          //LDB_CMD_ZCARD
+};
+
+#define LDB_CMD_MAX ((uint8_t)(sizeof(exec_args)/sizeof(exec_args[0]) - 1))
+
+//string writes held back by ldb_exec_batch, the results from pending_ on
+//wait for the commit
+typedef struct exec_group_t{
+  ldb_txn_t* txn_;
+  uint32_t* stripes_;
+  size_t stripenum_;
+  ldb_exec_result_t* pending_;
+  size_t pendingnum_;
+} exec_group_t;
+
+static void exec_group_add(exec_group_t* group, ldb_exec_result_t* result, const ldb_slice_t* key){
+  if(group->pending_ == NULL){
+    group->pending_ = result;
+  }
+  group->pendingnum_ = result - group->pending_ + 1;
+  if(result->retval_ == LDB_OK){
+    group->stripes_[group->stripenum_++] = ldb_context_key_stripe(ldb_slice_data(key), ldb_slice_size(key));
+  }
+}
+
+static void exec_group_commit(ldb_context_t* context, exec_group_t* group){
+  int retval = LDB_OK;
+  if(group->stripenum_ > 0){
+    char *errptr = NULL;
+    size_t stripenum = ldb_context_lock_stripes(context, group->stripes_, group->stripenum_);
+    ldb_txn_commit(context, group->txn_, &errptr);
+    ldb_context_unlock_stripes(context, group->stripes_, stripenum);
+    if(errptr != NULL){
+      fprintf(stderr, "%s ldb_txn_commit failed %s.\n", __func__, errptr);
+      leveldb_free(errptr);
+      retval = LDB_ERR;
+    }
+    ldb_txn_clear(group->txn_);
+  }
+  for(size_t i = 0; i < group->pendingnum_; ++i){
+    if(group->pending_[i].retval_ == LDB_OK){
+      group->pending_[i].retval_ = retval;
+    }
+  }
+  group->stripenum_ = 0;
+  group->pending_ = NULL;
+  group->pendingnum_ = 0;
+}
+
+static void exec_fill_item(value_item_t* item, const ldb_slice_t* slice_val, const ldb_meta_t* meta){
+  item->data_len_ = ldb_slice_size(slice_val);
+  item->data_ = malloc_and_copy(ldb_slice_data(slice_val), ldb_slice_size(slice_val));
+  item->version_ = ldb_meta_nextver(meta);
+}
+
+static int exec_read_args(ldb_bytes_t* bytes, uint8_t op, ldb_meta_t** pmeta, int64_t* nums, ldb_slice_t** strs){
+  if(exec_args[op].meta_){
+    uint32_t vercare = 0;
+    uint64_t lastver = 0, version = 0, exptime = 0;
+    if(ldb_bytes_read_uint32(bytes, &vercare) == -1 ||
+       ldb_bytes_read_uint64(bytes, &lastver) == -1 ||
+       ldb_bytes_read_uint64(bytes, &version) == -1 ||
+       ldb_bytes_read_uint64(bytes, &exptime) == -1){
+      return -1;
+    }
+    *pmeta = ldb_meta_create_with_exp(vercare, lastver, version, exptime);
+  }
+  for(int i = 0; i < exec_args[op].nums_; ++i){
+    if(ldb_bytes_read_int64(bytes, &nums[i]) == -1){
+      return -1;
+    }
+  }
+  for(int i = 0; i < exec_args[op].strs_; ++i){
+    if(ldb_bytes_read_slice_size_uint32(bytes, &strs[i]) == -1){
+      return -1;
+    }
+  }
+  return 0;
+}
+
+int ldb_exec_batch(ldb_context_t* context,
+                   const char* cmds,
+                   size_t cmdslen,
+                   size_t n,
+                   ldb_exec_result_t* results){
+  if(n == 0){
+    return LDB_OK;
+  }
+  ldb_arena_t* arena = ldb_arena_enter(NULL);
+  int retval = LDB_OK;
+  memset(results, 0, n * sizeof(ldb_exec_result_t));
+  ldb_bytes_t *bytes = ldb_bytes_create(cmds, cmdslen);
+  exec_group_t group;
+  memset(&group, 0, sizeof(group));
+  group.txn_ = ldb_txn_create();
+  group.stripes_ = (uint32_t*)lmalloc(n * sizeof(uint32_t));
+
+  size_t now = 0;
+  for(; now < n; ++now){
+    ldb_exec_result_t *result = &results[now];
+    ldb_meta_t *meta = NULL;
+    ldb_slice_t *strs[3] = {NULL, NULL, NULL};
+    int64_t nums[2] = {0, 0};
+    uint8_t op = 0;
+    if(ldb_bytes_read_uint8(bytes, &op) == -1 || op == 0 || op > LDB_CMD_MAX ||
+       exec_read_args(bytes, op, &meta, nums, strs) == -1){
+      fprintf(stderr, "%s malformed command %lu.\n", __func__, (unsigned long)now);
+      retval = LDB_ERR;
+    }else if(op == LDB_CMD_SET){
+      result->retval_ = string_txn_set(group.txn_, strs[0], strs[1], meta);
+      exec_group_add(&group, result, strs[0]);
+    }else if(op == LDB_CMD_DEL){
+      result->retval_ = string_txn_del(group.txn_, strs[0], meta);
+      exec_group_add(&group, result, strs[0]);
+    }else{
+      exec_group_commit(context, &group);
+      ldb_slice_t *slice_val = NULL;
+      ldb_meta_t *old_meta = NULL;
+      uint64_t length = 0;
+      switch(op){
+        case LDB_CMD_INCRBY:
+          result->retval_ = string_incr(context, strs[0], meta, nums[0], nums[1], &result->num_);
+          break;
+        case LDB_CMD_GET:
+          result->retval_ = string_get(context, strs[0], &slice_val, &old_meta);
+          if(result->retval_ == LDB_OK){
+            exec_fill_item(&result->item_, slice_val, old_meta);
+          }
+          break;
+        case LDB_CMD_HSET:
+          result->retval_ = hash_set(context, strs[0], strs[1], strs[2], meta);
+          break;
+        case LDB_CMD_HGET:
+          result->retval_ = hash_get(context, strs[0], strs[1], &slice_val, &old_meta);
+          if(result->retval_ == LDB_OK){
+            exec_fill_item(&result->item_, slice_val, old_meta);
+          }
+          break;
+        case LDB_CMD_HDEL:
+          result->retval_ = hash_del(context, strs[0], strs[1], meta);
+          break;
+        case LDB_CMD_HINCRBY:
+          result->retval_ = hash_incr(context, strs[0], strs[1], meta, nums[0], &result->num_);
+          break;
+        case LDB_CMD_HLEN:
+          result->retval_ = hash_length(context, strs[0], &length);
+          result->num_ = (int64_t)length;
+          break;
+        case LDB_CMD_SADD:
+          result->retval_ = set_add(context, strs[0], strs[1], meta);
+          break;
+        case LDB_CMD_SREM:
+          result->retval_ = set_rem(context, strs[0], strs[1], meta);
+          break;
+        case LDB_CMD_SISMEMBER:
+          result->retval_ = set_ismember(context, strs[0], strs[1]);
+          break;
+        case LDB_CMD_SCARD:
+          result->retval_ = set_card(context, strs[0], &length);
+          result->num_ = (int64_t)length;
+          break;
+        case LDB_CMD_ZADD:
+          result->retval_ = zset_add(context, strs[0], strs[1], meta, nums[0]);
+          break;
+        case LDB_CMD_ZREM:
+          result->retval_ = zset_del(context, strs[0], strs[1], meta);
+          break;
+        case LDB_CMD_ZINCRBY:
+          result->retval_ = zset_incr(context, strs[0], strs[1], meta, nums[0], &result->num_);
+          break;
+        case LDB_CMD_ZSCORE:
+          result->retval_ = zset_get(context, strs[0], strs[1], &result->num_);
+          break;
+        case LDB_CMD_ZCARD:
+          result->retval_ = zset_size(context, strs[0], &length);
+          result->num_ = (int64_t)length;
+          break;
+      }
+      ldb_slice_destroy(slice_val);
+      ldb_meta_destroy(old_meta);
+    }
+    ldb_meta_destroy(meta);
+    for(int i = 0; i < 3; ++i){
+      ldb_slice_destroy(strs[i]);
+    }
+    if(retval != LDB_OK){
+      break;
+    }
+  }
+  exec_group_commit(context, &group);
+  for(; now < n; ++now){
+    results[now].retval_ = LDB_ERR;
+  }
+
+  ldb_txn_destroy(group.txn_);
+  lfree(group.stripes_);
+  ldb_bytes_destroy(bytes);
+  ldb_arena_leave(arena);
+  return retval;
+}
+
+int ldb_exec_batch_async(ldb_context_t* context,
+                         const char* cmds,
+                         size_t cmdslen,
+                         size_t n,
+                         uint64_t tag){
+  ldb_arena_t* arena = ldb_arena_enter(NULL);
+  int retval = LDB_OK;
+  ldb_bytes_t *bytes = ldb_bytes_create(cmds, cmdslen);
+  ldb_txn_t *txn = ldb_txn_create();
+  uint32_t *stripes = (uint32_t*)lmalloc(sizeof(uint32_t) * (n + 1));
+  for(size_t now = 0; now < n && retval == LDB_OK; ++now){
+    ldb_meta_t *meta = NULL;
+    ldb_slice_t *strs[3] = {NULL, NULL, NULL};
+    int64_t nums[2] = {0, 0};
+    uint8_t op = 0;
+    if(ldb_bytes_read_uint8(bytes, &op) == -1 ||
+       (op != LDB_CMD_SET && op != LDB_CMD_DEL) ||
+       exec_read_args(bytes, op, &meta, nums, strs) == -1){
+      fprintf(stderr, "%s malformed command %lu.\n", __func__, (unsigned long)now);
+      retval = LDB_ERR;
+    }else if(op == LDB_CMD_SET){
+      retval = string_txn_set(txn, strs[0], strs[1], meta);
+    }else{
+      retval = string_txn_del(txn, strs[0], meta);
+    }
+    if(retval == LDB_OK){
+      stripes[now] = ldb_context_key_stripe(ldb_slice_data(strs[0]), ldb_slice_size(strs[0]));
+    }
+    ldb_meta_destroy(meta);
+    for(int i = 0; i < 3; ++i){
+      ldb_slice_destroy(strs[i]);
+    }
+  }
+  if(retval == LDB_OK){
+    retval = ldb_write_async(context, txn, stripes, n, tag);
+  }else{
+    ldb_txn_destroy(txn);
+  }
+
+  lfree(stripes);
+  ldb_bytes_destroy(bytes);
+  ldb_arena_leave(arena);
   return retval;
 }
@@ -3,6 +3,8 @@
 
 #include "ldb_context.h"
 #include "ldb_recovery.h"
+#include "ldb_define.h"
+#include "ldb_async.h"
 
 #include "util/cgo_util_base.h"
 
@@ -16,6 +18,21 @@ typedef struct value_item_t{
 } value_item_t;
 
 
+//one page of a cursor scan, every buffer in it belongs to the caller. the
+//fields or members and the values are copied into buf_ and the items point
+//into it, so pages of any collection take bounded memory.
+typedef struct ldb_scan_page_t{
+    size_t count_;                     //room in items_, values_ and scores_
+    value_item_t* items_;              //fields or members
+    value_item_t* values_;             //hash values, may be NULL otherwise
+    int64_t* scores_;                  //zset scores, may be NULL otherwise
+    size_t itemnum_;
+    char* buf_;
+    size_t buflen_;
+    char next_[LDB_SCAN_CURSOR_MAX];   //opaque, hand it back for the next page
+    size_t nextlen_;                   //0 once the scan is over
+} ldb_scan_page_t;
+
 void fill_value_item(value_item_t* item, uint64_t version, const char* data, size_t size);
 
 void free_value_item(value_item_t* item);
@@ -86,6 +103,16 @@ int ldb_get(ldb_context_t* context,
             size_t keylen, 
             value_item_t** item);
 
+//like ldb_get, but item->data_ points into the db instead of a copy and
+//stays valid until *pinned is passed to ldb_release_pinned
+int ldb_get_pinned(ldb_context_t* context,
+                   char* key,
+                   size_t keylen,
+                   value_item_t* item,
+                   leveldb_pinned_t** pinned);
+
+void ldb_release_pinned(leveldb_pinned_t* pinned);
+
 int ldb_mget(ldb_context_t* context,
              GoByteSlice* slice,
              size_t length,
@@ -99,6 +126,8 @@ int ldb_del(ldb_context_t* context,
             int vercare, 
             uint64_t version);
 
+//the result may be NULL when the caller does not need the new value, the
+//increment is then written without reading the counter
 int ldb_incrby(ldb_context_t* context,
                char* key,
                size_t keylen,
@@ -117,6 +146,14 @@ int ldb_hgetall(ldb_context_t* context,
                 value_item_t** items,
                 size_t* itemnum);
 
+//cursor is empty for the first page, the next_ of the previous page after
+int ldb_hscan(ldb_context_t* context,
+              char* name,
+              size_t namelen,
+              const char* cursor,
+              size_t cursorlen,
+              ldb_scan_page_t* page);
+
 int ldb_hkeys(ldb_context_t* context,
               char* name,
               size_t namelen,
@@ -205,14 +242,32 @@ int ldb_smembers(ldb_context_t* context,
                  value_item_t** items,
                  size_t* itemnum);
 
+int ldb_sscan(ldb_context_t* context,
+              char* name,
+              size_t namelen,
+              const char* cursor,
+              size_t cursorlen,
+              ldb_scan_page_t* page);
+
+//removes up to count random members
 int ldb_spop(ldb_context_t* context,
              char* name,
              size_t namelen,
              uint64_t version,
              int vercare,
+             uint64_t count,
              value_item_t** items,
+             size_t* itemnum,
              uint64_t nextver);
 
+//count > 0 for distinct members, count < 0 for -count members that may repeat
+int ldb_srandmember(ldb_context_t* context,
+                    char* name,
+                    size_t namelen,
+                    int64_t count,
+                    value_item_t** items,
+                    size_t* itemnum);
+
 int ldb_srem(ldb_context_t* context,
              char* name,
              size_t namelen,
@@ -267,6 +322,14 @@ int ldb_zrange_by_score(ldb_context_t* context,
                         int reverse,
                         int withscore);
 
+//members in member order, not by score
+int ldb_zscan(ldb_context_t* context,
+              char* name,
+              size_t namelen,
+              const char* cursor,
+              size_t cursorlen,
+              ldb_scan_page_t* page);
+
 int ldb_zadd(ldb_context_t* context,
              char* name,
              size_t namelen,
@@ -333,6 +396,63 @@ int ldb_zcard(ldb_context_t* context,
               size_t namelen,
               uint64_t* size);
 
+//builds the rank index of a zset, zrank and zrange by rank get answered
+//from it afterwards, LDB_OK_BUT_ALREADY_EXIST if the index is there
+int ldb_zrank_index(ldb_context_t* context,
+                    char* name,
+                    size_t namelen);
+
+//pipeline
+//commands for ldb_exec_batch, back to back in one buffer. each is its op
+//byte and then its arguments in the order below, numbers as fixed64, strings
+//as a fixed32 length and the bytes. meta is fixed32 vercare and fixed64
+//lastver, version and exptime, as the command alone would take them.
+#define LDB_CMD_SET          1    //meta key value
+#define LDB_CMD_DEL          2    //meta key
+#define LDB_CMD_INCRBY       3    //meta init by key, num_ gets the result
+#define LDB_CMD_GET          4    //key, item_ gets the value
+#define LDB_CMD_HSET         5    //meta name field value
+#define LDB_CMD_HGET         6    //name field, item_ gets the value
+#define LDB_CMD_HDEL         7    //meta name field
+#define LDB_CMD_HINCRBY      8    //meta by name field, num_ gets the result
+#define LDB_CMD_HLEN         9    //name, num_ gets the length
+#define LDB_CMD_SADD         10   //meta name member
+#define LDB_CMD_SREM         11   //meta name member
+#define LDB_CMD_SISMEMBER    12   //name member
+#define LDB_CMD_SCARD        13   //name, num_ gets the count
+#define LDB_CMD_ZADD         14   //meta score name member
+#define LDB_CMD_ZREM         15   //meta name member
+#define LDB_CMD_ZINCRBY      16   //meta by name member, num_ gets the score
+#define LDB_CMD_ZSCORE       17   //name member, num_ gets the score
+#define LDB_CMD_ZCARD        18   //name, num_ gets the size
+
+typedef struct ldb_exec_result_t{
+    int retval_;                       //what the command alone returns
+    int64_t num_;
+    value_item_t item_;                //free it with free_value_item
+} ldb_exec_result_t;
+
+//runs the n commands of cmds in order, results holds room for n of them.
+//runs of sets and deletes of strings go into one write batch, committed
+//before any other command runs, so every command sees those before it.
+//LDB_ERR if cmds is malformed, the commands from the bad one on are not run
+//and get LDB_ERR.
+int ldb_exec_batch(ldb_context_t* context,
+                   const char* cmds,
+                   size_t cmdslen,
+                   size_t n,
+                   ldb_exec_result_t* results);
+
+//queues the n commands of cmds, sets and deletes of strings only, as one
+//write with ldb_write_async and returns without waiting for it. the
+//completion comes with tag from ldb_async_poll. LDB_ERR and nothing queued
+//if cmds is malformed, holds other commands or an empty key.
+int ldb_exec_batch_async(ldb_context_t* context,
+                         const char* cmds,
+                         size_t cmdslen,
+                         size_t n,
+                         uint64_t tag);
+
 
 
 
@@ -1,4 +1,5 @@
 #include "ldb_slice.h"
+#include "ldb_arena.h"
 #include "lmalloc.h"
 
 #include <string.h>
@@ -9,18 +10,21 @@ struct ldb_slice_t {
     size_t size_;
     size_t capacity_;
     char *data_;
+    ldb_arena_t *arena_;
 };
 
 
 
 
 ldb_slice_t* ldb_slice_create(const char* data, size_t size){
-  ldb_slice_t *slice = (ldb_slice_t*)lmalloc(sizeof(ldb_slice_t));
+  ldb_arena_t *arena = NULL;
+  ldb_slice_t *slice = (ldb_slice_t*)ldb_arena_lmalloc(sizeof(ldb_slice_t), &arena);
+  slice->arena_ = arena;
   if(size==0 || data == NULL){
     slice->data_ = NULL;
     slice->size_ = 0;
   }else{
-    slice->data_ = lmalloc(size + 1);
+    slice->data_ = ldb_arena_lrealloc(arena, NULL, 0, size + 1);
     memcpy(slice->data_, data, size);
     slice->data_[size] = '\0';
     slice->size_ = size;
@@ -31,8 +35,8 @@ ldb_slice_t* ldb_slice_create(const char* data, size_t size){
 
 void ldb_slice_destroy(ldb_slice_t* slice){
   if(slice!=NULL){
-    lfree(slice->data_);
-    lfree(slice);
+    ldb_arena_lfree(slice->arena_, slice->data_);
+    ldb_arena_lfree(slice->arena_, slice);
   }
 }
 
@@ -49,8 +53,9 @@ static size_t ensure_capacity(size_t size){
 void ldb_slice_push_back(ldb_slice_t* slice, const char* data, size_t size){
   if(size > 0){
     if(slice->capacity_ < (slice->size_ + size + 1)){
-      slice->capacity_ = ensure_capacity(slice->size_ + size + 1);
-      slice->data_ = lrealloc(slice->data_, slice->capacity_);
+      size_t capacity = ensure_capacity(slice->size_ + size + 1);
+      slice->data_ = ldb_arena_lrealloc(slice->arena_, slice->data_, slice->size_ + 1, capacity);
+      slice->capacity_ = capacity;
     }
     memcpy(slice->data_ + slice->size_, data, size);
     slice->size_ += size;
@@ -62,8 +67,9 @@ void ldb_slice_push_back(ldb_slice_t* slice, const char* data, size_t size){
 void ldb_slice_push_front(ldb_slice_t* slice, const char* data, size_t size){
   if(size > 0){
     if(slice->capacity_ < (slice->size_ + size + 1)){
-      slice->capacity_ = ensure_capacity(slice->size_ + size + 1);
-      slice->data_ = lrealloc(slice->data_, slice->capacity_);
+      size_t capacity = ensure_capacity(slice->size_ + size + 1);
+      slice->data_ = ldb_arena_lrealloc(slice->arena_, slice->data_, slice->size_ + 1, capacity);
+      slice->capacity_ = capacity;
     }
     memmove(slice->data_ + size, slice->data_, slice->size_);
     memcpy(slice->data_, data, size);
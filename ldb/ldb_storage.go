@@ -1,6 +1,9 @@
 package ldb
 
-import "unsafe"
+import (
+	"encoding/binary"
+	"unsafe"
+)
 
 const (
 	STORAGE_OK_SUB_NOT_EXIST            = 6
@@ -120,6 +123,199 @@ type StorageStatusItem struct {
 	Value string
 }
 
+// Op bytes of the commands in a StoragePipeline, as LDB_CMD_* in ldb_session.h
+const (
+	pipelineSet       = 1
+	pipelineDel       = 2
+	pipelineIncrby    = 3
+	pipelineGet       = 4
+	pipelineHSet      = 5
+	pipelineHGet      = 6
+	pipelineHDel      = 7
+	pipelineHIncrby   = 8
+	pipelineHLen      = 9
+	pipelineSAdd      = 10
+	pipelineSRem      = 11
+	pipelineSIsMember = 12
+	pipelineSCard     = 13
+	pipelineZAdd      = 14
+	pipelineZRem      = 15
+	pipelineZIncrby   = 16
+	pipelineZScore    = 17
+	pipelineZCard     = 18
+)
+
+// StoragePipeline collects commands for ExecPipeline, which runs all of them
+// in one call. Each command gets one StoragePipelineResult, in order.
+type StoragePipeline struct {
+	buf []byte
+	n   int
+}
+
+// StoragePipelineResult is the outcome of one pipelined command: Ret is what
+// the command alone returns, Num the result of incrby, hincrby, zincrby,
+// zscore, hlen, scard and zcard, Value the result of get and hget.
+type StoragePipelineResult struct {
+	Ret   int
+	Num   int64
+	Value StorageByteValueData
+}
+
+func (p *StoragePipeline) Len() int {
+	return p.n
+}
+
+func (p *StoragePipeline) Reset() {
+	p.buf = p.buf[:0]
+	p.n = 0
+}
+
+func (p *StoragePipeline) op(op byte) {
+	p.buf = append(p.buf, op)
+	p.n++
+}
+
+func (p *StoragePipeline) meta(meta StorageMetaData, version StorageVersionType) {
+	var b [28]byte
+	binary.LittleEndian.PutUint32(b[0:], uint32(meta.Versioncare))
+	binary.LittleEndian.PutUint64(b[4:], uint64(meta.Lastversion))
+	binary.LittleEndian.PutUint64(b[12:], uint64(version))
+	binary.LittleEndian.PutUint64(b[20:], uint64(meta.Expiretime))
+	p.buf = append(p.buf, b[:]...)
+}
+
+func (p *StoragePipeline) num(n int64) {
+	var b [8]byte
+	binary.LittleEndian.PutUint64(b[:], uint64(n))
+	p.buf = append(p.buf, b[:]...)
+}
+
+func (p *StoragePipeline) str(s string) {
+	var b [4]byte
+	binary.LittleEndian.PutUint32(b[:], uint32(len(s)))
+	p.buf = append(p.buf, b[:]...)
+	p.buf = append(p.buf, s...)
+}
+
+func (p *StoragePipeline) Set(key string, value StorageValueData, meta StorageMetaData) {
+	p.op(pipelineSet)
+	p.meta(meta, value.Version)
+	p.str(key)
+	p.str(value.Value)
+}
+
+func (p *StoragePipeline) Del(key string, version StorageVersionType, meta StorageMetaData) {
+	p.op(pipelineDel)
+	p.meta(meta, version)
+	p.str(key)
+}
+
+func (p *StoragePipeline) Incrby(key string, version StorageVersionType, by int64, meta StorageMetaData) {
+	p.op(pipelineIncrby)
+	p.meta(meta, version)
+	p.num(0)
+	p.num(by)
+	p.str(key)
+}
+
+func (p *StoragePipeline) Get(key string) {
+	p.op(pipelineGet)
+	p.str(key)
+}
+
+func (p *StoragePipeline) HSet(key, field string, value StorageValueData, meta StorageMetaData) {
+	p.op(pipelineHSet)
+	p.meta(meta, value.Version)
+	p.str(key)
+	p.str(field)
+	p.str(value.Value)
+}
+
+func (p *StoragePipeline) HGet(key, field string) {
+	p.op(pipelineHGet)
+	p.str(key)
+	p.str(field)
+}
+
+func (p *StoragePipeline) HDel(key string, field StorageValueData, meta StorageMetaData) {
+	p.op(pipelineHDel)
+	p.meta(meta, field.Version)
+	p.str(key)
+	p.str(field.Value)
+}
+
+func (p *StoragePipeline) HIncrby(key, field string, version StorageVersionType, by int64, meta StorageMetaData) {
+	p.op(pipelineHIncrby)
+	p.meta(meta, version)
+	p.num(by)
+	p.str(key)
+	p.str(field)
+}
+
+func (p *StoragePipeline) HLen(key string) {
+	p.op(pipelineHLen)
+	p.str(key)
+}
+
+func (p *StoragePipeline) SAdd(key string, value StorageValueData, meta StorageMetaData) {
+	p.op(pipelineSAdd)
+	p.meta(meta, value.Version)
+	p.str(key)
+	p.str(value.Value)
+}
+
+func (p *StoragePipeline) SRem(key string, value StorageValueData, meta StorageMetaData) {
+	p.op(pipelineSRem)
+	p.meta(meta, value.Version)
+	p.str(key)
+	p.str(value.Value)
+}
+
+func (p *StoragePipeline) SIsMember(key string, value string) {
+	p.op(pipelineSIsMember)
+	p.str(key)
+	p.str(value)
+}
+
+func (p *StoragePipeline) SCard(key string) {
+	p.op(pipelineSCard)
+	p.str(key)
+}
+
+func (p *StoragePipeline) ZAdd(key string, scoreValue StorageScoreValueData, meta StorageMetaData) {
+	p.op(pipelineZAdd)
+	p.meta(meta, scoreValue.Version)
+	p.num(scoreValue.Score)
+	p.str(key)
+	p.str(scoreValue.Value)
+}
+
+func (p *StoragePipeline) ZRem(key string, value StorageValueData, meta StorageMetaData) {
+	p.op(pipelineZRem)
+	p.meta(meta, value.Version)
+	p.str(key)
+	p.str(value.Value)
+}
+
+func (p *StoragePipeline) ZIncrby(key string, value StorageValueData, by int64, meta StorageMetaData) {
+	p.op(pipelineZIncrby)
+	p.meta(meta, value.Version)
+	p.num(by)
+	p.str(key)
+	p.str(value.Value)
+}
+
+func (p *StoragePipeline) ZScore(key string, value string) {
+	p.op(pipelineZScore)
+	p.str(key)
+	p.str(value)
+}
+
+func (p *StoragePipeline) ZCard(key string) {
+	p.op(pipelineZCard)
+	p.str(key)
+}
+
 type IStorageManager interface {
 
 	/// common
@@ -210,6 +406,8 @@ type IStorageManager interface {
 
 	SPop(key string, meta StorageMetaData) (int, StorageByteValueData)
 
+	SRandMember(key string, count int64) (int, []StorageByteValueData)
+
 	SRem(key string, values []StorageValueData, meta StorageMetaData) (int, []int)
 
 	SCard(key string) (int, uint64)
@@ -240,9 +438,21 @@ type IStorageManager interface {
 
 	ZRevRank(key string, value StorageValueData) (int, uint64)
 
-	HScan(key string, cursor int, matchFmt string, count int) (int, []StorageByteValueData)
+	// cursor is nil for the first page and the returned next cursor is nil
+	// once the scan is over
+	HScan(key string, cursor []byte, count int) (int, []StorageByteValueData, []StorageByteValueData, []byte)
+
+	SScan(key string, cursor []byte, count int) (int, []StorageByteValueData, []byte)
+
+	ZScan(key string, cursor []byte, count int) (int, []StorageByteValueData, []int64, []byte)
+
+	/// pipeline
 
-	SScan(key string, cursor int, matchFmt string, count int) (int, []StorageByteValueData)
+	// runs the commands of p in one call, sets and deletes of strings in
+	// a row are written in one batch
+	ExecPipeline(p *StoragePipeline) (int, []StoragePipelineResult)
 
-	ZScan(key string, cursor int, matchFmt string, count int) (int, []StorageByteValueData)
+	// queues the sets and deletes of p as one write, done gets the result
+	// once it is written
+	ExecPipelineAsync(p *StoragePipeline, done func(ret int)) int
 }
@@ -0,0 +1,73 @@
+#include "ldb_txn.h"
+#include "lmalloc.h"
+
+#include <leveldb/c.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+struct ldb_txn_t {
+    leveldb_writebatch_t*   batch_;
+};
+
+ldb_txn_t* ldb_txn_create(){
+    ldb_txn_t* txn = (ldb_txn_t*)lmalloc(sizeof(ldb_txn_t));
+    txn->batch_ = leveldb_writebatch_create();
+    return txn;
+}
+
+void ldb_txn_destroy(ldb_txn_t* txn){
+    if(txn!=NULL){
+        leveldb_writebatch_destroy(txn->batch_);
+    }
+    lfree(txn);
+}
+
+void ldb_txn_put(ldb_txn_t* txn, const char* key, size_t klen, const char* val, size_t vlen){
+    leveldb_writebatch_put(txn->batch_, key, klen, val, vlen);
+}
+
+void ldb_txn_put_with_meta(ldb_txn_t* txn, const ldb_meta_t* meta, const char* key, size_t klen, const char* val, size_t vlen){
+    leveldb_writebatch_put_with_meta(txn->batch_,
+                                     ldb_meta_vercare(meta),
+                                     ldb_meta_lastver(meta),
+                                     ldb_meta_nextver(meta),
+                                     ldb_meta_exptime(meta),
+                                     key, klen, val, vlen);
+}
+
+void ldb_txn_delete(ldb_txn_t* txn, const char* key, size_t klen){
+    leveldb_writebatch_delete(txn->batch_, key, klen);
+}
+
+void ldb_txn_touch(ldb_txn_t* txn, const char* key, size_t klen){
+    leveldb_writebatch_touch(txn->batch_, key, klen);
+}
+
+void ldb_txn_merge(ldb_txn_t* txn, const ldb_meta_t* meta, const char* key, size_t klen, int64_t delta, int64_t initial, int drop_zero){
+    leveldb_writebatch_merge(txn->batch_,
+                             ldb_meta_vercare(meta),
+                             ldb_meta_lastver(meta),
+                             ldb_meta_nextver(meta),
+                             ldb_meta_exptime(meta),
+                             key, klen, delta, initial,
+                             drop_zero ? 1 : 0);
+}
+
+void ldb_txn_clear(ldb_txn_t* txn){
+    leveldb_writebatch_clear(txn->batch_);
+}
+
+void ldb_txn_append(ldb_txn_t* dst, ldb_txn_t* src){
+    leveldb_writebatch_append(dst->batch_, src->batch_);
+    leveldb_writebatch_clear(src->batch_);
+}
+
+size_t ldb_txn_size(const ldb_txn_t* txn){
+    return leveldb_writebatch_size(txn->batch_);
+}
+
+void ldb_txn_commit(ldb_context_t* context, ldb_txn_t* txn, char** errptr){
+    leveldb_write(context->database_, context->writeoptions_, txn->batch_, errptr);
+    leveldb_writebatch_clear(txn->batch_);
+}
@@ -0,0 +1,45 @@
+#ifndef LDB_TXN_H
+#define LDB_TXN_H
+
+#include "ldb_context.h"
+#include "ldb_meta.h"
+
+#include <leveldb/c.h>
+#include <stdlib.h>
+
+
+//a write batch owned by one command, never shared between callers,
+//concurrent commands only meet in leveldb's group commit
+typedef struct ldb_txn_t     ldb_txn_t;
+
+ldb_txn_t* ldb_txn_create();
+
+void ldb_txn_destroy(ldb_txn_t* txn);
+
+void ldb_txn_put(ldb_txn_t* txn, const char* key, size_t klen, const char* val, size_t vlen);
+
+//key comes without the meta prefix, meta is logged apart from it
+void ldb_txn_put_with_meta(ldb_txn_t* txn, const ldb_meta_t* meta, const char* key, size_t klen, const char* val, size_t vlen);
+
+void ldb_txn_delete(ldb_txn_t* txn, const char* key, size_t klen);
+
+//rewrites the version and exptime encoded in key but keeps the value
+void ldb_txn_touch(ldb_txn_t* txn, const char* key, size_t klen);
+
+//adds delta to the 8 byte counter of key without reading it, the counter
+//starts from initial if there is none. key comes without the meta prefix.
+//with drop_zero, compactions remove the counter once it is 0.
+void ldb_txn_merge(ldb_txn_t* txn, const ldb_meta_t* meta, const char* key, size_t klen, int64_t delta, int64_t initial, int drop_zero);
+
+void ldb_txn_clear(ldb_txn_t* txn);
+
+//moves the records of src behind those of dst, src is left empty
+void ldb_txn_append(ldb_txn_t* dst, ldb_txn_t* src);
+
+//bytes taken by the records of txn
+size_t ldb_txn_size(const ldb_txn_t* txn);
+
+//write the batch into context->database_ and clear it for reuse
+void ldb_txn_commit(ldb_context_t* context, ldb_txn_t* txn, char** errptr);
+
+#endif //LDB_TXN_H
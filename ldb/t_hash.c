@@ -6,6 +6,8 @@
 #include "ldb_list.h"
 #include "ldb_iterator.h"
 #include "ldb_context.h"
+#include "ldb_txn.h"
+#include "lmalloc.h"
 #include "util.h"
 
 
@@ -16,14 +18,13 @@
 #include <stdint.h>
 #include <assert.h>
 
-static int hset_one(ldb_context_t* context, const ldb_slice_t* name,
+static int hset_one(ldb_context_t* context, ldb_txn_t* txn, const ldb_slice_t* name,
                     const ldb_slice_t* key, const ldb_slice_t* value, const ldb_meta_t* meta); 
 
-static int hdel_one(ldb_context_t* context, const ldb_slice_t* name,
+static int hdel_one(ldb_context_t* context, ldb_txn_t* txn, const ldb_slice_t* name,
                     const ldb_slice_t* key, const ldb_meta_t* meta);
 
-static int hash_incr_size(ldb_context_t* context, const ldb_slice_t* name,
-                    int64_t by);
+static int hash_incr_size(ldb_txn_t* txn, const ldb_slice_t* name, int64_t by);
 
 static int hscan(ldb_context_t* context, const ldb_slice_t* name,
                  const ldb_slice_t* kstart, const ldb_slice_t* kend, uint64_t limit, int reverse, ldb_hash_iterator_t** piterator);
@@ -79,6 +80,21 @@ void encode_hash_key(const char* name, size_t namelen, const char* key, size_t k
   *pslice = slice;
 }
 
+size_t encode_hash_key_raw(char* buf, size_t buflen, const char* name, size_t namelen, const char* key, size_t keylen){
+  size_t size = strlen(LDB_DATA_TYPE_HASH) + sizeof(uint8_t) + namelen + 1 + keylen;
+  if(size > buflen){
+    return size;
+  }
+  memcpy(buf, LDB_DATA_TYPE_HASH, strlen(LDB_DATA_TYPE_HASH));
+  buf += strlen(LDB_DATA_TYPE_HASH);
+  *buf++ = (char)(uint8_t)namelen;
+  memcpy(buf, name, namelen);
+  buf += namelen;
+  *buf++ = '=';
+  memcpy(buf, key, keylen);
+  return size;
+}
+
 int decode_hash_key(const char* ldbkey, size_t ldbkeylen, ldb_slice_t **pslice_name, ldb_slice_t **pslice_key){
   int retval = 0;
   ldb_slice_t *slice_name = NULL, *slice_key = NULL;
@@ -131,11 +147,9 @@ int hash_get(ldb_context_t* context, const ldb_slice_t* name, const ldb_slice_t*
   int retval = 0;
   char *val = NULL, *errptr = NULL;
   size_t vallen = 0;
-  leveldb_readoptions_t *readoptions = leveldb_readoptions_create();
   ldb_slice_t* slice_key = NULL;
   encode_hash_key(ldb_slice_data(name), ldb_slice_size(name), ldb_slice_data(key), ldb_slice_size(key), NULL, &slice_key);
-  val = leveldb_get(context->database_, readoptions, ldb_slice_data(slice_key), ldb_slice_size(slice_key), &vallen, &errptr);
-  leveldb_readoptions_destroy(readoptions);
+  val = leveldb_get(context->database_, context->readoptions_, ldb_slice_data(slice_key), ldb_slice_size(slice_key), &vallen, &errptr);
   ldb_slice_destroy(slice_key);
   if(errptr!=NULL){
     fprintf(stderr, "%s leveldb_get fail %s.\n", __func__, errptr);
@@ -170,25 +184,11 @@ end:
 }
 
 
-static int hash_mget_one(ldb_context_t* context, 
-                         const leveldb_readoptions_t* options, 
-                         const ldb_slice_t* name, 
-                         const ldb_slice_t* key, 
+static int hash_mget_one(const char* val,
+                         size_t vallen,
                          ldb_slice_t** pslice, 
                          ldb_meta_t** pmeta){
   int retval = 0;
-  char *val = NULL, *errptr = NULL;
-  size_t vallen = 0;
-  ldb_slice_t* slice_key = NULL;
-  encode_hash_key(ldb_slice_data(name), ldb_slice_size(name), ldb_slice_data(key), ldb_slice_size(key), NULL, &slice_key);
-  val = leveldb_get(context->database_, options, ldb_slice_data(slice_key), ldb_slice_size(slice_key), &vallen, &errptr);
-  ldb_slice_destroy(slice_key);
-  if(errptr!=NULL){
-    fprintf(stderr, "%s leveldb_get fail %s.\n", __func__, errptr);
-    leveldb_free(errptr);
-    retval = LDB_ERR;
-    goto end;
-  }
   if(val!=NULL){
     assert(vallen>= LDB_VAL_META_SIZE);
     uint8_t type = leveldb_decode_fixed8(val);
@@ -209,32 +209,44 @@ static int hash_mget_one(ldb_context_t* context,
   }
 
 end:
-  if(val != NULL){
-    leveldb_free(val); 
-  }
   return retval;
 }
 
 int hash_mget(ldb_context_t* context, const ldb_slice_t* name, const ldb_list_t* keylist, ldb_list_t** pvallist, ldb_list_t** pmetalist){
   int retval = 0;
-  leveldb_readoptions_t* readoptions = leveldb_readoptions_create();
-  const leveldb_snapshot_t *snapshot_for_mget = leveldb_create_snapshot(context->database_);
-  leveldb_readoptions_set_snapshot(readoptions, snapshot_for_mget);
+  size_t count = keylist->length_, now = 0;
+  ldb_slice_t **slice_keys = (ldb_slice_t**)lmalloc(sizeof(ldb_slice_t*) * (count + 1));
+  const char **keys = (const char**)lmalloc(sizeof(char*) * (count + 1));
+  size_t *keylens = (size_t*)lmalloc(sizeof(size_t) * (count + 1));
+  char **vals = (char**)lmalloc(sizeof(char*) * (count + 1));
+  size_t *vallens = (size_t*)lmalloc(sizeof(size_t) * (count + 1));
 
   ldb_list_iterator_t *keyiterator = ldb_list_iterator_create(keylist);
+  for(now = 0; now < count; ++now){
+    ldb_list_node_t *node_key = ldb_list_next(&keyiterator);
+    const ldb_slice_t *key = (const ldb_slice_t*)node_key->data_;
+    encode_hash_key(ldb_slice_data(name), ldb_slice_size(name), ldb_slice_data(key), ldb_slice_size(key), NULL, &slice_keys[now]);
+    keys[now] = ldb_slice_data(slice_keys[now]);
+    keylens[now] = ldb_slice_size(slice_keys[now]);
+  }
+  ldb_list_iterator_destroy(keyiterator);
+
+  //one lookup of all fields, read from the same state of the db
+  char *errptr = NULL;
+  leveldb_multi_get(context->database_, context->readoptions_, count, keys, keylens, vals, vallens, &errptr);
+  if(errptr != NULL){
+    fprintf(stderr, "%s leveldb_multi_get fail %s.\n", __func__, errptr);
+    leveldb_free(errptr);
+  }
+
   *pvallist = ldb_list_create();
   *pmetalist = ldb_list_create();
-  while(1){
-    ldb_list_node_t *node_key = ldb_list_next(&keyiterator);
-    if(node_key == NULL){
-      retval = LDB_OK;
-      break;
-    }
+  for(now = 0; now < count; ++now){
     ldb_slice_t *val = NULL;
     ldb_meta_t *meta = NULL;
     ldb_list_node_t *node_val = ldb_list_node_create();
     ldb_list_node_t *node_meta = ldb_list_node_create();
-    if(hash_mget_one(context, readoptions, name, (ldb_slice_t*)node_key->data_, &val, &meta)== LDB_OK){
+    if(hash_mget_one(vals[now], vallens[now], &val, &meta)== LDB_OK){
       node_val->data_ = val;
       node_val->type_ = LDB_LIST_NODE_TYPE_SLICE;
       node_meta->value_ = ldb_meta_nextver(meta);
@@ -246,11 +258,18 @@ int hash_mget(ldb_context_t* context, const ldb_slice_t* name, const ldb_list_t*
     ldb_meta_destroy(meta);
     rpush_ldb_list_node(*pvallist, node_val);
     rpush_ldb_list_node(*pmetalist, node_meta);
+    if(vals[now] != NULL){
+      leveldb_free(vals[now]);
+    }
+    ldb_slice_destroy(slice_keys[now]);
   }
+  retval = LDB_OK;
 
-  ldb_list_iterator_destroy(keyiterator);
-  leveldb_readoptions_destroy(readoptions);
-  leveldb_release_snapshot(context->database_, snapshot_for_mget);
+  lfree(vallens);
+  lfree(vals);
+  lfree(keylens);
+  lfree(keys);
+  lfree(slice_keys);
   return retval;
 }
 
@@ -370,17 +389,19 @@ end:
 
 int hash_set(ldb_context_t* context, const ldb_slice_t* name, const ldb_slice_t* key, const ldb_slice_t* value, const ldb_meta_t* meta){
     int retval = 0, ret = 0;
+    ldb_txn_t *txn = ldb_txn_create();
 
-    ret = hset_one(context, name, key, value, meta); 
+    ldb_context_lock_key(context, ldb_slice_data(name), ldb_slice_size(name));
+    ret = hset_one(context, txn, name, key, value, meta); 
     if(ret >=0){
         if(ret > 0){
-            if(hash_incr_size(context, name, 1) < 0){
+            if(hash_incr_size(txn, name, 1) < 0){
                 retval = LDB_ERR;
                 goto end;
             }
         }
         char *errptr = NULL;
-        ldb_context_writebatch_commit(context, &errptr);
+        ldb_txn_commit(context, txn, &errptr);
         if(errptr != NULL){
             fprintf(stderr, "%s leveldb_write fail %s.\n", __func__, errptr);
             leveldb_free(errptr);
@@ -392,6 +413,8 @@ int hash_set(ldb_context_t* context, const ldb_slice_t* name, const ldb_slice_t*
         retval = LDB_ERR;
     }
 end:
+    ldb_context_unlock_key(context, ldb_slice_data(name), ldb_slice_size(name));
+    ldb_txn_destroy(txn);
     return retval;
 }
 
@@ -399,6 +422,7 @@ end:
 int hash_setnx(ldb_context_t* context, const ldb_slice_t* name, const ldb_slice_t* key, const ldb_slice_t* value, const ldb_meta_t* meta){
     int retval, ret = 0;
 
+    ldb_context_lock_key(context, ldb_slice_data(name), ldb_slice_size(name));
     ret = hash_exists(context, name, key);
     if(ret == LDB_OK_NOT_EXIST){
         retval = hash_set(context, name, key, value, meta);
@@ -407,6 +431,7 @@ int hash_setnx(ldb_context_t* context, const ldb_slice_t* name, const ldb_slice_
     }else{
         retval = LDB_ERR;
     }
+    ldb_context_unlock_key(context, ldb_slice_data(name), ldb_slice_size(name));
 
     return retval;
 }
@@ -417,6 +442,7 @@ int hash_mset(ldb_context_t* context, const ldb_slice_t* name, const ldb_list_t*
     ldb_list_iterator_t *dataiterator = ldb_list_iterator_create(datalist);
     ldb_list_iterator_t *metaiterator = ldb_list_iterator_create(metalist);
     ldb_list_t *retlist = ldb_list_create();
+    ldb_context_lock_key(context, ldb_slice_data(name), ldb_slice_size(name));
     while(1){
         ldb_list_node_t* node_key = ldb_list_next(&dataiterator);
         if(node_key== NULL){
@@ -439,6 +465,7 @@ int hash_mset(ldb_context_t* context, const ldb_slice_t* name, const ldb_list_t*
         node_ret->value_ = ret;
         rpush_ldb_list_node(retlist, node_ret); 
     }
+    ldb_context_unlock_key(context, ldb_slice_data(name), ldb_slice_size(name));
 
     if(retlist != NULL){
         (*plist) = retlist;
@@ -450,13 +477,27 @@ int hash_mset(ldb_context_t* context, const ldb_slice_t* name, const ldb_list_t*
 
 
 int hash_exists(ldb_context_t* context, const ldb_slice_t* name, const ldb_slice_t* key){ 
-  ldb_slice_t* slice_val = NULL;
-  ldb_meta_t* meta = NULL;
-  int retval = hash_get(context, name, key, &slice_val, &meta); 
-
-  ldb_slice_destroy(slice_val);
-  ldb_meta_destroy(meta);
-  return retval;
+  char header[LDB_VAL_HEADER_MAX_SIZE];
+  size_t headerlen = sizeof(header);
+  char *errptr = NULL;
+  ldb_slice_t* slice_key = NULL;
+  encode_hash_key(ldb_slice_data(name), ldb_slice_size(name), ldb_slice_data(key), ldb_slice_size(key), NULL, &slice_key);
+  unsigned char found = leveldb_exists(context->database_, context->readoptions_, ldb_slice_data(slice_key), ldb_slice_size(slice_key), header, &headerlen, &errptr);
+  ldb_slice_destroy(slice_key);
+  if(errptr!=NULL){
+    fprintf(stderr, "%s leveldb_exists fail %s.\n", __func__, errptr);
+    leveldb_free(errptr);
+    return LDB_ERR;
+  }
+  if(!found){
+    return LDB_OK_NOT_EXIST;
+  }
+  assert(headerlen >= LDB_VAL_META_SIZE);
+  uint8_t type = leveldb_decode_fixed8(header);
+  if((type & LDB_VALUE_TYPE_VAL) && !(type & LDB_VALUE_TYPE_LAT)){
+    return LDB_OK;
+  }
+  return LDB_OK_NOT_EXIST;
 }
 
 
@@ -466,11 +507,9 @@ int hash_length(ldb_context_t* context, const ldb_slice_t* name, uint64_t* lengt
   int retval = 0;
   char *val = NULL, *errptr = NULL;
   size_t vallen = 0;
-  leveldb_readoptions_t *readoptions = leveldb_readoptions_create();
   ldb_slice_t* slice_key = NULL;
   encode_hsize_key(ldb_slice_data(name), ldb_slice_size(name), &slice_key);
-  val = leveldb_get(context->database_, readoptions, ldb_slice_data(slice_key), ldb_slice_size(slice_key), &vallen, &errptr);
-  leveldb_readoptions_destroy(readoptions);
+  val = leveldb_get(context->database_, context->readoptions_, ldb_slice_data(slice_key), ldb_slice_size(slice_key), &vallen, &errptr);
   ldb_slice_destroy(slice_key);
   if(errptr!=NULL){
     fprintf(stderr, "%s leveldb_get fail %s.\n", __func__, errptr);
@@ -486,7 +525,13 @@ int hash_length(ldb_context_t* context, const ldb_slice_t* name, uint64_t* lengt
         retval = LDB_OK_NOT_EXIST;
         goto end;
       }
-      *length = leveldb_decode_fixed64(val + LDB_VAL_META_SIZE);
+      //the merged size drops to 0 instead of being deleted
+      int64_t size = (int64_t)leveldb_decode_fixed64(val + LDB_VAL_META_SIZE);
+      if(size <= 0){
+        retval = LDB_OK_NOT_EXIST;
+        goto end;
+      }
+      *length = size;
       retval = LDB_OK;
     }else{
       retval = LDB_OK_NOT_EXIST;
@@ -507,7 +552,9 @@ int hash_incr(ldb_context_t* context, const ldb_slice_t* name, const ldb_slice_t
   ldb_slice_t *slice_old_val = NULL;
   ldb_slice_t *slice_new_val= NULL;
   ldb_meta_t *old_meta = NULL;
+  ldb_txn_t *txn = ldb_txn_create();
   int64_t old_val = 0;
+  ldb_context_lock_key(context, ldb_slice_data(name), ldb_slice_size(name));
   int ret = hash_get(context, name, key, &slice_old_val, &old_meta);
   if(ret == LDB_OK){
     old_val = leveldb_decode_fixed64(ldb_slice_data(slice_old_val));
@@ -521,16 +568,16 @@ int hash_incr(ldb_context_t* context, const ldb_slice_t* name, const ldb_slice_t
   char buff[sizeof(uint64_t)] = {0};
   leveldb_encode_fixed64(buff, old_val);
   slice_new_val = ldb_slice_create(buff, sizeof(buff));
-  ret = hset_one(context, name, key, slice_new_val, meta);
+  ret = hset_one(context, txn, name, key, slice_new_val, meta);
   if(ret >=0){
     if(ret > 0){
-      if(hash_incr_size(context, name, 1) < 0){
+      if(hash_incr_size(txn, name, 1) < 0){
         retval = LDB_ERR;
         goto end;
       }
     }
     char *errptr = NULL;
-    ldb_context_writebatch_commit(context, &errptr);
+    ldb_txn_commit(context, txn, &errptr);
     if(errptr != NULL){
       fprintf(stderr, "%s leveldb_write fail %s.\n", __func__, errptr);
       leveldb_free(errptr);
@@ -544,24 +591,28 @@ int hash_incr(ldb_context_t* context, const ldb_slice_t* name, const ldb_slice_t
   }
  
 end:
+  ldb_context_unlock_key(context, ldb_slice_data(name), ldb_slice_size(name));
   ldb_slice_destroy(slice_old_val);
   ldb_slice_destroy(slice_new_val);
   ldb_meta_destroy(old_meta);
+  ldb_txn_destroy(txn);
   return retval;
 }
 
 
 int hash_del(ldb_context_t* context, const ldb_slice_t* name, const ldb_slice_t* key, const ldb_meta_t* meta){
     int retval, ret = 0;
-    ret = hdel_one(context, name, key, meta);
+    ldb_txn_t *txn = ldb_txn_create();
+    ldb_context_lock_key(context, ldb_slice_data(name), ldb_slice_size(name));
+    ret = hdel_one(context, txn, name, key, meta);
     if(ret >=0){
         if(ret > 0){
-            if(hash_incr_size(context, name, -1) < 0){
+            if(hash_incr_size(txn, name, -1) < 0){
                 retval = LDB_ERR;
                 goto end;
             }
             char *errptr = NULL;
-            ldb_context_writebatch_commit(context, &errptr);
+            ldb_txn_commit(context, txn, &errptr);
             if(errptr != NULL){
                 fprintf(stderr, "%s leveldb_write fail %s.\n", errptr, __func__);
                 leveldb_free(errptr);
@@ -577,12 +628,14 @@ int hash_del(ldb_context_t* context, const ldb_slice_t* name, const ldb_slice_t*
     }
 
 end:
+    ldb_context_unlock_key(context, ldb_slice_data(name), ldb_slice_size(name));
+    ldb_txn_destroy(txn);
     return retval;
 }
 
 
 
-static int hset_one(ldb_context_t* context, const ldb_slice_t* name,
+static int hset_one(ldb_context_t* context, ldb_txn_t* txn, const ldb_slice_t* name,
                     const ldb_slice_t* key, const ldb_slice_t* value, const ldb_meta_t* meta){
   if(ldb_slice_size(name)==0 || ldb_slice_size(key)==0){
     fprintf(stderr, "%s empty name or key!", __func__);
@@ -597,48 +650,33 @@ static int hset_one(ldb_context_t* context, const ldb_slice_t* name,
     return -1;
   }
   int retval = 0;
-  ldb_slice_t *slice_key = NULL;
   ldb_slice_t *slice_val = NULL;
   ldb_meta_t *old_meta = NULL;
   if(hash_get(context, name, key, &slice_val, &old_meta) == LDB_OK_NOT_EXIST){
-    encode_hash_key(ldb_slice_data(name),
-                    ldb_slice_size(name),
-                    ldb_slice_data(key),
-                    ldb_slice_size(key),
-                    meta,
-                    &slice_key);
-
-    ldb_context_writebatch_put(context,
-                               ldb_slice_data(slice_key),
-                               ldb_slice_size(slice_key),
-                               ldb_slice_data(value),
-                               ldb_slice_size(value));
     retval = 1;
-  }else{
-    encode_hash_key(ldb_slice_data(name),
-                    ldb_slice_size(name),
-                    ldb_slice_data(key),
-                    ldb_slice_size(key),
-                    meta,
-                    &slice_key);
-
-    ldb_context_writebatch_put(context,
-                               ldb_slice_data(slice_key),
-                               ldb_slice_size(slice_key),
-                               ldb_slice_data(value),
-                               ldb_slice_size(value)); 
-
-    retval = 0;
   }
+  char keybuf[LDB_KEY_BUF_SIZE];
+  size_t keylen = encode_hash_key_raw(keybuf,
+                                      sizeof(keybuf),
+                                      ldb_slice_data(name),
+                                      ldb_slice_size(name),
+                                      ldb_slice_data(key),
+                                      ldb_slice_size(key));
+  assert(keylen <= sizeof(keybuf));
+  ldb_txn_put_with_meta(txn,
+                        meta,
+                        keybuf,
+                        keylen,
+                        ldb_slice_data(value),
+                        ldb_slice_size(value));
 
-  ldb_slice_destroy(slice_key);
   ldb_slice_destroy(slice_val);
   ldb_meta_destroy(old_meta);
   return retval;
 }
 
 
-static int hdel_one(ldb_context_t* context, const ldb_slice_t* name,
+static int hdel_one(ldb_context_t* context, ldb_txn_t* txn, const ldb_slice_t* name,
                     const ldb_slice_t* key, const ldb_meta_t* meta){
 
   if(ldb_slice_size(name) > LDB_DATA_TYPE_KEY_LEN_MAX){
@@ -663,41 +701,28 @@ static int hdel_one(ldb_context_t* context, const ldb_slice_t* name,
                   ldb_slice_size(key),
                   meta,
                   &slice_key);
-  ldb_context_writebatch_delete(context,
-                                ldb_slice_data(slice_key),
-                                ldb_slice_size(slice_key));
+  ldb_txn_delete(txn,
+                 ldb_slice_data(slice_key),
+                 ldb_slice_size(slice_key));
   return 1;
 }
 
 
-static int hash_incr_size(ldb_context_t* context, const ldb_slice_t* name,
-                    int64_t by){
-  uint64_t length = 0;
-  int retval = hash_length(context, name, &length);
-  if(retval!=LDB_OK && retval != LDB_OK_NOT_EXIST){
-    return -1;
-  }
-  int64_t size = (int64_t)length;
-  size += by;
-
-  ldb_slice_t* slice_key = NULL;
-  encode_hsize_key(ldb_slice_data(name),
-                   ldb_slice_size(name),
-                   &slice_key);
-  if(size <= 0){
-    ldb_context_writebatch_delete(context,
-                                  ldb_slice_data(slice_key),
-                                  ldb_slice_size(slice_key));
-  }else{
-    char buff[sizeof(uint64_t)] = {0};
-    length = size;
-    leveldb_encode_fixed64(buff, length);
-    ldb_context_writebatch_put(context,
-                               ldb_slice_data(slice_key),
-                               ldb_slice_size(slice_key),
-                               buff,
-                               sizeof(buff));
-  }
+static int hash_incr_size(ldb_txn_t* txn, const ldb_slice_t* name, int64_t by){
+  //a merge operand, so that writers do not have to read the size first,
+  //dropped by compactions once the size is back to 0
+  ldb_meta_t *meta = ldb_meta_create(LDB_VERSION_CARE_DIRCT, 0, 0);
+  ldb_slice_t *slice_key = ldb_slice_create(LDB_DATA_TYPE_HSIZE, strlen(LDB_DATA_TYPE_HSIZE));
+  ldb_slice_push_back(slice_key, ldb_slice_data(name), ldb_slice_size(name));
+  ldb_txn_merge(txn,
+                meta,
+                ldb_slice_data(slice_key),
+                ldb_slice_size(slice_key),
+                by,
+                0,
+                1);
+  ldb_slice_destroy(slice_key);
+  ldb_meta_destroy(meta);
   return 0;
 }
 
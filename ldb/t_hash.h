@@ -14,6 +14,9 @@ int decode_hsize_key(const char* ldbkey, size_t ldbkeylen, ldb_slice_t** pslice)
 
 
 void encode_hash_key(const char* name, size_t namelen, const char* key, size_t keylen, const ldb_meta_t* meta, ldb_slice_t** pslice);
+//the key without the meta prefix into buf, returns its size, nothing is
+//written if that is more than buflen
+size_t encode_hash_key_raw(char* buf, size_t buflen, const char* name, size_t namelen, const char* key, size_t keylen);
 int decode_hash_key(const char* ldbkey, size_t ldbkeylen, ldb_slice_t **pslice_name, ldb_slice_t **pslice_key);
 
 
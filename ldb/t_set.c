@@ -6,6 +6,8 @@
 #include "ldb_list.h"
 #include "ldb_iterator.h"
 #include "ldb_context.h"
+#include "ldb_txn.h"
+#include "lmalloc.h"
 #include "util.h"
 
 #include <leveldb/c.h>
@@ -14,21 +16,19 @@
 #include <string.h>
 #include <stdint.h>
 #include <assert.h>
-#include <time.h>
 
 
 
-static int sset_one(ldb_context_t *context, const ldb_slice_t* name, 
+static int sset_one(ldb_context_t *context, ldb_txn_t* txn, const ldb_slice_t* name, 
                     const ldb_slice_t* key, const ldb_meta_t* meta);
 
 static int sget_one(ldb_context_t *context, const ldb_slice_t* name,
                     const ldb_slice_t* key, ldb_meta_t** pmeta);
 
-static int sdel_one(ldb_context_t *context, const ldb_slice_t* name, 
+static int sdel_one(ldb_context_t *context, ldb_txn_t* txn, const ldb_slice_t* name, 
                     const ldb_slice_t* key, const ldb_meta_t* meta);
 
-static int set_incr_size(ldb_context_t *context, 
-                          const ldb_slice_t* name, int64_t by);
+static int set_incr_size(ldb_txn_t* txn, const ldb_slice_t* name, int64_t by);
 
 static int sscan(ldb_context_t* context, const ldb_slice_t* name, 
                  const ldb_slice_t *kstart, const ldb_slice_t *kend, uint64_t limit, int reverse, ldb_set_iterator_t **piterator); 
@@ -84,6 +84,21 @@ void encode_set_key(const char* name, size_t namelen, const char* key, size_t ke
   *pslice = slice;
 }
 
+size_t encode_set_key_raw(char* buf, size_t buflen, const char* name, size_t namelen, const char* key, size_t keylen){
+  size_t size = strlen(LDB_DATA_TYPE_SET) + sizeof(uint8_t) + namelen + 1 + keylen;
+  if(size > buflen){
+    return size;
+  }
+  memcpy(buf, LDB_DATA_TYPE_SET, strlen(LDB_DATA_TYPE_SET));
+  buf += strlen(LDB_DATA_TYPE_SET);
+  *buf++ = (char)(uint8_t)namelen;
+  memcpy(buf, name, namelen);
+  buf += namelen;
+  *buf++ = '=';
+  memcpy(buf, key, keylen);
+  return size;
+}
+
 int decode_set_key(const char* ldbkey, size_t ldbkeylen, ldb_slice_t** pslice_name, ldb_slice_t** pslice_key){
   int retval = 0;
   ldb_slice_t *slice_name, *slice_key = NULL;
@@ -132,11 +147,9 @@ int set_card(ldb_context_t* context, const ldb_slice_t* name, uint64_t *length){
   int retval = 0;
   char *val = NULL, *errptr = NULL;
   size_t vallen = 0;
-  leveldb_readoptions_t *readoptions = leveldb_readoptions_create();
   ldb_slice_t* slice_key = NULL;
   encode_ssize_key(ldb_slice_data(name), ldb_slice_size(name), &slice_key);
-  val = leveldb_get(context->database_, readoptions, ldb_slice_data(slice_key), ldb_slice_size(slice_key), &vallen, &errptr);
-  leveldb_readoptions_destroy(readoptions);
+  val = leveldb_get(context->database_, context->readoptions_, ldb_slice_data(slice_key), ldb_slice_size(slice_key), &vallen, &errptr);
   ldb_slice_destroy(slice_key);
   if(errptr!=NULL){
     fprintf(stderr, "%s leveldb_get fail %s.\n", errptr, __func__);
@@ -152,7 +165,13 @@ int set_card(ldb_context_t* context, const ldb_slice_t* name, uint64_t *length){
         retval = LDB_OK_NOT_EXIST;
         goto end;
       }
-      *length = leveldb_decode_fixed64(val + LDB_VAL_META_SIZE);
+      //the merged size drops to 0 instead of being deleted
+      int64_t size = (int64_t)leveldb_decode_fixed64(val + LDB_VAL_META_SIZE);
+      if(size <= 0){
+        retval = LDB_OK_NOT_EXIST;
+        goto end;
+      }
+      *length = size;
       retval = LDB_OK;
     }else{
       retval = LDB_OK_NOT_EXIST;
@@ -209,17 +228,19 @@ end:
 
 int set_add(ldb_context_t* context, const ldb_slice_t* name, const ldb_slice_t* key, const ldb_meta_t* meta){
     int retval = 0, ret = 0;
+    ldb_txn_t *txn = ldb_txn_create();
 
-    ret = sset_one(context, name, key, meta); 
+    ldb_context_lock_key(context, ldb_slice_data(name), ldb_slice_size(name));
+    ret = sset_one(context, txn, name, key, meta); 
     if(ret >=0){
         if(ret > 0){
-            if(set_incr_size(context, name, 1) < 0){
+            if(set_incr_size(txn, name, 1) < 0){
                 retval = LDB_ERR;
                 goto end;
             }
         }
         char *errptr = NULL;
-        ldb_context_writebatch_commit(context, &errptr);
+        ldb_txn_commit(context, txn, &errptr);
         if(errptr != NULL){
             fprintf(stderr, "%s leveldb_write fail %s.\n", __func__, errptr);
             leveldb_free(errptr);
@@ -231,59 +252,338 @@ int set_add(ldb_context_t* context, const ldb_slice_t* name, const ldb_slice_t*
         retval = LDB_ERR;
     }
 end:
+    ldb_context_unlock_key(context, ldb_slice_data(name), ldb_slice_size(name));
+    ldb_txn_destroy(txn);
     return retval;
 }
 
-int set_pop(ldb_context_t* context, const ldb_slice_t* name, const ldb_meta_t* meta, ldb_slice_t** pslice){
-    uint64_t length = 0;
-    int retval = set_card(context, name, &length);
-    if(retval!=LDB_OK){
-        goto end;
-    }
+//raw bounds of the members of name, "e" len name "=" member sorts before "e" len name ">"
+static void encode_set_bound(const ldb_slice_t* name, const char* bound, ldb_slice_t** pslice){
+  uint8_t len = (uint8_t)ldb_slice_size(name);
+  ldb_slice_t* slice = ldb_slice_create(LDB_DATA_TYPE_SET, strlen(LDB_DATA_TYPE_SET));
+  ldb_slice_push_back(slice, (const char*)(&len), sizeof(uint8_t));
+  ldb_slice_push_back(slice, ldb_slice_data(name), ldb_slice_size(name));
+  ldb_slice_push_back(slice, bound, 1);
+  *pslice = slice;
+}
 
-    ldb_set_iterator_t* iterator = NULL;
-    if(sscan(context, name, NULL, NULL, 20000000, 0, &iterator)!=0){
-        retval = LDB_OK_NOT_EXIST;
-        goto end;
+typedef struct set_sampler_t {
+  ldb_context_t* context_;
+  leveldb_iterator_t* iterator_;
+  uint64_t sequence_;
+  ldb_slice_t* start_;
+  ldb_slice_t* end_;
+  ldb_slice_t* first_;
+  ldb_slice_t* last_;
+} set_sampler_t;
+
+//moves the iterator to the nearest live member in direction, -1 if there is none
+static int sampler_settle(set_sampler_t* sampler, int direction){
+  leveldb_iterator_t* iterator = sampler->iterator_;
+  while(leveldb_iter_valid(iterator)){
+    size_t klen = 0, vlen = 0;
+    const char* key = leveldb_iter_key(iterator, &klen);
+    if(direction == FORWARD){
+      if(compare_with_length(key, klen, ldb_slice_data(sampler->end_), ldb_slice_size(sampler->end_)) >= 0){
+        return -1;
+      }
+    }else{
+      if(compare_with_length(key, klen, ldb_slice_data(sampler->start_), ldb_slice_size(sampler->start_)) < 0){
+        return -1;
+      }
     }
+    const char* val = leveldb_iter_value(iterator, &vlen);
+    assert(vlen >= LDB_VAL_META_SIZE);
+    if(!(leveldb_decode_fixed8(val) & LDB_VALUE_TYPE_LAT)){
+      return 0;
+    }
+    if(direction == FORWARD){
+      leveldb_iter_next(iterator);
+    }else{
+      leveldb_iter_prev(iterator);
+    }
+  }
+  return -1;
+}
 
-    srandom(time(NULL));
-    uint64_t offset = random()%length;
-    if(ldb_set_iterator_skip(iterator, offset)<0){
-        retval = LDB_ERR;
-        goto end;
+static int sampler_open(ldb_context_t* context, const ldb_slice_t* name, set_sampler_t* sampler){
+  encode_set_bound(name, "=", &sampler->start_);
+  encode_set_bound(name, ">", &sampler->end_);
+  sampler->context_ = context;
+  sampler->iterator_ = ldb_context_iterator_acquire(context, &sampler->sequence_);
+
+  size_t klen = 0;
+  const char* key = NULL;
+  leveldb_iter_seek(sampler->iterator_, ldb_slice_data(sampler->end_), ldb_slice_size(sampler->end_));
+  if(leveldb_iter_valid(sampler->iterator_)){
+    leveldb_iter_prev(sampler->iterator_);
+  }else{
+    leveldb_iter_seek_to_last(sampler->iterator_);
+  }
+  if(sampler_settle(sampler, BACKWARD) < 0){
+    return -1;
+  }
+  key = leveldb_iter_key(sampler->iterator_, &klen);
+  sampler->last_ = ldb_slice_create(key, klen);
+
+  leveldb_iter_seek(sampler->iterator_, ldb_slice_data(sampler->start_), ldb_slice_size(sampler->start_));
+  if(sampler_settle(sampler, FORWARD) < 0){
+    return -1;
+  }
+  key = leveldb_iter_key(sampler->iterator_, &klen);
+  sampler->first_ = ldb_slice_create(key, klen);
+  return 0;
+}
+
+static void sampler_close(set_sampler_t* sampler){
+  if(sampler->iterator_ != NULL){
+    ldb_context_iterator_release(sampler->context_, sampler->iterator_, sampler->sequence_);
+  }
+  ldb_slice_destroy(sampler->start_);
+  ldb_slice_destroy(sampler->end_);
+  ldb_slice_destroy(sampler->first_);
+  ldb_slice_destroy(sampler->last_);
+}
+
+//seeks to a random key between the first and the last member, a member
+//following a wide gap in the key space is picked more often than others
+static int sampler_pick(set_sampler_t* sampler){
+  const char *first = ldb_slice_data(sampler->first_), *last = ldb_slice_data(sampler->last_);
+  size_t flen = ldb_slice_size(sampler->first_), llen = ldb_slice_size(sampler->last_);
+  size_t common = 0;
+  while(common < flen && common < llen && first[common] == last[common]){
+    ++common;
+  }
+  ldb_slice_t* target = ldb_slice_create(first, common);
+  if(common < llen){
+    uint8_t lo = common < flen ? (uint8_t)first[common] : 0;
+    uint8_t hi = (uint8_t)last[common];
+    char c = (char)(lo + random_u64() % (hi - lo + 1));
+    ldb_slice_push_back(target, &c, 1);
+    uint64_t tail = random_u64();
+    ldb_slice_push_back(target, (const char*)(&tail), sizeof(uint64_t));
+  }
+  leveldb_iter_seek(sampler->iterator_, ldb_slice_data(target), ldb_slice_size(target));
+  ldb_slice_destroy(target);
+  if(sampler_settle(sampler, FORWARD) < 0){
+    leveldb_iter_seek(sampler->iterator_, ldb_slice_data(sampler->start_), ldb_slice_size(sampler->start_));
+    return sampler_settle(sampler, FORWARD);
+  }
+  return 0;
+}
+
+static int sampler_member(set_sampler_t* sampler, ldb_slice_t** pkey){
+  size_t klen = 0;
+  const char* key = leveldb_iter_key(sampler->iterator_, &klen);
+  return decode_set_key(key, klen, NULL, pkey);
+}
+
+static int compare_u64(const void* a, const void* b){
+  uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+  return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+static void push_member(ldb_list_t* keylist, ldb_slice_t* key){
+  ldb_list_node_t *node_key = ldb_list_node_create();
+  node_key->data_ = key;
+  node_key->type_ = LDB_LIST_NODE_TYPE_SLICE;
+  rpush_ldb_list_node(keylist, node_key);
+}
+
+static int list_has_member(const ldb_list_t* keylist, const ldb_slice_t* key){
+  ldb_list_node_t* node = keylist->head_;
+  while(node != NULL){
+    const ldb_slice_t* other = (const ldb_slice_t*)node->data_;
+    if(compare_with_length(ldb_slice_data(other), ldb_slice_size(other), ldb_slice_data(key), ldb_slice_size(key)) == 0){
+      return 1;
     }
+    node = node->next_;
+  }
+  return 0;
+}
 
-    ldb_slice_t *key = NULL;
-    size_t raw_klen = 0;
-    const char* raw_key = ldb_set_iterator_key_raw(iterator, &raw_klen);
-    if(decode_set_key(raw_key, raw_klen, NULL, &key) != 0){
-        retval = LDB_ERR;
-        goto end;
+//a single pass over the members, selection sampling when distinct,
+//sorted random offsets otherwise
+static int sample_by_scan(set_sampler_t* sampler, uint64_t length, uint64_t want, int distinct, ldb_list_t* keylist){
+  uint64_t *offsets = NULL;
+  if(!distinct){
+    offsets = (uint64_t*)lmalloc(sizeof(uint64_t) * want);
+    for(uint64_t i = 0; i < want; ++i){
+      offsets[i] = random_u64() % length;
     }
-    retval = set_rem(context, name, key, meta);
-    if(retval == LDB_OK){
-        *pslice = key;
+    qsort(offsets, want, sizeof(uint64_t), compare_u64);
+  }
+  int retval = 0;
+  uint64_t seen = 0, next = 0;
+  leveldb_iter_seek(sampler->iterator_, ldb_slice_data(sampler->start_), ldb_slice_size(sampler->start_));
+  while(keylist->length_ < want && sampler_settle(sampler, FORWARD) == 0){
+    uint64_t picks = 0;
+    if(distinct){
+      uint64_t remain = length > seen ? length - seen : 1;
+      picks = (random_u64() % remain < want - keylist->length_) ? 1 : 0;
     }else{
-        ldb_slice_destroy(key);
+      while(next < want && offsets[next] == seen){
+        ++picks;
+        ++next;
+      }
     }
+    for(uint64_t i = 0; i < picks; ++i){
+      ldb_slice_t* key = NULL;
+      if(sampler_member(sampler, &key) != 0){
+        retval = -1;
+        goto end;
+      }
+      push_member(keylist, key);
+    }
+    ++seen;
+    leveldb_iter_next(sampler->iterator_);
+  }
 
 end:
-    ldb_set_iterator_destroy(iterator);
+  lfree(offsets);
+  return retval;
+}
+
+//random seeks, each one O(log n), for a few members of a big set
+static int sample_by_seek(set_sampler_t* sampler, uint64_t want, int distinct, ldb_list_t* keylist){
+  uint64_t attempts = want * 8;
+  while(keylist->length_ < want && attempts-- > 0){
+    if(sampler_pick(sampler) < 0){
+      return -1;
+    }
+    ldb_slice_t* key = NULL;
+    if(sampler_member(sampler, &key) != 0){
+      return -1;
+    }
+    if(distinct && list_has_member(keylist, key)){
+      ldb_slice_destroy(key);
+      continue;
+    }
+    push_member(keylist, key);
+  }
+  return 0;
+}
+
+int set_random_members(ldb_context_t* context, const ldb_slice_t* name, int64_t count, ldb_list_t** pkeylist, ldb_list_t** pmetalist){
+  uint64_t length = 0;
+  int retval = set_card(context, name, &length);
+  if(retval != LDB_OK){
     return retval;
+  }
+  int distinct = count >= 0;
+  uint64_t want = distinct ? (uint64_t)count : (uint64_t)(-(count + 1)) + 1;
+  if(distinct && want > length){
+    want = length;
+  }
+  ldb_list_t* keylist = ldb_list_create();
+  set_sampler_t sampler;
+  memset(&sampler, 0, sizeof(set_sampler_t));
+  if(want == 0 || length == 0 || sampler_open(context, name, &sampler) < 0){
+    goto done;
+  }
+  if(length > LDB_SET_SAMPLE_SCAN_MAX && want <= LDB_SET_SAMPLE_SEEK_MAX){
+    if(sample_by_seek(&sampler, want, distinct, keylist) < 0){
+      retval = LDB_ERR;
+      goto end;
+    }
+    if(keylist->length_ < want){
+      //too many repeats, members crowd a small part of the key space
+      ldb_list_destroy(keylist);
+      keylist = ldb_list_create();
+    }
+  }
+  if(keylist->length_ < want && sample_by_scan(&sampler, length, want, distinct, keylist) < 0){
+    retval = LDB_ERR;
+    goto end;
+  }
+
+done:
+  if(pmetalist != NULL){
+    *pmetalist = ldb_list_create();
+    ldb_list_node_t* node = keylist->head_;
+    while(node != NULL){
+      ldb_meta_t* meta = NULL;
+      ldb_list_node_t *node_meta = ldb_list_node_create();
+      node_meta->type_ = LDB_LIST_NODE_TYPE_BASE;
+      if(sget_one(context, name, (const ldb_slice_t*)node->data_, &meta) == LDB_OK){
+        node_meta->value_ = ldb_meta_nextver(meta);
+        ldb_meta_destroy(meta);
+      }
+      rpush_ldb_list_node(*pmetalist, node_meta);
+      node = node->next_;
+    }
+  }
+  *pkeylist = keylist;
+  keylist = NULL;
+  retval = LDB_OK;
+
+end:
+  sampler_close(&sampler);
+  ldb_list_destroy(keylist);
+  return retval;
+}
+
+int set_pop(ldb_context_t* context, const ldb_slice_t* name, const ldb_meta_t* meta, uint64_t count, ldb_list_t** pkeylist){
+  ldb_list_t *keylist = NULL;
+  ldb_txn_t *txn = NULL;
+  if(count > INT64_MAX){
+    count = INT64_MAX;
+  }
+  ldb_context_lock_key(context, ldb_slice_data(name), ldb_slice_size(name));
+  int retval = set_random_members(context, name, (int64_t)count, &keylist, NULL);
+  if(retval != LDB_OK){
+    goto end;
+  }
+  txn = ldb_txn_create();
+  int64_t removed = 0;
+  ldb_list_node_t* node = keylist->head_;
+  while(node != NULL){
+    int ret = sdel_one(context, txn, name, (const ldb_slice_t*)node->data_, meta);
+    if(ret < 0){
+      retval = LDB_ERR;
+      goto end;
+    }
+    removed += ret;
+    node = node->next_;
+  }
+  if(removed > 0){
+    if(set_incr_size(txn, name, -removed) < 0){
+      retval = LDB_ERR;
+      goto end;
+    }
+    char *errptr = NULL;
+    ldb_txn_commit(context, txn, &errptr);
+    if(errptr != NULL){
+      fprintf(stderr, "%s leveldb_write fail %s.\n", __func__, errptr);
+      leveldb_free(errptr);
+      retval = LDB_ERR;
+      goto end;
+    }
+  }
+  *pkeylist = keylist;
+  keylist = NULL;
+  retval = LDB_OK;
+
+end:
+  ldb_context_unlock_key(context, ldb_slice_data(name), ldb_slice_size(name));
+  ldb_txn_destroy(txn);
+  ldb_list_destroy(keylist);
+  return retval;
 }
 
 int set_rem(ldb_context_t* context, const ldb_slice_t* name, const ldb_slice_t* key, const ldb_meta_t* meta){
     int retval, ret = 0;
-    ret = sdel_one(context, name, key, meta);
+    ldb_txn_t *txn = ldb_txn_create();
+    ldb_context_lock_key(context, ldb_slice_data(name), ldb_slice_size(name));
+    ret = sdel_one(context, txn, name, key, meta);
     if(ret >=0){
         if(ret > 0){
-            if(set_incr_size(context, name, -1) < 0){
+            if(set_incr_size(txn, name, -1) < 0){
                 retval = LDB_ERR;
                 goto end;
             }
             char *errptr = NULL;
-            ldb_context_writebatch_commit(context, &errptr);
+            ldb_txn_commit(context, txn, &errptr);
             if(errptr != NULL){
                 fprintf(stderr, "%s leveldb_write fail %s.\n", errptr, __func__);
                 leveldb_free(errptr);
@@ -299,6 +599,8 @@ int set_rem(ldb_context_t* context, const ldb_slice_t* name, const ldb_slice_t*
     }
 
 end:
+    ldb_context_unlock_key(context, ldb_slice_data(name), ldb_slice_size(name));
+    ldb_txn_destroy(txn);
     return retval;
 }
 
@@ -313,38 +615,25 @@ int set_ismember(ldb_context_t* context, const ldb_slice_t* name, const ldb_slic
 }
 
 
-static int set_incr_size(ldb_context_t *context, 
-                         const ldb_slice_t* name, int64_t by){
-  uint64_t length = 0;
-  int retval = set_card(context, name, &length);
-  if(retval!=LDB_OK && retval != LDB_OK_NOT_EXIST){
-    return -1;
-  }
-  int64_t size = (int64_t)length;
-  size += by;
-
-  ldb_slice_t* slice_key = NULL;
-  encode_ssize_key(ldb_slice_data(name),
-                   ldb_slice_size(name),
-                   &slice_key);
-  if(size <= 0){
-    ldb_context_writebatch_delete(context,
-                                  ldb_slice_data(slice_key),
-                                  ldb_slice_size(slice_key));
-  }else{
-    char buff[sizeof(uint64_t)] = {0};
-    length = size;
-    leveldb_encode_fixed64(buff, length);
-    ldb_context_writebatch_put(context,
-                               ldb_slice_data(slice_key),
-                               ldb_slice_size(slice_key),
-                               buff,
-                               sizeof(buff));
-  }
+static int set_incr_size(ldb_txn_t* txn, const ldb_slice_t* name, int64_t by){
+  //a merge operand, so that writers do not have to read the size first,
+  //dropped by compactions once the size is back to 0
+  ldb_meta_t *meta = ldb_meta_create(LDB_VERSION_CARE_DIRCT, 0, 0);
+  ldb_slice_t *slice_key = ldb_slice_create(LDB_DATA_TYPE_SSIZE, strlen(LDB_DATA_TYPE_SSIZE));
+  ldb_slice_push_back(slice_key, ldb_slice_data(name), ldb_slice_size(name));
+  ldb_txn_merge(txn,
+                meta,
+                ldb_slice_data(slice_key),
+                ldb_slice_size(slice_key),
+                by,
+                0,
+                1);
+  ldb_slice_destroy(slice_key);
+  ldb_meta_destroy(meta);
   return 0;
 }
 
-static int sdel_one(ldb_context_t *context, const ldb_slice_t* name, 
+static int sdel_one(ldb_context_t *context, ldb_txn_t* txn, const ldb_slice_t* name, 
                     const ldb_slice_t* key, const ldb_meta_t* meta){
   
   if(ldb_slice_size(name) > LDB_DATA_TYPE_KEY_LEN_MAX){
@@ -368,9 +657,9 @@ static int sdel_one(ldb_context_t *context, const ldb_slice_t* name,
                   ldb_slice_size(key),
                   meta,
                   &slice_key);
-  ldb_context_writebatch_delete(context,
-                                ldb_slice_data(slice_key),
-                                ldb_slice_size(slice_key));
+  ldb_txn_delete(txn,
+                 ldb_slice_data(slice_key),
+                 ldb_slice_size(slice_key));
   return 1;
 }
 
@@ -378,21 +667,21 @@ static int sdel_one(ldb_context_t *context, const ldb_slice_t* name,
 static int sget_one(ldb_context_t *context, const ldb_slice_t* name,
                     const ldb_slice_t* key, ldb_meta_t** pmeta){ 
   int retval = 0;
-  char *val = NULL, *errptr = NULL;
-  size_t vallen = 0;
-  leveldb_readoptions_t *readoptions = leveldb_readoptions_create();
+  char val[LDB_VAL_HEADER_MAX_SIZE];
+  char *errptr = NULL;
+  size_t vallen = sizeof(val);
   ldb_slice_t* slice_key = NULL;
   encode_set_key(ldb_slice_data(name), ldb_slice_size(name), ldb_slice_data(key), ldb_slice_size(key), NULL, &slice_key);
-  val = leveldb_get(context->database_, readoptions, ldb_slice_data(slice_key), ldb_slice_size(slice_key), &vallen, &errptr);
-  leveldb_readoptions_destroy(readoptions);
+  //only the version is needed, leave the value in place
+  unsigned char found = leveldb_exists(context->database_, context->readoptions_, ldb_slice_data(slice_key), ldb_slice_size(slice_key), val, &vallen, &errptr);
   ldb_slice_destroy(slice_key);
   if(errptr!=NULL){
-    fprintf(stderr, "%s leveldb_get fail %s.\n", errptr, __func__);
+    fprintf(stderr, "%s leveldb_exists fail %s.\n", __func__, errptr);
     leveldb_free(errptr);
     retval = LDB_ERR;
     goto end;
   }
-  if(val!=NULL){
+  if(found){
     assert(vallen>= LDB_VAL_META_SIZE);
     uint8_t type = leveldb_decode_fixed8(val);
     if(type & LDB_VALUE_TYPE_VAL){
@@ -411,14 +700,11 @@ static int sget_one(ldb_context_t *context, const ldb_slice_t* name,
   }
 
 end:
-  if(val != NULL){
-    leveldb_free(val); 
-  }
   return retval;
 }
 
 
-static int sset_one(ldb_context_t* context, const ldb_slice_t* name,
+static int sset_one(ldb_context_t* context, ldb_txn_t* txn, const ldb_slice_t* name,
                     const ldb_slice_t* key, const ldb_meta_t* meta){
   if(ldb_slice_size(name)==0 || ldb_slice_size(key)==0){
     fprintf(stderr, "%s empty name or key!", __func__);
@@ -433,41 +719,27 @@ static int sset_one(ldb_context_t* context, const ldb_slice_t* name,
     return -1;
   }
   int retval = 0;
-  ldb_slice_t *slice_key = NULL;
   ldb_meta_t *old_meta = NULL;
   if(sget_one(context, name, key, &old_meta) == LDB_OK_NOT_EXIST){
-    encode_set_key(ldb_slice_data(name),
-                    ldb_slice_size(name),
-                    ldb_slice_data(key),
-                    ldb_slice_size(key),
-                    meta,
-                    &slice_key);
-
-    ldb_context_writebatch_put(context,
-                               ldb_slice_data(slice_key),
-                               ldb_slice_size(slice_key),
-                               NULL,
-                               0);
     retval = 1;
   }else{
-    encode_set_key(ldb_slice_data(name),
-                    ldb_slice_size(name),
-                    ldb_slice_data(key),
-                    ldb_slice_size(key),
-                    meta,
-                    &slice_key);
-
-    ldb_context_writebatch_put(context,
-                               ldb_slice_data(slice_key),
-                               ldb_slice_size(slice_key),
-                               NULL,
-                               0); 
-
     ldb_meta_destroy(old_meta);
     retval = 0;
   }
-
-  ldb_slice_destroy(slice_key);
+  char keybuf[LDB_KEY_BUF_SIZE];
+  size_t keylen = encode_set_key_raw(keybuf,
+                                     sizeof(keybuf),
+                                     ldb_slice_data(name),
+                                     ldb_slice_size(name),
+                                     ldb_slice_data(key),
+                                     ldb_slice_size(key));
+  assert(keylen <= sizeof(keybuf));
+  ldb_txn_put_with_meta(txn,
+                        meta,
+                        keybuf,
+                        keylen,
+                        NULL,
+                        0);
   return retval;
 }
 
@@ -14,6 +14,9 @@ void encode_ssize_key(const char* name, size_t namelen, ldb_slice_t** pslice);
 int decode_ssize_key(const char* ldbkey, size_t ldbkeylen, ldb_slice_t** pslice);
 
 void encode_set_key(const char* name, size_t namelen, const char* key, size_t keylen, const ldb_meta_t* meta, ldb_slice_t** pslice);
+//the key without the meta prefix into buf, returns its size, nothing is
+//written if that is more than buflen
+size_t encode_set_key_raw(char* buf, size_t buflen, const char* name, size_t namelen, const char* key, size_t keylen);
 int decode_set_key(const char* ldbkey, size_t ldbkeylen, ldb_slice_t** pslice_name, ldb_slice_t** pslice_key);
 
 int set_card(ldb_context_t* context, const ldb_slice_t* name, uint64_t *length);
@@ -22,7 +25,12 @@ int set_members(ldb_context_t* context, const ldb_slice_t* name, ldb_list_t** pk
 
 int set_add(ldb_context_t* context, const ldb_slice_t* name, const ldb_slice_t* key, const ldb_meta_t* meta);
 
-int set_pop(ldb_context_t* context, const ldb_slice_t* name, const ldb_meta_t* meta, ldb_slice_t** pslice);
+//count > 0 gives up to count distinct members, count < 0 gives -count
+//members that may repeat, like SRANDMEMBER
+int set_random_members(ldb_context_t* context, const ldb_slice_t* name, int64_t count, ldb_list_t** pkeylist, ldb_list_t** pmetalist);
+
+//removes and returns up to count random members in one write
+int set_pop(ldb_context_t* context, const ldb_slice_t* name, const ldb_meta_t* meta, uint64_t count, ldb_list_t** pkeylist);
 
 int set_rem(ldb_context_t* context, const ldb_slice_t* name, const ldb_slice_t* key, const ldb_meta_t* meta);
 
@@ -1,9 +1,11 @@
 #include "ldb_define.h"
 #include "ldb_slice.h"
 #include "ldb_context.h"
+#include "ldb_txn.h"
 #include "ldb_meta.h"
 #include "ldb_bytes.h"
 #include "ldb_list.h"
+#include "lmalloc.h"
 #include "t_string.h"
 #include "util.h"
 
@@ -22,6 +24,70 @@ void encode_kv_key(const char* key, size_t keylen, const ldb_meta_t* meta, ldb_s
   *pslice =  slice;
 }
 
+size_t encode_kv_key_raw(char* buf, size_t buflen, const char* key, size_t keylen){
+  size_t size = strlen(LDB_DATA_TYPE_STRING) + keylen;
+  if(size > buflen){
+    return size;
+  }
+  memcpy(buf, LDB_DATA_TYPE_STRING, strlen(LDB_DATA_TYPE_STRING));
+  memcpy(buf + strlen(LDB_DATA_TYPE_STRING), key, keylen);
+  return size;
+}
+
+//the raw key in keybuf, or on the heap for keys that do not fit there
+static char* kv_raw_key(const ldb_slice_t* key, char* keybuf, size_t buflen, size_t* rawlen){
+  char* rawkey = keybuf;
+  *rawlen = encode_kv_key_raw(keybuf, buflen, ldb_slice_data(key), ldb_slice_size(key));
+  if(*rawlen > buflen){
+    rawkey = (char*)lmalloc(*rawlen);
+    encode_kv_key_raw(rawkey, *rawlen, ldb_slice_data(key), ldb_slice_size(key));
+  }
+  return rawkey;
+}
+
+static void kv_raw_key_free(char* rawkey, char* keybuf){
+  if(rawkey != keybuf){
+    lfree(rawkey);
+  }
+}
+
+static void kv_put(ldb_context_t* context, const ldb_slice_t* key, const ldb_meta_t* meta,
+                   const char* val, size_t vlen, char** errptr){
+  char keybuf[LDB_KEY_BUF_SIZE];
+  size_t rawlen = 0;
+  char* rawkey = kv_raw_key(key, keybuf, sizeof(keybuf), &rawlen);
+  leveldb_put_with_meta(context->database_,
+                        context->writeoptions_,
+                        ldb_meta_vercare(meta),
+                        ldb_meta_lastver(meta),
+                        ldb_meta_nextver(meta),
+                        ldb_meta_exptime(meta),
+                        rawkey,
+                        rawlen,
+                        val,
+                        vlen,
+                        errptr);
+  kv_raw_key_free(rawkey, keybuf);
+}
+
+static void kv_txn_put(ldb_txn_t* txn, const ldb_slice_t* key, const ldb_meta_t* meta,
+                       const char* val, size_t vlen){
+  char keybuf[LDB_KEY_BUF_SIZE];
+  size_t rawlen = 0;
+  char* rawkey = kv_raw_key(key, keybuf, sizeof(keybuf), &rawlen);
+  ldb_txn_put_with_meta(txn, meta, rawkey, rawlen, val, vlen);
+  kv_raw_key_free(rawkey, keybuf);
+}
+
+static void kv_txn_merge(ldb_txn_t* txn, const ldb_slice_t* key, const ldb_meta_t* meta,
+                         int64_t delta, int64_t initial){
+  char keybuf[LDB_KEY_BUF_SIZE];
+  size_t rawlen = 0;
+  char* rawkey = kv_raw_key(key, keybuf, sizeof(keybuf), &rawlen);
+  ldb_txn_merge(txn, meta, rawkey, rawlen, delta, initial, 0);
+  kv_raw_key_free(rawkey, keybuf);
+}
+
 int decode_kv_key(const char* ldbkey, size_t ldbkeylen, ldb_slice_t** pslice){
   int retval = 0;
   ldb_slice_t *slice_key = NULL;
@@ -55,22 +121,11 @@ int string_set(ldb_context_t* context, const ldb_slice_t* key, const ldb_slice_t
   int retval = 0;
   if(ldb_slice_size(key) == 0){
     fprintf(stderr, "%s empty key!\n", __func__);
-    retval = LDB_ERR;
-    goto end;
+    return LDB_ERR;
   }
+  ldb_context_lock_key(context, ldb_slice_data(key), ldb_slice_size(key));
   char *errptr = NULL;
-  leveldb_writeoptions_t* writeoptions = leveldb_writeoptions_create();
-  ldb_slice_t *slice_key = NULL;
-  encode_kv_key(ldb_slice_data(key), ldb_slice_size(key), meta, &slice_key);
-  leveldb_put(context->database_, 
-              writeoptions, 
-              ldb_slice_data(slice_key), 
-              ldb_slice_size(slice_key), 
-              ldb_slice_data(value), 
-              ldb_slice_size(value), 
-              &errptr);
-  leveldb_writeoptions_destroy(writeoptions);
-  ldb_slice_destroy(slice_key);
+  kv_put(context, key, meta, ldb_slice_data(value), ldb_slice_size(value), &errptr);
   if(errptr != NULL){
     fprintf(stderr, "%s leveldb_put failed %s.\n", __func__, errptr);
     leveldb_free(errptr);
@@ -80,6 +135,7 @@ int string_set(ldb_context_t* context, const ldb_slice_t* key, const ldb_slice_t
   retval = LDB_OK;
 
 end:
+  ldb_context_unlock_key(context, ldb_slice_data(key), ldb_slice_size(key));
   return retval;
 }
 
@@ -87,9 +143,9 @@ int string_setnx(ldb_context_t* context, const ldb_slice_t* key, const ldb_slice
   int retval = LDB_OK;
   if(ldb_slice_size(key) == 0){
     fprintf(stderr, "%s empty key!\n", __func__);
-    retval = LDB_ERR;
-    goto end;
+    return LDB_ERR;
   }
+  ldb_context_lock_key(context, ldb_slice_data(key), ldb_slice_size(key));
   //get
   ldb_slice_t *slice_value = NULL;
   ldb_meta_t *old_meta = NULL;
@@ -100,18 +156,7 @@ int string_setnx(ldb_context_t* context, const ldb_slice_t* key, const ldb_slice
   }
   //set
   char *errptr = NULL;
-  leveldb_writeoptions_t* writeoptions = leveldb_writeoptions_create();
-  ldb_slice_t *slice_key = NULL;
-  encode_kv_key(ldb_slice_data(key), ldb_slice_size(key), meta, &slice_key);
-  leveldb_put(context->database_, 
-              writeoptions, 
-              ldb_slice_data(slice_key), 
-              ldb_slice_size(slice_key), 
-              ldb_slice_data(value), 
-              ldb_slice_size(value), 
-              &errptr);
-  leveldb_writeoptions_destroy(writeoptions);
-  ldb_slice_destroy(slice_key);
+  kv_put(context, key, meta, ldb_slice_data(value), ldb_slice_size(value), &errptr);
   if(errptr != NULL){
     fprintf(stderr, "%s leveldb_put failed %s.\n", __func__, errptr);
     leveldb_free(errptr);
@@ -121,6 +166,7 @@ int string_setnx(ldb_context_t* context, const ldb_slice_t* key, const ldb_slice
   retval = LDB_OK; 
 
 end:
+  ldb_context_unlock_key(context, ldb_slice_data(key), ldb_slice_size(key));
   ldb_slice_destroy(slice_value);
   ldb_meta_destroy(old_meta);
   return retval;
@@ -130,9 +176,9 @@ int string_setxx(ldb_context_t* context, const ldb_slice_t* key, const ldb_slice
   int retval = LDB_OK;
   if(ldb_slice_size(key) == 0){
     fprintf(stderr, "%s empty key!\n", __func__);
-    retval = LDB_ERR;
-    goto end;
+    return LDB_ERR;
   }
+  ldb_context_lock_key(context, ldb_slice_data(key), ldb_slice_size(key));
   //get
   ldb_slice_t *slice_value = NULL;
   ldb_meta_t *old_meta = NULL;
@@ -143,18 +189,7 @@ int string_setxx(ldb_context_t* context, const ldb_slice_t* key, const ldb_slice
   }
   //set
   char *errptr = NULL;
-  leveldb_writeoptions_t* writeoptions = leveldb_writeoptions_create();
-  ldb_slice_t *slice_key = NULL;
-  encode_kv_key(ldb_slice_data(key), ldb_slice_size(key), meta, &slice_key);
-  leveldb_put(context->database_, 
-              writeoptions, 
-              ldb_slice_data(slice_key), 
-              ldb_slice_size(slice_key), 
-              ldb_slice_data(value), 
-              ldb_slice_size(value), 
-              &errptr);
-  leveldb_writeoptions_destroy(writeoptions);
-  ldb_slice_destroy(slice_key);
+  kv_put(context, key, meta, ldb_slice_data(value), ldb_slice_size(value), &errptr);
   if(errptr != NULL){
     fprintf(stderr, "%s leveldb_put failed %s.\n", __func__, errptr);
     leveldb_free(errptr);
@@ -163,18 +198,45 @@ int string_setxx(ldb_context_t* context, const ldb_slice_t* key, const ldb_slice
   }
   retval = LDB_OK; 
 end:
+  ldb_context_unlock_key(context, ldb_slice_data(key), ldb_slice_size(key));
   ldb_slice_destroy(slice_value);
   ldb_meta_destroy(old_meta);
   return retval;
 }
 
 
+//locks the stripes of the keys of a key, value list, to be released with
+//unlock_kv_keys
+static size_t lock_kv_keys(ldb_context_t* context, const ldb_list_t* datalist, uint32_t** pstripes){
+  uint32_t *stripes = (uint32_t*)lmalloc(sizeof(uint32_t) * (datalist->length_/2 + 1));
+  size_t num = 0;
+  ldb_list_iterator_t *iterator = ldb_list_iterator_create(datalist);
+  ldb_list_node_t* node = NULL;
+  while((node = ldb_list_next(&iterator)) != NULL){
+    ldb_slice_t *key = (ldb_slice_t*)(node->data_);
+    stripes[num++] = ldb_context_key_stripe(ldb_slice_data(key), ldb_slice_size(key));
+    if(ldb_list_next(&iterator) == NULL){
+      break;
+    }
+  }
+  ldb_list_iterator_destroy(iterator);
+  *pstripes = stripes;
+  return ldb_context_lock_stripes(context, stripes, num);
+}
+
+static void unlock_kv_keys(ldb_context_t* context, uint32_t* stripes, size_t num){
+  ldb_context_unlock_stripes(context, stripes, num);
+  lfree(stripes);
+}
+
 int string_mset(ldb_context_t* context, const ldb_list_t* datalist, const ldb_list_t* metalist, ldb_list_t** plist){
   int retval = 0; 
+  uint32_t *stripes = NULL;
+  size_t stripenum = lock_kv_keys(context, datalist, &stripes);
   ldb_list_iterator_t *dataiterator = ldb_list_iterator_create(datalist);
   ldb_list_iterator_t *metaiterator = ldb_list_iterator_create(metalist);
   ldb_list_t *retlist = ldb_list_create();
-  
+  ldb_txn_t *txn = ldb_txn_create();
   
   while(1){
     ldb_list_node_t* node_key = ldb_list_next(&dataiterator);
@@ -184,31 +246,22 @@ int string_mset(ldb_context_t* context, const ldb_list_t* datalist, const ldb_li
     }
     //encode key
     ldb_list_node_t* node_meta = ldb_list_next(&metaiterator);
-    ldb_slice_t *slice_key = NULL;
     ldb_slice_t *key = (ldb_slice_t*)(node_key->data_);
     ldb_meta_t *meta = (ldb_meta_t*)(node_meta->data_);
-    encode_kv_key(ldb_slice_data(key), ldb_slice_size(key), meta, &slice_key);
 
     //put kv
     ldb_list_node_t* node_val = ldb_list_next(&dataiterator);
     ldb_slice_t *value = (ldb_slice_t*)(node_val->data_);
-    ldb_context_writebatch_put(context,
-                               ldb_slice_data(slice_key),
-                               ldb_slice_size(slice_key),
-                               ldb_slice_data(value),
-                               ldb_slice_size(value));
+    kv_txn_put(txn, key, meta, ldb_slice_data(value), ldb_slice_size(value));
     
     //push return value
     ldb_list_node_t* node_ret = ldb_list_node_create();
     node_ret->type_ = LDB_LIST_NODE_TYPE_BASE;
     node_ret->value_ = LDB_OK;
     rpush_ldb_list_node(retlist, node_ret); 
-
-    //destroy slice_key
-    ldb_slice_destroy(slice_key);
   } 
   char* errptr = NULL;
-  ldb_context_writebatch_commit(context, &errptr);
+  ldb_txn_commit(context, txn, &errptr);
   if(errptr != NULL){
     fprintf(stderr, "%s write writebatch fail %s.\n", __func__, errptr);
     leveldb_free(errptr);
@@ -226,17 +279,22 @@ end:
   if(retlist != NULL){
     (*plist) = retlist;
   }
+  unlock_kv_keys(context, stripes, stripenum);
   ldb_list_iterator_destroy(dataiterator);
   ldb_list_iterator_destroy(metaiterator);
+  ldb_txn_destroy(txn);
   return retval;
 }
 
 
 int string_msetnx(ldb_context_t* context, const ldb_list_t* datalist, const ldb_list_t* metalist, ldb_list_t** plist){
   int retval = 0; 
+  uint32_t *stripes = NULL;
+  size_t stripenum = lock_kv_keys(context, datalist, &stripes);
   ldb_list_iterator_t *dataiterator = ldb_list_iterator_create(datalist);
   ldb_list_iterator_t *metaiterator = ldb_list_iterator_create(metalist);
   ldb_list_t *retlist = ldb_list_create();
+  ldb_txn_t *txn = ldb_txn_create();
    
   while(1){
     ldb_list_node_t* node_key = ldb_list_next(&dataiterator);
@@ -245,9 +303,7 @@ int string_msetnx(ldb_context_t* context, const ldb_list_t* datalist, const ldb_
       break;
     }
 
-    //encode key
     ldb_list_node_t* node_meta = ldb_list_next(&metaiterator);
-    ldb_slice_t *slice_key = NULL;
     ldb_slice_t *key = (ldb_slice_t*)(node_key->data_);
 
 
@@ -268,28 +324,20 @@ int string_msetnx(ldb_context_t* context, const ldb_list_t* datalist, const ldb_
     }
 
     ldb_meta_t *meta = (ldb_meta_t*)(node_meta->data_);
-    encode_kv_key(ldb_slice_data(key), ldb_slice_size(key), meta, &slice_key);
 
     //put kv
     ldb_list_node_t* node_val = ldb_list_next(&dataiterator);
     ldb_slice_t *value = (ldb_slice_t*)(node_val->data_);
-    ldb_context_writebatch_put(context,
-                               ldb_slice_data(slice_key),
-                               ldb_slice_size(slice_key),
-                               ldb_slice_data(value),
-                               ldb_slice_size(value));
+    kv_txn_put(txn, key, meta, ldb_slice_data(value), ldb_slice_size(value));
     
     //push return value
     ldb_list_node_t* node = ldb_list_node_create();
     node->type_ = LDB_LIST_NODE_TYPE_BASE;
     node->value_ = LDB_OK;
     rpush_ldb_list_node(retlist, node); 
-
-    //destroy slice_key
-    ldb_slice_destroy(slice_key);
   } 
   char* errptr = NULL;
-  ldb_context_writebatch_commit(context, &errptr);
+  ldb_txn_commit(context, txn, &errptr);
   if(errptr != NULL){
     fprintf(stderr, "%s write writebatch fail %s.\n", __func__, errptr);
     leveldb_free(errptr);
@@ -307,28 +355,29 @@ end:
   if(retlist != NULL){
     (*plist) = retlist;
   }
+  unlock_kv_keys(context, stripes, stripenum);
   ldb_list_iterator_destroy(dataiterator);
   ldb_list_iterator_destroy(metaiterator);
+  ldb_txn_destroy(txn);
   return retval;
 }
 
-int string_get(ldb_context_t* context, const ldb_slice_t* key, ldb_slice_t** pvalue, ldb_meta_t** pmeta){
-  char *val, *errptr = NULL;
+int string_get_pinned(ldb_context_t* context, const ldb_slice_t* key, const char** pdata, size_t* psize, uint64_t* pversion, uint64_t* pexptime, leveldb_pinned_t** ppinned){
+  const char *val = NULL;
+  char *errptr = NULL;
   size_t vallen = 0;
-  leveldb_readoptions_t* readoptions = leveldb_readoptions_create();
   ldb_slice_t *slice_key = NULL;
   encode_kv_key(ldb_slice_data(key), ldb_slice_size(key), NULL, &slice_key);
-  val = leveldb_get(context->database_, readoptions, ldb_slice_data(slice_key), ldb_slice_size(slice_key), &vallen, &errptr);
-  leveldb_readoptions_destroy(readoptions);
+  leveldb_pinned_t* pinned = leveldb_get_pinned(context->database_, context->readoptions_, ldb_slice_data(slice_key), ldb_slice_size(slice_key), &val, &vallen, &errptr);
   ldb_slice_destroy(slice_key);
   int retval = LDB_OK;
   if(errptr != NULL){
-    fprintf(stderr, "%s leveldb_get fail %s.\n", __func__, errptr);
+    fprintf(stderr, "%s leveldb_get_pinned fail %s.\n", __func__, errptr);
     leveldb_free(errptr);
     retval = LDB_ERR;
     goto end;
   }
-  if(val != NULL){
+  if(pinned != NULL){
     assert(vallen>= LDB_VAL_META_SIZE);
     uint8_t type = leveldb_decode_fixed8(val);
     if(type & LDB_VALUE_TYPE_VAL){
@@ -345,8 +394,13 @@ int string_get(ldb_context_t* context, const ldb_slice_t* key, ldb_slice_t** pva
               goto end;
           }
       }
-      *pvalue = ldb_slice_create(val+LDB_VAL_META_SIZE, vallen-LDB_VAL_META_SIZE);
-      *pmeta = ldb_meta_create_with_exp(0, 0, version, exptime); 
+      size_t header = LDB_VAL_META_SIZE + ((type & LDB_VALUE_TYPE_EXP) ? sizeof(uint64_t) : 0);
+      *pdata = val + header;
+      *psize = vallen - header;
+      *pversion = version;
+      *pexptime = exptime;
+      *ppinned = pinned;
+      pinned = NULL;
       retval = LDB_OK;
     }else{
       retval = LDB_OK_NOT_EXIST;
@@ -356,26 +410,100 @@ int string_get(ldb_context_t* context, const ldb_slice_t* key, ldb_slice_t** pva
   }
 
 end:
-  if(val != NULL){
-    leveldb_free(val);
+  if(pinned != NULL){
+    leveldb_pinned_release(pinned);
   }
   return retval;
 }
 
-static int string_mget_one(ldb_context_t* context, const leveldb_readoptions_t* options, const ldb_slice_t* key, ldb_slice_t** pvalue, ldb_meta_t** pmeta){
-  char *val, *errptr = NULL;
-  size_t vallen = 0;
+static int string_get_header(ldb_context_t* context, const ldb_slice_t* key, uint64_t* pversion, uint64_t* pexptime){
+  char header[LDB_VAL_HEADER_MAX_SIZE];
+  size_t headerlen = sizeof(header);
+  char *errptr = NULL;
   ldb_slice_t *slice_key = NULL;
   encode_kv_key(ldb_slice_data(key), ldb_slice_size(key), NULL, &slice_key);
-  val = leveldb_get(context->database_, options, ldb_slice_data(slice_key), ldb_slice_size(slice_key), &vallen, &errptr);
+  unsigned char found = leveldb_exists(context->database_, context->readoptions_, ldb_slice_data(slice_key), ldb_slice_size(slice_key), header, &headerlen, &errptr);
   ldb_slice_destroy(slice_key);
+  if(errptr != NULL){
+    fprintf(stderr, "%s leveldb_exists fail %s.\n", __func__, errptr);
+    leveldb_free(errptr);
+    return LDB_ERR;
+  }
+  if(!found){
+    return LDB_OK_NOT_EXIST;
+  }
+  assert(headerlen >= LDB_VAL_META_SIZE);
+  uint8_t type = leveldb_decode_fixed8(header);
+  if(!(type & LDB_VALUE_TYPE_VAL) || (type & LDB_VALUE_TYPE_LAT)){
+    return LDB_OK_NOT_EXIST;
+  }
+  uint64_t exptime = 0;
+  if(type & LDB_VALUE_TYPE_EXP){
+    assert(headerlen >= LDB_VAL_META_SIZE + sizeof(uint64_t));
+    exptime = leveldb_decode_fixed64(header + LDB_VAL_META_SIZE);
+    if(time_ms() >= exptime){
+      return LDB_OK_NOT_EXIST;
+    }
+  }
+  *pversion = leveldb_decode_fixed64(header + LDB_VAL_TYPE_SIZE);
+  *pexptime = exptime;
+  return LDB_OK;
+}
+
+int string_exists(ldb_context_t* context, const ldb_slice_t* key){
+  uint64_t version = 0, exptime = 0;
+  return string_get_header(context, key, &version, &exptime);
+}
+
+int string_get_meta(ldb_context_t* context, const ldb_slice_t* key, ldb_meta_t** pmeta){
+  uint64_t version = 0, exptime = 0;
+  int retval = string_get_header(context, key, &version, &exptime);
+  if(retval == LDB_OK){
+    *pmeta = ldb_meta_create_with_exp(0, 0, version, exptime);
+  }
+  return retval;
+}
+
+int string_touch(ldb_context_t* context, const ldb_slice_t* key, const ldb_meta_t* meta){
+  if(ldb_slice_size(key) == 0){
+    fprintf(stderr, "%s empty key!\n", __func__);
+    return LDB_ERR;
+  }
   int retval = LDB_OK;
+  char *errptr = NULL;
+  ldb_slice_t *slice_key = NULL;
+  encode_kv_key(ldb_slice_data(key), ldb_slice_size(key), meta, &slice_key);
+  ldb_txn_t* txn = ldb_txn_create();
+  ldb_txn_touch(txn, ldb_slice_data(slice_key), ldb_slice_size(slice_key));
+  ldb_context_lock_key(context, ldb_slice_data(key), ldb_slice_size(key));
+  ldb_txn_commit(context, txn, &errptr);
+  ldb_context_unlock_key(context, ldb_slice_data(key), ldb_slice_size(key));
+  ldb_txn_destroy(txn);
+  ldb_slice_destroy(slice_key);
   if(errptr != NULL){
-    fprintf(stderr, "%s leveldb_get fail %s.\n", __func__, errptr);
+    fprintf(stderr, "%s ldb_txn_commit fail %s.\n", __func__, errptr);
     leveldb_free(errptr);
     retval = LDB_ERR;
-    goto end;
   }
+  return retval;
+}
+
+int string_get(ldb_context_t* context, const ldb_slice_t* key, ldb_slice_t** pvalue, ldb_meta_t** pmeta){
+  const char* data = NULL;
+  size_t size = 0;
+  uint64_t version = 0, exptime = 0;
+  leveldb_pinned_t* pinned = NULL;
+  int retval = string_get_pinned(context, key, &data, &size, &version, &exptime, &pinned);
+  if(retval == LDB_OK){
+    *pvalue = ldb_slice_create(data, size);
+    *pmeta = ldb_meta_create_with_exp(0, 0, version, exptime); 
+    leveldb_pinned_release(pinned);
+  }
+  return retval;
+}
+
+static int string_mget_one(const char* val, size_t vallen, ldb_slice_t** pvalue, ldb_meta_t** pmeta){
+  int retval = LDB_OK;
   if(val != NULL){
     assert(vallen>= LDB_VAL_META_SIZE);
     uint8_t type = leveldb_decode_fixed8(val);
@@ -393,7 +521,8 @@ static int string_mget_one(ldb_context_t* context, const leveldb_readoptions_t*
               goto end;
           }
       }
-      *pvalue = ldb_slice_create(val+LDB_VAL_META_SIZE, vallen-LDB_VAL_META_SIZE);
+      size_t header = LDB_VAL_META_SIZE + ((type & LDB_VALUE_TYPE_EXP) ? sizeof(uint64_t) : 0);
+      *pvalue = ldb_slice_create(val+header, vallen-header);
       *pmeta = ldb_meta_create_with_exp(0, 0, version, exptime); 
       retval = LDB_OK;
     }else{
@@ -404,33 +533,44 @@ static int string_mget_one(ldb_context_t* context, const leveldb_readoptions_t*
   }
 
 end:
-  if(val != NULL){
-    leveldb_free(val);
-  }
   return retval;
 }
 
-
 int string_mget(ldb_context_t* context, const ldb_list_t* keylist, ldb_list_t** pvallist, ldb_list_t** pmetalist){
   int retval = 0; 
-  leveldb_readoptions_t* readoptions = leveldb_readoptions_create();
-  const leveldb_snapshot_t *snapshot_for_mget = leveldb_create_snapshot(context->database_);
-  leveldb_readoptions_set_snapshot(readoptions, snapshot_for_mget);
-  
+  size_t count = keylist->length_, now = 0;
+  ldb_slice_t **slice_keys = (ldb_slice_t**)lmalloc(sizeof(ldb_slice_t*) * (count + 1));
+  const char **keys = (const char**)lmalloc(sizeof(char*) * (count + 1));
+  size_t *keylens = (size_t*)lmalloc(sizeof(size_t) * (count + 1));
+  char **vals = (char**)lmalloc(sizeof(char*) * (count + 1));
+  size_t *vallens = (size_t*)lmalloc(sizeof(size_t) * (count + 1));
+
   ldb_list_iterator_t *keyiterator = ldb_list_iterator_create(keylist);
+  for(now = 0; now < count; ++now){
+    ldb_list_node_t *node_key = ldb_list_next(&keyiterator); 
+    const ldb_slice_t *key = (const ldb_slice_t*)node_key->data_;
+    encode_kv_key(ldb_slice_data(key), ldb_slice_size(key), NULL, &slice_keys[now]);
+    keys[now] = ldb_slice_data(slice_keys[now]);
+    keylens[now] = ldb_slice_size(slice_keys[now]);
+  }
+  ldb_list_iterator_destroy(keyiterator);
+
+  //one lookup of all keys, read from the same state of the db
+  char *errptr = NULL;
+  leveldb_multi_get(context->database_, context->readoptions_, count, keys, keylens, vals, vallens, &errptr);
+  if(errptr != NULL){
+    fprintf(stderr, "%s leveldb_multi_get fail %s.\n", __func__, errptr);
+    leveldb_free(errptr);
+  }
+
   *pvallist = ldb_list_create();
   *pmetalist = ldb_list_create();
-  while(1){
-    ldb_list_node_t *node_key = ldb_list_next(&keyiterator); 
-    if(node_key== NULL){
-      retval = LDB_OK;
-      break;
-    }
+  for(now = 0; now < count; ++now){
     ldb_slice_t *val = NULL;
     ldb_meta_t *meta = NULL;
     ldb_list_node_t *node_val = ldb_list_node_create();
     ldb_list_node_t *node_meta = ldb_list_node_create();
-    if(string_mget_one(context, readoptions, (ldb_slice_t*)node_key->data_, &val, &meta)== LDB_OK){
+    if(string_mget_one(vals[now], vallens[now], &val, &meta)== LDB_OK){
       node_val->data_ = val;
       node_val->type_ = LDB_LIST_NODE_TYPE_SLICE;
       node_meta->data_ = meta;
@@ -441,11 +581,18 @@ int string_mget(ldb_context_t* context, const ldb_list_t* keylist, ldb_list_t**
     }
     rpush_ldb_list_node(*pvallist, node_val);
     rpush_ldb_list_node(*pmetalist, node_meta);
+    if(vals[now] != NULL){
+      leveldb_free(vals[now]);
+    }
+    ldb_slice_destroy(slice_keys[now]);
   }
+  retval = LDB_OK;
 
-  ldb_list_iterator_destroy(keyiterator);
-  leveldb_readoptions_destroy(readoptions);
-  leveldb_release_snapshot(context->database_, snapshot_for_mget);
+  lfree(vallens);
+  lfree(vals);
+  lfree(keylens);
+  lfree(keys);
+  lfree(slice_keys);
   return retval;
 }
 
@@ -457,15 +604,15 @@ int string_del(ldb_context_t* context, const ldb_slice_t* key, const ldb_meta_t*
     goto end;
   }
   char *errptr = NULL;
-  leveldb_writeoptions_t* writeoptions = leveldb_writeoptions_create();
   ldb_slice_t *slice_key = NULL;
   encode_kv_key(ldb_slice_data(key), ldb_slice_size(key), meta, &slice_key);
+  ldb_context_lock_key(context, ldb_slice_data(key), ldb_slice_size(key));
   leveldb_delete(context->database_, 
-                 writeoptions, 
+                 context->writeoptions_, 
                  ldb_slice_data(slice_key), 
                  ldb_slice_size(slice_key), 
                  &errptr);
-  leveldb_writeoptions_destroy(writeoptions);
+  ldb_context_unlock_key(context, ldb_slice_data(key), ldb_slice_size(key));
   ldb_slice_destroy(slice_key);
   if(errptr != NULL){
     fprintf(stderr, "%s leveldb_delete fail %s.\n", errptr, __func__);
@@ -479,39 +626,52 @@ end:
   return retval;
 }
 
+int string_txn_set(ldb_txn_t* txn, const ldb_slice_t* key, const ldb_slice_t* value, const ldb_meta_t* meta){
+  if(ldb_slice_size(key) == 0){
+    fprintf(stderr, "%s empty key!\n", __func__);
+    return LDB_ERR;
+  }
+  kv_txn_put(txn, key, meta, ldb_slice_data(value), ldb_slice_size(value));
+  return LDB_OK;
+}
+
+int string_txn_del(ldb_txn_t* txn, const ldb_slice_t* key, const ldb_meta_t* meta){
+  if(ldb_slice_size(key) == 0){
+    fprintf(stderr, "%s empty key!\n", __func__);
+    return LDB_ERR;
+  }
+  ldb_slice_t *slice_key = NULL;
+  encode_kv_key(ldb_slice_data(key), ldb_slice_size(key), meta, &slice_key);
+  ldb_txn_delete(txn, ldb_slice_data(slice_key), ldb_slice_size(slice_key));
+  ldb_slice_destroy(slice_key);
+  return LDB_OK;
+}
 
 int string_incr(ldb_context_t* context, const ldb_slice_t* key, const ldb_meta_t* meta, int64_t init, int64_t by, int64_t* val){
   int retval = 0;
   ldb_slice_t *slice_value = NULL;
   ldb_meta_t *old_meta = NULL;
-  int found = string_get(context, key, &slice_value, &old_meta);
-  if(found == LDB_OK){
-    *val = leveldb_decode_fixed64(ldb_slice_data(slice_value));
-  }else if(found == LDB_OK_NOT_EXIST){
-    *val = init;
-  }else{
-    retval = found;
-    goto end;
+  ldb_txn_t *txn = ldb_txn_create();
+  ldb_context_lock_key(context, ldb_slice_data(key), ldb_slice_size(key));
+  //only the reply needs the old value, leveldb folds the delta into it
+  if(val != NULL){
+    int found = string_get(context, key, &slice_value, &old_meta);
+    if(found == LDB_OK && ldb_slice_size(slice_value) == sizeof(int64_t)){
+      *val = leveldb_decode_fixed64(ldb_slice_data(slice_value));
+    }else if(found == LDB_OK || found == LDB_OK_NOT_EXIST){
+      *val = init;
+    }else{
+      retval = found;
+      goto end;
+    }
+    *val += by; 
   }
-  *val += by; 
-  char buf[sizeof(int64_t)] = {0};
-  leveldb_encode_fixed64(buf, *val);
 
   char *errptr = NULL;
-  leveldb_writeoptions_t* writeoptions = leveldb_writeoptions_create();
-  ldb_slice_t *slice_key = NULL;
-  encode_kv_key(ldb_slice_data(key), ldb_slice_size(key), meta, &slice_key);
-  leveldb_put(context->database_, 
-              writeoptions, 
-              ldb_slice_data(slice_key), 
-              ldb_slice_size(slice_key), 
-              buf,
-              sizeof(buf),
-              &errptr);
-  leveldb_writeoptions_destroy(writeoptions);
-  ldb_slice_destroy(slice_key);
+  kv_txn_merge(txn, key, meta, by, init);
+  ldb_txn_commit(context, txn, &errptr);
   if(errptr != NULL){
-    fprintf(stderr, "%s leveldb_put failed %s.\n", __func__, errptr);
+    fprintf(stderr, "%s ldb_txn_commit failed %s.\n", __func__, errptr);
     leveldb_free(errptr);
     retval = LDB_ERR;
     goto end;
@@ -519,6 +679,9 @@ int string_incr(ldb_context_t* context, const ldb_slice_t* key, const ldb_meta_t
   retval = LDB_OK;
 
 end:
+  ldb_context_unlock_key(context, ldb_slice_data(key), ldb_slice_size(key));
+  ldb_txn_destroy(txn);
   ldb_slice_destroy(slice_value);
+  ldb_meta_destroy(old_meta);
   return retval;
 }
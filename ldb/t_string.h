@@ -6,9 +6,13 @@
 #include "ldb_slice.h"
 #include "ldb_meta.h"
 #include "ldb_list.h"
+#include "ldb_txn.h"
 
 
 void encode_kv_key(const char* key, size_t keylen, const ldb_meta_t* meta, ldb_slice_t** pslice);
+//the key without the meta prefix into buf, returns its size, nothing is
+//written if that is more than buflen
+size_t encode_kv_key_raw(char* buf, size_t buflen, const char* key, size_t keylen);
 
 int decode_kv_key(const char* ldbkey, size_t ldbkeylen, ldb_slice_t** pslice);
 
@@ -26,10 +30,30 @@ int string_msetnx(ldb_context_t* context, const ldb_list_t* datalist, const ldb_
 
 int string_get(ldb_context_t* context, const ldb_slice_t* key, ldb_slice_t** pvalue, ldb_meta_t** meta);
 
+//reads only the value header, never the value
+int string_exists(ldb_context_t* context, const ldb_slice_t* key);
+
+//reads only the value header, *pmeta gets the version and exptime
+int string_get_meta(ldb_context_t* context, const ldb_slice_t* key, ldb_meta_t** pmeta);
+
+//replaces the version and exptime of key with those of meta, leaving the value alone
+int string_touch(ldb_context_t* context, const ldb_slice_t* key, const ldb_meta_t* meta);
+
+//*pdata points into the db and stays valid until *ppinned is passed to leveldb_pinned_release
+int string_get_pinned(ldb_context_t* context, const ldb_slice_t* key, const char** pdata, size_t* psize, uint64_t* pversion, uint64_t* pexptime, leveldb_pinned_t** ppinned);
+
 int string_mget(ldb_context_t* context, const ldb_list_t* keylist, ldb_list_t** pvallist, ldb_list_t** pmetalist);
 
 int string_del(ldb_context_t* context, const ldb_slice_t* key, const ldb_meta_t* meta);
 
+//the writes of string_set and string_del appended to txn, for callers that
+//commit writes to many keys at once. the caller holds the locks of the keys.
+int string_txn_set(ldb_txn_t* txn, const ldb_slice_t* key, const ldb_slice_t* value, const ldb_meta_t* meta);
+
+int string_txn_del(ldb_txn_t* txn, const ldb_slice_t* key, const ldb_meta_t* meta);
+
+//adds by to the counter, init if there is none, with a merge operand. the
+//counter is only read when val asks for the result, NULL makes it a blind write
 int string_incr(ldb_context_t* context, const ldb_slice_t* key, const ldb_meta_t* meta, int64_t init, int64_t by, int64_t* val);
 
 
@@ -6,6 +6,8 @@
 #include "ldb_list.h"
 #include "ldb_iterator.h"
 #include "ldb_context.h"
+#include "ldb_txn.h"
+#include "lmalloc.h"
 #include "util.h"
 
 #include <leveldb/c.h>
@@ -18,14 +20,13 @@
 int64_t LDB_SCORE_MIN = INT64_MIN;
 int64_t LDB_SCORE_MAX = INT64_MAX;
 
-static int zset_one(ldb_context_t *context, const ldb_slice_t* name, 
+static int zset_one(ldb_context_t *context, ldb_txn_t* txn, const ldb_slice_t* name, 
                     const ldb_slice_t* key, const ldb_meta_t* meta, int64_t score);
 
-static int zdel_one(ldb_context_t *context, const ldb_slice_t* name, 
+static int zdel_one(ldb_context_t *context, ldb_txn_t* txn, const ldb_slice_t* name, 
                     const ldb_slice_t* key, const ldb_meta_t* meta);
 
-static int zset_incr_size(ldb_context_t *context, 
-                          const ldb_slice_t* name, int64_t by);
+static int zset_incr_size(ldb_txn_t* txn, const ldb_slice_t* name, int64_t by);
 
 static ldb_zset_iterator_t* ziterator(ldb_context_t *context, const ldb_slice_t *name,
                                       const ldb_slice_t *kstart, int64_t sstart, int64_t send, uint64_t limit,int direction);
@@ -36,6 +37,25 @@ static int zrange(ldb_context_t* context, const ldb_slice_t* name,
 static int zscan(ldb_context_t* context, const ldb_slice_t* name, 
         const ldb_slice_t* key, int64_t start, int64_t end, int reverse, ldb_zset_iterator_t **piterator); 
 
+typedef struct zrank_move_t{
+  int64_t old_;
+  int64_t new_;
+  uint8_t has_old_;
+  uint8_t has_new_;
+} zrank_move_t;
+
+static int zrank_index_move(ldb_context_t* context, ldb_txn_t* txn, const ldb_slice_t* name,
+                            const zrank_move_t* moves, size_t count);
+
+static int zrank_index_update(ldb_context_t* context, ldb_txn_t* txn, const ldb_slice_t* name,
+                              const int64_t* old_score, const int64_t* new_score);
+
+static int zrank_index_rank(ldb_context_t* context, const ldb_slice_t* name,
+                            const ldb_slice_t* key, int64_t score, uint64_t* rank);
+
+static int zrank_index_range(ldb_context_t* context, const ldb_slice_t* name,
+                             uint64_t offset, uint64_t limit, int reverse, ldb_zset_iterator_t **piterator);
+
 
 void encode_zsize_key(const char* name, size_t namelen, ldb_slice_t** pslice){
   ldb_meta_t *meta = ldb_meta_create(LDB_VERSION_CARE_DIRCT, 0, 0);
@@ -87,6 +107,21 @@ void encode_zset_key(const char* name, size_t namelen, const char* key, size_t k
   *pslice = slice;
 }
 
+size_t encode_zset_key_raw(char* buf, size_t buflen, const char* name, size_t namelen, const char* key, size_t keylen){
+  size_t size = strlen(LDB_DATA_TYPE_ZSET) + sizeof(uint8_t) + namelen + sizeof(uint8_t) + keylen;
+  if(size > buflen){
+    return size;
+  }
+  memcpy(buf, LDB_DATA_TYPE_ZSET, strlen(LDB_DATA_TYPE_ZSET));
+  buf += strlen(LDB_DATA_TYPE_ZSET);
+  *buf++ = (char)(uint8_t)namelen;
+  memcpy(buf, name, namelen);
+  buf += namelen;
+  *buf++ = (char)(uint8_t)keylen;
+  memcpy(buf, key, keylen);
+  return size;
+}
+
 int decode_zset_key(const char* ldbkey, size_t ldbkeylen, ldb_slice_t** pslice_name, ldb_slice_t** pslice_key){
   int retval = 0;
   ldb_slice_t *slice_name, *slice_key = NULL;
@@ -139,6 +174,25 @@ void encode_zscore_key(const char* name, size_t namelen, const char* key, size_t
   *pslice = slice;
 }
 
+size_t encode_zscore_key_raw(char* buf, size_t buflen, const char* name, size_t namelen, const char* key, size_t keylen, int64_t score){
+  size_t size = strlen(LDB_DATA_TYPE_ZSCORE) + sizeof(uint8_t) + namelen + 1 + sizeof(int64_t) + 1 + keylen;
+  if(size > buflen){
+    return size;
+  }
+  memcpy(buf, LDB_DATA_TYPE_ZSCORE, strlen(LDB_DATA_TYPE_ZSCORE));
+  buf += strlen(LDB_DATA_TYPE_ZSCORE);
+  *buf++ = (char)(uint8_t)namelen;
+  memcpy(buf, name, namelen);
+  buf += namelen;
+  *buf++ = (score < 0) ? '-' : '=';
+  score = big_endian_u64(score);
+  memcpy(buf, &score, sizeof(int64_t));
+  buf += sizeof(int64_t);
+  *buf++ = '=';
+  memcpy(buf, key, keylen);
+  return size;
+}
+
 int decode_zscore_key(const char* ldbkey, size_t ldbkeylen, ldb_slice_t** pslice_name, ldb_slice_t** pslice_key,  int64_t *pscore){
   int retval = 0;
   ldb_slice_t *slice_name = NULL;
@@ -200,20 +254,58 @@ end:
   return retval;
 }
 
+//scores are flipped so that the rank keys of negative scores sort first
+static uint64_t zrank_uscore(int64_t score){
+  return ((uint64_t)score) ^ 0x8000000000000000ULL;
+}
+
+static int64_t zrank_score(uint64_t uscore){
+  return (int64_t)(uscore ^ 0x8000000000000000ULL);
+}
+
+//uscore with all but its first level bytes cleared
+static uint64_t zrank_prefix(uint64_t uscore, int level){
+  if(level == 0){
+    return 0;
+  }
+  if(level >= LDB_DATA_TYPE_ZRANK_LEVELS){
+    return uscore;
+  }
+  return uscore & ~(((uint64_t)-1) >> (8 * level));
+}
+
+void encode_zrank_key(const char* name, size_t namelen, int level, uint64_t uscore, ldb_slice_t** pslice){
+  ldb_meta_t *meta = ldb_meta_create(LDB_VERSION_CARE_DIRCT, 0, 0);
+  ldb_slice_t* slice = ldb_meta_slice_create(meta);
+  ldb_slice_push_back(slice, LDB_DATA_TYPE_ZRANK, strlen(LDB_DATA_TYPE_ZRANK));
+  uint8_t len = (uint8_t)namelen;
+  ldb_slice_push_back(slice, (const char*)(&len), sizeof(uint8_t));
+  ldb_slice_push_back(slice, name, namelen);
+  len = (uint8_t)level;
+  ldb_slice_push_back(slice, (const char*)(&len), sizeof(uint8_t));
+  uint64_t prefix = big_endian_u64(uscore);
+  ldb_slice_push_back(slice, (const char*)&prefix, level);
+  *pslice = slice;
+
+  ldb_meta_destroy(meta);
+}
+
 
 int zset_add(ldb_context_t* context, const ldb_slice_t* name, 
              const ldb_slice_t* key, const ldb_meta_t* meta, int64_t score){
-  int ret = zset_one(context, name, key, meta, score);
+  ldb_txn_t *txn = ldb_txn_create();
+  ldb_context_lock_key(context, ldb_slice_data(name), ldb_slice_size(name));
+  int ret = zset_one(context, txn, name, key, meta, score);
   int retval = LDB_OK;
   if(ret >= 0){
     if(ret > 0){
-      if(zset_incr_size(context, name, ret) == -1){
+      if(zset_incr_size(txn, name, ret) == -1){
         retval = LDB_ERR;
         goto end;
       }
     }
     char* errptr = NULL;
-    ldb_context_writebatch_commit(context, &errptr);
+    ldb_txn_commit(context, txn, &errptr);
     if( errptr != NULL){
       fprintf(stderr, "leveldb write fail %s.\n", errptr);
       leveldb_free(errptr);
@@ -226,22 +318,26 @@ int zset_add(ldb_context_t* context, const ldb_slice_t* name,
   }
 
 end:
+  ldb_context_unlock_key(context, ldb_slice_data(name), ldb_slice_size(name));
+  ldb_txn_destroy(txn);
   return retval;
 }
 
 int zset_del(ldb_context_t* context, const ldb_slice_t* name, 
              const ldb_slice_t* key, const ldb_meta_t* meta){
-  int ret = zdel_one(context, name, key, meta);
+  ldb_txn_t *txn = ldb_txn_create();
+  ldb_context_lock_key(context, ldb_slice_data(name), ldb_slice_size(name));
+  int ret = zdel_one(context, txn, name, key, meta);
   int retval = LDB_OK; 
   if(ret >= 0){
     if(ret > 0){
-      if(zset_incr_size(context, name, -ret) == -1){
+      if(zset_incr_size(txn, name, -ret) == -1){
         retval = LDB_ERR;
         goto end;
       }
     }
     char* errptr = NULL;
-    ldb_context_writebatch_commit(context, &errptr);
+    ldb_txn_commit(context, txn, &errptr);
     if( errptr != NULL ){
       fprintf(stderr, "write writebatch fail %s.\n", errptr);
       leveldb_free(errptr);
@@ -253,15 +349,273 @@ int zset_del(ldb_context_t* context, const ldb_slice_t* name,
     retval = LDB_ERR;
   }
 end:
+  ldb_context_unlock_key(context, ldb_slice_data(name), ldb_slice_size(name));
+  ldb_txn_destroy(txn);
+  return retval;
+}
+
+
+typedef struct zset_item_t{
+  const ldb_slice_t* key_;
+  const ldb_meta_t* meta_;
+  int64_t score_;
+  size_t index_;
+} zset_item_t;
+
+static int zset_item_cmp(const void* a, const void* b){
+  const zset_item_t *ia = (const zset_item_t*)a, *ib = (const zset_item_t*)b;
+  int cmp = compare_with_length(ldb_slice_data(ia->key_), ldb_slice_size(ia->key_),
+                                ldb_slice_data(ib->key_), ldb_slice_size(ib->key_));
+  if(cmp != 0){
+    return cmp;
+  }
+  return ia->index_ < ib->index_ ? -1 : (ia->index_ > ib->index_ ? 1 : 0);
+}
+
+//writes every member of keylist in one batch, setting the member to the
+//score held by its node or removing it when del is set. old scores are
+//probed once per distinct member in key order, and the size and rank
+//counters take one merged update.
+static int zset_batch(ldb_context_t* context, const ldb_slice_t* name, const ldb_list_t* keylist,
+                      const ldb_list_t* metalist, int del, ldb_list_t** plist){
+  int retval = LDB_OK;
+  size_t count = keylist->length_, now = 0, i = 0;
+  zset_item_t *items = (zset_item_t*)lmalloc(sizeof(zset_item_t) * (count + 1));
+  int *results = (int*)lmalloc(sizeof(int) * (count + 1));
+  zrank_move_t *moves = (zrank_move_t*)lmalloc(sizeof(zrank_move_t) * (count + 1));
+  size_t nmoves = 0;
+  int64_t by = 0;
+  ldb_txn_t *txn = ldb_txn_create();
+  ldb_context_lock_key(context, ldb_slice_data(name), ldb_slice_size(name));
+
+  ldb_list_iterator_t *keyiterator = ldb_list_iterator_create(keylist);
+  ldb_list_iterator_t *metaiterator = ldb_list_iterator_create(metalist);
+  for(now = 0; now < count; ++now){
+    ldb_list_node_t *node_key = ldb_list_next(&keyiterator);
+    ldb_list_node_t *node_meta = ldb_list_next(&metaiterator);
+    items[now].key_ = (const ldb_slice_t*)(node_key->data_);
+    items[now].meta_ = (const ldb_meta_t*)(node_meta->data_);
+    items[now].score_ = (int64_t)(node_key->value_);
+    items[now].index_ = now;
+    results[now] = LDB_OK;
+  }
+  ldb_list_iterator_destroy(keyiterator);
+  ldb_list_iterator_destroy(metaiterator);
+
+  if(ldb_slice_size(name) > LDB_DATA_TYPE_KEY_LEN_MAX){
+    fprintf(stderr, "name too long!");
+    retval = LDB_ERR;
+    goto end;
+  }
+  qsort(items, count, sizeof(zset_item_t), zset_item_cmp);
+
+  for(i = 0; i < count;){
+    //repeats of a member follow each other in command order
+    size_t j = i;
+    const ldb_slice_t *key = items[i].key_;
+    int64_t old_score = 0;
+    int found = LDB_OK_NOT_EXIST, empty = 0;
+    if(ldb_slice_size(name) == 0 || ldb_slice_size(key) == 0){
+      fprintf(stderr, "empty name or key!");
+      empty = 1;
+    }else if(ldb_slice_size(key) > LDB_DATA_TYPE_KEY_LEN_MAX){
+      fprintf(stderr, "key too long!");
+      found = LDB_ERR;
+    }else{
+      found = zset_get(context, name, key, &old_score);
+    }
+    int existed = (found == LDB_OK);
+    int64_t first_score = old_score;
+    for(; j < count && compare_with_length(ldb_slice_data(key), ldb_slice_size(key),
+                                           ldb_slice_data(items[j].key_), ldb_slice_size(items[j].key_)) == 0; ++j){
+      const zset_item_t *item = &items[j];
+      if(found == LDB_ERR){
+        results[item->index_] = LDB_ERR;
+        continue;
+      }
+      if(empty){
+        continue;
+      }
+      ldb_slice_t *slice_key = NULL;
+      if(found == LDB_OK && (del || old_score != item->score_)){
+        //delete zscore key
+        encode_zscore_key(ldb_slice_data(name),
+                          ldb_slice_size(name),
+                          ldb_slice_data(key),
+                          ldb_slice_size(key),
+                          item->meta_,
+                          old_score,
+                          &slice_key);
+        ldb_txn_delete(txn,
+                       ldb_slice_data(slice_key),
+                       ldb_slice_size(slice_key));
+        ldb_slice_destroy(slice_key);
+      }
+      if(del){
+        if(found == LDB_OK){
+          encode_zset_key(ldb_slice_data(name),
+                          ldb_slice_size(name),
+                          ldb_slice_data(key),
+                          ldb_slice_size(key),
+                          item->meta_,
+                          &slice_key);
+          ldb_txn_delete(txn,
+                         ldb_slice_data(slice_key),
+                         ldb_slice_size(slice_key));
+          ldb_slice_destroy(slice_key);
+          found = LDB_OK_NOT_EXIST;
+        }
+        continue;
+      }
+      if(found == LDB_OK && old_score == item->score_){
+        continue;
+      }
+      //add zscore key
+      char keybuf[LDB_KEY_BUF_SIZE];
+      size_t keylen = encode_zscore_key_raw(keybuf,
+                                            sizeof(keybuf),
+                                            ldb_slice_data(name),
+                                            ldb_slice_size(name),
+                                            ldb_slice_data(key),
+                                            ldb_slice_size(key),
+                                            item->score_);
+      assert(keylen <= sizeof(keybuf));
+      char buf0[sizeof(uint64_t)] = {0};
+      leveldb_encode_fixed64(buf0, ldb_meta_nextver(item->meta_));
+      ldb_txn_put_with_meta(txn,
+                            item->meta_,
+                            keybuf,
+                            keylen,
+                            buf0,
+                            sizeof(buf0));
+      //update zset
+      keylen = encode_zset_key_raw(keybuf,
+                                   sizeof(keybuf),
+                                   ldb_slice_data(name),
+                                   ldb_slice_size(name),
+                                   ldb_slice_data(key),
+                                   ldb_slice_size(key));
+      assert(keylen <= sizeof(keybuf));
+      char buf1[sizeof(int64_t)] = {0};
+      leveldb_encode_fixed64(buf1, item->score_);
+      ldb_txn_put_with_meta(txn,
+                            item->meta_,
+                            keybuf,
+                            keylen,
+                            buf1,
+                            sizeof(int64_t));
+      found = LDB_OK;
+      old_score = item->score_;
+    }
+    //only the net change of the member reaches the counters
+    if(found != LDB_ERR && !empty){
+      int exists = (found == LDB_OK);
+      if(existed != exists || (exists && first_score != old_score)){
+        moves[nmoves].has_old_ = (uint8_t)existed;
+        moves[nmoves].old_ = first_score;
+        moves[nmoves].has_new_ = (uint8_t)exists;
+        moves[nmoves].new_ = old_score;
+        ++nmoves;
+        by += exists - existed;
+      }
+    }
+    i = j;
+  }
+
+  if(zrank_index_move(context, txn, name, moves, nmoves) < 0){
+    retval = LDB_ERR;
+    goto end;
+  }
+  if(by != 0 && zset_incr_size(txn, name, by) == -1){
+    retval = LDB_ERR;
+    goto end;
+  }
+  char* errptr = NULL;
+  ldb_txn_commit(context, txn, &errptr);
+  if(errptr != NULL){
+    fprintf(stderr, "leveldb write fail %s.\n", errptr);
+    leveldb_free(errptr);
+    retval = LDB_ERR;
+    goto end;
+  }
+  retval = LDB_OK;
+
+end:
+  if(retval != LDB_OK){
+    for(now = 0; now < count; ++now){
+      results[now] = LDB_ERR;
+    }
+  }
+  ldb_list_t *retlist = ldb_list_create();
+  for(now = 0; now < count; ++now){
+    ldb_list_node_t* node_ret = ldb_list_node_create();
+    node_ret->type_ = LDB_LIST_NODE_TYPE_BASE;
+    node_ret->value_ = results[now];
+    rpush_ldb_list_node(retlist, node_ret);
+  }
+  *plist = retlist;
+  ldb_context_unlock_key(context, ldb_slice_data(name), ldb_slice_size(name));
+  ldb_txn_destroy(txn);
+  lfree(moves);
+  lfree(results);
+  lfree(items);
   return retval;
 }
 
+int zset_madd(ldb_context_t* context, const ldb_slice_t* name,
+              const ldb_list_t* keylist, const ldb_list_t* metalist, ldb_list_t** plist){
+  return zset_batch(context, name, keylist, metalist, 0, plist);
+}
+
+int zset_mdel(ldb_context_t* context, const ldb_slice_t* name,
+              const ldb_list_t* keylist, const ldb_list_t* metalist, ldb_list_t** plist){
+  return zset_batch(context, name, keylist, metalist, 1, plist);
+}
+
+static void zset_push_del(ldb_list_t* keylist, ldb_list_t* metalist, ldb_slice_t* key, const ldb_meta_t* meta){
+  ldb_list_node_t *node_key = ldb_list_node_create();
+  node_key->type_ = LDB_LIST_NODE_TYPE_SLICE;
+  node_key->data_ = key;
+  rpush_ldb_list_node(keylist, node_key);
+
+  ldb_list_node_t *node_meta = ldb_list_node_create();
+  node_meta->type_ = LDB_LIST_NODE_TYPE_META;
+  node_meta->data_ = ldb_meta_create_with_exp(ldb_meta_vercare(meta),
+                                              ldb_meta_lastver(meta),
+                                              ldb_meta_nextver(meta),
+                                              ldb_meta_exptime(meta));
+  rpush_ldb_list_node(metalist, node_meta);
+}
+
+static int zset_mdel_count(ldb_context_t* context, const ldb_slice_t* name,
+                           const ldb_list_t* keylist, const ldb_list_t* metalist, uint64_t* deleted){
+  ldb_list_t *retlist = NULL;
+  if(keylist->length_ == 0){
+    return LDB_OK;
+  }
+  zset_mdel(context, name, keylist, metalist, &retlist);
+  ldb_list_iterator_t *iterator = ldb_list_iterator_create(retlist);
+  while(1){
+    ldb_list_node_t *node = ldb_list_next(&iterator);
+    if(node == NULL){
+      break;
+    }
+    if((int)(node->value_) == LDB_OK){
+      *deleted += 1;
+    }
+  }
+  ldb_list_iterator_destroy(iterator);
+  ldb_list_destroy(retlist);
+  return LDB_OK;
+}
 
 int zset_del_range_by_rank(ldb_context_t* context, const ldb_slice_t* name,
                            const ldb_meta_t* meta, int rank_start, int rank_end, uint64_t *deleted){
   int retval = 0;
   ldb_zset_iterator_t *iterator = NULL;
+  ldb_list_t *keylist = NULL, *metalist = NULL;
   uint64_t offset, limit, size = 0;
+  ldb_context_lock_key(context, ldb_slice_data(name), ldb_slice_size(name));
   retval = zset_size(context, name, &size);
   if(retval == LDB_OK_NOT_EXIST){
     goto end;
@@ -295,8 +649,10 @@ int zset_del_range_by_rank(ldb_context_t* context, const ldb_slice_t* name,
   }
   
   (*deleted) = 0;
+  keylist = ldb_list_create();
+  metalist = ldb_list_create();
   do{
-    if((*deleted)==limit){
+    if(keylist->length_==limit){
       break;
     }
     if(!ldb_zset_iterator_valid(iterator)){
@@ -314,17 +670,17 @@ int zset_del_range_by_rank(ldb_context_t* context, const ldb_slice_t* name,
                             NULL,
                             &key,
                             NULL)== 0){ 
-        if(zset_del(context, name, key, meta) == LDB_OK){
-          *deleted += 1;
-        }
-        ldb_slice_destroy(key);
+        zset_push_del(keylist, metalist, key, meta);
       }
     }
   }while(!ldb_zset_iterator_next(iterator));
 
-  retval = LDB_OK;
+  retval = zset_mdel_count(context, name, keylist, metalist, deleted);
 
 end:
+  ldb_context_unlock_key(context, ldb_slice_data(name), ldb_slice_size(name));
+  ldb_list_destroy(keylist);
+  ldb_list_destroy(metalist);
   ldb_zset_iterator_destroy(iterator);
   return retval; 
 }
@@ -334,12 +690,16 @@ int zset_del_range_by_score(ldb_context_t* context, const ldb_slice_t* name,
                             const ldb_meta_t* meta, int64_t score_start, int64_t score_end, uint64_t *deleted){
   int retval = 0;
   ldb_zset_iterator_t *iterator = NULL;
+  ldb_list_t *keylist = NULL, *metalist = NULL;
+  ldb_context_lock_key(context, ldb_slice_data(name), ldb_slice_size(name));
   if(zscan(context, name, NULL, score_start, score_end, 0, &iterator) < 0){
     retval = LDB_OK_RANGE_HAVE_NONE;
     goto end;
   }
 
   (*deleted) = 0;
+  keylist = ldb_list_create();
+  metalist = ldb_list_create();
   do{
     if(!ldb_zset_iterator_valid(iterator)){
       break;
@@ -358,21 +718,21 @@ int zset_del_range_by_score(ldb_context_t* context, const ldb_slice_t* name,
                            &key,
                            &value) == 0){ 
         if(value < score_end){
-          if(zset_del(context, name, key, meta) == LDB_OK){
-            *deleted += 1;
-          }
+          zset_push_del(keylist, metalist, key, meta);
         }else{
           ldb_slice_destroy(key);
           break;
         }
-        ldb_slice_destroy(key);
       }
     }
   }while(!ldb_zset_iterator_next(iterator));
 
-  retval = LDB_OK;
+  retval = zset_mdel_count(context, name, keylist, metalist, deleted);
 
 end:
+  ldb_context_unlock_key(context, ldb_slice_data(name), ldb_slice_size(name));
+  ldb_list_destroy(keylist);
+  ldb_list_destroy(metalist);
   ldb_zset_iterator_destroy(iterator);
   return retval;
 }
@@ -381,11 +741,9 @@ int zset_get(ldb_context_t* context, const ldb_slice_t* name,
              const ldb_slice_t* key, int64_t* score){ 
   char *val, *errptr = NULL;
   size_t vallen = 0;
-  leveldb_readoptions_t* readoptions = leveldb_readoptions_create();
   ldb_slice_t *slice_key = NULL;
   encode_zset_key(ldb_slice_data(name), ldb_slice_size(name), ldb_slice_data(key), ldb_slice_size(key), NULL, &slice_key); 
-  val = leveldb_get(context->database_, readoptions, ldb_slice_data(slice_key), ldb_slice_size(slice_key), &vallen, &errptr);
-  leveldb_readoptions_destroy(readoptions);
+  val = leveldb_get(context->database_, context->readoptions_, ldb_slice_data(slice_key), ldb_slice_size(slice_key), &vallen, &errptr);
   ldb_slice_destroy(slice_key);
   int retval = 0;
   if(errptr != NULL){
@@ -423,6 +781,28 @@ int zset_rank(ldb_context_t* context, const ldb_slice_t* name,
               const ldb_slice_t* key, int reverse, uint64_t* rank){
   int retval = 0;
   ldb_zset_iterator_t *iterator = NULL; 
+  int64_t score = 0;
+  retval = zset_get(context, name, key, &score);
+  if(retval != LDB_OK){
+    goto end;
+  }
+  retval = zrank_index_rank(context, name, key, score, rank);
+  if(retval == LDB_OK){
+    if(reverse){
+      uint64_t size = 0;
+      retval = zset_size(context, name, &size);
+      if(retval != LDB_OK || *rank >= size){
+        retval = LDB_ERR;
+        goto end;
+      }
+      *rank = size - 1 - *rank;
+    }
+    goto end;
+  }
+  if(retval != LDB_OK_NOT_EXIST){
+    goto end;
+  }
+  //no rank index, walk the members
   if(reverse == 0){
     iterator = ziterator(context, name, NULL, LDB_SCORE_MIN, LDB_SCORE_MAX, INT32_MAX, FORWARD); 
   }else{
@@ -448,8 +828,6 @@ int zset_rank(ldb_context_t* context, const ldb_slice_t* name,
     assert(raw_vlen >= LDB_VAL_META_SIZE);
     uint8_t type = leveldb_decode_fixed8(raw_val);
     if((type & LDB_VALUE_TYPE_VAL)&& !(type & LDB_VALUE_TYPE_LAT)){
-      printf("%s, score=%ld\n", __func__, score);
-      printbuf(raw_key, raw_klen);
       if(compare_with_length(ldb_slice_data(key),
                           ldb_slice_size(key),
                           ldb_slice_data(slice_key),
@@ -670,6 +1048,8 @@ end:
 int zset_incr(ldb_context_t* context, const ldb_slice_t* name, 
               const ldb_slice_t* key, const ldb_meta_t* meta, int64_t by, int64_t* val){
   int64_t old_score = 0;
+  ldb_txn_t *txn = ldb_txn_create();
+  ldb_context_lock_key(context, ldb_slice_data(name), ldb_slice_size(name));
   int ret = zset_get(context, name, key, &old_score);
   int retval = LDB_OK;
   if(ret == LDB_OK){
@@ -680,16 +1060,16 @@ int zset_incr(ldb_context_t* context, const ldb_slice_t* name,
     retval = ret;
     goto end;
   }
-  ret = zset_one(context, name, key, meta, *val);
+  ret = zset_one(context, txn, name, key, meta, *val);
   if(ret >= 0){
     if(ret > 0){
-      if(zset_incr_size(context, name, ret) == -1){
+      if(zset_incr_size(txn, name, ret) == -1){
         retval = LDB_ERR;
         goto end;
       }
     }
     char* errptr = NULL;
-    ldb_context_writebatch_commit(context, &errptr);
+    ldb_txn_commit(context, txn, &errptr);
     if(errptr!=NULL){
       fprintf(stderr, "leveldb_write fail %s.\n", errptr);
       leveldb_free(errptr);
@@ -702,6 +1082,8 @@ int zset_incr(ldb_context_t* context, const ldb_slice_t* name,
   }
   
 end:
+  ldb_context_unlock_key(context, ldb_slice_data(name), ldb_slice_size(name));
+  ldb_txn_destroy(txn);
   return retval;
 }
 
@@ -715,9 +1097,7 @@ int zset_size(ldb_context_t* context, const ldb_slice_t* name,
  
   char *val, *errptr = NULL;
   size_t vallen = 0;
-  leveldb_readoptions_t* readoptions = leveldb_readoptions_create();
-  val = leveldb_get(context->database_, readoptions, ldb_slice_data(slice_key), ldb_slice_size(slice_key), &vallen, &errptr);
-  leveldb_readoptions_destroy(readoptions);
+  val = leveldb_get(context->database_, context->readoptions_, ldb_slice_data(slice_key), ldb_slice_size(slice_key), &vallen, &errptr);
   ldb_slice_destroy(slice_key);
   int retval = LDB_OK;
   if(errptr != NULL){
@@ -730,7 +1110,13 @@ int zset_size(ldb_context_t* context, const ldb_slice_t* name,
     assert(vallen >= (sizeof(uint64_t) + LDB_VAL_META_SIZE));
     uint8_t type = leveldb_decode_fixed8(val);
     if(type & LDB_VALUE_TYPE_VAL){
-      *size = leveldb_decode_fixed64(val + LDB_VAL_META_SIZE);
+      //the merged size drops to 0 instead of being deleted
+      int64_t length = (int64_t)leveldb_decode_fixed64(val + LDB_VAL_META_SIZE);
+      if(length <= 0){
+        retval = LDB_OK_NOT_EXIST;
+        goto end;
+      }
+      *size = length;
       retval = LDB_OK;
     }else{
       retval = LDB_OK_NOT_EXIST;
@@ -746,7 +1132,7 @@ end:
 }
 
 
-static int zset_one(ldb_context_t *context, const ldb_slice_t* name, 
+static int zset_one(ldb_context_t *context, ldb_txn_t* txn, const ldb_slice_t* name, 
                     const ldb_slice_t* key, const ldb_meta_t* meta, int64_t score){
   if(ldb_slice_size(name)==0 || ldb_slice_size(key)==0){
     fprintf(stderr, "empty name or key!");
@@ -775,48 +1161,50 @@ static int zset_one(ldb_context_t *context, const ldb_slice_t* name,
                         old_score,
                         &slice_key1);
 
-      ldb_context_writebatch_delete(context,
-                                    ldb_slice_data(slice_key1),
-                                    ldb_slice_size(slice_key1));
+      ldb_txn_delete(txn,
+                     ldb_slice_data(slice_key1),
+                     ldb_slice_size(slice_key1));
       ldb_slice_destroy(slice_key1);
     }
-    ldb_slice_t *slice_key2 = NULL;
-    //add zscore key
-    encode_zscore_key(ldb_slice_data(name),
-                      ldb_slice_size(name),
-                      ldb_slice_data(key),
-                      ldb_slice_size(key),
-                      meta,
-                      score,
-                      &slice_key2);
     //add zscore key
+    char keybuf[LDB_KEY_BUF_SIZE];
+    size_t keylen = encode_zscore_key_raw(keybuf,
+                                          sizeof(keybuf),
+                                          ldb_slice_data(name),
+                                          ldb_slice_size(name),
+                                          ldb_slice_data(key),
+                                          ldb_slice_size(key),
+                                          score);
+    assert(keylen <= sizeof(keybuf));
     char buf0[sizeof(uint64_t)] = {0};
     leveldb_encode_fixed64(buf0, ldb_meta_nextver(meta));
-    ldb_context_writebatch_put(context,
-                               ldb_slice_data(slice_key2),
-                               ldb_slice_size(slice_key2),
-                               buf0,
-                               sizeof(buf0));
-    ldb_slice_destroy(slice_key2);
-
-    ldb_slice_t *slice_key0 = NULL;
-    //update zset
-    encode_zset_key(ldb_slice_data(name),
-                    ldb_slice_size(name),
-                    ldb_slice_data(key),
-                    ldb_slice_size(key),
-                    meta,
-                    &slice_key0);
+    ldb_txn_put_with_meta(txn,
+                          meta,
+                          keybuf,
+                          keylen,
+                          buf0,
+                          sizeof(buf0));
 
+    //update zset
+    keylen = encode_zset_key_raw(keybuf,
+                                 sizeof(keybuf),
+                                 ldb_slice_data(name),
+                                 ldb_slice_size(name),
+                                 ldb_slice_data(key),
+                                 ldb_slice_size(key));
+    assert(keylen <= sizeof(keybuf));
     char buf1[sizeof(int64_t)] = {0};
     leveldb_encode_fixed64(buf1, score);
-    ldb_context_writebatch_put(context,
-                               ldb_slice_data(slice_key0),
-                               ldb_slice_size(slice_key0),
-                               buf1,
-                               sizeof(int64_t));
-
-   ldb_slice_destroy(slice_key0);
+    ldb_txn_put_with_meta(txn,
+                          meta,
+                          keybuf,
+                          keylen,
+                          buf1,
+                          sizeof(int64_t));
+
+    if(zrank_index_update(context, txn, name, (found==LDB_OK) ? &old_score : NULL, &score) < 0){
+      return -1;
+    }
 
     return (found==LDB_OK) ? 0 : 1;
   }
@@ -825,7 +1213,7 @@ static int zset_one(ldb_context_t *context, const ldb_slice_t* name,
 
 
 
-static int zdel_one(ldb_context_t *context, const ldb_slice_t* name, 
+static int zdel_one(ldb_context_t *context, ldb_txn_t* txn, const ldb_slice_t* name, 
                     const ldb_slice_t* key, const ldb_meta_t* meta){
   if(ldb_slice_size(name) > LDB_DATA_TYPE_KEY_LEN_MAX){
     fprintf(stderr, "name too long!");
@@ -849,9 +1237,9 @@ static int zdel_one(ldb_context_t *context, const ldb_slice_t* name,
                     old_score,
                     &slice_key1);
 
-  ldb_context_writebatch_delete(context,
-                                ldb_slice_data(slice_key1),
-                                ldb_slice_size(slice_key1));
+  ldb_txn_delete(txn,
+                 ldb_slice_data(slice_key1),
+                 ldb_slice_size(slice_key1));
   
   encode_zset_key(ldb_slice_data(name),
                   ldb_slice_size(name),
@@ -860,38 +1248,33 @@ static int zdel_one(ldb_context_t *context, const ldb_slice_t* name,
                   meta,
                   &slice_key0);
 
-  ldb_context_writebatch_delete(context,
-                                ldb_slice_data(slice_key0),
-                                ldb_slice_size(slice_key0)); 
+  ldb_txn_delete(txn,
+                 ldb_slice_data(slice_key0),
+                 ldb_slice_size(slice_key0));
+  ldb_slice_destroy(slice_key0);
+  ldb_slice_destroy(slice_key1);
+
+  if(zrank_index_update(context, txn, name, &old_score, NULL) < 0){
+    return -1;
+  }
   return 1;
 }
 
-static int zset_incr_size(ldb_context_t *context, 
-                          const ldb_slice_t* name, int64_t by){
-  uint64_t length = 0;
-  zset_size(context, name, &length);
-  int64_t size = (int64_t)length;
-  size += by;
-  ldb_slice_t *slice_key = NULL;
-
-  encode_zsize_key(ldb_slice_data(name),
-                   ldb_slice_size(name),
-                   &slice_key);
-  if(size <= 0){
-    ldb_context_writebatch_delete(context,
-                                  ldb_slice_data(slice_key),
-                                  ldb_slice_size(slice_key));
-  }else{
-    char buff[sizeof(uint64_t)] = {0};
-    length = size;
-    leveldb_encode_fixed64(buff, length);
-    ldb_context_writebatch_put(context,
-                               ldb_slice_data(slice_key),
-                               ldb_slice_size(slice_key),
-                               buff,
-                               sizeof(uint64_t));
-  } 
+static int zset_incr_size(ldb_txn_t* txn, const ldb_slice_t* name, int64_t by){
+  //a merge operand, so that writers do not have to read the size first,
+  //dropped by compactions once the size is back to 0
+  ldb_meta_t *meta = ldb_meta_create(LDB_VERSION_CARE_DIRCT, 0, 0);
+  ldb_slice_t *slice_key = ldb_slice_create(LDB_DATA_TYPE_ZSIZE, strlen(LDB_DATA_TYPE_ZSIZE));
+  ldb_slice_push_back(slice_key, ldb_slice_data(name), ldb_slice_size(name));
+  ldb_txn_merge(txn,
+                meta,
+                ldb_slice_data(slice_key),
+                ldb_slice_size(slice_key),
+                by,
+                0,
+                1);
   ldb_slice_destroy(slice_key);
+  ldb_meta_destroy(meta);
   return 0;
 }
 
@@ -954,6 +1337,9 @@ static int zrange(ldb_context_t* context, const ldb_slice_t* name,
   uint64_t start, end = 0;
   start = LDB_SCORE_MIN;
   end = LDB_SCORE_MAX;
+  if(zrank_index_range(context, name, offset, limit, reverse, piterator) == 0){
+    return 0;
+  }
   if((offset + limit)> limit){
     limit = offset + limit;
   }
@@ -986,3 +1372,549 @@ static int zscan(ldb_context_t* context, const ldb_slice_t* name,
   }
   return 0; 
 }
+
+//rank index
+//
+//the index is a radix tree over the flipped scores with a byte per level:
+//the counter of level l and prefix p holds the number of members whose
+//score starts with the l bytes of p. the rank of a member sums, on each
+//level, the counters of the prefixes sorting before its own under the same
+//parent, plus the members sharing its score and sorting before it. the
+//level 0 counter holds the zset size and tells whether the index exists.
+
+static int zrank_read(ldb_context_t* context, const ldb_slice_t* slice_key, uint64_t* count){
+  char *val, *errptr = NULL;
+  size_t vallen = 0;
+  val = leveldb_get(context->database_, context->readoptions_, ldb_slice_data(slice_key), ldb_slice_size(slice_key), &vallen, &errptr);
+  int retval = LDB_OK;
+  if(errptr != NULL){
+    fprintf(stderr, "leveldb_get fail %s.\n", errptr);
+    leveldb_free(errptr);
+    retval = LDB_ERR;
+    goto end;
+  }
+  if(val != NULL){
+    assert(vallen >= (sizeof(uint64_t) + LDB_VAL_META_SIZE));
+    uint8_t type = leveldb_decode_fixed8(val);
+    if(type & LDB_VALUE_TYPE_VAL){
+      *count = leveldb_decode_fixed64(val + LDB_VAL_META_SIZE);
+      retval = LDB_OK;
+    }else{
+      retval = LDB_OK_NOT_EXIST;
+    }
+  }else{
+    retval = LDB_OK_NOT_EXIST;
+  }
+end:
+  if(val != NULL){
+    leveldb_free(val);
+  }
+  return retval;
+}
+
+static void zrank_write(ldb_txn_t* txn, const ldb_slice_t* slice_key, uint64_t count){
+  char buff[sizeof(uint64_t)] = {0};
+  leveldb_encode_fixed64(buff, count);
+  ldb_txn_put(txn,
+              ldb_slice_data(slice_key),
+              ldb_slice_size(slice_key),
+              buff,
+              sizeof(uint64_t));
+}
+
+static int zrank_add(ldb_context_t* context, ldb_txn_t* txn, const ldb_slice_t* name,
+                     int level, uint64_t uscore, int64_t by){
+  ldb_slice_t *slice_key = NULL;
+  encode_zrank_key(ldb_slice_data(name), ldb_slice_size(name), level, uscore, &slice_key);
+  uint64_t count = 0;
+  int retval = zrank_read(context, slice_key, &count);
+  if(retval == LDB_ERR){
+    retval = -1;
+    goto end;
+  }
+  if((int64_t)count + by <= 0){
+    ldb_txn_delete(txn,
+                   ldb_slice_data(slice_key),
+                   ldb_slice_size(slice_key));
+  }else{
+    zrank_write(txn, slice_key, count + by);
+  }
+  retval = 0;
+end:
+  ldb_slice_destroy(slice_key);
+  return retval;
+}
+
+//position of name in context->zrank_names_, or where it would go
+static size_t zrank_names_find(ldb_context_t* context, const char* name, size_t namelen, int* found){
+  size_t lo = 0, hi = context->zrank_num_;
+  *found = 0;
+  while(lo < hi){
+    size_t mid = lo + (hi - lo) / 2;
+    int cmp = compare_with_length(ldb_slice_data(context->zrank_names_[mid]),
+                                  ldb_slice_size(context->zrank_names_[mid]),
+                                  name, namelen);
+    if(cmp == 0){
+      *found = 1;
+      return mid;
+    }
+    if(cmp < 0){
+      lo = mid + 1;
+    }else{
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
+//requires the zrank_lock_ of context held for writing
+static void zrank_names_insert(ldb_context_t* context, const char* name, size_t namelen){
+  int found = 0;
+  size_t pos = zrank_names_find(context, name, namelen, &found);
+  if(found){
+    return;
+  }
+  if(context->zrank_num_ == context->zrank_cap_){
+    context->zrank_cap_ = (context->zrank_cap_ == 0) ? 16 : context->zrank_cap_ * 2;
+    context->zrank_names_ = (ldb_slice_t**)lrealloc(context->zrank_names_, sizeof(ldb_slice_t*) * context->zrank_cap_);
+  }
+  memmove(context->zrank_names_ + pos + 1,
+          context->zrank_names_ + pos,
+          sizeof(ldb_slice_t*) * (context->zrank_num_ - pos));
+  context->zrank_names_[pos] = ldb_slice_create(name, namelen);
+  ++context->zrank_num_;
+}
+
+//one seek per zset with rank counters, the other levels of a zset are
+//skipped. requires the zrank_lock_ of context held for writing
+static void zrank_names_load(ldb_context_t* context){
+  uint64_t sequence = 0;
+  char seekbuf[3 + LDB_DATA_TYPE_KEY_LEN_MAX];
+  leveldb_iterator_t* iterator = ldb_context_iterator_acquire(context, &sequence);
+  leveldb_iter_seek(iterator, LDB_DATA_TYPE_ZRANK, strlen(LDB_DATA_TYPE_ZRANK));
+  while(leveldb_iter_valid(iterator)){
+    size_t klen = 0, vlen = 0;
+    const char* key = leveldb_iter_key(iterator, &klen);
+    if(klen < 3 || key[0] != LDB_DATA_TYPE_ZRANK[0]){
+      break;
+    }
+    size_t namelen = (uint8_t)key[1];
+    if(klen < 3 + namelen){
+      break;
+    }
+    const char* val = leveldb_iter_value(iterator, &vlen);
+    uint8_t type = (vlen > 0) ? leveldb_decode_fixed8(val) : 0;
+    if(key[2 + namelen] == 0 && (type & LDB_VALUE_TYPE_VAL) && !(type & LDB_VALUE_TYPE_LAT)){
+      zrank_names_insert(context, key + 2, namelen);
+    }
+    memcpy(seekbuf, key, 2 + namelen);
+    seekbuf[2 + namelen] = (char)(LDB_DATA_TYPE_ZRANK_LEVELS + 1);
+    leveldb_iter_seek(iterator, seekbuf, 3 + namelen);
+  }
+  ldb_context_iterator_release(context, iterator, sequence);
+  context->zrank_loaded_ = 1;
+}
+
+//answered from memory, so that writes to a zset without a rank index do
+//not read anything for it. an index is never dropped, the level 0 counter
+//outlives an empty zset
+static int zrank_index_exists(ldb_context_t* context, const ldb_slice_t* name){
+  int found = 0;
+  pthread_rwlock_rdlock(&context->zrank_lock_);
+  if(!context->zrank_loaded_){
+    pthread_rwlock_unlock(&context->zrank_lock_);
+    pthread_rwlock_wrlock(&context->zrank_lock_);
+    if(!context->zrank_loaded_){
+      zrank_names_load(context);
+    }
+  }
+  zrank_names_find(context, ldb_slice_data(name), ldb_slice_size(name), &found);
+  pthread_rwlock_unlock(&context->zrank_lock_);
+  return found ? LDB_OK : LDB_OK_NOT_EXIST;
+}
+
+static void zrank_index_register(ldb_context_t* context, const ldb_slice_t* name){
+  pthread_rwlock_wrlock(&context->zrank_lock_);
+  zrank_names_insert(context, ldb_slice_data(name), ldb_slice_size(name));
+  pthread_rwlock_unlock(&context->zrank_lock_);
+}
+
+typedef struct zrank_delta_t{
+  uint64_t prefix_;
+  int level_;
+  int64_t by_;
+} zrank_delta_t;
+
+static int zrank_delta_cmp(const void* a, const void* b){
+  const zrank_delta_t *da = (const zrank_delta_t*)a, *db = (const zrank_delta_t*)b;
+  if(da->level_ != db->level_){
+    return da->level_ < db->level_ ? -1 : 1;
+  }
+  if(da->prefix_ != db->prefix_){
+    return da->prefix_ < db->prefix_ ? -1 : 1;
+  }
+  return 0;
+}
+
+//applies the moves of members from their old to their new scores, a
+//missing old or new score for an added or removed member. deltas hitting
+//the same counter are merged so that each counter is read and written once.
+//does nothing if the zset has no rank index.
+static int zrank_index_move(ldb_context_t* context, ldb_txn_t* txn, const ldb_slice_t* name,
+                            const zrank_move_t* moves, size_t count){
+  if(zrank_index_exists(context, name) != LDB_OK){
+    return 0;
+  }
+  int retval = 0;
+  uint64_t total = 0;
+  zrank_delta_t *deltas = NULL;
+  ldb_slice_t *slice_key = NULL;
+  encode_zrank_key(ldb_slice_data(name), ldb_slice_size(name), 0, 0, &slice_key);
+  retval = zrank_read(context, slice_key, &total);
+  if(retval == LDB_OK_NOT_EXIST){
+    retval = 0;
+    goto end;
+  }
+  if(retval != LDB_OK){
+    retval = -1;
+    goto end;
+  }
+  deltas = (zrank_delta_t*)lmalloc(sizeof(zrank_delta_t) * 2 * LDB_DATA_TYPE_ZRANK_LEVELS * (count + 1));
+  size_t ndeltas = 0, i = 0;
+  int64_t by = 0;
+  for(i = 0; i < count; ++i){
+    const zrank_move_t *move = &moves[i];
+    if(!move->has_old_ && !move->has_new_){
+      continue;
+    }
+    if(!move->has_old_){
+      ++by;
+    }else if(!move->has_new_){
+      --by;
+    }
+    uint64_t uold = zrank_uscore(move->old_);
+    uint64_t unew = zrank_uscore(move->new_);
+    int level = 1;
+    for(; level <= LDB_DATA_TYPE_ZRANK_LEVELS; ++level){
+      if(move->has_old_ && move->has_new_ &&
+         zrank_prefix(uold, level) == zrank_prefix(unew, level)){
+        continue;
+      }
+      if(move->has_old_){
+        deltas[ndeltas].level_ = level;
+        deltas[ndeltas].prefix_ = zrank_prefix(uold, level);
+        deltas[ndeltas].by_ = -1;
+        ++ndeltas;
+      }
+      if(move->has_new_){
+        deltas[ndeltas].level_ = level;
+        deltas[ndeltas].prefix_ = zrank_prefix(unew, level);
+        deltas[ndeltas].by_ = 1;
+        ++ndeltas;
+      }
+    }
+  }
+  //the level 0 counter stays at zero so that the index outlives an empty zset
+  if(by != 0){
+    zrank_write(txn, slice_key, ((int64_t)total + by) > 0 ? total + by : 0);
+  }
+  qsort(deltas, ndeltas, sizeof(zrank_delta_t), zrank_delta_cmp);
+  for(i = 0; i < ndeltas;){
+    size_t j = i + 1;
+    by = deltas[i].by_;
+    while(j < ndeltas && zrank_delta_cmp(&deltas[i], &deltas[j]) == 0){
+      by += deltas[j].by_;
+      ++j;
+    }
+    if(by != 0 && zrank_add(context, txn, name, deltas[i].level_, deltas[i].prefix_, by) < 0){
+      retval = -1;
+      goto end;
+    }
+    i = j;
+  }
+  retval = 0;
+end:
+  lfree(deltas);
+  ldb_slice_destroy(slice_key);
+  return retval;
+}
+
+static int zrank_index_update(ldb_context_t* context, ldb_txn_t* txn, const ldb_slice_t* name,
+                              const int64_t* old_score, const int64_t* new_score){
+  zrank_move_t move = {0};
+  if(old_score != NULL){
+    move.has_old_ = 1;
+    move.old_ = *old_score;
+  }
+  if(new_score != NULL){
+    move.has_new_ = 1;
+    move.new_ = *new_score;
+  }
+  return zrank_index_move(context, txn, name, &move, 1);
+}
+
+static int zrank_index_rank(ldb_context_t* context, const ldb_slice_t* name,
+                            const ldb_slice_t* key, int64_t score, uint64_t* rank){
+  int retval = zrank_index_exists(context, name);
+  if(retval != LDB_OK){
+    return retval;
+  }
+  uint64_t uscore = zrank_uscore(score), before = 0, sequence = 0;
+  leveldb_iterator_t* iterator = ldb_context_iterator_acquire(context, &sequence);
+  ldb_zset_iterator_t* ziter = NULL;
+  int level = 1;
+  for(; level <= LDB_DATA_TYPE_ZRANK_LEVELS; ++level){
+    //siblings sort from the parent prefix followed by 0 up to our own prefix
+    ldb_slice_t *slice_start = NULL, *slice_limit = NULL;
+    encode_zrank_key(ldb_slice_data(name), ldb_slice_size(name), level, zrank_prefix(uscore, level - 1), &slice_start);
+    encode_zrank_key(ldb_slice_data(name), ldb_slice_size(name), level, uscore, &slice_limit);
+    leveldb_iter_seek(iterator, ldb_slice_data(slice_start) + LDB_KEY_META_SIZE, ldb_slice_size(slice_start) - LDB_KEY_META_SIZE);
+    while(leveldb_iter_valid(iterator)){
+      size_t klen = 0, vlen = 0;
+      const char* k = leveldb_iter_key(iterator, &klen);
+      if(compare_with_length(k, klen, ldb_slice_data(slice_limit) + LDB_KEY_META_SIZE, ldb_slice_size(slice_limit) - LDB_KEY_META_SIZE) >= 0){
+        break;
+      }
+      const char* v = leveldb_iter_value(iterator, &vlen);
+      assert(vlen >= (sizeof(uint64_t) + LDB_VAL_META_SIZE));
+      before += leveldb_decode_fixed64(v + LDB_VAL_META_SIZE);
+      leveldb_iter_next(iterator);
+    }
+    ldb_slice_destroy(slice_start);
+    ldb_slice_destroy(slice_limit);
+  }
+
+  //members sharing the score sort by key
+  ziter = ziterator(context, name, NULL, score, LDB_SCORE_MAX, INT32_MAX, FORWARD);
+  retval = LDB_ERR;
+  while(ldb_zset_iterator_valid(ziter)){
+    size_t raw_klen = 0, raw_vlen = 0;
+    const char* raw_key = ldb_zset_iterator_key_raw(ziter, &raw_klen);
+    const char* raw_val = ldb_zset_iterator_val_raw(ziter, &raw_vlen);
+    ldb_slice_t *slice_key = NULL;
+    int64_t s = 0;
+    if(decode_zscore_key(raw_key, raw_klen, NULL, &slice_key, &s) < 0 || s != score){
+      ldb_slice_destroy(slice_key);
+      break;
+    }
+    uint8_t type = leveldb_decode_fixed8(raw_val);
+    if((type & LDB_VALUE_TYPE_VAL) && !(type & LDB_VALUE_TYPE_LAT)){
+      if(compare_with_length(ldb_slice_data(key), ldb_slice_size(key),
+                             ldb_slice_data(slice_key), ldb_slice_size(slice_key)) == 0){
+        ldb_slice_destroy(slice_key);
+        *rank = before;
+        retval = LDB_OK;
+        break;
+      }
+      ++before;
+    }
+    ldb_slice_destroy(slice_key);
+    if(ldb_zset_iterator_next(ziter)){
+      break;
+    }
+  }
+  if(retval != LDB_OK){
+    fprintf(stderr, "%s rank index of %.*s does not hold the member.\n", __func__,
+            (int)ldb_slice_size(name), ldb_slice_data(name));
+  }
+
+  ldb_zset_iterator_destroy(ziter);
+  ldb_context_iterator_release(context, iterator, sequence);
+  return retval;
+}
+
+//finds the score of the member of the given rank and how many members with
+//that score come before it, ties holds the number of members with the score
+static int zrank_index_select(ldb_context_t* context, const ldb_slice_t* name, uint64_t rank,
+                              int64_t* score, uint64_t* before, uint64_t* ties){
+  int retval = 0;
+  uint64_t uscore = 0, count = 0, sequence = 0;
+  leveldb_iterator_t* iterator = ldb_context_iterator_acquire(context, &sequence);
+  int level = 1;
+  for(; level <= LDB_DATA_TYPE_ZRANK_LEVELS; ++level){
+    ldb_slice_t *slice_start = NULL;
+    encode_zrank_key(ldb_slice_data(name), ldb_slice_size(name), level, uscore, &slice_start);
+    //keys of the siblings only differ in their last byte
+    const char* sibling = ldb_slice_data(slice_start) + LDB_KEY_META_SIZE;
+    size_t sibling_len = ldb_slice_size(slice_start) - LDB_KEY_META_SIZE - 1;
+    leveldb_iter_seek(iterator, sibling, sibling_len + 1);
+    int found = 0;
+    while(leveldb_iter_valid(iterator)){
+      size_t klen = 0, vlen = 0;
+      const char* k = leveldb_iter_key(iterator, &klen);
+      if(klen != sibling_len + 1 || memcmp(k, sibling, sibling_len) != 0){
+        break;
+      }
+      const char* v = leveldb_iter_value(iterator, &vlen);
+      assert(vlen >= (sizeof(uint64_t) + LDB_VAL_META_SIZE));
+      count = leveldb_decode_fixed64(v + LDB_VAL_META_SIZE);
+      if(rank < count){
+        uscore |= ((uint64_t)(uint8_t)k[sibling_len]) << (8 * (LDB_DATA_TYPE_ZRANK_LEVELS - level));
+        found = 1;
+        break;
+      }
+      rank -= count;
+      leveldb_iter_next(iterator);
+    }
+    ldb_slice_destroy(slice_start);
+    if(!found){
+      retval = -1;
+      goto end;
+    }
+  }
+  *score = zrank_score(uscore);
+  *before = rank;
+  *ties = count;
+  retval = 0;
+end:
+  ldb_context_iterator_release(context, iterator, sequence);
+  return retval;
+}
+
+//positions the iterator on the member at offset, like zrange() does after
+//skipping offset members from the first or the last one. returns -1 if the
+//zset has no rank index.
+static int zrank_index_range(ldb_context_t* context, const ldb_slice_t* name,
+                             uint64_t offset, uint64_t limit, int reverse, ldb_zset_iterator_t **piterator){
+  uint64_t size = 0;
+  if(zrank_index_exists(context, name) != LDB_OK ||
+     zset_size(context, name, &size) != LDB_OK || offset >= size){
+    return -1;
+  }
+  int64_t score = 0;
+  uint64_t before = 0, ties = 0, skip = 0;
+  if(zrank_index_select(context, name, reverse ? size - 1 - offset : offset, &score, &before, &ties) < 0){
+    fprintf(stderr, "%s rank index of %.*s is short of rank %lu.\n", __func__,
+            (int)ldb_slice_size(name), ldb_slice_data(name), (unsigned long)offset);
+    return -1;
+  }
+  //the iterator budget matches zrange(), a removed member sitting where the
+  //seek lands takes one more step
+  int removed = 0;
+  while(1){
+    if(reverse == 0){
+      skip = before + removed;
+      *piterator = ziterator(context, name, NULL, score, LDB_SCORE_MAX, skip + limit, FORWARD);
+    }else{
+      skip = ties - 1 - before + removed;
+      *piterator = ziterator(context, name, NULL, score, LDB_SCORE_MIN, skip + limit, BACKWARD);
+    }
+    if(removed || !ldb_zset_iterator_valid(*piterator)){
+      break;
+    }
+    size_t raw_vlen = 0;
+    const char* raw_val = ldb_zset_iterator_val_raw(*piterator, &raw_vlen);
+    uint8_t type = leveldb_decode_fixed8(raw_val);
+    if((type & LDB_VALUE_TYPE_VAL) && !(type & LDB_VALUE_TYPE_LAT)){
+      break;
+    }
+    ldb_zset_iterator_destroy(*piterator);
+    removed = 1;
+  }
+  if(ldb_zset_iterator_skip(*piterator, skip) < 0){
+    ldb_zset_iterator_destroy(*piterator);
+    *piterator = NULL;
+    return -1;
+  }
+  return 0;
+}
+
+static int zrank_index_build(ldb_context_t* context, const ldb_slice_t* name){
+  int retval = zrank_index_exists(context, name);
+  if(retval == LDB_OK){
+    return LDB_OK_BUT_ALREADY_EXIST;
+  }
+  if(retval != LDB_OK_NOT_EXIST){
+    return retval;
+  }
+
+  //members come sorted by score, so a counter is complete as soon as its
+  //prefix changes
+  uint64_t prefixes[LDB_DATA_TYPE_ZRANK_LEVELS + 1] = {0};
+  uint64_t counts[LDB_DATA_TYPE_ZRANK_LEVELS + 1] = {0};
+  uint64_t total = 0;
+  size_t pending = 0;
+  char* errptr = NULL;
+  ldb_txn_t *txn = ldb_txn_create();
+  ldb_zset_iterator_t* ziter = ziterator(context, name, NULL, LDB_SCORE_MIN, LDB_SCORE_MAX, UINT64_MAX, FORWARD);
+  int level = 0, more = ldb_zset_iterator_valid(ziter);
+  while(1){
+    uint64_t uscore = 0;
+    if(more){
+      size_t raw_klen = 0, raw_vlen = 0;
+      const char* raw_key = ldb_zset_iterator_key_raw(ziter, &raw_klen);
+      const char* raw_val = ldb_zset_iterator_val_raw(ziter, &raw_vlen);
+      ldb_slice_t *slice_name = NULL;
+      int64_t score = 0;
+      if(decode_zscore_key(raw_key, raw_klen, &slice_name, NULL, &score) < 0){
+        more = 0;
+      }else if(compare_with_length(ldb_slice_data(slice_name), ldb_slice_size(slice_name),
+                                   ldb_slice_data(name), ldb_slice_size(name)) != 0){
+        more = 0;
+      }
+      ldb_slice_destroy(slice_name);
+      uint8_t type = leveldb_decode_fixed8(raw_val);
+      if(more && (!(type & LDB_VALUE_TYPE_VAL) || (type & LDB_VALUE_TYPE_LAT))){
+        more = (ldb_zset_iterator_next(ziter) == 0);
+        continue;
+      }
+      uscore = zrank_uscore(score);
+    }
+    for(level = 1; level <= LDB_DATA_TYPE_ZRANK_LEVELS; ++level){
+      if(counts[level] > 0 && (!more || zrank_prefix(uscore, level) != prefixes[level])){
+        ldb_slice_t *slice_key = NULL;
+        encode_zrank_key(ldb_slice_data(name), ldb_slice_size(name), level, prefixes[level], &slice_key);
+        zrank_write(txn, slice_key, counts[level]);
+        ldb_slice_destroy(slice_key);
+        counts[level] = 0;
+        ++pending;
+      }
+      if(more){
+        prefixes[level] = zrank_prefix(uscore, level);
+        counts[level] += 1;
+      }
+    }
+    if(!more){
+      break;
+    }
+    ++total;
+    if(pending >= 10000){
+      ldb_txn_commit(context, txn, &errptr);
+      if(errptr != NULL){
+        goto err;
+      }
+      pending = 0;
+    }
+    more = (ldb_zset_iterator_next(ziter) == 0);
+  }
+
+  //the level 0 counter enables the index, write it last
+  ldb_slice_t *slice_key = NULL;
+  encode_zrank_key(ldb_slice_data(name), ldb_slice_size(name), 0, 0, &slice_key);
+  zrank_write(txn, slice_key, total);
+  ldb_slice_destroy(slice_key);
+  ldb_txn_commit(context, txn, &errptr);
+  if(errptr != NULL){
+    goto err;
+  }
+  zrank_index_register(context, name);
+  retval = LDB_OK;
+  goto end;
+
+err:
+  fprintf(stderr, "leveldb write fail %s.\n", errptr);
+  leveldb_free(errptr);
+  retval = LDB_ERR;
+
+end:
+  ldb_zset_iterator_destroy(ziter);
+  ldb_txn_destroy(txn);
+  return retval;
+}
+
+int zset_rank_index_build(ldb_context_t* context, const ldb_slice_t* name){
+  ldb_context_lock_key(context, ldb_slice_data(name), ldb_slice_size(name));
+  int retval = zrank_index_build(context, name);
+  ldb_context_unlock_key(context, ldb_slice_data(name), ldb_slice_size(name));
+  return retval;
+}
@@ -14,11 +14,19 @@ void encode_zsize_key(const char* name, size_t namelen, ldb_slice_t** pslice);
 int decode_zsize_key(const char* ldbkey, size_t ldbkeylen, ldb_slice_t** pslice);
 
 void encode_zset_key(const char* name, size_t namelen, const char* key, size_t keylen, const ldb_meta_t* meta, ldb_slice_t** pslice);
+//the key without the meta prefix into buf, returns its size, nothing is
+//written if that is more than buflen
+size_t encode_zset_key_raw(char* buf, size_t buflen, const char* name, size_t namelen, const char* key, size_t keylen);
 int decode_zset_key(const char* ldbkey, size_t ldbkeylen, ldb_slice_t** pslice_name, ldb_slice_t** pslice_key);
 
 void encode_zscore_key(const char* name, size_t namelen, const char* key, size_t keylen, const ldb_meta_t* meta, int64_t score, ldb_slice_t** pslice);
+size_t encode_zscore_key_raw(char* buf, size_t buflen, const char* name, size_t namelen, const char* key, size_t keylen, int64_t score);
 int decode_zscore_key(const char* ldbkey, size_t ldbkeylen, ldb_slice_t** pslice_name, ldb_slice_t** pslice_key,  int64_t *pscore);
 
+//count of the members whose score, flipped to sort unsigned, starts with the
+//first level bytes of uscore, level 0 counts every member
+void encode_zrank_key(const char* name, size_t namelen, int level, uint64_t uscore, ldb_slice_t** pslice);
+
 
 int zset_add(ldb_context_t* context, const ldb_slice_t* name, 
         const ldb_slice_t* key, const ldb_meta_t* meta, int64_t score); 
@@ -26,6 +34,15 @@ int zset_add(ldb_context_t* context, const ldb_slice_t* name,
 int zset_del(ldb_context_t* context, const ldb_slice_t* name, 
         const ldb_slice_t* key, const ldb_meta_t* meta);
 
+//keylist holds the members with their scores in the node values, metalist
+//one meta per member, plist gets one return value per member. the members
+//are written in a single batch.
+int zset_madd(ldb_context_t* context, const ldb_slice_t* name,
+        const ldb_list_t* keylist, const ldb_list_t* metalist, ldb_list_t** plist);
+
+int zset_mdel(ldb_context_t* context, const ldb_slice_t* name,
+        const ldb_list_t* keylist, const ldb_list_t* metalist, ldb_list_t** plist);
+
 int zset_del_range_by_rank(ldb_context_t* context, const ldb_slice_t* name,
         const ldb_meta_t* meta, int rank_start, int rank_end, uint64_t *deleted);
 
@@ -53,5 +70,10 @@ int zset_range(ldb_context_t* context, const ldb_slice_t* name,
 int zset_scan(ldb_context_t* context, const ldb_slice_t* name,
         int64_t score_start, int64_t score_end, int reverse, ldb_list_t **pkeylist, ldb_list_t **pmetalist);
 
+//builds the rank index of the zset, from then on zset writes maintain it and
+//rank lookups descend it instead of walking the members, must not run
+//concurrently with writes to the same zset
+int zset_rank_index_build(ldb_context_t* context, const ldb_slice_t* name);
+
 #endif //LDB_T_ZSET_H
 
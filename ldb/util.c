@@ -4,6 +4,7 @@
 #include <sys/time.h>
 #include <string.h>
 #include <stdio.h>
+#include <stdint.h>
 
 
 
@@ -23,6 +24,25 @@ uint64_t time_ms(){
     return now.tv_sec*1000 + now.tv_usec/1000;
 }
 
+static __thread uint64_t random_state = 0;
+
+uint64_t random_u64(){
+    uint64_t x = random_state;
+    if(x == 0){
+        struct timeval now;
+        gettimeofday(&now, NULL);
+        x = ((uint64_t)now.tv_sec << 20) ^ (uint64_t)now.tv_usec ^ (uint64_t)(uintptr_t)&random_state;
+        if(x == 0){
+            x = 0x9e3779b97f4a7c15ull;
+        }
+    }
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    random_state = x;
+    return x * 0x2545f4914f6cdd1dull;
+}
+
 void printbuf(const char *buf, size_t length){
     uint8_t c;
     size_t i=0;
@@ -10,6 +10,9 @@ int compare_with_length(const void* s1, size_t l1, const void* s2, size_t l2);
 
 uint64_t time_ms();
 
+//xorshift64* with a per thread state seeded on first use, not for crypto
+uint64_t random_u64();
+
 void printbuf(const char* buf, size_t length);
 
 
@@ -7,6 +7,7 @@
 #include <string.h>
 #include <stdio.h>
 #include <stdint.h>
+#include <unistd.h>
 
 static void test_hash(ldb_context_t* context){
     const char *hash_name1 = "hash_name";
@@ -256,13 +257,94 @@ static void test_hash(ldb_context_t* context){
 
 
 
+static void test_hscan(ldb_context_t* context){
+    const char *name = "hash_scan";
+    ldb_slice_t *slice_name = ldb_slice_create(name, strlen(name));
+    uint64_t nextver = time_ms();
+    char field[32], value[32];
+    const int count = 100;
+    for(int i=0; i<count; ++i){
+        snprintf(field, sizeof(field), "field_%03d", i);
+        snprintf(value, sizeof(value), "value_%d", i);
+        ldb_slice_t *slice_key = ldb_slice_create(field, strlen(field));
+        ldb_slice_t *slice_val = ldb_slice_create(value, strlen(value));
+        ldb_meta_t *meta = ldb_meta_create(0, 0, nextver);
+        assert(hash_set(context, slice_name, slice_key, slice_val, meta) == LDB_OK);
+        ldb_slice_destroy(slice_key);
+        ldb_slice_destroy(slice_val);
+        ldb_meta_destroy(meta);
+    }
+
+    value_item_t items[7], values[7];
+    char buf[96];
+    ldb_scan_page_t page;
+    memset(&page, 0, sizeof(page));
+    page.count_ = 7;
+    page.items_ = items;
+    page.values_ = values;
+    page.buf_ = buf;
+    page.buflen_ = sizeof(buf);
+
+    char cursor[LDB_SCAN_CURSOR_MAX];
+    size_t cursorlen = 0;
+    int seen = 0, pages = 0;
+    do{
+        assert(ldb_hscan(context, (char*)name, strlen(name), cursor, cursorlen, &page) == LDB_OK);
+        assert(page.itemnum_ > 0 && page.itemnum_ <= page.count_);
+        for(size_t i=0; i<page.itemnum_; ++i){
+            snprintf(field, sizeof(field), "field_%03d", seen);
+            snprintf(value, sizeof(value), "value_%d", seen);
+            assert(compare_with_length(items[i].data_, items[i].data_len_, field, strlen(field)) == 0);
+            assert(compare_with_length(values[i].data_, values[i].data_len_, value, strlen(value)) == 0);
+            assert(values[i].version_ == nextver);
+            ++seen;
+        }
+        memcpy(cursor, page.next_, page.nextlen_);
+        cursorlen = page.nextlen_;
+        ++pages;
+    }while(cursorlen > 0);
+    assert(seen == count);
+    //96 bytes hold 5 fields with their values, the buffer ends the pages
+    assert(pages > (count + 6) / 7);
+
+    //not even one field fits
+    page.buflen_ = 4;
+    assert(ldb_hscan(context, (char*)name, strlen(name), NULL, 0, &page) == LDB_ERR);
+    //a cursor of another hash
+    page.buflen_ = sizeof(buf);
+    assert(ldb_hscan(context, "other", 5, cursor, 3, &page) == LDB_ERR);
+    //nothing to scan
+    assert(ldb_hscan(context, "other", 5, NULL, 0, &page) == LDB_OK);
+    assert(page.itemnum_ == 0 && page.nextlen_ == 0);
+
+    //scans keep their iterators around, a write must not be missed by them
+    assert(context->iterator_num_ > 0);
+    assert(ldb_hscan(context, (char*)name, strlen(name), NULL, 0, &page) == LDB_OK);
+    assert(compare_with_length(values[0].data_, values[0].data_len_, "value_0", 7) == 0);
+    ldb_slice_t *slice_key = ldb_slice_create("field_000", 9);
+    ldb_slice_t *slice_val = ldb_slice_create("changed", 7);
+    ldb_meta_t *meta = ldb_meta_create(0, 0, nextver + 1);
+    assert(hash_set(context, slice_name, slice_key, slice_val, meta) == LDB_OK);
+    ldb_slice_destroy(slice_key);
+    ldb_slice_destroy(slice_val);
+    ldb_meta_destroy(meta);
+    assert(ldb_hscan(context, (char*)name, strlen(name), NULL, 0, &page) == LDB_OK);
+    assert(compare_with_length(values[0].data_, values[0].data_len_, "changed", 7) == 0);
+    assert(values[0].version_ == nextver + 1);
+
+    ldb_slice_destroy(slice_name);
+}
+
 int main(int argc, char* argv[]){
-    ldb_context_t *context = ldb_context_create("/tmp/testhash", 128, 64, 1);
+    ldb_context_t *context = ldb_context_create("/tmp/testhash", 128, 64, 1, LDB_CACHE_CLOCK);
     assert(context != NULL);
     ldb_recovery_t *recovery = NULL;
-    ldb_recover_meta(context, &recovery);
+    while(ldb_recover_meta(context, &recovery) == 0){
+        usleep(2000);
+    }
 
     test_hash(context);
+    test_hscan(context);
 
 
 
@@ -60,11 +60,14 @@ static void test_set(ldb_context_t* context){
         printf("set_members result key=%s\n", ldb_slice_data(node_key->data_));  
     }
 
-    ldb_slice_t *slice_key6 = NULL;
+    ldb_list_t *keylist6 = NULL;
     uint64_t nextver6 = nextver4 + 100000;
     ldb_meta_t *meta6 = ldb_meta_create(0, 0, nextver6);
-    assert(set_pop(context, slice_name1, meta6, &slice_key6) == LDB_OK);
+    assert(set_pop(context, slice_name1, meta6, 1, &keylist6) == LDB_OK);
+    assert(keylist6->length_ == 1);
+    ldb_slice_t *slice_key6 = keylist6->head_->data_;
     printf("set_pop result key=%s\n", ldb_slice_data(slice_key6));
+    assert(set_ismember(context, slice_name1, slice_key6) == LDB_OK_NOT_EXIST);
 
 
     ldb_list_t *keylist7 = NULL, *metalist7 = NULL;
@@ -82,12 +85,101 @@ static void test_set(ldb_context_t* context){
 
 
 
+static void check_members(ldb_context_t* context, const ldb_slice_t* name, const ldb_list_t* keylist, int distinct){
+    ldb_list_node_t *node = keylist->head_;
+    while(node != NULL){
+        assert(set_ismember(context, name, node->data_) == LDB_OK);
+        if(distinct){
+            ldb_list_node_t *other = node->next_;
+            while(other != NULL){
+                assert(compare_with_length(ldb_slice_data(node->data_), ldb_slice_size(node->data_),
+                                           ldb_slice_data(other->data_), ldb_slice_size(other->data_)) != 0);
+                other = other->next_;
+            }
+        }
+        node = node->next_;
+    }
+}
+
+static void test_set_random(ldb_context_t* context){
+    ldb_slice_t *name = ldb_slice_create("set_random", strlen("set_random"));
+    uint64_t nextver = time_ms();
+    char buf[32];
+    const int count = LDB_SET_SAMPLE_SCAN_MAX * 2;
+    for(int i=0; i<count; ++i){
+        snprintf(buf, sizeof(buf), "member_%d", i);
+        ldb_slice_t *key = ldb_slice_create(buf, strlen(buf));
+        ldb_meta_t *meta = ldb_meta_create(0, 0, nextver);
+        assert(set_add(context, name, key, meta) == LDB_OK);
+        ldb_slice_destroy(key);
+        ldb_meta_destroy(meta);
+    }
+
+    //distinct members by random seeks, repeats allowed with a negative count
+    ldb_list_t *keylist = NULL, *metalist = NULL;
+    assert(set_random_members(context, name, 20, &keylist, &metalist) == LDB_OK);
+    assert(keylist->length_ == 20 && metalist->length_ == 20);
+    assert(metalist->head_->value_ == nextver);
+    check_members(context, name, keylist, 1);
+    ldb_list_destroy(keylist);
+    ldb_list_destroy(metalist);
+    assert(set_random_members(context, name, -20, &keylist, NULL) == LDB_OK);
+    assert(keylist->length_ == 20);
+    check_members(context, name, keylist, 0);
+    ldb_list_destroy(keylist);
+
+    //one pass for a large share of the set
+    assert(set_random_members(context, name, count - 1, &keylist, NULL) == LDB_OK);
+    assert(keylist->length_ == (size_t)(count - 1));
+    check_members(context, name, keylist, 1);
+    ldb_list_destroy(keylist);
+    assert(set_random_members(context, name, -(count * 2), &keylist, NULL) == LDB_OK);
+    assert(keylist->length_ == (size_t)(count * 2));
+    ldb_list_destroy(keylist);
+
+    ldb_meta_t *meta = ldb_meta_create(0, 0, nextver + 1);
+    assert(set_pop(context, name, meta, 10, &keylist) == LDB_OK);
+    assert(keylist->length_ == 10);
+    ldb_list_node_t *node = keylist->head_;
+    while(node != NULL){
+        assert(set_ismember(context, name, node->data_) == LDB_OK_NOT_EXIST);
+        node = node->next_;
+    }
+    ldb_list_destroy(keylist);
+    uint64_t length = 0;
+    assert(set_card(context, name, &length) == LDB_OK);
+    assert(length == (uint64_t)(count - 10));
+
+    //more than the set holds gives the whole set
+    assert(set_pop(context, name, meta, count, &keylist) == LDB_OK);
+    assert(keylist->length_ == (size_t)(count - 10));
+    ldb_list_destroy(keylist);
+    assert(set_card(context, name, &length) == LDB_OK_NOT_EXIST);
+    assert(set_random_members(context, name, 1, &keylist, NULL) == LDB_OK_NOT_EXIST);
+    ldb_meta_destroy(meta);
+
+    //the size counter is left at 0 and counts on from there
+    ldb_slice_t *again = ldb_slice_create("again", strlen("again"));
+    meta = ldb_meta_create(0, 0, nextver + 2);
+    assert(set_add(context, name, again, meta) == LDB_OK);
+    assert(set_card(context, name, &length) == LDB_OK);
+    assert(length == 1);
+    ldb_meta_destroy(meta);
+    meta = ldb_meta_create(0, 0, nextver + 3);
+    assert(set_rem(context, name, again, meta) == LDB_OK);
+    assert(set_card(context, name, &length) == LDB_OK_NOT_EXIST);
+    ldb_meta_destroy(meta);
+    ldb_slice_destroy(again);
+    ldb_slice_destroy(name);
+}
+
 int main(int argc, char* argv[]){
-    ldb_context_t *context = ldb_context_create("/tmp/testset", 128, 64, 1);
+    ldb_context_t *context = ldb_context_create("/tmp/testset", 128, 64, 1, LDB_CACHE_LRU);
     assert(context != NULL);
     
 
     test_set(context);
+    test_set_random(context);
 
 
     ldb_context_destroy(context);  
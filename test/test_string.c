@@ -1,8 +1,12 @@
 #include "ldb/t_string.h"
 #include "ldb/ldb_define.h"
+#include "ldb/ldb_arena.h"
 #include "ldb/util.h"
+#include "ldb/ldb_async.h"
 
 #include <assert.h>
+#include <poll.h>
+#include <pthread.h>
 #include <string.h>
 #include <stdio.h>
 
@@ -29,12 +33,26 @@ static void test_string(ldb_context_t* context){
     ldb_slice_destroy(val1);
     ldb_meta_destroy(meta2);
 
+    const char* pdata = NULL;
+    size_t psize = 0;
+    uint64_t pversion = 0, pexptime = 0;
+    leveldb_pinned_t* pinned = NULL;
+    assert(string_get_pinned(context, key1, &pdata, &psize, &pversion, &pexptime, &pinned) == LDB_OK);
+    assert(compare_with_length(pdata, psize, cval, strlen(cval))==0);
+    assert(pversion == nextver1 && pexptime == 0);
+    leveldb_pinned_release(pinned);
+    assert(string_exists(context, key1) == LDB_OK);
+
     uint64_t nextver2 = nextver1 + 100000;
     ldb_meta_t *meta3 =  ldb_meta_create(0, 0, nextver2); 
     assert(string_del(context, key1, meta3) == LDB_OK);
 
     ldb_meta_t *meta4 = NULL;
     assert(string_get(context, key1, &val1, &meta4) == LDB_OK_NOT_EXIST);
+    pinned = NULL;
+    assert(string_get_pinned(context, key1, &pdata, &psize, &pversion, &pexptime, &pinned) == LDB_OK_NOT_EXIST);
+    assert(pinned == NULL);
+    assert(string_exists(context, key1) == LDB_OK_NOT_EXIST);
     ldb_meta_destroy(meta3);
 
     int64_t init = 100;
@@ -60,6 +78,20 @@ static void test_string(ldb_context_t* context){
 
     printf("string_incr result %ld\n", result);
 
+    //without a result only the operand is written, reads fold it in
+    nextver4 += 100;
+    ldb_meta_t *meta_blind = ldb_meta_create(0, 0, nextver4);
+    assert(string_incr(context, key1, meta_blind, 0, 6, NULL) == LDB_OK);
+    ldb_meta_destroy(meta_blind);
+    ldb_slice_t *slice_blind = NULL;
+    ldb_meta_t *meta_read = NULL;
+    assert(string_get(context, key1, &slice_blind, &meta_read) == LDB_OK);
+    assert(ldb_slice_size(slice_blind) == sizeof(int64_t));
+    assert(leveldb_decode_fixed64(ldb_slice_data(slice_blind)) == 120);
+    assert(ldb_meta_nextver(meta_read) == nextver4);
+    ldb_slice_destroy(slice_blind);
+    ldb_meta_destroy(meta_read);
+
 
     
     char *cval2 = "val2";
@@ -232,6 +264,40 @@ static void test_expire(ldb_context_t* context){
 
     assert(string_get(context, key1, &val1, &meta2)==LDB_OK); 
     assert(now = ldb_meta_nextver(meta2));
+    assert(string_exists(context, key1) == LDB_OK);
+    assert(compare_with_length(ldb_slice_data(val1), ldb_slice_size(val1), cval, strlen(cval))==0);
+    assert(ldb_meta_exptime(meta2) == exp+now);
+    ldb_slice_destroy(val1);
+
+    //the value stays, only the version and exptime change
+    ldb_meta_t *meta4 = NULL;
+    assert(string_get_meta(context, key1, &meta4) == LDB_OK);
+    assert(ldb_meta_nextver(meta4) == now && ldb_meta_exptime(meta4) == exp+now);
+    ldb_meta_destroy(meta4);
+    meta4 = ldb_meta_create_with_exp(0, 0, now+1, exp+now+1000);
+    assert(string_touch(context, key1, meta4) == LDB_OK);
+    ldb_meta_destroy(meta4);
+    assert(string_get(context, key1, &val1, &meta4) == LDB_OK);
+    assert(compare_with_length(ldb_slice_data(val1), ldb_slice_size(val1), cval, strlen(cval))==0);
+    assert(ldb_meta_nextver(meta4) == now+1 && ldb_meta_exptime(meta4) == exp+now+1000);
+    ldb_slice_destroy(val1);
+    ldb_meta_destroy(meta4);
+    //persist
+    meta4 = ldb_meta_create_with_exp(0, 0, now+2, 0);
+    assert(string_touch(context, key1, meta4) == LDB_OK);
+    ldb_meta_destroy(meta4);
+    assert(string_get(context, key1, &val1, &meta4) == LDB_OK);
+    assert(compare_with_length(ldb_slice_data(val1), ldb_slice_size(val1), cval, strlen(cval))==0);
+    assert(ldb_meta_nextver(meta4) == now+2 && ldb_meta_exptime(meta4) == 0);
+    ldb_meta_destroy(meta4);
+
+    //already expired
+    ldb_slice_t *key2 = ldb_slice_create("expkey3", 7);
+    ldb_meta_t *meta3 = ldb_meta_create_with_exp(0, 0, now, now - 1);
+    assert(string_set(context, key2, key2, meta3) == LDB_OK);
+    assert(string_exists(context, key2) == LDB_OK_NOT_EXIST);
+    ldb_slice_destroy(key2);
+    ldb_meta_destroy(meta3);
     printf("expire time %lu \n", ldb_meta_exptime(meta2));
 
     ldb_slice_destroy(val1);
@@ -239,13 +305,162 @@ static void test_expire(ldb_context_t* context){
     ldb_meta_destroy(meta2); 
 }
 
+static void test_arena(ldb_context_t* context){
+    ldb_arena_t *arena = ldb_arena_create(64);
+    char *a = ldb_arena_alloc(arena, 10);
+    memcpy(a, "0123456789", 10);
+    //the last allocation grows in place, others are copied
+    assert(ldb_arena_grow(arena, a, 10, 40) == a);
+    char *b = ldb_arena_alloc(arena, 8);
+    char *c = ldb_arena_grow(arena, a, 40, 48);
+    assert(c != a && c != b && memcmp(c, "0123456789", 10) == 0);
+    ldb_arena_alloc(arena, 1000);
+    assert(ldb_arena_usage(arena) > 1000);
+    ldb_arena_reset(arena);
+    assert(ldb_arena_usage(arena) == 64);
+    ldb_arena_destroy(arena);
+
+    assert(ldb_arena_current() == NULL);
+    arena = ldb_arena_enter(NULL);
+    assert(ldb_arena_current() == arena);
+    assert(ldb_arena_enter(NULL) == arena);
+    size_t usage = ldb_arena_usage(arena);
+    ldb_slice_t *slice = ldb_slice_create("abc", 3);
+    for(int i=0; i<2000; ++i){
+        ldb_slice_push_back(slice, "defgh", 5);
+    }
+    assert(ldb_slice_size(slice) == 10003);
+    assert(memcmp(ldb_slice_data(slice) + 9998, "defgh", 5) == 0);
+    assert(ldb_arena_usage(arena) > usage);
+    ldb_slice_destroy(slice);
+    ldb_arena_leave(arena);
+    //only the outermost leave resets
+    assert(ldb_arena_current() == arena);
+
+    //the whole command path with its temporaries in the arena
+    test_string(context);
+    ldb_arena_leave(arena);
+    assert(ldb_arena_current() == NULL);
+    assert(ldb_arena_usage(arena) == LDB_ARENA_BLOCK_SIZE);
+}
+
+#define INCR_THREADS 8
+#define INCR_TIMES   2000
+
+static void* incr_worker(void* arg){
+    ldb_context_t *context = (ldb_context_t*)arg;
+    ldb_slice_t *key = ldb_slice_create("incrkey", 7);
+    ldb_slice_t *nxkey = ldb_slice_create("nxkey", 5);
+    ldb_meta_t *meta = ldb_meta_create(0, 0, time_ms());
+    int64_t result = 0;
+    for(int i = 0; i < INCR_TIMES; ++i){
+        assert(string_incr(context, key, meta, 0, 1, &result) == LDB_OK);
+    }
+    int won = (string_setnx(context, nxkey, key, meta) == LDB_OK);
+    ldb_meta_destroy(meta);
+    ldb_slice_destroy(nxkey);
+    ldb_slice_destroy(key);
+    return (void*)(intptr_t)won;
+}
+
+static void test_concurrent(ldb_context_t* context){
+    //stripes come back sorted and without duplicates
+    uint32_t stripes[4] = {ldb_context_key_stripe("b", 1), ldb_context_key_stripe("a", 1),
+                           ldb_context_key_stripe("b", 1), ldb_context_key_stripe("a", 1)};
+    size_t num = ldb_context_lock_stripes(context, stripes, 4);
+    assert(num == 2 && stripes[0] < stripes[1]);
+    //recursive, a command may call another on the same key
+    ldb_context_lock_key(context, "a", 1);
+    ldb_context_unlock_key(context, "a", 1);
+    ldb_context_unlock_stripes(context, stripes, num);
+
+    //no increment is lost and exactly one setnx wins
+    ldb_slice_t *key = ldb_slice_create("incrkey", 7);
+    ldb_slice_t *nxkey = ldb_slice_create("nxkey", 5);
+    ldb_meta_t *meta = ldb_meta_create(0, 0, time_ms());
+    assert(string_del(context, key, meta) == LDB_OK);
+    assert(string_del(context, nxkey, meta) == LDB_OK);
+    ldb_meta_destroy(meta);
+    ldb_slice_destroy(nxkey);
+    pthread_t threads[INCR_THREADS];
+    for(int i = 0; i < INCR_THREADS; ++i){
+        assert(pthread_create(&threads[i], NULL, incr_worker, context) == 0);
+    }
+    int won = 0;
+    for(int i = 0; i < INCR_THREADS; ++i){
+        void* ret = NULL;
+        pthread_join(threads[i], &ret);
+        won += (int)(intptr_t)ret;
+    }
+    assert(won == 1);
+    ldb_slice_t *val = NULL;
+    meta = NULL;
+    assert(string_get(context, key, &val, &meta) == LDB_OK);
+    assert(leveldb_decode_fixed64(ldb_slice_data(val)) == INCR_THREADS * INCR_TIMES);
+    ldb_slice_destroy(val);
+    ldb_meta_destroy(meta);
+    ldb_slice_destroy(key);
+}
+
+#define ASYNC_WRITES 200
+
+static void test_async(ldb_context_t* context){
+    uint64_t nextver = time_ms();
+    char buf[32];
+    for(int i = 0; i < ASYNC_WRITES; ++i){
+        snprintf(buf, sizeof(buf), "async%d", i);
+        ldb_slice_t *key = ldb_slice_create(buf, strlen(buf));
+        ldb_slice_t *val = ldb_slice_create(buf, strlen(buf));
+        ldb_meta_t *meta = ldb_meta_create(0, 0, nextver);
+        ldb_txn_t *txn = ldb_txn_create();
+        assert(string_txn_set(txn, key, val, meta) == LDB_OK);
+        uint32_t stripe = ldb_context_key_stripe(buf, strlen(buf));
+        assert(ldb_write_async(context, txn, &stripe, 1, i) == LDB_OK);
+        ldb_meta_destroy(meta);
+        ldb_slice_destroy(val);
+        ldb_slice_destroy(key);
+    }
+
+    //completions come in the order of the writes
+    int done = 0;
+    struct pollfd pfd = {ldb_async_fd(context), POLLIN, 0};
+    ldb_async_done_t dones[16];
+    while(done < ASYNC_WRITES){
+        assert(poll(&pfd, 1, 10000) == 1);
+        uint64_t count = 0;
+        assert(read(pfd.fd, &count, sizeof(count)) == sizeof(count));
+        size_t num = 0;
+        while((num = ldb_async_poll(context, dones, 16)) > 0){
+            for(size_t i = 0; i < num; ++i){
+                assert(dones[i].tag_ == (uint64_t)done);
+                assert(dones[i].retval_ == LDB_OK);
+                ++done;
+            }
+        }
+    }
+
+    for(int i = 0; i < ASYNC_WRITES; ++i){
+        snprintf(buf, sizeof(buf), "async%d", i);
+        ldb_slice_t *key = ldb_slice_create(buf, strlen(buf));
+        ldb_slice_t *val = NULL;
+        ldb_meta_t *meta = NULL;
+        assert(string_get(context, key, &val, &meta) == LDB_OK);
+        assert(ldb_slice_size(val) == strlen(buf) && memcmp(ldb_slice_data(val), buf, strlen(buf)) == 0);
+        ldb_slice_destroy(val);
+        ldb_meta_destroy(meta);
+        ldb_slice_destroy(key);
+    }
+}
 
 int main(int argc, char* argv[]){
-    ldb_context_t *context = ldb_context_create("/tmp/teststring", 128, 64, 1);
+    ldb_context_t *context = ldb_context_create("/tmp/teststring", 128, 64, 1, LDB_CACHE_LRU);
     assert(context != NULL);
 
     test_string(context);
     test_expire(context);
+    test_arena(context);
+    test_concurrent(context);
+    test_async(context);
 
 
 
@@ -1,11 +1,13 @@
 #include "ldb/t_zset.h"
 #include "ldb/ldb_define.h"
 #include "ldb/util.h"
+#include "ldb/ldb_session.h"
 
 #include <leveldb/c.h>
 #include <assert.h>
 #include <string.h>
 #include <stdio.h>
+#include <stdlib.h>
 
 static void test_zset(ldb_context_t* context){
     const char *zset_name1 = "zset_namekk";
@@ -184,13 +186,265 @@ static void test_zset(ldb_context_t* context){
 
 
 
+typedef struct zrank_member_t{
+    char key_[16];
+    int64_t score_;
+    int live_;
+} zrank_member_t;
+
+static int zrank_member_cmp(const void* a, const void* b){
+    const zrank_member_t *ma = (const zrank_member_t*)a, *mb = (const zrank_member_t*)b;
+    if(ma->live_ != mb->live_){
+        return mb->live_ - ma->live_;
+    }
+    if(ma->score_ != mb->score_){
+        return ma->score_ < mb->score_ ? -1 : 1;
+    }
+    return strcmp(ma->key_, mb->key_);
+}
+
+//checks zset_rank and zset_range against the members sorted by hand
+static void check_zrank(ldb_context_t* context, ldb_slice_t* slice_name, zrank_member_t* members, int n){
+    zrank_member_t sorted[256];
+    memcpy(sorted, members, sizeof(zrank_member_t) * n);
+    qsort(sorted, n, sizeof(zrank_member_t), zrank_member_cmp);
+    int live = 0;
+    while(live < n && sorted[live].live_){
+        ++live;
+    }
+    uint64_t size = 0;
+    assert(zset_size(context, slice_name, &size) == LDB_OK);
+    assert(size == (uint64_t)live);
+
+    int i = 0;
+    for(i = 0; i < live; ++i){
+        ldb_slice_t *slice_key = ldb_slice_create(sorted[i].key_, strlen(sorted[i].key_));
+        uint64_t rank = 0;
+        assert(zset_rank(context, slice_name, slice_key, 0, &rank) == LDB_OK);
+        assert(rank == (uint64_t)i);
+        assert(zset_rank(context, slice_name, slice_key, 1, &rank) == LDB_OK);
+        assert(rank == (uint64_t)(live - 1 - i));
+        ldb_slice_destroy(slice_key);
+    }
+
+    int reverse = 0;
+    for(reverse = 0; reverse <= 1; ++reverse){
+        for(i = 0; i < live; i += 7){
+            ldb_list_t *keylist = NULL, *metalist = NULL;
+            assert(zset_range(context, slice_name, i, i + 4, reverse, &keylist, &metalist) == LDB_OK);
+            ldb_list_iterator_t *iterator = ldb_list_iterator_create(keylist);
+            int pos = i;
+            while(1){
+                ldb_list_node_t *node_key = ldb_list_next(&iterator);
+                if(node_key == NULL){
+                    break;
+                }
+                const zrank_member_t *m = &sorted[reverse ? live - 1 - pos : pos];
+                assert(ldb_slice_size(node_key->data_) == strlen(m->key_));
+                assert(memcmp(ldb_slice_data(node_key->data_), m->key_, strlen(m->key_)) == 0);
+                assert(node_key->value_ == m->score_);
+                ++pos;
+            }
+            assert(pos - i >= (live - i < 5 ? live - i : 5));
+            ldb_list_iterator_destroy(iterator);
+            ldb_list_destroy(keylist);
+            ldb_list_destroy(metalist);
+        }
+    }
+}
+
+static void test_zset_rank_index(ldb_context_t* context){
+    const char *zset_name = "zset_rank_index";
+    ldb_slice_t *slice_name = ldb_slice_create(zset_name, strlen(zset_name));
+    zrank_member_t members[256];
+    uint64_t nextver = time_ms();
+    int n = 200, i = 0;
+    for(i = 0; i < n; ++i){
+        snprintf(members[i].key_, sizeof(members[i].key_), "member%03d", (i * 73) % n);
+        members[i].score_ = (int64_t)(i % 37 - 18) * 1000003;
+        members[i].live_ = 1;
+    }
+    members[0].score_ = INT64_MIN + 1;
+    members[1].score_ = ((int64_t)1) << 62;
+    members[2].score_ = -(((int64_t)1) << 40);
+    for(i = 0; i < n; ++i){
+        ldb_slice_t *slice_key = ldb_slice_create(members[i].key_, strlen(members[i].key_));
+        ldb_meta_t *meta = ldb_meta_create(0, 0, ++nextver);
+        assert(zset_add(context, slice_name, slice_key, meta, members[i].score_) == LDB_OK);
+        ldb_meta_destroy(meta);
+        ldb_slice_destroy(slice_key);
+    }
+    check_zrank(context, slice_name, members, n);
+
+    int retval = zset_rank_index_build(context, slice_name);
+    assert(retval == LDB_OK || retval == LDB_OK_BUT_ALREADY_EXIST);
+    assert(zset_rank_index_build(context, slice_name) == LDB_OK_BUT_ALREADY_EXIST);
+    check_zrank(context, slice_name, members, n);
+
+    //moves, deletes and re-adds keep the index in step
+    for(i = 0; i < n; i += 3){
+        ldb_slice_t *slice_key = ldb_slice_create(members[i].key_, strlen(members[i].key_));
+        ldb_meta_t *meta = ldb_meta_create(0, 0, ++nextver);
+        if(i % 2 == 0){
+            members[i].score_ = members[i].score_ / 2 + 5;
+            assert(zset_add(context, slice_name, slice_key, meta, members[i].score_) == LDB_OK);
+        }else{
+            assert(zset_del(context, slice_name, slice_key, meta) == LDB_OK);
+            members[i].live_ = 0;
+        }
+        ldb_meta_destroy(meta);
+        ldb_slice_destroy(slice_key);
+    }
+    check_zrank(context, slice_name, members, n);
+
+    //one batch moves, adds and re-adds members, repeats apply in order
+    ldb_list_t *keylist = ldb_list_create(), *metalist = ldb_list_create(), *retlist = NULL;
+    int batch[] = {4, 5, 6, 200, 201, 4, 200, 9};
+    int64_t batch_scores[] = {7, -7, 70, 3, 4, -9, 11, 8};
+    for(i = 0; i < (int)(sizeof(batch) / sizeof(batch[0])); ++i){
+        int m = batch[i];
+        if(m >= n){
+            snprintf(members[m].key_, sizeof(members[m].key_), "added%03d", m);
+            n = m + 1;
+        }
+        members[m].score_ = batch_scores[i];
+        members[m].live_ = 1;
+        ldb_list_node_t *node_key = ldb_list_node_create();
+        node_key->type_ = LDB_LIST_NODE_TYPE_SLICE;
+        node_key->value_ = batch_scores[i];
+        node_key->data_ = ldb_slice_create(members[m].key_, strlen(members[m].key_));
+        rpush_ldb_list_node(keylist, node_key);
+        ldb_list_node_t *node_meta = ldb_list_node_create();
+        node_meta->type_ = LDB_LIST_NODE_TYPE_META;
+        node_meta->data_ = ldb_meta_create(0, 0, ++nextver);
+        rpush_ldb_list_node(metalist, node_meta);
+    }
+    assert(zset_madd(context, slice_name, keylist, metalist, &retlist) == LDB_OK);
+    assert(retlist->length_ == keylist->length_);
+    ldb_list_destroy(keylist);
+    ldb_list_destroy(metalist);
+    ldb_list_destroy(retlist);
+    check_zrank(context, slice_name, members, n);
+
+    keylist = ldb_list_create();
+    metalist = ldb_list_create();
+    int removed[] = {5, 201, 5, 10, 11};
+    for(i = 0; i < (int)(sizeof(removed) / sizeof(removed[0])); ++i){
+        members[removed[i]].live_ = 0;
+        ldb_list_node_t *node_key = ldb_list_node_create();
+        node_key->type_ = LDB_LIST_NODE_TYPE_SLICE;
+        node_key->data_ = ldb_slice_create(members[removed[i]].key_, strlen(members[removed[i]].key_));
+        rpush_ldb_list_node(keylist, node_key);
+        ldb_list_node_t *node_meta = ldb_list_node_create();
+        node_meta->type_ = LDB_LIST_NODE_TYPE_META;
+        node_meta->data_ = ldb_meta_create(0, 0, ++nextver);
+        rpush_ldb_list_node(metalist, node_meta);
+    }
+    assert(zset_mdel(context, slice_name, keylist, metalist, &retlist) == LDB_OK);
+    ldb_list_destroy(keylist);
+    ldb_list_destroy(metalist);
+    ldb_list_destroy(retlist);
+    check_zrank(context, slice_name, members, n);
+
+    uint64_t size = 0, deleted = 0;
+    assert(zset_size(context, slice_name, &size) == LDB_OK);
+    ldb_meta_t *meta = ldb_meta_create(0, 0, ++nextver);
+    assert(zset_del_range_by_score(context, slice_name, meta, INT64_MIN, INT64_MAX, &deleted) == LDB_OK);
+    assert(deleted == size);
+    ldb_meta_destroy(meta);
+    printf("zset_rank_index checked %lu members\n", size);
+    ldb_slice_destroy(slice_name);
+}
+
+//a reopened context still knows which zsets carry an index
+static void test_zset_rank_index_reopen(ldb_context_t* context){
+    const char *zset_name = "zset_rank_index";
+    ldb_slice_t *slice_name = ldb_slice_create(zset_name, strlen(zset_name));
+    assert(zset_rank_index_build(context, slice_name) == LDB_OK_BUT_ALREADY_EXIST);
+    zrank_member_t members[64];
+    uint64_t nextver = time_ms();
+    int n = 64, i = 0;
+    for(i = 0; i < n; ++i){
+        snprintf(members[i].key_, sizeof(members[i].key_), "reopen%03d", i);
+        members[i].score_ = (int64_t)(i % 7) * 100 - i;
+        members[i].live_ = 1;
+        ldb_slice_t *slice_key = ldb_slice_create(members[i].key_, strlen(members[i].key_));
+        ldb_meta_t *meta = ldb_meta_create(0, 0, ++nextver);
+        assert(zset_add(context, slice_name, slice_key, meta, members[i].score_) == LDB_OK);
+        ldb_meta_destroy(meta);
+        ldb_slice_destroy(slice_key);
+    }
+    check_zrank(context, slice_name, members, n);
+
+    uint64_t deleted = 0;
+    ldb_meta_t *meta = ldb_meta_create(0, 0, ++nextver);
+    assert(zset_del_range_by_score(context, slice_name, meta, INT64_MIN, INT64_MAX, &deleted) == LDB_OK);
+    assert(deleted == (uint64_t)n);
+    ldb_meta_destroy(meta);
+    ldb_slice_destroy(slice_name);
+}
+
+static void test_zscan(ldb_context_t* context){
+    const char *name = "zset_scan";
+    ldb_slice_t *slice_name = ldb_slice_create(name, strlen(name));
+    uint64_t nextver = time_ms();
+    char member[32];
+    const int count = 50;
+    for(int i=0; i<count; ++i){
+        snprintf(member, sizeof(member), "member_%03d", i);
+        ldb_slice_t *slice_key = ldb_slice_create(member, strlen(member));
+        ldb_meta_t *meta = ldb_meta_create(0, 0, nextver);
+        assert(zset_add(context, slice_name, slice_key, meta, count - 2*i) == LDB_OK);
+        ldb_slice_destroy(slice_key);
+        ldb_meta_destroy(meta);
+    }
+
+    value_item_t items[8];
+    int64_t scores[8];
+    char buf[256];
+    ldb_scan_page_t page;
+    memset(&page, 0, sizeof(page));
+    page.count_ = 8;
+    page.items_ = items;
+    page.scores_ = scores;
+    page.buf_ = buf;
+    page.buflen_ = sizeof(buf);
+
+    char cursor[LDB_SCAN_CURSOR_MAX];
+    size_t cursorlen = 0;
+    int seen = 0;
+    do{
+        assert(ldb_zscan(context, (char*)name, strlen(name), cursor, cursorlen, &page) == LDB_OK);
+        for(size_t i=0; i<page.itemnum_; ++i){
+            snprintf(member, sizeof(member), "member_%03d", seen);
+            assert(compare_with_length(items[i].data_, items[i].data_len_, member, strlen(member)) == 0);
+            assert(scores[i] == count - 2*seen);
+            ++seen;
+        }
+        memcpy(cursor, page.next_, page.nextlen_);
+        cursorlen = page.nextlen_;
+    }while(cursorlen > 0);
+    assert(seen == count);
+
+    ldb_slice_destroy(slice_name);
+}
+
 int main(int argc, char* argv[]){
-    ldb_context_t *context = ldb_context_create("/tmp/testzset", 128, 64, 1);
+    ldb_context_t *context = ldb_context_create("/tmp/testzset", 128, 64, 1, LDB_CACHE_CLOCK);
     assert(context != NULL);
     
 
     test_zset(context);
 
+    test_zset_rank_index(context);
+
+    test_zscan(context);
+
+    ldb_context_destroy(context);
+    context = ldb_context_create("/tmp/testzset", 128, 64, 1, LDB_CACHE_CLOCK);
+    assert(context != NULL);
+    ldb_context_do_write_recovering(context);
+    test_zset_rank_index_reopen(context);
 
     ldb_context_destroy(context);  
     return 0;